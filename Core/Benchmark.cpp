@@ -0,0 +1,123 @@
+#include "Benchmark.h"
+#include "Renderer.h"
+#include <QDebug>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <exception>
+#include <numeric>
+#include <string>
+#include <vector>
+
+namespace bbl
+{
+
+namespace
+{
+// Nærmeste rang, samme definisjon for alle kolonnene
+double percentile(const std::vector<double>& sorted, double fraction)
+{
+    size_t rank = static_cast<size_t>(std::ceil(fraction * sorted.size()));
+    return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+
+void printRow(const char* name, std::vector<double> samples)
+{
+    if (samples.empty()) {
+        std::printf("%-12s %8s\n", name, "n/a");
+        return;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    double mean = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+    std::printf("%-12s %8.3f %8.3f %8.3f %8.3f %8.3f %8zu\n", name, mean, percentile(samples, 0.50),
+                percentile(samples, 0.90), percentile(samples, 0.99), samples.back(), samples.size());
+}
+}
+
+int runBenchmark(const BenchmarkOptions& options)
+{
+    Renderer renderer;
+    try {
+        renderer.initHeadless(options.width, options.height);
+    } catch (const std::exception& e) {
+        qCritical() << "Benchmark: could not initialise Vulkan:" << e.what();
+        return 1;
+    }
+    // Samme simulering hver kjøring, uavhengig av hvor raskt framene går
+    renderer.setFixedTimeStep(1.0f / 60.0f);
+    if (options.framesInFlight > 0) {
+        renderer.setFramesInFlight(options.framesInFlight);
+    }
+
+    SceneManager* sceneManager = renderer.getSceneManager();
+    if (!sceneManager->loadScene(options.scenePath.toStdString())) {
+        qCritical() << "Benchmark: could not load" << options.scenePath;
+        return 1;
+    }
+    // Som i MainWindow: kollisjonssystemet må vite hvilken entitet som er terrenget
+    for (const auto& [id, name] : sceneManager->getEntityNames()) {
+        if (name == "Terrain") {
+            renderer.getGameWorld()->setTerrainEntity(id);
+            break;
+        }
+    }
+    renderer.markSceneChanged();
+
+    // Oppvarming: opplastinger, pipeline-varianter i bakgrunnen og vekst i upload-minnet
+    for (uint32_t i = 0; i < options.warmupFrames; ++i) {
+        renderer.renderFrame();
+    }
+    renderer.waitIdle();
+
+    std::vector<double> frameMs, cpuMs, gpuMs;
+    frameMs.reserve(options.frames);
+    cpuMs.reserve(options.frames);
+    gpuMs.reserve(options.frames);
+
+    // GPU-tiden for en frame blir kjent først når fencen dens er ventet på, noen frames senere
+    const uint64_t firstMeasured = renderer.getFrameCount() + 1;
+    uint64_t lastGpuFrame = 0;
+    auto previous = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < options.frames; ++i) {
+        renderer.renderFrame();
+
+        auto now = std::chrono::steady_clock::now();
+        frameMs.push_back(std::chrono::duration<double, std::milli>(now - previous).count());
+        previous = now;
+
+        Renderer::FrameTimings timings = renderer.getFrameTimings();
+        cpuMs.push_back(timings.cpuRecordMs);
+        if (timings.gpuFrame >= firstMeasured && timings.gpuFrame != lastGpuFrame) {
+            gpuMs.push_back(timings.gpuMs);
+            lastGpuFrame = timings.gpuFrame;
+        }
+    }
+    renderer.waitIdle();
+
+    Renderer::RenderStats stats = renderer.getRenderStats();
+    std::printf("Benchmark: %s, %ux%u, %u frames (%u warmup, %u in flight), %u drawn / %u culled, "
+                "%u draw calls, %u pipeline / %u descriptor binds\n",
+                options.scenePath.toUtf8().constData(), options.width, options.height, options.frames,
+                options.warmupFrames, renderer.getFramesInFlight(), stats.drawnEntities, stats.culledEntities,
+                stats.drawCalls, stats.pipelineBinds, stats.descriptorBinds);
+    std::printf("%-12s %8s %8s %8s %8s %8s %8s\n", "ms", "mean", "p50", "p90", "p99", "max", "samples");
+    printRow("frame", frameMs);
+    printRow("cpu record", cpuMs);
+    printRow("gpu", gpuMs);
+
+    // Fordelingen på scopes fra GpuProfiler, glidende snitt over de siste framene
+    bbl::GpuProfiler::Results profile = renderer.getGpuProfile();
+    for (const bbl::GpuProfiler::Scope& scope : profile.scopes) {
+        std::string name = std::string(scope.depth * 2, ' ') + scope.name;
+        std::printf("  %-30s %8.3f\n", name.c_str(), scope.averageMs);
+    }
+    std::fflush(stdout);
+
+    if (!options.screenshotPath.isEmpty() && !renderer.saveFrameImage(options.screenshotPath)) {
+        return 1;
+    }
+    return 0;
+}
+}
@@ -0,0 +1,26 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QString>
+#include <cstdint>
+
+namespace bbl
+{
+// Rendrer en scene headless i et fast antall frames og skriver tidene til stdout.
+// Startes med QtVulkan --benchmark <scene>, se main.cpp og målet benchmark i CMakeLists.txt.
+struct BenchmarkOptions
+{
+    QString scenePath;
+    QString screenshotPath;   // Tom = ingen readback
+    uint32_t width = 1280;
+    uint32_t height = 720;
+    uint32_t warmupFrames = 60;
+    uint32_t frames = 300;
+    uint32_t framesInFlight = 0;   // 0 = rendererens standard
+};
+
+// Returnerer exit-koden til prosessen
+int runBenchmark(const BenchmarkOptions& options);
+}
+
+#endif // BENCHMARK_H
@@ -2,6 +2,58 @@
 #include "../Editor/MainWindow.h"
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/constants.hpp>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define BBL_FRUSTUM_SSE 1
+#include <xmmintrin.h>
+#endif
+
+void Frustum::cullSpheres(const float* centerX, const float* centerY, const float* centerZ,
+                          const float* radius, size_t count, uint8_t* visible) const
+{
+    size_t i = 0;
+
+#ifdef BBL_FRUSTUM_SSE
+    // Planene lastes én gang, hver lane tester sin egen kule
+    __m128 planeX[6], planeY[6], planeZ[6], planeD[6];
+    for (int p = 0; p < 6; p++)
+    {
+        planeX[p] = _mm_set1_ps(planes[p].normal.x);
+        planeY[p] = _mm_set1_ps(planes[p].normal.y);
+        planeZ[p] = _mm_set1_ps(planes[p].normal.z);
+        planeD[p] = _mm_set1_ps(planes[p].distance);
+    }
+
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 cx = _mm_loadu_ps(centerX + i);
+        __m128 cy = _mm_loadu_ps(centerY + i);
+        __m128 cz = _mm_loadu_ps(centerZ + i);
+        __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+
+        __m128 inside = _mm_cmpge_ps(_mm_setzero_ps(), _mm_setzero_ps());
+        for (int p = 0; p < 6; p++)
+        {
+            __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], cx), _mm_mul_ps(planeY[p], cy)),
+                                     _mm_add_ps(_mm_mul_ps(planeZ[p], cz), planeD[p]));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(dist, negRadius));
+        }
+
+        int mask = _mm_movemask_ps(inside);
+        visible[i + 0] = static_cast<uint8_t>(mask & 1);
+        visible[i + 1] = static_cast<uint8_t>((mask >> 1) & 1);
+        visible[i + 2] = static_cast<uint8_t>((mask >> 2) & 1);
+        visible[i + 3] = static_cast<uint8_t>((mask >> 3) & 1);
+    }
+#endif
+
+    // Resten (og alt uten SSE, f.eks. ARM)
+    for (; i < count; i++)
+    {
+        visible[i] = containsSphere(glm::vec3(centerX[i], centerY[i], centerZ[i]), radius[i]) ? 1 : 0;
+    }
+}
 
 Camera::Camera()
 {
@@ -58,6 +110,21 @@ glm::mat4 Camera::getProjectionMatrix(float aspectRatio, float fov, float nearPl
     return glm::perspective(glm::radians(fov), aspectRatio, nearPlane, farPlane);
 }
 
+bbl::Ray Camera::screenPointToRay(float screenX, float screenY, float width, float height) const
+{
+    // Normaliserte koordinater -1..1, y opp
+    float ndcX = (2.0f * screenX) / width - 1.0f;
+    float ndcY = 1.0f - (2.0f * screenY) / height;
+
+    float tanHalfFov = std::tan(glm::radians(fov) * 0.5f);
+    float aspectRatio = width / height;
+
+    bbl::Ray ray;
+    ray.origin = position;
+    ray.direction = glm::normalize(forward + right * (ndcX * tanHalfFov * aspectRatio) + up * (ndcY * tanHalfFov));
+    return ray;
+}
+
 void Camera::updateFrustum(float aspectRatio, float fov, float nearPlane, float farPlane)
 {
 
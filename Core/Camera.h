@@ -1,5 +1,8 @@
 #pragma once
 #include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include "Utility/Raycast.h"
 
 struct Plane
 {
@@ -42,6 +45,11 @@ struct Frustum
         return true;
     }
 
+    // Samme test som containsSphere for count kuler på én gang, fire om gangen med SSE.
+    // Kulene ligger som SoA; visible[i] settes til 1 hvis kule i kan være synlig.
+    void cullSpheres(const float* centerX, const float* centerY, const float* centerZ,
+                     const float* radius, size_t count, uint8_t* visible) const;
+
     // checks AABB
     bool containsAABB(const glm::vec3& min, const glm::vec3& max) const
     {
@@ -86,6 +94,9 @@ public:
 
     glm::vec3 getPosition() const { return position; }
 
+    // Stråle fra kameraet gjennom et punkt i vinduet (pixels, origo øverst til venstre)
+    bbl::Ray screenPointToRay(float screenX, float screenY, float width, float height) const;
+
 
     //Movement Helper for Camera. To make less clutter in UBO in Renderer
     void processInput(bool w, bool a, bool s, bool d, bool q, bool e, float deltaTime);
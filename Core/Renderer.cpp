@@ -31,7 +31,10 @@
 #include <unordered_map>
 #include <QDebug>
 #include <QKeyEvent>
+#include <QImage>
 #include "../Core/Utility/BblHub.h"
+#include "../Core/Utility/JobSystem.h"
+#include "../Core/Utility/RadixSort.h"
 #include "../Soundsystem/resourcemanager.h"
 #include "../Editor/MainWindow.h"
 #include "../Game/GameWorld.h"
@@ -54,14 +57,28 @@ Renderer::Renderer(QWindow* parent) : QWindow(parent)
 
     camera = new Camera();
     BBLHub::Instance().SetCamera(camera);
+
+    // Standardvalg for presentasjon og pacing, kan overstyres fra miljøet som BBL_GPU_CULLING
+    const int frameCount = qEnvironmentVariableIntValue("BBL_FRAMES_IN_FLIGHT");
+    setFramesInFlight(frameCount > 0 ? static_cast<uint32_t>(frameCount) : DEFAULT_FRAMES_IN_FLIGHT);
+    const QByteArray mode = qgetenv("BBL_PRESENT_MODE").toLower();
+    if (mode == "fifo") {
+        setPresentMode(PresentMode::Fifo);
+    } else if (mode == "immediate") {
+        setPresentMode(PresentMode::Immediate);
+    } else if (mode == "mailbox") {
+        setPresentMode(PresentMode::Mailbox);
+    }
+    setTargetLatency(qEnvironmentVariable("BBL_TARGET_LATENCY_MS").toDouble());
 }
 
 Renderer::~Renderer()
 {
 
     qDebug("VulkanRenderer Destructor");
-    delete camera;
+    // Rendertråden bruker kameraet helt til cleanup() har stoppet den
     cleanup();
+    delete camera;
 }
 
 // void Renderer::initWindow() {
@@ -80,26 +97,39 @@ Renderer::~Renderer()
 // }
 
 void Renderer::initVulkan() {
+    framesInFlight = requestedFramesInFlight;
+    presentMode = requestedPresentMode;
+    windowWidth = width();
+    windowHeight = height();
+
     createInstance();
     setupDebugMessenger();
-    createSurface();
+    if (!headless) {
+        createSurface();
+    }
     pickPhysicalDevice();
     createLogicalDevice();
+    memoryAllocator = std::make_unique<bbl::DeviceMemoryAllocator>(device, deviceProperties, memoryProperties);
+    uploadQueue = std::make_unique<bbl::UploadQueue>(device, memoryAllocator.get(), transferQueue,
+                                                     transferQueueFamily, graphicsQueueFamily);
+    pipelineRegistry = std::make_unique<bbl::PipelineRegistry>(device, deviceProperties, PATH + "pipeline_cache.bin",
+                                                               BBLHub::Instance().getJobSystem());
+    unlitShaders = pipelineRegistry->addShaderSet(PATH + "Shaders/vert.spv", PATH + "Shaders/frag.spv");
+    phongShaders = pipelineRegistry->addShaderSet(PATH + "Shaders/phong.vert.spv", PATH + "Shaders/phong.frag.spv");
+
     createSwapChain();
     createImageViews();
-    createRenderPass();
     createDescriptorSetLayout();
-    createGraphicsPipeline("Shaders/vert.spv", "Shaders/frag.spv", graphicsPipeline, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
-    createGraphicsPipeline("Shaders/phong.vert.spv", "Shaders/phong.frag.spv", phongPipeline, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
-    createGraphicsPipeline("Shaders/vert.spv", "Shaders/point.frag.spv", pointPipeline, VK_PRIMITIVE_TOPOLOGY_POINT_LIST);
-    createGraphicsPipeline("Shaders/vert.spv", "Shaders/point.frag.spv", linePipeline, VK_PRIMITIVE_TOPOLOGY_LINE_LIST);
+    createPipelines();
     createCommandPool();
     createColorResources();
     createDepthResources();
     createFramebuffers();
 
     // Initialize ResourceManager to handle all GPU resources
-    GPUresources.reset(new bbl::GPUResourceManager(device, physicalDevice, commandPool, graphicsQueue));
+    GPUresources.reset(new bbl::GPUResourceManager(device, physicalDevice, uploadQueue.get(),
+                                                  memoryAllocator.get()));
+    GPUresources->setFramesInFlight(framesInFlight);
 
     // Initialize EntityManager with GPU resources
     entityManager.reset(new bbl::EntityManager(GPUresources.get()));
@@ -111,6 +141,11 @@ void Renderer::initVulkan() {
     m_gameWorld.Setup();                         // Sett til true for å ha friksjonsone på terrenget
     m_gameWorld.initializeSystems(entityManager.get(), this, true);
 
+    // Headless og benchmark simulerer i drawFrame() med tick(), så kjøringene blir like
+    simulation = std::make_unique<bbl::SimulationThread>(m_gameWorld, *entityManager);
+    simulation->setResourceMutex(&gpuMutex);
+    simulation->setPublishListener([this] { requestRender(); });
+
     // Create ModelLoader instance
     bbl::ModelLoader modelLoader;
 
@@ -138,11 +173,115 @@ void Renderer::initVulkan() {
 
     qDebug() << "How many entities in the scene?:" << entityManager->getEntityCount();
 
-    createUniformBuffers();
-    createDescriptorPool();
-    createDescriptorSets();
-    createCommandBuffers();
+    createFrameResources();
     createSyncObjects();
+
+    // Headless og benchmark rendrer på kallende tråd med renderFrame()
+    if (!headless) {
+        simulation->start();
+        startRenderThread();
+    }
+}
+
+void Renderer::initHeadless(uint32_t width, uint32_t height)
+{
+    headless = true;
+    swapChainExtent = {width, height};
+    initVulkan();
+}
+
+void Renderer::waitIdle()
+{
+    pipelineRegistry->waitForCompiles();
+    std::lock_guard<std::recursive_mutex> lock(gpuMutex);
+    vkDeviceWaitIdle(device);
+}
+
+void Renderer::setFramesInFlight(uint32_t count)
+{
+    requestedFramesInFlight = std::clamp<uint32_t>(count, 1, MAX_FRAMES_IN_FLIGHT);
+    requestRender();
+}
+
+void Renderer::requestRender()
+{
+    {
+        std::lock_guard<std::mutex> lock(renderWakeMutex);
+        renderRequested = true;
+    }
+    renderWake.notify_one();
+}
+
+bool Renderer::needsFrame()
+{
+    if (renderRequested.exchange(false)) {
+        settleFrames = framesInFlight;
+        return true;
+    }
+    if (!m_gameWorld.isPaused() || keyW || keyA || keyS || keyD || keyQ || keyE ||
+        pipelineRegistry->hasPendingCompiles()) {
+        return true;
+    }
+    if (settleFrames > 0) {
+        --settleFrames;
+        return true;
+    }
+    return false;
+}
+
+void Renderer::startRenderThread()
+{
+    renderThreadStop = false;
+    renderThread = std::thread([this] { renderLoop(); });
+    qDebug() << "Render thread started";
+}
+
+void Renderer::stopRenderThread()
+{
+    if (!renderThread.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(renderWakeMutex);
+        renderThreadStop = true;
+    }
+    renderWake.notify_all();
+    renderThread.join();
+}
+
+void Renderer::renderLoop()
+{
+    auto visible = [this] {
+        return windowExposed.load() && windowWidth.load() > 0 && windowHeight.load() > 0;
+    };
+
+    while (!renderThreadStop.load()) {
+        // Skjult eller minimert: ingen bilder å få fra swapchainen, vent til vinduet vises
+        if (!visible()) {
+            std::unique_lock<std::mutex> lock(renderWakeMutex);
+            renderWake.wait_for(lock, std::chrono::milliseconds(100), [&] {
+                return renderThreadStop.load() || visible();
+            });
+            continue;
+        }
+
+        // Pauset, stille kamera og ingen endringer: sov til noe kaller requestRender()
+        if (!needsFrame()) {
+            std::unique_lock<std::mutex> lock(renderWakeMutex);
+            renderWake.wait(lock, [this] { return renderThreadStop.load() || renderRequested.load(); });
+            // Tiden vi sov er ikke et frame-intervall
+            framePacer.reset();
+            continue;
+        }
+
+        try {
+            drawFrame();
+        } catch (const std::exception& e) {
+            // Et unntak her ville avsluttet programmet uten melding
+            qCritical() << "Render thread stopped:" << e.what();
+            return;
+        }
+    }
 }
 
 
@@ -150,67 +289,64 @@ bbl::EntityID Renderer::spawnModel(const std::string& modelPath,
                                    const std::string& texturePath,
                                    const glm::vec3& basePosition)
 {
+    // Modellen lastes før låsen tas, simuleringen står bare stille mens entiteten lages
     bbl::ModelLoader loader;
     auto model = loader.loadModel(modelPath, texturePath);
 
-    bbl::EntityID newEntity = bbl::INVALID_ENTITY;
+    return simulation->execute([&] {
+        bbl::EntityID newEntity = bbl::INVALID_ENTITY;
 
-    if (model && !model->meshes.empty()) {
-        // Calculate spawn position with offset
-        glm::vec3 spawnPosition = basePosition + mNextSpawnOffset;
+        if (model && !model->meshes.empty()) {
+            // Calculate spawn position with offset
+            glm::vec3 spawnPosition = basePosition + mNextSpawnOffset;
 
-        // Get the first mesh from the model
-        const auto& meshData = model->meshes[0];
+            // Get the first mesh from the model
+            const auto& meshData = model->meshes[0];
 
-        // Create entity with mesh
-        newEntity = entityManager->createEntityFromMesh(meshData, spawnPosition);
-
-        // Store the model path in the mesh component
-        if (auto* meshComp = entityManager->getComponent<bbl::Mesh>(newEntity)) {
-            meshComp->modelPath = modelPath;
-            meshComp->meshIndex = 0;
-        }
+            // Create entity with mesh
+            newEntity = entityManager->createEntityFromMesh(meshData, spawnPosition);
 
-        // Add texture if provided and exists in the model
-        if (!texturePath.empty()) {
-            auto textureResourceID = GPUresources->uploadTexture(texturePath);
-            // ... rest of texture code
-        }
-
-        // Add texture if provided and exists in the model
-        if (!texturePath.empty()) {
-            auto textureResourceID = GPUresources->uploadTexture(texturePath);
-            bbl::Texture texComp;
-            texComp.textureResourceID = textureResourceID;
-            texComp.texturePath = texturePath;
-            entityManager->addComponent(newEntity, texComp);
+            // Store the model path in the mesh component
+            if (auto* meshComp = entityManager->getComponent<bbl::Mesh>(newEntity)) {
+                meshComp->modelPath = modelPath;
+                meshComp->meshIndex = 0;
+            }
 
-            // Update render component with texture
-            if (auto* render = entityManager->getComponent<bbl::Render>(newEntity)) {
-                render->textureResourceID = textureResourceID;
-                render->usePoint = false;
+            // Add texture if provided and exists in the model
+            if (!texturePath.empty()) {
+                auto textureResourceID = GPUresources->uploadTexture(texturePath);
+                bbl::Texture texComp;
+                texComp.textureResourceID = textureResourceID;
+                texComp.texturePath = texturePath;
+                entityManager->addComponent(newEntity, texComp);
+
+                // Update render component with texture
+                if (auto* render = entityManager->getComponent<bbl::Render>(newEntity)) {
+                    render->textureResourceID = textureResourceID;
+                    render->usePoint = false;
+                }
             }
-        }
 
-        // Add entity to names map for UI display
-        if (sceneManager) {
-            sceneManager->setEntityName(newEntity, model->name);
-            sceneManager->markSceneDirty();
-        }
+            // Add entity to names map for UI display
+            if (sceneManager) {
+                sceneManager->setEntityName(newEntity, model->name);
+                sceneManager->markSceneDirty();
+            }
 
 
 
 
-        qInfo() << QString::fromStdString(model->name) << "successfully spawned with EntityID:" << newEntity;
+            qInfo() << QString::fromStdString(model->name) << "successfully spawned with EntityID:" << newEntity;
 
-        // Update spawn offset for next model
-        //mNextSpawnOffset.x += 0.2f;
-        //mNextSpawnOffset.z += 0.2f;
-    } else {
-        qWarning() << "Failed to spawn from" << QString::fromStdString(modelPath);
-    }
+            // Update spawn offset for next model
+            //mNextSpawnOffset.x += 0.2f;
+            //mNextSpawnOffset.z += 0.2f;
+        } else {
+            qWarning() << "Failed to spawn from" << QString::fromStdString(modelPath);
+        }
 
-    return newEntity;
+        return newEntity;
+    });
 }
 void Renderer::createEntitiesFromModel(const bbl::ModelData& modelData,
                                        const glm::vec3& basePosition, bool usePhong) {
@@ -327,46 +463,33 @@ void Renderer::createTerrainEntity(bbl::GameWorld* gameWorld) {
 }
 void Renderer::spawnTerrain()
 {
-    createTerrainEntity(&m_gameWorld);
-    recreateSwapChain();
+    simulation->execute([this] { createTerrainEntity(&m_gameWorld); });
+    markSceneChanged();
 }
 
 
 void Renderer::cleanupSwapChain() {
     vkDestroyImageView(device, depthImageView, nullptr);
-    vkDestroyImage(device, depthImage, nullptr);
-    vkFreeMemory(device, depthImageMemory, nullptr);
+    memoryAllocator->destroyImage(depthImage, depthImageAllocation);
 
     vkDestroyImageView(device, colorImageView, nullptr);
-    vkDestroyImage(device, colorImage, nullptr);
-    vkFreeMemory(device, colorImageMemory, nullptr);
+    memoryAllocator->destroyImage(colorImage, colorImageAllocation);
 
     for (auto framebuffer : swapChainFramebuffers) {
         vkDestroyFramebuffer(device, framebuffer, nullptr);
     }
 
-    vkFreeCommandBuffers(device, commandPool, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
-
-    vkDestroyPipeline(device, graphicsPipeline, nullptr);
-    vkDestroyPipeline(device, phongPipeline, nullptr);
-
-    std::cout << "Destroying pipeline layout" << std::endl;
-    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
-    pipelineLayout = VK_NULL_HANDLE;
-    vkDestroyRenderPass(device, renderPass, nullptr);
-
     for (auto imageView : swapChainImageViews) {
         vkDestroyImageView(device, imageView, nullptr);
     }
 
+    if (headless) {
+        for (size_t i = 0; i < swapChainImages.size(); ++i) {
+            memoryAllocator->destroyImage(swapChainImages[i], offscreenAllocations[i]);
+        }
+        return;
+    }
     vkDestroySwapchainKHR(device, swapChain, nullptr);
-
-    // for (size_t i = 0; i < swapChainImages.size(); i++) {
-    //     vkDestroyBuffer(device, uniformBuffers[i], nullptr);
-    //     vkFreeMemory(device, uniformBuffersMemory[i], nullptr);
-    // }
-
-    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
 }
 
 void Renderer::cleanup()
@@ -375,6 +498,10 @@ void Renderer::cleanup()
     std::cout << "STD::COUT << CLEANUP() IS CALLED";
 
     qDebug() << " CLEANUP() IS CALLED ";
+
+    // Rendertråden bruker alt under, og simuleringen ECS-en og GameWorld; stopp dem før noe rives
+    stopRenderThread();
+    simulation.reset();
     vkDeviceWaitIdle(device);
 
 
@@ -389,7 +516,13 @@ void Renderer::cleanup()
 
     cleanupSwapChain();
 
-
+    // Lagrer pipeline-cachen til neste oppstart
+    pipelineRegistry.reset();
+    std::cout << "Destroying pipeline layout" << std::endl;
+    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+    pipelineLayout = VK_NULL_HANDLE;
+    vkDestroyRenderPass(device, renderPass, nullptr);
+    renderPass = VK_NULL_HANDLE;
 
     // vkDestroySampler(device, textureSampler, nullptr);
     // vkDestroyImageView(device, textureImageView, nullptr);
@@ -404,27 +537,16 @@ void Renderer::cleanup()
     // vkDestroyBuffer(device, vertexBuffer, nullptr);
     // vkFreeMemory(device, vertexBufferMemory, nullptr);
 
-    //std::cout << "Cleaning up uniform buffers..." << std::endl;
-    for (size_t i = 0; i < swapChainImages.size(); i++) {
-        //std::cout << "  Destroying uniform buffer " << i << std::endl;
-        vkDestroyBuffer(device, uniformBuffers[i], nullptr);
-        vkFreeMemory(device, uniformBuffersMemory[i], nullptr);
-    }
-    //std::cout << "Uniform buffers cleanup complete" << std::endl;
+    destroyFrameResources();
 
-    // destroy per-image renderFinished semaphores
-    for (size_t i = 0; i < swapChainImages.size(); i++) {
-        vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
-    }
-
-    // destroy per-frame semaphores + fences
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
-        vkDestroyFence(device, inFlightFences[i], nullptr);
-    }
+    destroySyncObjects();
 
 
     vkDestroyCommandPool(device, commandPool, nullptr);
+
+    // Alle buffere og images er slettet over, blokkene kan gis tilbake
+    uploadQueue.reset();
+    memoryAllocator.reset();
     vkDestroyDevice(device, nullptr);
 
     if (enableValidationLayers) {
@@ -444,55 +566,64 @@ void Renderer::recreateSwapChain() {
     //     glfwWaitEvents();
     // }
 
+    // Bare for endringer i selve overflaten (resize, out-of-date, present mode). Endringer i
+    // scenen går via markSceneChanged().
+    std::lock_guard<std::recursive_mutex> lock(gpuMutex);
     vkDeviceWaitIdle(device);
 
-    std::cout << "Cleaning up old uniform buffers in recreateSwapChain..." << std::endl;
-    for (size_t i = 0; i < uniformBuffers.size(); i++)
-    {
-        if (uniformBuffers[i] != VK_NULL_HANDLE)
-        {
-            //std::cout << "  Destroying old uniform buffer " << i << std::endl;
-            vkDestroyBuffer(device, uniformBuffers[i], nullptr);
-            uniformBuffers[i] = VK_NULL_HANDLE;
-        }
-        if (uniformBuffersMemory[i] != VK_NULL_HANDLE)
-        {
-            //std::cout << "  Freeing old uniform buffer memory " << i << std::endl;
-            vkFreeMemory(device, uniformBuffersMemory[i], nullptr);
-            uniformBuffersMemory[i] = VK_NULL_HANDLE;
-        }
-    }
-
-
     cleanupSwapChain();
     createSwapChain();
     createImageViews();
-    createRenderPass();
-    createGraphicsPipeline("Shaders/vert.spv", "Shaders/frag.spv", graphicsPipeline, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
-    createGraphicsPipeline("Shaders/phong.vert.spv", "Shaders/phong.frag.spv", phongPipeline, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
-    createGraphicsPipeline("Shaders/vert.spv", "Shaders/point.frag.spv", pointPipeline, VK_PRIMITIVE_TOPOLOGY_POINT_LIST);
-    createGraphicsPipeline("Shaders/vert.spv", "Shaders/point.frag.spv", linePipeline, VK_PRIMITIVE_TOPOLOGY_LINE_LIST);
+    createPipelines();
     createColorResources();
     createDepthResources();
     createFramebuffers();
-    createUniformBuffers();
-    createDescriptorPool();
-    createDescriptorSets();
-    createCommandBuffers();
 
-    imagesInFlight.resize(swapChainImages.size(), VK_NULL_HANDLE);
+    // FrameData er uavhengig av swapchainen, command buffers tas opp hver frame uansett
+    imagesInFlight.assign(swapChainImages.size(), VK_NULL_HANDLE);
+
+    // Latency målt mot den gamle swapchainen sier ikke noe om den nye
+    framePacer.reset();
 }
 
-void Renderer::recreateCommandBuffers()
+void Renderer::applyFrameSettings()
 {
-    vkDeviceWaitIdle(device);
+    const uint32_t frameCount = requestedFramesInFlight;
+    const PresentMode mode = requestedPresentMode;
+    const bool framesChanged = frameCount != framesInFlight;
+    const bool modeChanged = !headless && mode != presentMode;
+    if (!framesChanged && !modeChanged) {
+        return;
+    }
 
-    if(!commandBuffers.empty())
-    {
-        vkFreeCommandBuffers(device, commandPool, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
+    std::lock_guard<std::recursive_mutex> lock(gpuMutex);
+    vkDeviceWaitIdle(device);
+    presentMode = mode;
+
+    // Alt med én kopi per frame in flight lages på nytt. Headless har også ett mål per frame,
+    // så swapchainen (eller offscreen-målene) bygges om i begge tilfeller.
+    if (framesChanged) {
+        qDebug() << "Frames in flight:" << framesInFlight << "->" << frameCount;
+        destroySyncObjects();
+        destroyFrameResources();
+        framesInFlight = frameCount;
+        GPUresources->setFramesInFlight(framesInFlight);
+        currentFrame = 0;
+    }
+    recreateSwapChain();
+    if (framesChanged) {
+        createFrameResources();
+        createSyncObjects();
     }
+}
 
-    createCommandBuffers();
+void Renderer::markSceneChanged()
+{
+    ++sceneVersion;
+    if (simulation) {
+        simulation->invalidate();
+    }
+    requestRender();
 }
 
 
@@ -510,7 +641,9 @@ void Renderer::createInstance() {
     appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
     appInfo.pEngineName = "INNgine";
     appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-    appInfo.apiVersion = VK_API_VERSION_1_0;
+    // 1.2 for drawIndirectCount (GPU-culling). Enheter med eldre versjon fungerer fortsatt,
+    // da brukes bare det de støtter.
+    appInfo.apiVersion = VK_API_VERSION_1_2;
 
     VkInstanceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -638,6 +771,8 @@ void Renderer::pickPhysicalDevice() {
     for (const auto& device : devices) {
         if (isDeviceSuitable(device)) {
             physicalDevice = device;
+            vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+            vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
             msaaSamples = getMaxUsableSampleCount();
             break;
         }
@@ -653,9 +788,27 @@ void Renderer::createLogicalDevice()
     //Get the queue family indices for the chosen Physical Device
     QueueFamilyIndices indices = findQueueFamilies(physicalDevice);
 
+    VkPhysicalDeviceVulkan12Features supportedFeatures12{};
+    supportedFeatures12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    if (deviceProperties.apiVersion >= VK_API_VERSION_1_2) {
+        VkPhysicalDeviceFeatures2 features2{};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &supportedFeatures12;
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+    }
+
+    // Egen transfer-kø for opplastinger. Krever timeline semaphores, ellers vet ikke
+    // grafikk-køen når kopiene er ferdige, og da brukes grafikk-køen.
+    graphicsQueueFamily = indices.graphicsFamily.value();
+    transferQueueFamily = graphicsQueueFamily;
+    if (indices.transferFamily && supportedFeatures12.timelineSemaphore) {
+        transferQueueFamily = indices.transferFamily.value();
+    }
+
     //Vector for queue creation information, and Set for family indices
     std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-    std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.presentFamily.value()};
+    std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.presentFamily.value(),
+                                              transferQueueFamily};
 
     //Queues the logical device needs to create and info to do so
     float queuePriority = 1.0f;
@@ -668,17 +821,44 @@ void Renderer::createLogicalDevice()
         queueCreateInfos.push_back(queueCreateInfo);
     }
 
+    VkPhysicalDeviceFeatures supportedFeatures{};
+    vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
     VkPhysicalDeviceFeatures deviceFeatures{};
     deviceFeatures.samplerAnisotropy = VK_TRUE;
 
+    // Indirect draw med mange kommandoer og firstInstance, for GPU-culling
+    multiDrawIndirectSupported = supportedFeatures.multiDrawIndirect && supportedFeatures.drawIndirectFirstInstance;
+    deviceFeatures.multiDrawIndirect = multiDrawIndirectSupported ? VK_TRUE : VK_FALSE;
+    deviceFeatures.drawIndirectFirstInstance = multiDrawIndirectSupported ? VK_TRUE : VK_FALSE;
+
+    // Pipeline-statistikk i GpuProfiler. Queryen er aktiv mens secondary buffers kjøres,
+    // så de må kunne arve den.
+    pipelineStatisticsSupported = supportedFeatures.pipelineStatisticsQuery && supportedFeatures.inheritedQueries;
+    deviceFeatures.pipelineStatisticsQuery = pipelineStatisticsSupported ? VK_TRUE : VK_FALSE;
+    deviceFeatures.inheritedQueries = pipelineStatisticsSupported ? VK_TRUE : VK_FALSE;
+
+    // drawIndirectCount lar GPU-en bestemme antall kommandoer, så tomme batcher hoppes over
+    VkPhysicalDeviceVulkan12Features enabledFeatures12{};
+    enabledFeatures12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    drawIndirectCountSupported = supportedFeatures12.drawIndirectCount == VK_TRUE;
+    enabledFeatures12.drawIndirectCount = supportedFeatures12.drawIndirectCount;
+    enabledFeatures12.timelineSemaphore = transferQueueFamily != graphicsQueueFamily ? VK_TRUE : VK_FALSE;
+
     //Information to create logical device (often just called "device")
     VkDeviceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
     createInfo.pEnabledFeatures = &deviceFeatures;
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    // Headless trenger ikke swapchain-utvidelsen
+    if (!headless) {
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
+        createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    }
+    if (deviceProperties.apiVersion >= VK_API_VERSION_1_2) {
+        createInfo.pNext = &enabledFeatures12;
+    }
 
     if (enableValidationLayers) {
         createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
@@ -699,9 +879,15 @@ void Renderer::createLogicalDevice()
     //(0 since only one queue), place reference into graphicsQueue
     vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
     vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+    vkGetDeviceQueue(device, transferQueueFamily, 0, &transferQueue);
 }
 
 void Renderer::createSwapChain() {
+    if (headless) {
+        createOffscreenTarget();
+        return;
+    }
+
     //Get swap chain details so we can pick best settings
     SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physicalDevice);
 
@@ -766,6 +952,26 @@ void Renderer::createSwapChain() {
     swapChainExtent = extent;
 }
 
+void Renderer::createOffscreenTarget()
+{
+    // Tar plassen til swapchain-bildene: resolve-målet for render passet, ett per frame in
+    // flight så to frames aldri skriver til samme image. swapChainExtent er satt av initHeadless().
+    swapChainImageFormat = findSupportedFormat({VK_FORMAT_R8G8B8A8_SRGB, VK_FORMAT_B8G8R8A8_SRGB},
+                                               VK_IMAGE_TILING_OPTIMAL,
+                                               VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_TRANSFER_SRC_BIT);
+
+    swapChainImages.assign(framesInFlight, VK_NULL_HANDLE);
+    offscreenAllocations.assign(framesInFlight, bbl::DeviceAllocation{});
+    for (size_t i = 0; i < swapChainImages.size(); ++i) {
+        createImage(swapChainExtent.width, swapChainExtent.height, 1, VK_SAMPLE_COUNT_1_BIT,
+                    swapChainImageFormat, VK_IMAGE_TILING_OPTIMAL,
+                    VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, swapChainImages[i], offscreenAllocations[i]);
+    }
+    qDebug("Created %d offscreen targets (%ux%u)", static_cast<int>(swapChainImages.size()),
+           swapChainExtent.width, swapChainExtent.height);
+}
+
 void Renderer::createImageViews() {
     swapChainImageViews.resize(swapChainImages.size());
 
@@ -804,7 +1010,9 @@ void Renderer::createRenderPass() {
     colorAttachmentResolve.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachmentResolve.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     colorAttachmentResolve.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    colorAttachmentResolve.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    // Headless leses bildet tilbake med en kopi i stedet for å presenteres
+    colorAttachmentResolve.finalLayout = headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+                                                  : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
     VkAttachmentReference colorAttachmentRef{};
     colorAttachmentRef.attachment = 0;
@@ -878,104 +1086,23 @@ void Renderer::createDescriptorSetLayout() {
     }
 }
 
-void Renderer::createGraphicsPipeline(std::string vertPath, std::string fragPath, VkPipeline& Pipeline, VkPrimitiveTopology topology) {
-    auto vertShaderCode = readFile(PATH + vertPath);
-    auto fragShaderCode = readFile(PATH + fragPath);
-
-    VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-    VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
-
-    VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
-    vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-    vertShaderStageInfo.module = vertShaderModule;
-    vertShaderStageInfo.pName = "main";
-
-    VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
-    fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    fragShaderStageInfo.module = fragShaderModule;
-    fragShaderStageInfo.pName = "main";
-
-    VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
-
-    // 1. Vertex input
-    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
-    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    VkVertexInputBindingDescription bindingDescription = Vertex::getBindingDescription();
-    std::array<VkVertexInputAttributeDescription, 4> attributeDescriptions = Vertex::getAttributeDescriptions();
-    vertexInputInfo.vertexBindingDescriptionCount = 1;
-    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-    vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-    vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
-
-    // 2. Input assembly
-    VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
-    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    inputAssembly.topology = topology;
-    inputAssembly.primitiveRestartEnable = VK_FALSE;
-
-    // 3. Viewport & Scissor (Modified for dynamic state)
-    VkPipelineViewportStateCreateInfo viewportState{};
-    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-    viewportState.viewportCount = 1; // Must be > 0, even for dynamic
-    viewportState.pViewports = nullptr; // Ignored for dynamic state
-    viewportState.scissorCount = 1; // Must be > 0
-    viewportState.pScissors = nullptr; // Ignored for dynamic state
-
-    // 4. Dynamic State
-    std::vector<VkDynamicState> dynamicStates = {
-        VK_DYNAMIC_STATE_VIEWPORT,
-        VK_DYNAMIC_STATE_SCISSOR
-    };
-    VkPipelineDynamicStateCreateInfo dynamicState{};
-    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-    dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
-    dynamicState.pDynamicStates = dynamicStates.data();
-
-    // 5. Rasterizer
-    VkPipelineRasterizationStateCreateInfo rasterizer{};
-    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-    rasterizer.depthClampEnable = VK_FALSE;
-    rasterizer.rasterizerDiscardEnable = VK_FALSE;
-    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-    rasterizer.lineWidth = 1.0f;
-    rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-    rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-    rasterizer.depthBiasEnable = VK_FALSE;
-
-    // 6. Multisampling
-    VkPipelineMultisampleStateCreateInfo multisampling{};
-    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-    multisampling.sampleShadingEnable = VK_FALSE;
-    multisampling.rasterizationSamples = msaaSamples;
-
-    // 7. Depth and Stencil
-    VkPipelineDepthStencilStateCreateInfo depthStencil{};
-    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-    depthStencil.depthTestEnable = VK_TRUE;
-    depthStencil.depthWriteEnable = VK_TRUE;
-    depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
-    depthStencil.depthBoundsTestEnable = VK_FALSE;
-    depthStencil.stencilTestEnable = VK_FALSE;
-
-    // 8. Blending
-    VkPipelineColorBlendAttachmentState colorBlendAttachment{};
-    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-    colorBlendAttachment.blendEnable = VK_FALSE;
-
-    VkPipelineColorBlendStateCreateInfo colorBlending{};
-    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-    colorBlending.logicOpEnable = VK_FALSE;
-    colorBlending.logicOp = VK_LOGIC_OP_COPY;
-    colorBlending.attachmentCount = 1;
-    colorBlending.pAttachments = &colorBlendAttachment;
-    colorBlending.blendConstants[0] = 0.0f;
-    colorBlending.blendConstants[1] = 0.0f;
-    colorBlending.blendConstants[2] = 0.0f;
-    colorBlending.blendConstants[3] = 0.0f;
-
-    // 9. Pipeline Layout - only create if it doesn't exist
+void Renderer::createPipelines()
+{
+    // Vanlig resize beholder formatet, da er render pass og pipelines fortsatt kompatible
+    bbl::PipelineRegistry::RenderPassKey key{swapChainImageFormat, findDepthFormat(), msaaSamples};
+    if (!pipelineRegistry->needsRebuild(key)) {
+        return;
+    }
+
+    // Bakgrunnskompileringer bruker den gamle render passen, vent før den slettes
+    pipelineRegistry->waitForCompiles();
+    if (renderPass != VK_NULL_HANDLE) {
+        vkDestroyRenderPass(device, renderPass, nullptr);
+        renderPass = VK_NULL_HANDLE;
+    }
+    createRenderPass();
+
+    // Felles for alle varianter
     if (pipelineLayout == VK_NULL_HANDLE) {
         VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
         pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
@@ -985,38 +1112,26 @@ void Renderer::createGraphicsPipeline(std::string vertPath, std::string fragPath
         if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
             throw std::runtime_error("failed to create pipeline layout!");
         }
-       // std::cout << "Created new pipeline layout: " << pipelineLayout << std::endl;
-    } else {
-        //std::cout << "Reusing existing pipeline layout: " << pipelineLayout << std::endl;
-    }
-
-    // 10. Create the pipeline
-    VkGraphicsPipelineCreateInfo pipelineInfo{};
-    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipelineInfo.stageCount = 2;
-    pipelineInfo.pStages = shaderStages;
-    pipelineInfo.pVertexInputState = &vertexInputInfo;
-    pipelineInfo.pInputAssemblyState = &inputAssembly;
-    pipelineInfo.pViewportState = &viewportState;
-    pipelineInfo.pRasterizationState = &rasterizer;
-    pipelineInfo.pMultisampleState = &multisampling;
-    pipelineInfo.pDepthStencilState = &depthStencil;
-    pipelineInfo.pColorBlendState = &colorBlending;
-    pipelineInfo.pDynamicState = &dynamicState; // Add dynamic state
-    pipelineInfo.layout = pipelineLayout;
-    pipelineInfo.renderPass = renderPass;
-    pipelineInfo.subpass = 0;
-    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-
-    if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &Pipeline) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create graphics pipeline!");
-    } else {
-        qDebug("Successfully created a Graphics pipeline!");
     }
 
-    // Destroy shader modules
-    vkDestroyShaderModule(device, fragShaderModule, nullptr);
-    vkDestroyShaderModule(device, vertShaderModule, nullptr);
+    pipelineRegistry->beginRebuild(key, renderPass, pipelineLayout);
+
+    // Standard, Phong, punkter og linjer bygges med en gang og er fallback for andre
+    // varianter med samme topologi. Alt annet kompileres i bakgrunnen første gang det trengs.
+    bbl::Render standard;
+    bbl::Render phong;
+    phong.usePhong = true;
+    bbl::Render point;
+    point.usePoint = true;
+    bbl::Render line;
+    line.useLine = true;
+    for (const bbl::Render* render : {&standard, &phong, &point, &line}) {
+        pipelineRegistry->compile(pipelineVariantFor(*render));
+    }
+    qDebug("Successfully created the default pipeline variants!");
+
+    // Lagres med en gang, så cachen er der neste gang selv om programmet krasjer
+    pipelineRegistry->save();
 }
 
 void Renderer::createFramebuffers()
@@ -1074,7 +1189,7 @@ void Renderer::createColorResources()
     createImage(swapChainExtent.width, swapChainExtent.height, 1, msaaSamples,
                 colorFormat, VK_IMAGE_TILING_OPTIMAL,
                 VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, colorImage, colorImageMemory);
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, colorImage, colorImageAllocation);
     colorImageView = createImageView(colorImage, colorFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
 }
 
@@ -1083,7 +1198,7 @@ void Renderer::createDepthResources() {
 
     createImage(swapChainExtent.width, swapChainExtent.height, 1, msaaSamples, depthFormat,
                 VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImage, depthImageMemory);
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImage, depthImageAllocation);
     depthImageView = createImageView(depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
 }
 
@@ -1126,24 +1241,20 @@ void Renderer::createTextureImage()
     }
 
     VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+    bbl::DeviceAllocation stagingAllocation;
+    createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingAllocation);
 
-    void* data;
-    vkMapMemory(device, stagingBufferMemory, 0, imageSize, 0, &data);
-    memcpy(data, pixels, static_cast<size_t>(imageSize));
-    vkUnmapMemory(device, stagingBufferMemory);
+    memcpy(stagingAllocation.mapped, pixels, static_cast<size_t>(imageSize));
 
     stbi_image_free(pixels);
 
-    createImage(texWidth, texHeight, mipLevels, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage, textureImageMemory);
+    createImage(texWidth, texHeight, mipLevels, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage, textureImageAllocation);
 
     transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
     copyBufferToImage(stagingBuffer, textureImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
     //transitioned to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL while generating mipmaps
 
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
+    memoryAllocator->destroyBuffer(stagingBuffer, stagingAllocation);
 
     generateMipmaps(textureImage, VK_FORMAT_R8G8B8A8_SRGB, texWidth, texHeight, mipLevels);
 }
@@ -1236,10 +1347,7 @@ void Renderer::generateMipmaps(VkImage image, VkFormat imageFormat, int32_t texW
 }
 
 VkSampleCountFlagBits Renderer::getMaxUsableSampleCount() {
-    VkPhysicalDeviceProperties physicalDeviceProperties;
-    vkGetPhysicalDeviceProperties(physicalDevice, &physicalDeviceProperties);
-
-    VkSampleCountFlags counts = physicalDeviceProperties.limits.framebufferColorSampleCounts & physicalDeviceProperties.limits.framebufferDepthSampleCounts;
+    VkSampleCountFlags counts = deviceProperties.limits.framebufferColorSampleCounts & deviceProperties.limits.framebufferDepthSampleCounts;
     if (counts & VK_SAMPLE_COUNT_64_BIT) { return VK_SAMPLE_COUNT_64_BIT; }
     if (counts & VK_SAMPLE_COUNT_32_BIT) { return VK_SAMPLE_COUNT_32_BIT; }
     if (counts & VK_SAMPLE_COUNT_16_BIT) { return VK_SAMPLE_COUNT_16_BIT; }
@@ -1256,8 +1364,6 @@ void Renderer::createTextureImageView() {
 }
 
 void Renderer::createTextureSampler() {
-    VkPhysicalDeviceProperties properties{};
-    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
 
     VkSamplerCreateInfo samplerInfo{};
     samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
@@ -1267,7 +1373,7 @@ void Renderer::createTextureSampler() {
     samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
     samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
     samplerInfo.anisotropyEnable = VK_TRUE;
-    samplerInfo.maxAnisotropy = properties.limits.maxSamplerAnisotropy;
+    samplerInfo.maxAnisotropy = deviceProperties.limits.maxSamplerAnisotropy;
     samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
     samplerInfo.unnormalizedCoordinates = VK_FALSE;
     samplerInfo.compareEnable = VK_FALSE;
@@ -1302,7 +1408,7 @@ VkImageView Renderer::createImageView(VkImage image, VkFormat format, VkImageAsp
     return imageView;
 }
 
-void Renderer::createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage &image, VkDeviceMemory &imageMemory) {
+void Renderer::createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage &image, bbl::DeviceAllocation &imageAllocation) {
     VkImageCreateInfo imageInfo{};
     imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
     imageInfo.imageType = VK_IMAGE_TYPE_2D;
@@ -1318,23 +1424,7 @@ void Renderer::createImage(uint32_t width, uint32_t height, uint32_t mipLevels,
     imageInfo.samples = numSamples;
     imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-    if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create image!");
-    }
-
-    VkMemoryRequirements memRequirements;
-    vkGetImageMemoryRequirements(device, image, &memRequirements);
-
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-    if (vkAllocateMemory(device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate image memory!");
-    }
-
-    vkBindImageMemory(device, image, imageMemory, 0);
+    memoryAllocator->createImage(imageInfo, properties, image, imageAllocation);
 }
 
 void Renderer::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels) {
@@ -1450,218 +1540,560 @@ void Renderer::createVertexBuffer() {
     VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
 
     VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+    bbl::DeviceAllocation stagingAllocation;
+    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingAllocation);
 
-    void* data;
-    vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, vertices.data(), (size_t) bufferSize);
-    vkUnmapMemory(device, stagingBufferMemory);
+    memcpy(stagingAllocation.mapped, vertices.data(), (size_t) bufferSize);
 
-    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory);
+    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferAllocation);
 
     copyBuffer(stagingBuffer, vertexBuffer, bufferSize);
 
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
+    memoryAllocator->destroyBuffer(stagingBuffer, stagingAllocation);
 }
 
 void Renderer::createIndexBuffer() {
     VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
 
     VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+    bbl::DeviceAllocation stagingAllocation;
+    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingAllocation);
 
-    void* data;
-    vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, indices.data(), (size_t) bufferSize);
-    vkUnmapMemory(device, stagingBufferMemory);
+    memcpy(stagingAllocation.mapped, indices.data(), (size_t) bufferSize);
 
-    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory);
+    createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferAllocation);
 
     copyBuffer(stagingBuffer, indexBuffer, bufferSize);
 
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
+    memoryAllocator->destroyBuffer(stagingBuffer, stagingAllocation);
 }
 
-void Renderer::createUniformBuffers()
+void Renderer::createFrameResources()
 {
-    // Get renderable entities from EntityManager
-    std::vector<bbl::EntityID> renderableEntities = entityManager->getEntitiesWith<bbl::Transform, bbl::Render>();
+    QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
+
+    // Én opptakspool per worker + tråden som kjører drawFrame() + én delt, se recordDrawChunk()
+    bbl::JobSystem* jobs = BBLHub::Instance().getJobSystem();
+    size_t recordingThreads = (jobs ? jobs->getWorkerCount() : 0) + 2;
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+    // Nullstilles samlet hver frame med vkResetCommandPool
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
 
-    // Calculate proper alignment
-    VkPhysicalDeviceProperties properties;
-    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
-    size_t minUboAlignment = properties.limits.minUniformBufferOffsetAlignment;
-    size_t alignedUniformSize = (sizeof(UniformBufferObject) + minUboAlignment - 1) & ~(minUboAlignment - 1);
+    // Upload-minne og descriptor pool lages av prepareFrameResources() når draw-lista er kjent
+    uploadAllocator = std::make_unique<bbl::UploadAllocator>(device, deviceProperties.limits, memoryProperties,
+                                                             framesInFlight);
 
-    // Use aligned size, not raw sizeof!
-    uint32_t maxEntities = std::max(1u, static_cast<uint32_t>(renderableEntities.size()));
-    VkDeviceSize bufferSize = alignedUniformSize * maxEntities;
+    gpuProfiler = std::make_unique<bbl::GpuProfiler>(device, physicalDevice, graphicsQueueFamily,
+                                                     pipelineStatisticsSupported, framesInFlight);
 
-    qDebug() << "Creating uniform buffers:";
-    qDebug() << "  Entities:" << maxEntities;
-    qDebug() << "  Raw UBO size:" << sizeof(UniformBufferObject);
-    qDebug() << "  Aligned UBO size:" << alignedUniformSize;
-    qDebug() << "  Total buffer size:" << bufferSize;
+    frames.resize(framesInFlight);
+    pacingInputTimes.assign(framesInFlight, {});
+    for (FrameData& frame : frames) {
+        if (vkCreateCommandPool(device, &poolInfo, nullptr, &frame.commandPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create frame command pool!");
+        }
 
-    uniformBuffers.resize(swapChainImages.size());
-    uniformBuffersMemory.resize(swapChainImages.size());
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = frame.commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
 
-    for (size_t i = 0; i < swapChainImages.size(); i++) {
-        createBuffer(bufferSize,
-                     VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                     uniformBuffers[i],
-                     uniformBuffersMemory[i]);
+        if (vkAllocateCommandBuffers(device, &allocInfo, &frame.commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate command buffers!");
+        }
+
+        frame.recordingPools.resize(recordingThreads);
+        for (RecordingPool& recording : frame.recordingPools) {
+            if (vkCreateCommandPool(device, &poolInfo, nullptr, &recording.pool) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create recording command pool!");
+            }
+        }
+    }
+
+    // GPU-culling er valgfritt: uten støtte eller shader faller vi tilbake til CPU-culling
+    if (multiDrawIndirectSupported) {
+        try {
+            gpuCulling = std::make_unique<bbl::GpuCulling>(device, memoryAllocator.get(), framesInFlight,
+                                                           drawIndirectCountSupported);
+            gpuCulling->createPipeline(pipelineRegistry->getShaderCode(PATH + "Shaders/cull.comp.spv"),
+                                       pipelineRegistry->getCache());
+        } catch (const std::exception& e) {
+            qWarning() << "GPU culling disabled:" << e.what();
+            gpuCulling.reset();
+        }
+    } else {
+        qDebug() << "GPU culling unavailable: multiDrawIndirect/drawIndirectFirstInstance not supported";
     }
 }
 
-void Renderer::createDescriptorPool() {
-    uint32_t imageCount = static_cast<uint32_t>(swapChainImages.size());
+void Renderer::destroyFrameResources()
+{
+    for (FrameData& frame : frames) {
+        if (frame.descriptorPool != VK_NULL_HANDLE) {
+            vkDestroyDescriptorPool(device, frame.descriptorPool, nullptr);
+        }
+        // Command buffers frigjøres sammen med poolene sine
+        for (RecordingPool& recording : frame.recordingPools) {
+            vkDestroyCommandPool(device, recording.pool, nullptr);
+        }
+        vkDestroyCommandPool(device, frame.commandPool, nullptr);
+    }
+    frames.clear();
+    uploadAllocator.reset();
+    gpuProfiler.reset();
+    gpuCulling.reset();
+}
 
-    // Get renderable entities from EntityManager instead of old entities vector
-    auto renderableEntities = entityManager->getEntitiesWith<bbl::Transform, bbl::Render>();
-    uint32_t entityCount = static_cast<uint32_t>(renderableEntities.size());
+void Renderer::refreshRenderList()
+{
+    // Fanger opp endringer fra kode som ikke kaller markSceneChanged() (nye/slettede
+    // entiteter, nytt mesh eller tekstur, annen pipeline). Snapshotet har samme layout så
+    // lenge hashen er lik, så instanceSlots kan brukes mot nye snapshots uten ny draw-liste.
+    size_t hash = snapshot->entities.size();
+    auto combine = [&hash](size_t value) {
+        hash ^= value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+    };
+    for (size_t i = 0; i < snapshot->entities.size(); ++i) {
+        const bbl::Render& render = snapshot->renders[i];
+        combine(static_cast<size_t>(snapshot->entities[i]));
+        combine(render.meshResourceID);
+        combine(render.textureResourceID);
+        combine((render.visible ? 1u : 0u) | (render.usePhong ? 2u : 0u) |
+                (render.usePoint ? 4u : 0u) | (render.useLine ? 8u : 0u));
+    }
 
-    uint32_t totalSets = imageCount * entityCount;
+    if (hash != renderListHash) {
+        renderListHash = hash;
+        ++sceneVersion;
+    }
+    if (renderListVersion != sceneVersion) {
+        buildDrawBatches();
+        renderListVersion = sceneVersion;
+    }
+}
 
-    std::array<VkDescriptorPoolSize, 2> poolSizes{};
-    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-    poolSizes[0].descriptorCount = totalSets;
+void Renderer::buildDrawBatches()
+{
+    struct DrawItem
+    {
+        PipelineVariant pipeline;
+        size_t textureResourceID;
+        size_t meshResourceID;
+        uint32_t slot;
+        glm::vec4 bounds;
+    };
 
-    poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    poolSizes[1].descriptorCount = totalSets;
+    std::vector<DrawItem> items;
+    items.reserve(snapshot->entities.size());
+    for (uint32_t slot = 0; slot < snapshot->entities.size(); ++slot) {
+        const bbl::Render& render = snapshot->renders[slot];
+        const bbl::MeshGPUResources* meshRes = GPUresources->getMeshResources(render.meshResourceID);
+        if (!render.visible || !meshRes) {
+            continue;
+        }
 
-    VkDescriptorPoolCreateInfo poolInfo{};
-    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-    poolInfo.pPoolSizes = poolSizes.data();
-    poolInfo.maxSets = totalSets;
+        items.push_back({pipelineVariantFor(render), render.textureResourceID, render.meshResourceID,
+                         slot, glm::vec4(meshRes->boundsCenter, meshRes->boundsRadius)});
+    }
+
+    // Sortert på pipeline, tekstur og mesh: like entiteter havner ved siden av hverandre,
+    // og bytter av pipeline og descriptor set blir så få som mulig. Hver del av nøkkelen er
+    // rangen blant verdiene som finnes i scenen, så nøkkelen blir bare så bred som den må og
+    // radix-sorteringen tar få runder. Likt sortert beholder snapshot-rekkefølgen.
+    // Dybde er ikke med: lista gjenbrukes over mange frames, og instansene i en batch
+    // tegnes i ett kall uansett.
+    std::vector<uint64_t> pipelines, textures, meshes;
+    for (const DrawItem& item : items) {
+        pipelines.push_back(item.pipeline.pack());
+        textures.push_back(item.textureResourceID);
+        meshes.push_back(item.meshResourceID);
+    }
+    auto distinct = [](std::vector<uint64_t>& values) {
+        std::sort(values.begin(), values.end());
+        values.erase(std::unique(values.begin(), values.end()), values.end());
+        unsigned bits = 0;
+        while ((size_t(1) << bits) < values.size()) {
+            ++bits;
+        }
+        return bits;
+    };
+    auto rankOf = [](const std::vector<uint64_t>& values, uint64_t value) {
+        return static_cast<uint64_t>(std::lower_bound(values.begin(), values.end(), value) - values.begin());
+    };
+    const unsigned pipelineBits = distinct(pipelines);
+    const unsigned textureBits = distinct(textures);
+    const unsigned meshBits = distinct(meshes);
+    const unsigned keyBits = pipelineBits + textureBits + meshBits;
+    if (keyBits >= 64) {
+        throw std::runtime_error("draw list sort key does not fit in 64 bits!");
+    }
+
+    std::vector<uint64_t> sortKeys(items.size());
+    std::vector<uint32_t> order(items.size());
+    for (uint32_t i = 0; i < items.size(); ++i) {
+        const DrawItem& item = items[i];
+        sortKeys[i] = (rankOf(pipelines, item.pipeline.pack()) << (textureBits + meshBits)) |
+                      (rankOf(textures, item.textureResourceID) << meshBits) |
+                      rankOf(meshes, item.meshResourceID);
+        order[i] = i;
+    }
+    bbl::radixSort(sortKeys, order, keyBits);
+
+    instanceSlots.clear();
+    instanceBounds.clear();
+    drawBatches.clear();
+    batchTextures.clear();
+    drawGroups.clear();
+    gpuObjects.clear();
+    gpuBatches.clear();
+    std::unordered_map<size_t, uint32_t> textureSlots;
+
+    for (uint32_t index : order) {
+        const DrawItem& item = items[index];
+        DrawBatch* batch = drawBatches.empty() ? nullptr : &drawBatches.back();
+        if (!batch || batch->pipeline != item.pipeline ||
+            batch->textureResourceID != item.textureResourceID ||
+            batch->meshResourceID != item.meshResourceID) {
+            auto [slot, inserted] = textureSlots.try_emplace(item.textureResourceID,
+                                                             static_cast<uint32_t>(batchTextures.size()));
+            if (inserted) {
+                batchTextures.push_back(item.textureResourceID);
+            }
+
+            DrawBatch newBatch;
+            newBatch.pipeline = item.pipeline;
+            newBatch.meshResourceID = item.meshResourceID;
+            newBatch.textureResourceID = item.textureResourceID;
+            newBatch.descriptorIndex = slot->second;
+            newBatch.firstInstance = static_cast<uint32_t>(instanceSlots.size());
+            drawBatches.push_back(newBatch);
+            batch = &drawBatches.back();
+        }
+
+        instanceSlots.push_back(item.slot);
+        instanceBounds.push_back(item.bounds);
+        ++batch->instanceCount;
+    }
+
+    // Input til GPU-culling: grupper med samme pipeline og sett, en kule per instans og
+    // mesh-data per batch. Arena-mesher deler buffere, så en gruppe kan bli ett kall.
+    drawListInGeometryArena = true;
+    for (uint32_t batchIndex = 0; batchIndex < drawBatches.size(); ++batchIndex) {
+        const DrawBatch& batch = drawBatches[batchIndex];
+        const bbl::MeshGPUResources* meshRes = GPUresources->getMeshResources(batch.meshResourceID);
+        drawListInGeometryArena = drawListInGeometryArena && meshRes->inGeometryArena;
+
+        DrawGroup* group = drawGroups.empty() ? nullptr : &drawGroups.back();
+        if (!group || group->pipeline != batch.pipeline || group->descriptorIndex != batch.descriptorIndex) {
+            DrawGroup newGroup;
+            newGroup.pipeline = batch.pipeline;
+            newGroup.descriptorIndex = batch.descriptorIndex;
+            newGroup.firstBatch = batchIndex;
+            drawGroups.push_back(newGroup);
+            group = &drawGroups.back();
+        }
+        ++group->batchCount;
+
+        bbl::GpuCulling::BatchData data;
+        data.indexCount = static_cast<uint32_t>(meshRes->indexCount);
+        data.firstIndex = meshRes->firstIndex;
+        data.vertexOffset = meshRes->vertexOffset;
+        data.firstInstance = batch.firstInstance;
+        data.group = static_cast<uint32_t>(drawGroups.size() - 1);
+        data.firstCommand = group->firstBatch;
+        gpuBatches.push_back(data);
+
+        for (uint32_t i = 0; i < batch.instanceCount; ++i) {
+            bbl::GpuCulling::ObjectData object;
+            object.sphere = instanceBounds[batch.firstInstance + i];
+            object.batch = batchIndex;
+            gpuObjects.push_back(object);
+        }
+    }
+}
 
-    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create descriptor pool!");
+namespace
+{
+// Normalmatrisen er R * S^-1 for en TRS-matrise, dvs. hver kolonne delt på lengden i
+// andre. Slipper inverse() per vertex i Phong.vert.
+void writeInstanceData(InstanceData& instance, const glm::mat4& model)
+{
+    instance.model = model;
+    for (int column = 0; column < 3; ++column) {
+        glm::vec3 axis = glm::vec3(model[column]);
+        float lengthSquared = glm::dot(axis, axis);
+        instance.normalMatrix[column] =
+            glm::vec4(lengthSquared > 0.0f ? axis / lengthSquared : glm::vec3(0.0f), 0.0f);
     }
 }
+}
 
-void Renderer::createDescriptorSets()
+bool Renderer::useGpuCulling() const
+{
+    return gpuCullingEnabled && gpuCulling && drawListInGeometryArena && !instanceSlots.empty();
+}
+
+void Renderer::cullInstances()
+{
+    size_t instanceCount = instanceSlots.size();
+    instanceModels.resize(instanceCount);
+    cullCenterX.resize(instanceCount);
+    cullCenterY.resize(instanceCount);
+    cullCenterZ.resize(instanceCount);
+    cullRadius.resize(instanceCount);
+    cullVisible.resize(instanceCount);
+
+    const Frustum& frustum = BBLHub::Instance().GetCamera()->getFrustum();
+
+    // Model-matrise og kule i verdensrom per instans, så testes hele biten mot frustumet
+    bbl::parallelFor(BBLHub::Instance().getJobSystem(), 0, instanceCount, 1024,
+                     [&](size_t first, size_t last) {
+                         for (size_t i = first; i < last; ++i) {
+                             const glm::mat4& model = snapshot->models[instanceSlots[i]];
+                             writeInstanceData(instanceModels[i], model);
+
+                             const glm::vec4& bounds = instanceBounds[i];
+                             glm::vec3 center = glm::vec3(model * glm::vec4(glm::vec3(bounds), 1.0f));
+                             float maxScaleSquared = std::max({glm::dot(glm::vec3(model[0]), glm::vec3(model[0])),
+                                                               glm::dot(glm::vec3(model[1]), glm::vec3(model[1])),
+                                                               glm::dot(glm::vec3(model[2]), glm::vec3(model[2]))});
+                             cullCenterX[i] = center.x;
+                             cullCenterY[i] = center.y;
+                             cullCenterZ[i] = center.z;
+                             cullRadius[i] = bounds.w * std::sqrt(maxScaleSquared);
+                         }
+                         frustum.cullSpheres(cullCenterX.data() + first, cullCenterY.data() + first,
+                                             cullCenterZ.data() + first, cullRadius.data() + first,
+                                             last - first, cullVisible.data() + first);
+                     });
+
+    // Pakk synlige instanser tett per batch; tomme batcher tegnes ikke
+    visibleBatches.clear();
+    visibleInstances.clear();
+    for (const DrawBatch& batch : drawBatches) {
+        DrawBatch visible = batch;
+        visible.firstInstance = static_cast<uint32_t>(visibleInstances.size());
+        visible.instanceCount = 0;
+
+        for (uint32_t i = batch.firstInstance; i < batch.firstInstance + batch.instanceCount; ++i) {
+            if (cullVisible[i]) {
+                visibleInstances.push_back(instanceModels[i]);
+                ++visible.instanceCount;
+            }
+        }
+
+        if (visible.instanceCount > 0) {
+            visibleBatches.push_back(visible);
+        }
+    }
+
+    renderStats.drawnEntities = static_cast<uint32_t>(visibleInstances.size());
+    renderStats.culledEntities = static_cast<uint32_t>(instanceCount - visibleInstances.size());
+    renderStats.drawCalls = static_cast<uint32_t>(visibleBatches.size());
+}
+
+void Renderer::cullInstancesOnGpu(FrameData& frame)
+{
+    size_t instanceCount = instanceSlots.size();
+
+    // Matrisene må fortsatt skrives hver frame siden transformene endres av simuleringen, men rett
+    // inn i upload-bufferet. Selve testen, pakkingen og draw-kommandoene gjøres av Cull.comp.
+    bbl::UploadAllocator::Allocation instances = uploadAllocator->allocateStorage(sizeof(InstanceData) * instanceCount);
+    InstanceData* instanceData = static_cast<InstanceData*>(instances.data);
+    bbl::parallelFor(BBLHub::Instance().getJobSystem(), 0, instanceCount, 1024,
+                     [&](size_t first, size_t last) {
+                         for (size_t i = first; i < last; ++i) {
+                             writeInstanceData(instanceData[i], snapshot->models[instanceSlots[i]]);
+                         }
+                     });
+
+    // Kuler og batcher endres bare med draw-lista, men kopieres per frame så de ligger i
+    // samme buffer som matrisene
+    size_t objectsSize = sizeof(bbl::GpuCulling::ObjectData) * gpuObjects.size();
+    bbl::UploadAllocator::Allocation objects = uploadAllocator->allocateStorage(objectsSize);
+    memcpy(objects.data, gpuObjects.data(), objectsSize);
+
+    size_t batchesSize = sizeof(bbl::GpuCulling::BatchData) * gpuBatches.size();
+    bbl::UploadAllocator::Allocation batches = uploadAllocator->allocateStorage(batchesSize);
+    memcpy(batches.data, gpuBatches.data(), batchesSize);
+
+    bbl::GpuCulling::Inputs inputs;
+    inputs.buffer = instances.buffer;
+    inputs.objectsOffset = objects.offset;
+    inputs.batchesOffset = batches.offset;
+    inputs.instancesOffset = instances.offset;
+    inputs.instanceCount = static_cast<uint32_t>(instanceCount);
+    inputs.batchCount = static_cast<uint32_t>(gpuBatches.size());
+    inputs.groupCount = static_cast<uint32_t>(drawGroups.size());
+    gpuCulling->prepare(inputs);
+
+    frame.instanceBuffer = gpuCulling->getVisibleInstanceBuffer();
+    frame.instanceOffset = 0;
+
+    // CPU-stiens resultat brukes ikke denne framen
+    visibleBatches.clear();
+    visibleInstances.clear();
+
+    // Antall synlige leses tilbake fra en tidligere frame, så tallet henger litt etter
+    uint32_t drawn = std::min<uint32_t>(gpuCulling->getVisibleCount(), static_cast<uint32_t>(instanceCount));
+    renderStats.drawnEntities = drawn;
+    renderStats.culledEntities = static_cast<uint32_t>(instanceCount) - drawn;
+    renderStats.drawCalls = static_cast<uint32_t>(drawGroups.size());
+}
+
+void Renderer::prepareFrameResources(FrameData& frame)
 {
-    // Get renderable entities
-    auto renderableEntities = entityManager->getEntitiesWith<bbl::Transform, bbl::Render>();
-    if (renderableEntities.empty()) {
-        qWarning() << "No renderable entities found!";
+    // Kalles etter at fencen til framen er ventet på, så ingenting her er i bruk på GPU-en
+    uploadAllocator->beginFrame(static_cast<uint32_t>(currentFrame));
+    if (gpuCulling) {
+        gpuCulling->beginFrame(static_cast<uint32_t>(currentFrame));
+    }
+    refreshRenderList();
+
+    // Plass til UBO-en og alle instansene, i tilfelle ingenting blir cullet. Nytt buffer
+    // betyr at settene peker på feil buffer og må skrives på nytt.
+    VkDeviceSize uploadSize = uploadAllocator->uniformFootprint(sizeof(UniformBufferObject));
+    frame.gpuCulled = useGpuCulling();
+    if (frame.gpuCulled) {
+        uploadSize += uploadAllocator->storageFootprint(sizeof(InstanceData) * instanceSlots.size()) +
+                      uploadAllocator->storageFootprint(sizeof(bbl::GpuCulling::ObjectData) * gpuObjects.size()) +
+                      uploadAllocator->storageFootprint(sizeof(bbl::GpuCulling::BatchData) * gpuBatches.size());
+    } else {
+        uploadSize += uploadAllocator->vertexFootprint(sizeof(InstanceData) * instanceSlots.size());
+    }
+    if (uploadAllocator->reserve(uploadSize)) {
+        frame.descriptorSceneVersion = 0;
+        if (gpuCulling) {
+            gpuCulling->invalidateInputs();
+        }
+    }
+
+    if (frame.descriptorSceneVersion == sceneVersion) {
+        return;
+    }
+
+    writeDescriptorSets(frame);
+    frame.descriptorSceneVersion = sceneVersion;
+}
+
+void Renderer::writeDescriptorSets(FrameData& frame)
+{
+    std::vector<VkDescriptorSet>& sets = frame.descriptorSets;
+    sets.clear();
+
+    // UBO-en er lik for alle, så det trengs bare ett sett per tekstur
+    uint32_t setCount = static_cast<uint32_t>(batchTextures.size());
+    VkDescriptorPool& pool = frame.descriptorPool;
+
+    if (setCount > frame.descriptorCapacity || pool == VK_NULL_HANDLE) {
+        if (pool != VK_NULL_HANDLE) {
+            vkDestroyDescriptorPool(device, pool, nullptr);
+        }
+
+        uint32_t newCapacity = std::max({setCount, frame.descriptorCapacity * 2, 64u});
+
+        std::array<VkDescriptorPoolSize, 2> poolSizes{};
+        poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        poolSizes[0].descriptorCount = newCapacity;
+
+        poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        poolSizes[1].descriptorCount = newCapacity;
+
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        poolInfo.pPoolSizes = poolSizes.data();
+        poolInfo.maxSets = newCapacity;
+
+        if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor pool!");
+        }
+        frame.descriptorCapacity = newCapacity;
+    } else {
+        // Alle sett fra forrige gang frigjøres på én gang
+        vkResetDescriptorPool(device, pool, 0);
+    }
+
+    if (setCount == 0) {
         return;
     }
 
-    size_t totalDescriptorSets = renderableEntities.size() * swapChainImages.size();
-    std::vector<VkDescriptorSetLayout> layouts(totalDescriptorSets, descriptorSetLayout);
+    std::vector<VkDescriptorSetLayout> layouts(setCount, descriptorSetLayout);
 
     VkDescriptorSetAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocInfo.descriptorPool = descriptorPool;
-    allocInfo.descriptorSetCount = static_cast<uint32_t>(totalDescriptorSets);
+    allocInfo.descriptorPool = pool;
+    allocInfo.descriptorSetCount = setCount;
     allocInfo.pSetLayouts = layouts.data();
 
-    descriptorSets.resize(totalDescriptorSets);
-    if (vkAllocateDescriptorSets(device, &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
+    sets.resize(setCount);
+    if (vkAllocateDescriptorSets(device, &allocInfo, sets.data()) != VK_SUCCESS) {
         throw std::runtime_error("failed to allocate descriptor sets!");
     }
 
-    qDebug() << "Creating descriptor sets for" << renderableEntities.size() << "entities";
+    // Offset inn i upload-bufferet gis som dynamic offset ved binding
+    VkDescriptorBufferInfo bufferInfo{};
+    bufferInfo.buffer = uploadAllocator->getBuffer();
+    bufferInfo.offset = 0;
+    bufferInfo.range = sizeof(UniformBufferObject);
 
-    size_t descriptorIndex = 0;
-    for (size_t img = 0; img < swapChainImages.size(); ++img) {
-        size_t entityIndex = 0;
-        for (bbl::EntityID entity : renderableEntities) {
-            auto* renderComp = entityManager->getComponent<bbl::Render>(entity);
-            if (!renderComp) {
-                qWarning() << "Missing render component for entity" << entity;
-                ++entityIndex;
-                ++descriptorIndex;
-                continue;
-            }
+    for (uint32_t setIndex = 0; setIndex < setCount; ++setIndex) {
+        size_t textureResourceID = batchTextures[setIndex];
 
-            // For dynamic uniform buffers, set offset to 0 and let dynamic offsets handle positioning
-            VkDescriptorBufferInfo bufferInfo{};
-            bufferInfo.buffer = uniformBuffers[img];
-            bufferInfo.offset = 0;  // ← CHANGED: Always 0 for dynamic buffers
-            bufferInfo.range = sizeof(UniformBufferObject);
-
-            // Texture info
-            VkImageView imageView = defaultTextureImageView;
-            VkSampler sampler = defaultTextureSampler;
-
-            if (renderComp->textureResourceID != 0) {
-                const auto* texRes = GPUresources->getTextureResources(renderComp->textureResourceID);
-                if (texRes && texRes->textureImageView && texRes->textureSampler) {
-                    imageView = texRes->textureImageView;
-                    sampler = texRes->textureSampler;
-                }
-            }
+        // Texture info
+        VkImageView imageView = defaultTextureImageView;
+        VkSampler sampler = defaultTextureSampler;
 
-            VkDescriptorImageInfo imageInfo{};
-            imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            imageInfo.imageView = imageView;
-            imageInfo.sampler = sampler;
+        if (textureResourceID != 0) {
+            const auto* texRes = GPUresources->getTextureResources(textureResourceID);
+            if (texRes && texRes->textureImageView && texRes->textureSampler) {
+                imageView = texRes->textureImageView;
+                sampler = texRes->textureSampler;
+            }
+        }
 
-            std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+        VkDescriptorImageInfo imageInfo{};
+        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        imageInfo.imageView = imageView;
+        imageInfo.sampler = sampler;
 
-            // UBO binding
-            descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            descriptorWrites[0].dstSet = descriptorSets[descriptorIndex];
-            descriptorWrites[0].dstBinding = 0;
-            descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-            descriptorWrites[0].descriptorCount = 1;
-            descriptorWrites[0].pBufferInfo = &bufferInfo;
+        std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
 
-            // Texture binding
-            descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            descriptorWrites[1].dstSet = descriptorSets[descriptorIndex];
-            descriptorWrites[1].dstBinding = 1;
-            descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-            descriptorWrites[1].descriptorCount = 1;
-            descriptorWrites[1].pImageInfo = &imageInfo;
+        // UBO binding
+        descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[0].dstSet = sets[setIndex];
+        descriptorWrites[0].dstBinding = 0;
+        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        descriptorWrites[0].descriptorCount = 1;
+        descriptorWrites[0].pBufferInfo = &bufferInfo;
 
-            vkUpdateDescriptorSets(device,
-                                   static_cast<uint32_t>(descriptorWrites.size()),
-                                   descriptorWrites.data(),
-                                   0, nullptr);
+        // Texture binding
+        descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[1].dstSet = sets[setIndex];
+        descriptorWrites[1].dstBinding = 1;
+        descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrites[1].descriptorCount = 1;
+        descriptorWrites[1].pImageInfo = &imageInfo;
 
-            ++entityIndex;
-            ++descriptorIndex;
-        }
+        vkUpdateDescriptorSets(device,
+                               static_cast<uint32_t>(descriptorWrites.size()),
+                               descriptorWrites.data(),
+                               0, nullptr);
     }
-
-    qDebug() << "Created" << descriptorIndex << "descriptor sets";
 }
 
-
-void Renderer::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer, VkDeviceMemory &bufferMemory) {
+void Renderer::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer, bbl::DeviceAllocation &bufferAllocation) {
     VkBufferCreateInfo bufferInfo{};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bufferInfo.size = size;
     bufferInfo.usage = usage;
     bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-    if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create buffer!");
-    }
-
-    VkMemoryRequirements memRequirements;
-    vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
-
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-    if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-        throw std::runtime_error("failed to allocate buffer memory!");
-    }
-
-    vkBindBufferMemory(device, buffer, bufferMemory, 0);
+    memoryAllocator->createBuffer(bufferInfo, properties, buffer, bufferAllocation);
 }
 
 VkCommandBuffer Renderer::beginSingleTimeCommands() {
@@ -1707,158 +2139,350 @@ void Renderer::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize s
     endSingleTimeCommands(commandBuffer);
 }
 
-uint32_t Renderer::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
-    VkPhysicalDeviceMemoryProperties memProperties;
-    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+void Renderer::recordCommandBuffer(FrameData& frame, uint32_t imageIndex)
+{
+    // Alt framen tok opp sist er ferdig på GPU-en, nullstill alle pools på én gang
+    vkResetCommandPool(device, frame.commandPool, 0);
+    for (RecordingPool& recording : frame.recordingPools) {
+        vkResetCommandPool(device, recording.pool, 0);
+        recording.usedBuffers = 0;
+    }
+
+    VkCommandBuffer commandBuffer = frame.commandBuffer;
+    pipelineBindCount = 0;
+    descriptorBindCount = 0;
 
-    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-        if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-            return i;
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+        throw std::runtime_error("failed to begin recording command buffer!");
+
+    gpuProfiler->resetQueries(commandBuffer);
+    gpuProfiler->beginStatistics(commandBuffer);
+    bbl::GpuProfiler::ScopeId frameScope = gpuProfiler->beginScope(commandBuffer, "frame");
+
+    // Compute må kjøres utenfor render pass
+    if (frame.gpuCulled) {
+        const Frustum& frustum = BBLHub::Instance().GetCamera()->getFrustum();
+        glm::vec4 planes[6];
+        for (int i = 0; i < 6; ++i) {
+            planes[i] = glm::vec4(frustum.planes[i].normal, frustum.planes[i].distance);
+        }
+        bbl::GpuProfiler::ScopeId cullScope = gpuProfiler->beginScope(commandBuffer, "gpu cull");
+        gpuCulling->recordCull(commandBuffer, planes);
+        gpuProfiler->endScope(commandBuffer, cullScope);
+    }
+
+    bbl::GpuProfiler::ScopeId passScope = gpuProfiler->beginScope(commandBuffer, "render pass");
+
+    // Batchene deles i biter som tas opp i secondary buffers på jobbsystemet.
+    // Rekkefølgen på bitene er fast, så resultatet er det samme som serielt opptak.
+    // Med GPU-culling er det bare ett kall per gruppe, og alt tas opp direkte i primary.
+    constexpr size_t batchesPerChunk = 64;
+    size_t batchCount = frame.gpuCulled ? 0 : visibleBatches.size();
+    std::vector<VkCommandBuffer> chunkBuffers((batchCount + batchesPerChunk - 1) / batchesPerChunk, VK_NULL_HANDLE);
+
+    // Ett scope per løp av batcher med samme pipeline (visibleBatches er sortert på pipeline).
+    // Et løp kan krysse biter; den som har første batch skriver start, den med siste skriver slutt.
+    batchScopes.assign(gpuProfiler->isSupported() ? batchCount : 0, bbl::GpuProfiler::InvalidScope);
+    for (size_t i = 0; i < batchScopes.size(); ++i) {
+        const bool newRun = i == 0 || visibleBatches[i].pipeline != visibleBatches[i - 1].pipeline;
+        batchScopes[i] = newRun ? gpuProfiler->reserveScope(pipelineScopeName(visibleBatches[i].pipeline))
+                                : batchScopes[i - 1];
+    }
+
+    bbl::parallelFor(BBLHub::Instance().getJobSystem(), 0, batchCount, batchesPerChunk,
+                     [&](size_t first, size_t last) {
+                         chunkBuffers[first / batchesPerChunk] = recordDrawChunk(frame, imageIndex, first, last);
+                     });
+
+    // JobSystem logger og svelger unntak fra jobber, en manglende bit betyr at opptaket feilet
+    if (std::find(chunkBuffers.begin(), chunkBuffers.end(), VK_NULL_HANDLE) != chunkBuffers.end()) {
+        throw std::runtime_error("failed to record draw commands!");
+    }
+
+    // Render pass setup
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = renderPass;
+    renderPassInfo.framebuffer = swapChainFramebuffers[imageIndex];
+    renderPassInfo.renderArea.offset = {0, 0};
+    renderPassInfo.renderArea.extent = swapChainExtent;
+
+    std::array<VkClearValue, 2> clearValues{};
+    clearValues[0].color = {{0.2f, 0.2f, 0.2f, 1.0f}};
+    clearValues[1].depthStencil = {1.0f, 0};
+    renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+    renderPassInfo.pClearValues = clearValues.data();
+
+    if (frame.gpuCulled) {
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        recordIndirectDraws(frame, commandBuffer);
+    } else {
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        if (!chunkBuffers.empty()) {
+            vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(chunkBuffers.size()), chunkBuffers.data());
         }
     }
 
-    throw std::runtime_error("failed to find suitable memory type!");
-}
+    vkCmdEndRenderPass(commandBuffer);
+    renderStats.pipelineBinds = pipelineBindCount.load();
+    renderStats.descriptorBinds = descriptorBindCount.load();
 
-void Renderer::createCommandBuffers() {
-    commandBuffers.resize(swapChainFramebuffers.size());
+    gpuProfiler->endScope(commandBuffer, passScope);
+    gpuProfiler->endScope(commandBuffer, frameScope);
+    gpuProfiler->endStatistics(commandBuffer);
 
-    VkCommandBufferAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.commandPool = commandPool;
-    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+        throw std::runtime_error("failed to record command buffer!");
+}
 
-    if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS)
-    {
-        throw std::runtime_error("failed to allocate command buffers!");
+VkCommandBuffer Renderer::recordDrawChunk(FrameData& frame, uint32_t imageIndex, size_t firstBatch, size_t lastBatch)
+{
+    // Kjører på en worker (eller tråden som kjører drawFrame()): bare egen pool, og bare lesing
+    // fra snapshotet. Andre tråder som hjelper til i TaskGroup::wait() deler den siste poolen.
+    const int worker = bbl::JobSystem::currentWorkerIndex();
+    size_t poolIndex = static_cast<size_t>(worker + 1);
+    std::unique_lock<std::mutex> sharedLock;
+    if (worker < 0 && std::this_thread::get_id() != recordingThread) {
+        poolIndex = frame.recordingPools.size() - 1;
+        sharedLock = std::unique_lock<std::mutex>(sharedRecordingMutex);
+    }
+    RecordingPool& recording = frame.recordingPools[poolIndex];
+    if (recording.usedBuffers == recording.secondaryBuffers.size()) {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = recording.pool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        allocInfo.commandBufferCount = 1;
+
+        VkCommandBuffer buffer = VK_NULL_HANDLE;
+        if (vkAllocateCommandBuffers(device, &allocInfo, &buffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate secondary command buffer!");
+        }
+        recording.secondaryBuffers.push_back(buffer);
     }
+    VkCommandBuffer commandBuffer = recording.secondaryBuffers[recording.usedBuffers++];
 
-    // Physical device properties for alignment calculations
-    VkPhysicalDeviceProperties properties;
-    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
-    size_t minUboAlignment = properties.limits.minUniformBufferOffsetAlignment;
-    size_t alignedUniformSize = (sizeof(UniformBufferObject) + minUboAlignment - 1) & ~(minUboAlignment - 1);
+    VkCommandBufferInheritanceInfo inheritanceInfo{};
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.renderPass = renderPass;
+    inheritanceInfo.subpass = 0;
+    inheritanceInfo.framebuffer = swapChainFramebuffers[imageIndex];
+    // Statistikk-queryen i primary er aktiv mens bitene kjøres
+    inheritanceInfo.pipelineStatistics = gpuProfiler->getStatisticFlags();
 
-    for (size_t i = 0; i < commandBuffers.size(); i++)
-    {
-        VkCommandBufferBeginInfo beginInfo{};
-        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
-
-        if (vkBeginCommandBuffer(commandBuffers[i], &beginInfo) != VK_SUCCESS)
-            throw std::runtime_error("failed to begin recording command buffer!");
-
-        // Render pass setup
-        VkRenderPassBeginInfo renderPassInfo{};
-        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassInfo.renderPass = renderPass;
-        renderPassInfo.framebuffer = swapChainFramebuffers[i];
-        renderPassInfo.renderArea.offset = {0, 0};
-        renderPassInfo.renderArea.extent = swapChainExtent;
-
-        std::array<VkClearValue, 2> clearValues{};
-        clearValues[0].color = {{0.2f, 0.2f, 0.2f, 1.0f}};
-        clearValues[1].depthStencil = {1.0f, 0};
-        renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-        renderPassInfo.pClearValues = clearValues.data();
-
-        vkCmdBeginRenderPass(commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-        // Viewport & scissor
-        VkViewport viewport{};
-        viewport.x = 0.0f;
-        viewport.y = 0.0f;
-        viewport.width = static_cast<float>(swapChainExtent.width);
-        viewport.height = static_cast<float>(swapChainExtent.height);
-        viewport.minDepth = 0.0f;
-        viewport.maxDepth = 1.0f;
-        vkCmdSetViewport(commandBuffers[i], 0, 1, &viewport);
-
-        VkRect2D scissor{};
-        scissor.offset = {0, 0};
-        scissor.extent = swapChainExtent;
-        vkCmdSetScissor(commandBuffers[i], 0, 1, &scissor);
-
-
-        std::vector<bbl::EntityID> renderableEntities = entityManager->getEntitiesWith<bbl::Transform, bbl::Render>();
-        size_t baseDescriptorIndex = i * renderableEntities.size();
-        size_t entityIndex = 0;
-
-        for (bbl::EntityID entity : renderableEntities)
-        {
-            bbl::Render* renderComp = entityManager->getComponent<bbl::Render>(entity);
-            bbl::Transform* transform = entityManager->getComponent<bbl::Transform>(entity);
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+        throw std::runtime_error("failed to begin recording secondary command buffer!");
+
+    // Dynamisk state arves ikke fra primary
+    VkViewport viewport{};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = static_cast<float>(swapChainExtent.width);
+    viewport.height = static_cast<float>(swapChainExtent.height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    VkRect2D scissor{};
+    scissor.offset = {0, 0};
+    scissor.extent = swapChainExtent;
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    const std::vector<VkDescriptorSet>& sets = frame.descriptorSets;
+
+    // Unngå å binde samme pipeline og sett på nytt innenfor biten. Batchene er sortert på
+    // tilstand, så en bit binder bare når tilstanden faktisk skifter (og én gang i starten).
+    VkPipeline boundPipeline = VK_NULL_HANDLE;
+    VkDescriptorSet boundSet = VK_NULL_HANDLE;
+    VkBuffer boundVertexBuffer = VK_NULL_HANDLE;
+    VkBuffer boundIndexBuffer = VK_NULL_HANDLE;
+    uint32_t pipelineBinds = 0;
+    uint32_t descriptorBinds = 0;
+
+    auto drawBatch = [&](const DrawBatch& batch) {
+        const bbl::MeshGPUResources* meshRes = GPUresources->getMeshResources(batch.meshResourceID);
+        if (!meshRes) {
+            return;
+        }
 
-            // Skip if missing required components, but still increment entityIndex
-            if (!renderComp || !transform) {
-                ++entityIndex;
-                continue;
-            }
+        // Varianten kan fortsatt kompileres uten noen fallback klar
+        VkPipeline pipeline = getPipeline(batch.pipeline);
+        if (pipeline == VK_NULL_HANDLE) {
+            return;
+        }
+        if (pipeline != boundPipeline) {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+            boundPipeline = pipeline;
+            ++pipelineBinds;
+        }
 
-            const bbl::MeshGPUResources* meshRes = GPUresources->getMeshResources(renderComp->meshResourceID);
-            if (!meshRes) {
-                ++entityIndex;
-                continue;
-            }
+        VkDescriptorSet descriptorSet = sets[batch.descriptorIndex];
+        if (descriptorSet != boundSet) {
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                    pipelineLayout, 0, 1, &descriptorSet, 1, &frame.uniformOffset);
+            boundSet = descriptorSet;
+            ++descriptorBinds;
+        }
+
+        // Bind mesh buffers, og instance-bufferet på binding 1. Mesher i geometri-arenaen
+        // deler buffere, så for dem skjer dette én gang per bit.
+        if (meshRes->vertexBuffer != boundVertexBuffer) {
+            VkBuffer vertexBuffers[] = {meshRes->vertexBuffer, frame.instanceBuffer};
+            VkDeviceSize offsets[] = {0, frame.instanceOffset};
+            vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+            boundVertexBuffer = meshRes->vertexBuffer;
+        }
+        if (meshRes->indexBuffer != boundIndexBuffer) {
+            vkCmdBindIndexBuffer(commandBuffer, meshRes->indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+            boundIndexBuffer = meshRes->indexBuffer;
+        }
 
-            uint32_t dynamicOffset = static_cast<uint32_t>(entityIndex * alignedUniformSize);
+        // Alle instanser av meshet i ett kall
+        vkCmdDrawIndexed(commandBuffer,
+                         static_cast<uint32_t>(meshRes->indexCount),
+                         batch.instanceCount, meshRes->firstIndex, meshRes->vertexOffset,
+                         batch.firstInstance);
+    };
 
-            // Always bind descriptor set (regardless of visibility, this is for convenience sake)
-            if (renderComp->usePhong == true)
-            {
-                vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, phongPipeline);
-            }
+    for (size_t batchIndex = firstBatch; batchIndex < lastBatch; ++batchIndex)
+    {
+        // Tidsstempler også for batcher som hoppes over, så hvert scope får både start og slutt
+        const bool profiled = !batchScopes.empty();
+        const bbl::GpuProfiler::ScopeId scope = profiled ? batchScopes[batchIndex] : bbl::GpuProfiler::InvalidScope;
+        if (profiled && (batchIndex == 0 || batchScopes[batchIndex - 1] != scope)) {
+            gpuProfiler->writeBegin(commandBuffer, scope);
+        }
 
-            else if (renderComp->usePoint == true)
-            {
-                vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pointPipeline);
-            }
+        drawBatch(visibleBatches[batchIndex]);
 
-            else if (renderComp->useLine == true)
-            {
-                vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, linePipeline);
-            }
+        if (profiled && (batchIndex + 1 == batchScopes.size() || batchScopes[batchIndex + 1] != scope)) {
+            gpuProfiler->writeEnd(commandBuffer, scope);
+        }
+    }
 
-            else
-            {
-                vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
-            }
+    pipelineBindCount += pipelineBinds;
+    descriptorBindCount += descriptorBinds;
 
-            VkDescriptorSet descriptorSet = descriptorSets[baseDescriptorIndex + entityIndex];
-            vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                    pipelineLayout, 0, 1, &descriptorSet, 1, &dynamicOffset);
-
-            // Only draw if visible
-            if (renderComp->visible) {
-                // Bind mesh buffers
-                VkBuffer vertexBuffers[] = {meshRes->vertexBuffer};
-                VkDeviceSize offsets[] = {0};
-                vkCmdBindVertexBuffers(commandBuffers[i], 0, 1, vertexBuffers, offsets);
-                vkCmdBindIndexBuffer(commandBuffers[i], meshRes->indexBuffer, 0, VK_INDEX_TYPE_UINT32);
-
-                // Draw the mesh
-                vkCmdDrawIndexed(commandBuffers[i],
-                                 static_cast<uint32_t>(meshRes->indexCount),
-                                 1, 0, 0, 0);
-            }
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+        throw std::runtime_error("failed to record secondary command buffer!");
 
-            ++entityIndex; // Always increment for consistent indexing
+    return commandBuffer;
+}
+
+void Renderer::recordIndirectDraws(FrameData& frame, VkCommandBuffer commandBuffer)
+{
+    VkViewport viewport{};
+    viewport.x = 0.0f;
+    viewport.y = 0.0f;
+    viewport.width = static_cast<float>(swapChainExtent.width);
+    viewport.height = static_cast<float>(swapChainExtent.height);
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+    VkRect2D scissor{};
+    scissor.offset = {0, 0};
+    scissor.extent = swapChainExtent;
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    // All geometri ligger i arenaen, og de synlige matrisene i bufferet Cull.comp fylte.
+    // firstIndex, vertexOffset og firstInstance kommer fra kommandoene.
+    VkBuffer vertexBuffers[] = {GPUresources->getVertexArena()->getBuffer(), frame.instanceBuffer};
+    VkDeviceSize offsets[] = {0, frame.instanceOffset};
+    vkCmdBindVertexBuffers(commandBuffer, 0, 2, vertexBuffers, offsets);
+    vkCmdBindIndexBuffer(commandBuffer, GPUresources->getIndexArena()->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+
+    const std::vector<VkDescriptorSet>& sets = frame.descriptorSets;
+    VkPipeline boundPipeline = VK_NULL_HANDLE;
+    VkDescriptorSet boundSet = VK_NULL_HANDLE;
+
+    // Ett scope per løp av grupper med samme pipeline
+    bbl::GpuProfiler::ScopeId runScope = bbl::GpuProfiler::InvalidScope;
+
+    for (uint32_t groupIndex = 0; groupIndex < drawGroups.size(); ++groupIndex) {
+        const DrawGroup& group = drawGroups[groupIndex];
+
+        if (groupIndex == 0 || group.pipeline != drawGroups[groupIndex - 1].pipeline) {
+            gpuProfiler->endScope(commandBuffer, runScope);
+            runScope = gpuProfiler->beginScope(commandBuffer, pipelineScopeName(group.pipeline));
+        }
+
+        VkPipeline pipeline = getPipeline(group.pipeline);
+        if (pipeline == VK_NULL_HANDLE) {
+            continue;
+        }
+        if (pipeline != boundPipeline) {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+            boundPipeline = pipeline;
+            ++pipelineBindCount;
+        }
+
+        VkDescriptorSet descriptorSet = sets[group.descriptorIndex];
+        if (descriptorSet != boundSet) {
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                    pipelineLayout, 0, 1, &descriptorSet, 1, &frame.uniformOffset);
+            boundSet = descriptorSet;
+            ++descriptorBindCount;
         }
 
-        vkCmdEndRenderPass(commandBuffers[i]);
+        gpuCulling->drawGroup(commandBuffer, groupIndex, group.firstBatch, group.batchCount);
+    }
+    gpuProfiler->endScope(commandBuffer, runScope);
+}
 
-        if (vkEndCommandBuffer(commandBuffers[i]) != VK_SUCCESS)
-            throw std::runtime_error("failed to record command buffer!");
+Renderer::PipelineVariant Renderer::pipelineVariantFor(const bbl::Render& render) const
+{
+    // Flaggene i Render velger shader-sett og topologi. Nye materialegenskaper legges til
+    // som feature-bits (spesialiseringskonstanter), ikke som nye pipelines.
+    PipelineVariant variant;
+    if (render.usePhong) {
+        variant.shaderSet = phongShaders;
+        variant.features = bbl::PipelineRegistry::FeatureTexture | bbl::PipelineRegistry::FeatureBlinn;
+    } else if (render.usePoint || render.useLine) {
+        // Punkter og linjer bruker vertex-fargen
+        variant.shaderSet = unlitShaders;
+        variant.topology = render.usePoint ? VK_PRIMITIVE_TOPOLOGY_POINT_LIST : VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
+    } else {
+        variant.shaderSet = unlitShaders;
+        variant.features = bbl::PipelineRegistry::FeatureTexture;
     }
+    return variant;
+}
+
+VkPipeline Renderer::getPipeline(const PipelineVariant& variant) const
+{
+    return pipelineRegistry->request(variant);
+}
+
+std::string Renderer::pipelineScopeName(const PipelineVariant& variant) const
+{
+    std::string name = variant.shaderSet == phongShaders ? "phong" : "unlit";
+    if (variant.topology == VK_PRIMITIVE_TOPOLOGY_POINT_LIST) {
+        name += " points";
+    } else if (variant.topology == VK_PRIMITIVE_TOPOLOGY_LINE_LIST) {
+        name += " lines";
+    }
+    if (variant.blend == bbl::PipelineRegistry::BlendMode::Alpha) {
+        name += " alpha";
+    }
+    return name;
 }
 
 
 void Renderer::createSyncObjects()
 {
     // One fence and one imageAvailable semaphore per frame in flight
-    inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-    imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
+    inFlightFences.resize(framesInFlight);
+    imageAvailableSemaphores.resize(framesInFlight);
 
     // One renderFinished semaphore per swapchain image
     renderFinishedSemaphores.resize(swapChainImages.size());
@@ -1873,7 +2497,7 @@ void Renderer::createSyncObjects()
     semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
     // Create per-frame sync objects
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    for (size_t i = 0; i < framesInFlight; i++) {
         if (vkCreateFence(device, &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS ||
             vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS) {
             throw std::runtime_error("failed to create fence or imageAvailable semaphore!");
@@ -1888,146 +2512,406 @@ void Renderer::createSyncObjects()
     }
 }
 
+void Renderer::destroySyncObjects()
+{
+    // destroy per-image renderFinished semaphores
+    for (VkSemaphore semaphore : renderFinishedSemaphores) {
+        vkDestroySemaphore(device, semaphore, nullptr);
+    }
+
+    // destroy per-frame semaphores + fences
+    for (size_t i = 0; i < inFlightFences.size(); i++) {
+        vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
+        vkDestroyFence(device, inFlightFences[i], nullptr);
+    }
+
+    renderFinishedSemaphores.clear();
+    imageAvailableSemaphores.clear();
+    inFlightFences.clear();
+    imagesInFlight.clear();
+}
+
 
-void Renderer::updateUniformBuffer(uint32_t currentImage) {
+void Renderer::updateScene() {
     using clock = std::chrono::high_resolution_clock;
     static auto lastTime = clock::now();
     auto currentTime = clock::now();
-    deltaTime = std::chrono::duration<float>(currentTime - lastTime).count();
+    deltaTime = fixedTimeStep > 0.0f ? fixedTimeStep : std::chrono::duration<float>(currentTime - lastTime).count();
     lastTime = currentTime;
 
-    // Camera
+    // Camera. Musebevegelser og klikk fra GUI-tråden tas med først.
+    applyPendingInput();
     Camera* cam = BBLHub::Instance().GetCamera();
     cam->processInput(keyW, keyA, keyS, keyD, keyQ, keyE, deltaTime);
-    m_gameWorld.update(deltaTime);
+    cam->updateFrustum(swapChainExtent.width / static_cast<float>(swapChainExtent.height), cam->getFov());
+    simulation->setViewer(cam->getPosition(), cam->getFrustum());
 
-    // Get renderable entities
-    std::vector<bbl::EntityID> renderableEntities = entityManager->getEntitiesWith<bbl::Transform, bbl::Render>();
+    // Simuleringen går på egen tråd; headless tar steget her
+    if (!simulation->isRunning()) {
+        simulation->tick(deltaTime);
+    }
+    snapshot = &simulation->acquireSnapshot();
 
-    glm::vec3 lightPosition = glm::vec3{0, 60, 0};
-    glm::vec3 lightDirection = glm::vec3{0, -1, 0};
+    // Trace-meshene er GPU-opplastinger og lages her, ikke på simuleringstråden.
+    // De nye Render-komponentene kommer med i snapshotet execute() publiserer.
+    if (snapshot->traceVersion != uploadedTraceVersion) {
+        uploadedTraceVersion = snapshot->traceVersion;
+        simulation->execute([this] { m_gameWorld.updateTraceRenderData(); });
+        snapshot = &simulation->acquireSnapshot();
+    }
+}
 
-    if (!renderableEntities.empty()) {
-        bbl::Transform* firstTransform = entityManager->getComponent<bbl::Transform>(renderableEntities[0]);
-        if (firstTransform) {
-            lightPosition = firstTransform->position;
+void Renderer::applyPendingInput()
+{
+    PendingInput input;
+    {
+        std::lock_guard<std::mutex> lock(inputMutex);
+        std::swap(input, pendingInput);
+    }
+
+    Camera* cam = BBLHub::Instance().GetCamera();
+    if (input.yaw != 0.0f || input.pitch != 0.0f) {
+        cam->addYaw(input.yaw);
+        cam->addPitch(input.pitch);
+    }
 
-            glm::mat4 rotationMatrix = firstTransform->getRotationMatrix();
+    const float viewWidth = static_cast<float>(windowWidth.load());
+    const float viewHeight = static_cast<float>(windowHeight.load());
+    if (viewWidth <= 0.0f || viewHeight <= 0.0f) {
+        return;
+    }
 
-            glm::vec4 forward = rotationMatrix * glm::vec4(0, 0, -1, 0);
-            lightDirection = glm::normalize(glm::vec3(forward));
+    // Picking i viewporten. Utvalget hører til GUI-en, så treffet sendes tilbake dit.
+    for (const QPointF& position : input.picks) {
+        bbl::Ray ray = cam->screenPointToRay(static_cast<float>(position.x()), static_cast<float>(position.y()),
+                                             viewWidth, viewHeight);
+        bbl::RaycastHit hit;
+        bool picked = simulation->execute([&] { return m_gameWorld.raycast(ray, hit, true); });
+        if (!picked || hit.entity == bbl::INVALID_ENTITY) {
+            continue;
         }
+        const bbl::EntityID entity = hit.entity;
+        QMetaObject::invokeMethod(this, [this, entity] {
+            if (MainWindow* mw = BBLHub::Instance().GetMainWindow()) {
+                mw->selectEntity(entity);
+            } else {
+                setSelectedEntity(entity);
+            }
+        }, Qt::QueuedConnection);
     }
+}
 
-    float lightIntensity = 1.0f;
-
-    // Calculate alignment
-    VkPhysicalDeviceProperties properties;
-    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
-    size_t minUboAlignment = properties.limits.minUniformBufferOffsetAlignment;
-    size_t alignedUniformSize = (sizeof(UniformBufferObject) + minUboAlignment - 1) & ~(minUboAlignment - 1);
+void Renderer::updateUniformBuffer(FrameData& frame) {
+    if (snapshot->entities.empty()) {
+        return;
+    }
 
-    void* data = nullptr;
-    VkDeviceSize bufferSize = alignedUniformSize * renderableEntities.size();
-    vkMapMemory(device, uniformBuffersMemory[currentImage], 0, bufferSize, 0, &data);
-    char* mappedData = static_cast<char*>(data);
+    Camera* cam = BBLHub::Instance().GetCamera();
 
-    size_t entityIndex = 0;
-    for (bbl::EntityID entity : renderableEntities) {
-        bbl::Transform* transform = entityManager->getComponent<bbl::Transform>(entity);
-        if (!transform) {
-            ++entityIndex;
-            continue;
-        }
+    glm::vec3 lightPosition = glm::vec3{0, 60, 0};
+    glm::vec3 lightDirection = glm::vec3{0, -1, 0};
 
-        UniformBufferObject* ubo = reinterpret_cast<UniformBufferObject*>(mappedData + (entityIndex * alignedUniformSize));
-        ubo->model = transform->getModelMatrix();
-        ubo->lightPos = lightPosition;
-        ubo->lightDir = lightDirection;
-        ubo->viewPos = cam->getPosition();
-        ubo->view = cam->getViewMatrix();
-        ubo->proj = glm::perspective(glm::radians(cam->getFov()),
-                                     swapChainExtent.width / static_cast<float>(swapChainExtent.height),
-                                     0.1f, 1000.0f);
-        ubo->lightIntensity = lightIntensity;
-        ubo->proj[1][1] *= -1.0f;
-        ++entityIndex;
+    // Første renderbare entitet er lyset; posisjon og retning hentes fra model-matrisen
+    const glm::mat4& lightModel = snapshot->models[0];
+    lightPosition = glm::vec3(lightModel[3]);
+
+    glm::vec4 forward = lightModel * glm::vec4(0, 0, -1, 0);
+    lightDirection = glm::normalize(glm::vec3(forward));
+
+    // Samme for alle entiteter, skrives én gang
+    UniformBufferObject ubo{};
+    ubo.view = cam->getViewMatrix();
+    ubo.proj = glm::perspective(glm::radians(cam->getFov()),
+                                swapChainExtent.width / static_cast<float>(swapChainExtent.height),
+                                0.1f, 1000.0f);
+    ubo.proj[1][1] *= -1.0f;
+    ubo.lightPos = lightPosition;
+    ubo.viewPos = cam->getPosition();
+    ubo.lightDir = lightDirection;
+    ubo.lightIntensity = 1.0f;
+
+    // Rett inn i persistent mappet minne, ingen map/unmap
+    bbl::UploadAllocator::Allocation uniform = uploadAllocator->allocateUniform(sizeof(UniformBufferObject));
+    memcpy(uniform.data, &ubo, sizeof(UniformBufferObject));
+    frame.uniformOffset = static_cast<uint32_t>(uniform.offset);
+
+    if (visibleInstances.empty()) {
+        return;
     }
 
-    vkUnmapMemory(device, uniformBuffersMemory[currentImage]);
+    // Bare synlige instanser, pakket av cullInstances() i samme rekkefølge som visibleBatches
+    VkDeviceSize instanceSize = sizeof(InstanceData) * visibleInstances.size();
+    bbl::UploadAllocator::Allocation instances = uploadAllocator->allocateVertex(instanceSize);
+    memcpy(instances.data, visibleInstances.data(), static_cast<size_t>(instanceSize));
+    frame.instanceBuffer = instances.buffer;
+    frame.instanceOffset = instances.offset;
 }
 
 
 void Renderer::drawFrame()
 {
-    vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+    // Nytt antall frames in flight eller ny present mode tas i bruk mellom to frames
+    applyFrameSettings();
+    recordingThread = std::this_thread::get_id();
 
-    uint32_t imageIndex;
-    VkResult result = vkAcquireNextImageKHR(
-        device,
-        swapChain,
-        UINT64_MAX,
-        imageAvailableSemaphores[currentFrame],
-        VK_NULL_HANDLE,
-        &imageIndex);
-
-    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-        recreateSwapChain();
-        return;
-    } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
-        throw std::runtime_error("failed to acquire swap chain image!");
+    // Alt frem til input leses er venting: på slotten, på et swapchain-bilde og på pacingen
+    const auto blockedStart = std::chrono::steady_clock::now();
+    vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+    pollFrameCompletions();
+
+    // frames[currentFrame] er ledig siden fencen over er ventet på
+    FrameData& frame = frames[currentFrame];
+
+    // Headless har ett mål per frame in flight og ingen acquire. Vi venter maks 100 ms på et
+    // bilde, så rendertråden kan stoppes selv om vinduet ikke lenger vises.
+    uint32_t imageIndex = static_cast<uint32_t>(currentFrame);
+    if (!headless) {
+        VkResult result = vkAcquireNextImageKHR(
+            device,
+            swapChain,
+            100'000'000ull,
+            imageAvailableSemaphores[currentFrame],
+            VK_NULL_HANDLE,
+            &imageIndex);
+
+        if (result == VK_TIMEOUT || result == VK_NOT_READY) {
+            return;
+        } else if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+            recreateSwapChain();
+            return;
+        } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+            throw std::runtime_error("failed to acquire swap chain image!");
+        }
     }
 
-    updateUniformBuffer(imageIndex);
-
     // Wait if a previous frame is still using this image
     if (imagesInFlight[imageIndex] != VK_NULL_HANDLE) {
         vkWaitForFences(device, 1, &imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
     }
     imagesInFlight[imageIndex] = inFlightFences[currentFrame];
 
+    // Input leses så sent pacingen tillater
+    const auto inputTime = framePacer.wait(std::chrono::steady_clock::now() - blockedStart,
+                                           [this] { pollFrameCompletions(); });
+
+    auto recordStart = std::chrono::steady_clock::now();
+    updateScene();
+
+    // Herfra brukes GPU-ressurser, køene og frame-ressursene. Snapshotet hentes på nytt under
+    // låsen: en execute() som slapp ressurser før vi fikk den har publisert et nyere.
+    std::unique_lock<std::recursive_mutex> gpuLock(gpuMutex);
+    snapshot = &simulation->acquireSnapshot();
+
+    // Frames eldre enn denne slotten er ferdige, sluppede GPU-ressurser kan slettes
+    GPUresources->advanceFrame();
+
+    // Slotten er ferdig på GPU-en: les det den målte sist uten å vente, og start en ny frame i den
+    gpuProfiler->beginFrame(static_cast<uint32_t>(currentFrame), frameCounter + 1);
+    const bbl::GpuProfiler::Results& profile = gpuProfiler->getResults();
+    frameTimings.gpuMs = profile.frameMs();
+    frameTimings.gpuFrame = profile.frame;
+
+    prepareFrameResources(frame);
+    if (frame.gpuCulled) {
+        cullInstancesOnGpu(frame);
+    } else {
+        cullInstances();
+    }
+    updateUniformBuffer(frame);
+    recordCommandBuffer(frame, imageIndex);
+    frameTimings.cpuRecordMs =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - recordStart).count();
+
     VkSubmitInfo submitInfo{};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-    VkSemaphore waitSemaphores[] = { imageAvailableSemaphores[currentFrame] };
-    VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-    submitInfo.waitSemaphoreCount = 1;
+    // Opplastinger fra denne framen (spawn, lasting) sendes før framen. På egen transfer-kø
+    // venter framen på timeline-verdien til siste batch; på grafikk-køen holder rekkefølgen.
+    bbl::UploadQueue::Ticket uploadTicket = uploadQueue->flush();
+
+    VkSemaphore waitSemaphores[2];
+    VkPipelineStageFlags waitStages[2];
+    uint64_t waitValues[2];
+    uint32_t waitCount = 0;
+    if (!headless) {
+        waitSemaphores[waitCount] = imageAvailableSemaphores[currentFrame];
+        waitStages[waitCount] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        waitValues[waitCount++] = 0;
+    }
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    if (uploadQueue->getTimelineSemaphore() != VK_NULL_HANDLE && uploadTicket > 0) {
+        waitSemaphores[waitCount] = uploadQueue->getTimelineSemaphore();
+        waitStages[waitCount] = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        waitValues[waitCount++] = uploadTicket;
+
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfo.waitSemaphoreValueCount = waitCount;
+        timelineInfo.pWaitSemaphoreValues = waitValues;
+        submitInfo.pNext = &timelineInfo;
+    }
+    submitInfo.waitSemaphoreCount = waitCount;
     submitInfo.pWaitSemaphores = waitSemaphores;
     submitInfo.pWaitDstStageMask = waitStages;
 
     submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffers[imageIndex];
+    submitInfo.pCommandBuffers = &frame.commandBuffer;
 
     // Signal renderFinished for this particular swapchain image
     VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[imageIndex] };
-    submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = signalSemaphores;
+    if (!headless) {
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = signalSemaphores;
+    }
 
     vkResetFences(device, 1, &inFlightFences[currentFrame]);
 
     if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
         throw std::runtime_error("failed to submit draw command buffer!");
     }
+    pacingInputTimes[currentFrame] = inputTime;
+    ++frameCounter;
+
+    if (!headless) {
+        VkPresentInfoKHR presentInfo{};
+        presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+        presentInfo.waitSemaphoreCount = 1;
+        presentInfo.pWaitSemaphores = signalSemaphores;
+        VkSwapchainKHR swapChains[] = { swapChain };
+        presentInfo.swapchainCount = 1;
+        presentInfo.pSwapchains = swapChains;
+        presentInfo.pImageIndices = &imageIndex;
+
+        VkResult result = vkQueuePresentKHR(presentQueue, &presentInfo);
+
+        const bool resized = framebufferResized.exchange(false);
+        if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || resized) {
+            recreateSwapChain();
+        } else if (result != VK_SUCCESS) {
+            throw std::runtime_error("failed to present swap chain image!");
+        }
+    }
+
+    publishFrameStats();
+    gpuLock.unlock();
+
+    currentFrame = (currentFrame + 1) % framesInFlight;
+}
+
+void Renderer::pollFrameCompletions()
+{
+    // Input-tiden nullstilles når fencen er sett signalert, så hver frame måles én gang
+    const auto now = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < pacingInputTimes.size(); ++i) {
+        if (pacingInputTimes[i] != std::chrono::steady_clock::time_point{} &&
+            vkGetFenceStatus(device, inFlightFences[i]) == VK_SUCCESS) {
+            framePacer.frameCompleted(pacingInputTimes[i], now);
+            pacingInputTimes[i] = {};
+        }
+    }
+}
+
+void Renderer::publishFrameStats()
+{
+    const bbl::GpuProfiler::Results& profile = gpuProfiler->getResults();
+
+    std::lock_guard<std::mutex> lock(statsMutex);
+    publishedRenderStats = renderStats;
+    publishedTimings = frameTimings;
+    publishedPacing = framePacer.getStats();
+    // Profilen endres bare når en ny frame er lest tilbake, ikke kopier scopene hver frame
+    if (profile.frame != publishedProfile.frame) {
+        publishedProfile = profile;
+    }
+}
+
+Renderer::FrameTimings Renderer::getFrameTimings() const
+{
+    std::lock_guard<std::mutex> lock(statsMutex);
+    return publishedTimings;
+}
+
+Renderer::RenderStats Renderer::getRenderStats() const
+{
+    std::lock_guard<std::mutex> lock(statsMutex);
+    return publishedRenderStats;
+}
 
-    VkPresentInfoKHR presentInfo{};
-    presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-    presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = signalSemaphores;
-    VkSwapchainKHR swapChains[] = { swapChain };
-    presentInfo.swapchainCount = 1;
-    presentInfo.pSwapchains = swapChains;
-    presentInfo.pImageIndices = &imageIndex;
+bbl::GpuProfiler::Results Renderer::getGpuProfile() const
+{
+    std::lock_guard<std::mutex> lock(statsMutex);
+    return publishedProfile;
+}
 
-    result = vkQueuePresentKHR(presentQueue, &presentInfo);
+bbl::FramePacer::Stats Renderer::getPacingStats() const
+{
+    std::lock_guard<std::mutex> lock(statsMutex);
+    return publishedPacing;
+}
 
-    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized) {
-        framebufferResized = false;
-        recreateSwapChain();
-    } else if (result != VK_SUCCESS) {
-        throw std::runtime_error("failed to present swap chain image!");
+bool Renderer::saveFrameImage(const QString& path)
+{
+    if (!headless || frameCounter == 0) {
+        qWarning() << "saveFrameImage: needs a headless renderer with at least one frame";
+        return false;
     }
 
-    currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    waitIdle();
+
+    // Siste innsendte frame ligger i TRANSFER_SRC_OPTIMAL etter render passet
+    const uint32_t imageIndex = static_cast<uint32_t>((currentFrame + framesInFlight - 1) % framesInFlight);
+    const uint32_t width = swapChainExtent.width;
+    const uint32_t height = swapChainExtent.height;
+
+    VkBuffer readback = VK_NULL_HANDLE;
+    bbl::DeviceAllocation readbackAllocation;
+    createBuffer(static_cast<VkDeviceSize>(width) * height * 4, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 readback, readbackAllocation);
+
+    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = swapChainImages[imageIndex];
+    barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    VkBufferImageCopy region{};
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.imageExtent = {width, height, 1};
+    vkCmdCopyImageToBuffer(commandBuffer, swapChainImages[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           readback, 1, &region);
+
+    VkMemoryBarrier hostBarrier{};
+    hostBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                         0, 1, &hostBarrier, 0, nullptr, 0, nullptr);
+
+    endSingleTimeCommands(commandBuffer);
+
+    // Pikslene er allerede sRGB-kodet, så bytene kan lagres som de er
+    QImage image(static_cast<const uchar*>(readbackAllocation.mapped), static_cast<int>(width),
+                 static_cast<int>(height), static_cast<qsizetype>(width) * 4, QImage::Format_RGBA8888);
+    if (swapChainImageFormat == VK_FORMAT_B8G8R8A8_SRGB) {
+        image = image.rgbSwapped();
+    }
+    const bool saved = image.save(path);
+    memoryAllocator->destroyBuffer(readback, readbackAllocation);
+
+    if (!saved) {
+        qWarning() << "saveFrameImage: could not write" << path;
+    }
+    return saved;
 }
 
 
@@ -2056,12 +2940,21 @@ VkSurfaceFormatKHR Renderer::chooseSwapSurfaceFormat(const std::vector<VkSurface
 }
 
 VkPresentModeKHR Renderer::chooseSwapPresentMode(const std::vector<VkPresentModeKHR> &availablePresentModes) {
+    // FIFO is the only mode every device must support, use it when the chosen one is missing
+    VkPresentModeKHR wanted = VK_PRESENT_MODE_FIFO_KHR;
+    if (presentMode == PresentMode::Mailbox) {
+        wanted = VK_PRESENT_MODE_MAILBOX_KHR;
+    } else if (presentMode == PresentMode::Immediate) {
+        wanted = VK_PRESENT_MODE_IMMEDIATE_KHR;
+    }
+
     for (const auto& availablePresentMode : availablePresentModes) {
-        if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
+        if (availablePresentMode == wanted) {
             return availablePresentMode;
         }
     }
 
+    qWarning() << "Present mode" << static_cast<int>(wanted) << "not supported, using FIFO";
     return VK_PRESENT_MODE_FIFO_KHR;
 }
 
@@ -2072,10 +2965,10 @@ VkExtent2D Renderer::chooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabiliti
         return capabilities.currentExtent;
     } else {
         //If value can vary, need to set manually
-        //Get the size of the render window - Qt style
+        //Get the size of the render window - Qt style (as last seen by the GUI thread)
         //GLFW uses glfwGetFramebufferSize(window, &width, &height);
-        int width = this->width();
-        int height = this->height();
+        int width = windowWidth.load();
+        int height = windowHeight.load();
 
         //create new extent using window size
         VkExtent2D actualExtent = {
@@ -2120,8 +3013,8 @@ bool Renderer::isDeviceSuitable(VkPhysicalDevice device) {
 
     bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-    bool swapChainAdequate = false;
-    if (extensionsSupported) {
+    bool swapChainAdequate = headless;
+    if (extensionsSupported && !headless) {
         SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
         swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
     }
@@ -2139,7 +3032,10 @@ bool Renderer::checkDeviceExtensionSupport(VkPhysicalDevice device) {
     std::vector<VkExtensionProperties> availableExtensions(extensionCount);
     vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
-    std::set<std::string> requiredExtensions(deviceExtensions.begin(), deviceExtensions.end());
+    std::set<std::string> requiredExtensions;
+    if (!headless) {
+        requiredExtensions.insert(deviceExtensions.begin(), deviceExtensions.end());
+    }
 
     for (const auto& extension : availableExtensions) {
         requiredExtensions.erase(extension.extensionName);
@@ -2163,8 +3059,13 @@ QueueFamilyIndices Renderer::findQueueFamilies(VkPhysicalDevice device) {
             indices.graphicsFamily = i;
         }
 
+        // Uten overflate presenteres ingenting, grafikk-køen holder
         VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+        if (surface != VK_NULL_HANDLE) {
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+        } else {
+            presentSupport = (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) ? VK_TRUE : VK_FALSE;
+        }
 
         if (presentSupport) {
             indices.presentFamily = i;
@@ -2177,6 +3078,17 @@ QueueFamilyIndices Renderer::findQueueFamilies(VkPhysicalDevice device) {
         i++;
     }
 
+    // Helst en ren transfer-familie (DMA-motoren), ellers en uten grafikk
+    for (uint32_t family = 0; family < queueFamilyCount; ++family) {
+        VkQueueFlags flags = queueFamilies[family].queueFlags;
+        if (!(flags & VK_QUEUE_TRANSFER_BIT) || (flags & VK_QUEUE_GRAPHICS_BIT)) {
+            continue;
+        }
+        if (!indices.transferFamily || !(flags & VK_QUEUE_COMPUTE_BIT)) {
+            indices.transferFamily = family;
+        }
+    }
+
     return indices;
 }
 
@@ -2203,14 +3115,17 @@ std::vector<const char *> Renderer::getRequiredExtensions() {
         qDebug("\nVulkan instance extension count: %u", extensionCount);
     }
 
-    extensions.push_back("VK_KHR_surface");
+    // Headless har ingen overflate, og skal kunne kjøre uten vindussystem (lavapipe i CI)
+    if (!headless) {
+        extensions.push_back("VK_KHR_surface");
 #ifdef _WIN32
-    extensions.push_back("VK_KHR_win32_surface");	// Only on Windows
+        extensions.push_back("VK_KHR_win32_surface");	// Only on Windows
 #elif defined(Q_OS_LINUX)
-    instanceExtensions.push_back("VK_KHR_xcb_surface");		// or xlib_surface, depending on your Qt build
+        extensions.push_back("VK_KHR_xcb_surface");		// or xlib_surface, depending on your Qt build
 #elif defined(__APPLE__)
-    extensions.push_back("VK_MVK_macos_surface");
+        extensions.push_back("VK_MVK_macos_surface");
 #endif
+    }
 
     // If validation is enabled, add extension to report validation debug info
     if (enableValidationLayers) {
@@ -2271,29 +3186,25 @@ VkBool32 Renderer::debugCallback(VkDebugUtilsMessageSeverityFlagBitsEXT messageS
 
 void Renderer::exposeEvent(QExposeEvent* event)
 {
-#ifdef _WIN32   // These lines does not work on macOS !?!
-
-    qDebug("exposeEvent called");
-    if (isExposed()) {
-        drawFrame();			//actual drawing
-    }
-#endif
+    // Rendertråden tegner, her sier vi bare fra om det er noe å tegne til
+    windowExposed = isExposed();
+    requestRender();
 }
 
 void Renderer::resizeEvent(QResizeEvent *event)
 {
     qDebug("resizeEvent called");
-    if (isExposed()) {
-        drawFrame();			//actual drawing
-    }
+    windowWidth = width();
+    windowHeight = height();
+    framebufferResized = true;
+    requestRender();
 }
 
 bool Renderer::event(QEvent* ev)
 {
-    //qDebug("event(QEvent* ev) called");
-    if (ev->type() == QEvent::UpdateRequest && isExposed()) {
-        drawFrame();			//actual drawing
-        requestUpdate();        // schedule the next UpdateRequest == render loop
+    // Rendertråden går i egen løkke, requestUpdate() ber den bare om en frame
+    if (ev->type() == QEvent::UpdateRequest) {
+        requestRender();
         return true;
     }
     return QWindow::event(ev);
@@ -2307,6 +3218,13 @@ void Renderer::mousePressEvent(QMouseEvent* event)
 
         setCursor(Qt::BlankCursor);
     }
+
+    // Picking i viewporten. Kameraet eies av rendertråden, klikket tas med i neste frame.
+    if (event->button() == Qt::LeftButton) {
+        std::lock_guard<std::mutex> lock(inputMutex);
+        pendingInput.picks.push_back(event->position());
+    }
+    requestRender();
 }
 
 void Renderer::mouseReleaseEvent(QMouseEvent* event)
@@ -2327,10 +3245,13 @@ void Renderer::mouseMoveEvent(QMouseEvent* event)
 
         float sensitivity = 0.1f;
 
-        Camera* cam = BBLHub::Instance().GetCamera();
-
-        cam->addYaw(delta.x() * sensitivity);
-        cam->addPitch(-delta.y() * sensitivity);
+        // Summeres til rendertråden henter det i neste frame
+        {
+            std::lock_guard<std::mutex> lock(inputMutex);
+            pendingInput.yaw += delta.x() * sensitivity;
+            pendingInput.pitch += -delta.y() * sensitivity;
+        }
+        requestRender();
     }
 }
 
@@ -2360,6 +3281,7 @@ void Renderer::keyPressEvent(QKeyEvent* event)
     if (event->key() == Qt::Key_D) keyD = true;
     if (event->key() == Qt::Key_Q) keyQ = true;
     if (event->key() == Qt::Key_E) keyE = true;
+    requestRender();
 }
 
 void Renderer::keyReleaseEvent(QKeyEvent* event)
@@ -2371,6 +3293,7 @@ void Renderer::keyReleaseEvent(QKeyEvent* event)
     if (event->key() == Qt::Key_D) keyD = false;
     if (event->key() == Qt::Key_Q) keyQ = false;
     if (event->key() == Qt::Key_E) keyE = false;
+    requestRender();
 }
 
 
@@ -3,14 +3,27 @@
 
     #include <QWindow>
     #include <vulkan/vulkan_core.h>
+    #include <atomic>
+    #include <chrono>
+    #include <condition_variable>
+    #include <mutex>
     #include <string>
+    #include <thread>
     #include <vector>
     #include <unordered_map>
     #include "Camera.h"
     #include "../ECS/Entity/EntityManager.h"
     #include "../ECS/Entity/SceneManager.h"
     #include "../Core/Utility/Vertex.h"
+    #include "../Core/Utility/UploadAllocator.h"
+    #include "../Core/Utility/DeviceMemoryAllocator.h"
+    #include "../Core/Utility/GpuCulling.h"
+    #include "../Core/Utility/UploadQueue.h"
+    #include "../Core/Utility/PipelineRegistry.h"
+    #include "../Core/Utility/GpuProfiler.h"
+    #include "../Core/Utility/FramePacer.h"
     #include "../Game/GameWorld.h"
+    #include "../Game/SimulationThread.h"
 
 
 
@@ -27,6 +40,50 @@
 
         void initVulkan();
 
+        // Uten overflate og swapchain: rendrer til egne images, for benchmark og CI uten
+        // skjerm. Kalles i stedet for initVulkan(), og vinduet skal ikke vises.
+        void initHeadless(uint32_t width, uint32_t height);
+        bool isHeadless() const { return headless; }
+
+        // Én frame på kallende tråd (headless). I vinduet rendrer en egen tråd, se initVulkan().
+        void renderFrame() { drawFrame(); }
+
+        // Venter på GPU-en og på pipelines som kompileres i bakgrunnen
+        void waitIdle();
+
+        // Leser tilbake siste frame og lagrer den som bilde (PNG ut fra filendelsen). Bare headless.
+        bool saveFrameImage(const QString& path);
+
+        // Fast tidssteg for simuleringen i stedet for veggklokka, 0 = av
+        void setFixedTimeStep(float seconds) { fixedTimeStep = seconds; }
+
+        // cpuRecordMs er for siste frame. GPU-tiden er "frame"-scopet i getGpuProfile() og er for
+        // siste frame GPU-en er ferdig med (gpuFrame, 0 = ingen ennå eller ikke støttet).
+        struct FrameTimings
+        {
+            double cpuRecordMs = 0.0;
+            double gpuMs = 0.0;
+            uint64_t gpuFrame = 0;
+        };
+        FrameTimings getFrameTimings() const;
+        uint64_t getFrameCount() const { return frameCounter.load(); }
+
+        // Hvordan bildene vises. Fifo venter på vsync og finnes alltid, Mailbox bytter ut bildet
+        // som venter uten å rive, Immediate viser med en gang og kan rive. Mangler enheten
+        // modusen brukes Fifo. Tas i bruk ved starten av neste frame (ny swapchain).
+        enum class PresentMode { Fifo, Mailbox, Immediate };
+        void setPresentMode(PresentMode mode) { requestedPresentMode = mode; requestRender(); }
+        PresentMode getPresentMode() const { return requestedPresentMode.load(); }
+
+        // 1 til MAX_FRAMES_IN_FLIGHT. Flere jevner ut variasjon i CPU- og GPU-tid, færre gir
+        // lavere latency. Endringen venter på GPU-en og lager frame-ressursene på nytt.
+        void setFramesInFlight(uint32_t count);
+        uint32_t getFramesInFlight() const { return requestedFramesInFlight.load(); }
+
+        // Mål for tiden fra input leses til framen er ferdig på GPU-en (ms), 0 = av. Se FramePacer.
+        void setTargetLatency(double milliseconds) { framePacer.setTargetLatency(milliseconds); requestRender(); }
+        bbl::FramePacer::Stats getPacingStats() const;
+
 
     public:
 
@@ -36,9 +93,13 @@
         bbl::GameWorld* setGameWorld(){return &m_gameWorld;}
         std::vector<bbl::EntityID> getRenderableEntities()
         {
-            return entityManager->getEntitiesWith<bbl::Transform, bbl::Render>();
+            return simulation->execute([this] { return entityManager->getEntitiesWith<bbl::Transform, bbl::Render>(); });
         }
 
+        // Eier ECS-en og GameWorld mens simuleringen kjører på egen tråd. Editoren endrer
+        // verden med submit() eller execute(), aldri direkte (null før initVulkan).
+        bbl::SimulationThread* getSimulation() { return simulation.get(); }
+
         // Get entities map
         const std::unordered_map<bbl::EntityID, std::string>& getEntityNames() const {
             return entityNames;
@@ -63,7 +124,7 @@
         // Get entity count for debugging
         size_t getEntityCount()
         {
-            return entityManager->getEntityCount();
+            return simulation->execute([this] { return entityManager->getEntityCount(); });
         }
 
         void keyPressEvent(QKeyEvent* event) override;
@@ -78,7 +139,41 @@
         bbl::EntityID spawnModel(const std::string& modelPath, const std::string& texturePath, const glm::vec3& basePosition);
         void recreateSwapChain();
 
-        void recreateCommandBuffers();
+        // Kalles når scene-innholdet endres (spawn, sletting, komponent-endringer, lasting).
+        // Descriptor sets skrives på nytt ved neste frame, swapchainen røres ikke.
+        void markSceneChanged();
+
+        // Rendertråden tegner bare når noe kan ha endret seg: simuleringen går, en tast holdes
+        // nede, pipelines kompileres, eller noen har bedt om en frame siden sist. Ellers sover
+        // den. Input, vinduet, nye snapshots og markSceneChanged() kaller denne. Trådsikker.
+        void requestRender();
+
+        // Tall fra siste frame etter frustum culling
+        struct RenderStats
+        {
+            uint32_t drawnEntities = 0;
+            uint32_t culledEntities = 0;
+            uint32_t drawCalls = 0;
+            uint32_t pipelineBinds = 0;     // vkCmdBindPipeline, én per tilstandsbytte og bit
+            uint32_t descriptorBinds = 0;   // vkCmdBindDescriptorSets, likt
+        };
+        RenderStats getRenderStats() const;
+
+        // Blokker, bruk og fragmentering i device-minnet (tom før initVulkan)
+        bbl::DeviceMemoryAllocator::Stats getMemoryStats() const
+        {
+            return memoryAllocator ? memoryAllocator->getStats() : bbl::DeviceMemoryAllocator::Stats{};
+        }
+
+        // Culling og draw-kommandoer på GPU-en (Cull.comp + indirect draw). Brukes bare når
+        // enheten støtter det og alle mesher ligger i geometri-arenaen, ellers CPU-culling.
+        void setGpuCullingEnabled(bool enabled) { gpuCullingEnabled = enabled; requestRender(); }
+        bool isGpuCullingEnabled() const { return gpuCullingEnabled.load(); }
+        bool isGpuCullingAvailable() const { return gpuCulling != nullptr; }
+
+        // GPU-tid per scope (frame, culling, render pass, hver pipeline) og pipeline-statistikk,
+        // noen frames gammelt. Tomt når køen ikke har tidsstempler.
+        bbl::GpuProfiler::Results getGpuProfile() const;
 
     protected:
         //Qt event handlers - called when requestUpdate(); is called
@@ -88,13 +183,24 @@
 
     private:
 
-        //Editor Camera
-        bool keyW = {false};
-        bool keyA = {false};
-        bool keyS = {false};
-        bool keyD = {false};
-        bool keyQ = {false};
-        bool keyE = {false};
+        //Editor Camera. Settes av GUI-tråden, kameraet flyttes på rendertråden.
+        std::atomic<bool> keyW = {false};
+        std::atomic<bool> keyA = {false};
+        std::atomic<bool> keyS = {false};
+        std::atomic<bool> keyD = {false};
+        std::atomic<bool> keyQ = {false};
+        std::atomic<bool> keyE = {false};
+
+        // Input fra GUI-tråden som rendertråden tar med seg ved starten av neste frame
+        struct PendingInput
+        {
+            float yaw = 0.0f;
+            float pitch = 0.0f;
+            std::vector<QPointF> picks;   // Venstreklikk i viewporten, vindus-koordinater
+        };
+        std::mutex inputMutex;
+        PendingInput pendingInput;
+        void applyPendingInput();
         // class GLFWwindow* window;
         //GLFWwindow* window{nullptr};
         //QWindow* window{ nullptr }; //this object IS a QWindow
@@ -102,6 +208,44 @@
         bbl::GameWorld m_gameWorld;
         std::unique_ptr<bbl::SceneManager> sceneManager;
 
+        // Simuleringen og det den sist publiserte. snapshot er gyldig ut framen og brukes av
+        // alt som leser ECS-en i drawFrame(); instanceSlots peker inn i det.
+        std::unique_ptr<bbl::SimulationThread> simulation;
+        const bbl::RenderSnapshot* snapshot = nullptr;
+        uint64_t uploadedTraceVersion = 0;
+
+        // Rendertråden eier køene og swapchainen og kjører drawFrame() i løkke. gpuMutex holdes
+        // rundt alt i en frame som bruker GPU-ressurser, køene eller frame-ressursene; andre
+        // tråder tar den via SimulationThread::execute(). Rekkefølge: verdenslåsen før gpuMutex.
+        std::thread renderThread;
+        std::atomic<bool> renderThreadStop{false};
+        std::mutex renderWakeMutex;
+        std::condition_variable renderWake;
+        std::recursive_mutex gpuMutex;
+        void startRenderThread();
+        void stopRenderThread();
+        void renderLoop();
+
+        // Satt av requestRender(), under renderWakeMutex så rendertråden ikke sovner forbi den.
+        // settleFrames er frames som tegnes etter siste endring, til GPU-tallene for den er
+        // lest tilbake og utsatte slettinger er gjort.
+        std::atomic<bool> renderRequested{true};
+        uint32_t settleFrames = 0;
+        bool needsFrame();
+
+        // Vinduet slik GUI-tråden sist så det; rendertråden spør aldri QWindow selv
+        std::atomic<bool> windowExposed{false};
+        std::atomic<int> windowWidth{0};
+        std::atomic<int> windowHeight{0};
+
+        // Det GUI-tråden leser (statuslinja, benchmark), kopiert ut etter hver frame
+        mutable std::mutex statsMutex;
+        RenderStats publishedRenderStats;
+        FrameTimings publishedTimings;
+        bbl::GpuProfiler::Results publishedProfile;
+        bbl::FramePacer::Stats publishedPacing;
+        void publishFrameStats();
+
         void createTerrainEntity(bbl::GameWorld *gameWorld);
         bool rightMouseHeld = false;
         QPoint lastMousePos;
@@ -109,12 +253,27 @@
 
         VkInstance instance;
         VkDebugUtilsMessengerEXT debugMessenger;
-        VkSurfaceKHR surface;
+        VkSurfaceKHR surface = VK_NULL_HANDLE;
+
+        // Satt av initHeadless(); swapChainImages er da egne images i offscreenAllocations
+        bool headless = false;
+        std::vector<bbl::DeviceAllocation> offscreenAllocations;
 
         VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+        // Hentes én gang i pickPhysicalDevice(), endrer seg ikke mens programmet kjører
+        VkPhysicalDeviceProperties deviceProperties{};
+        VkPhysicalDeviceMemoryProperties memoryProperties{};
         VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT;
         VkDevice device;
 
+        // Satt i createLogicalDevice() ut fra hva enheten støtter
+        bool multiDrawIndirectSupported = false;
+        bool drawIndirectCountSupported = false;
+
+        // Alt device-minne (meshes, teksturer, color/depth) suballokeres herfra
+        std::unique_ptr<bbl::DeviceMemoryAllocator> memoryAllocator;
+        // Kopieringer til GPU-en, på transferQueue. Frames venter på siste ticket.
+        std::unique_ptr<bbl::UploadQueue> uploadQueue;
         std::unique_ptr<bbl::GPUResourceManager> GPUresources;
         std::unique_ptr<bbl::EntityManager> entityManager;
 
@@ -129,6 +288,10 @@
 
         VkQueue graphicsQueue;
         VkQueue presentQueue;
+        // Egen transfer-kø når enheten har det, ellers samme som graphicsQueue
+        VkQueue transferQueue = VK_NULL_HANDLE;
+        uint32_t graphicsQueueFamily = 0;
+        uint32_t transferQueueFamily = 0;
 
         VkSwapchainKHR swapChain;
         std::vector<VkImage> swapChainImages;
@@ -137,53 +300,161 @@
         std::vector<VkImageView> swapChainImageViews;
         std::vector<VkFramebuffer> swapChainFramebuffers;
 
-        VkRenderPass renderPass;
+        // Render pass og pipelines overlever resize, de bygges bare på nytt når formatet endres
+        VkRenderPass renderPass = VK_NULL_HANDLE;
         VkDescriptorSetLayout descriptorSetLayout;
         VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
 
-        VkPipeline graphicsPipeline;
-        VkPipeline phongPipeline;
-        VkPipeline pointPipeline;
-        VkPipeline linePipeline;
+        // Alle grafikk-pipelines er varianter i registryet, se pipelineVariantFor()
+        std::unique_ptr<bbl::PipelineRegistry> pipelineRegistry;
+        bbl::PipelineRegistry::ShaderSetId unlitShaders = 0;
+        bbl::PipelineRegistry::ShaderSetId phongShaders = 0;
 
         VkCommandPool commandPool;
 
         VkImage colorImage;
-        VkDeviceMemory colorImageMemory;
+        bbl::DeviceAllocation colorImageAllocation;
         VkImageView colorImageView;
 
         VkImage depthImage;
-        VkDeviceMemory depthImageMemory;
+        bbl::DeviceAllocation depthImageAllocation;
         VkImageView depthImageView;
 
         uint32_t mipLevels;
         VkImage textureImage;
-        VkDeviceMemory textureImageMemory;
+        bbl::DeviceAllocation textureImageAllocation;
         VkImageView textureImageView;
         VkSampler textureSampler;
 
         std::vector<Vertex> vertices;
         std::vector<uint32_t> indices;
         VkBuffer vertexBuffer;
-        VkDeviceMemory vertexBufferMemory;
+        bbl::DeviceAllocation vertexBufferAllocation;
         VkBuffer indexBuffer;
-        VkDeviceMemory indexBufferMemory;
-
-        std::vector<VkBuffer> uniformBuffers;
-        std::vector<VkDeviceMemory> uniformBuffersMemory;
+        bbl::DeviceAllocation indexBufferAllocation;
 
-        VkDescriptorPool descriptorPool;
-        std::vector<VkDescriptorSet> descriptorSets;
-
-        std::vector<VkCommandBuffer> commandBuffers;
+        // Én command pool per tråd som tar opp secondary buffers. Pools er ikke trådsikre,
+        // så hver worker i JobSystem har sin egen (indeks 0 er tråden som kjører drawFrame()).
+        // Den siste deles av andre tråder som hjelper til i TaskGroup::wait() (simuleringen),
+        // og brukes under sharedRecordingMutex.
+        struct RecordingPool
+        {
+            VkCommandPool pool = VK_NULL_HANDLE;
+            std::vector<VkCommandBuffer> secondaryBuffers;
+            size_t usedBuffers = 0;
+        };
+        std::thread::id recordingThread;
+        std::mutex sharedRecordingMutex;
+
+        // Alt en frame in flight eier. inFlightFences[i] beskytter frames[i], så alt her kan
+        // endres fritt etter at fencen er ventet på. Descriptor pool vokser geometrisk og
+        // bygges bare om når scenen trenger mer plass enn den har.
+        struct FrameData
+        {
+            // Hvor UBO og instansdata havnet i uploadAllocator denne framen
+            uint32_t uniformOffset = 0;
+            VkBuffer instanceBuffer = VK_NULL_HANDLE;
+            VkDeviceSize instanceOffset = 0;
+
+            // Ett sett per distinkt tekstur i draw-lista (DrawBatch::descriptorIndex)
+            VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+            uint32_t descriptorCapacity = 0;
+            std::vector<VkDescriptorSet> descriptorSets;
+            uint64_t descriptorSceneVersion = 0;
+
+            VkCommandPool commandPool = VK_NULL_HANDLE;
+            VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+            std::vector<RecordingPool> recordingPools;
+
+            // Framen ble cullet på GPU-en og tegnes med indirect draw per DrawGroup
+            bool gpuCulled = false;
+        };
+        std::vector<FrameData> frames;
+        std::unique_ptr<bbl::UploadAllocator> uploadAllocator;
+
+        using PipelineVariant = bbl::PipelineRegistry::VariantKey;
+
+        // Entiteter med samme pipeline, tekstur og mesh tegnes med ett instanced kall.
+        // Instansene ligger etter hverandre i instanceSlots fra firstInstance.
+        struct DrawBatch
+        {
+            PipelineVariant pipeline;
+            size_t meshResourceID = 0;
+            size_t textureResourceID = 0;
+            uint32_t descriptorIndex = 0;
+            uint32_t firstInstance = 0;
+            uint32_t instanceCount = 0;
+        };
+
+        // Draw-lista deles av instance-skriving og opptak, så firstInstance alltid peker
+        // på riktige matriser. Bygges bare på nytt når scene-versjonen endres.
+        std::atomic<uint64_t> sceneVersion{1};
+        uint64_t renderListVersion = 0;
+        size_t renderListHash = 0;
+        std::vector<uint32_t> instanceSlots;     // Indeks i snapshot per instans
+        std::vector<glm::vec4> instanceBounds;   // Lokal kule per instans (senter, radius)
+        std::vector<DrawBatch> drawBatches;
+        std::vector<size_t> batchTextures;
+
+        // Batcher etter hverandre med samme pipeline og tekstur. På GPU-stien er dette ett
+        // indirect-kall, og kommandoene til batchene ligger fra firstBatch i kommando-bufferet.
+        struct DrawGroup
+        {
+            PipelineVariant pipeline;
+            uint32_t descriptorIndex = 0;
+            uint32_t firstBatch = 0;
+            uint32_t batchCount = 0;
+        };
+        std::vector<DrawGroup> drawGroups;
+        std::vector<bbl::GpuCulling::ObjectData> gpuObjects;
+        std::vector<bbl::GpuCulling::BatchData> gpuBatches;
+        bool drawListInGeometryArena = false;   // Alle mesher deler arena-bufferne
+
+        std::unique_ptr<bbl::GpuCulling> gpuCulling;
+        std::atomic<bool> gpuCullingEnabled{qEnvironmentVariableIsSet("BBL_GPU_CULLING")};
+
+        // Query pools per frame in flight. batchScopes er scopet til pipeline-løpet hver synlige
+        // batch hører til, reservert før opptaket deles ut på jobbsystemet.
+        std::unique_ptr<bbl::GpuProfiler> gpuProfiler;
+        std::vector<bbl::GpuProfiler::ScopeId> batchScopes;
+
+        // Summeres av opptaksbitene og legges i renderStats når opptaket er ferdig
+        std::atomic<uint32_t> pipelineBindCount{0};
+        std::atomic<uint32_t> descriptorBindCount{0};
+        bool pipelineStatisticsSupported = false;
+
+        // Resultatet av cullInstances() for denne framen: batchene med bare synlige
+        // instanser, og matrisene deres pakket tett i samme rekkefølge
+        std::vector<DrawBatch> visibleBatches;
+        std::vector<InstanceData> visibleInstances;
+        std::vector<InstanceData> instanceModels;
+        std::vector<float> cullCenterX, cullCenterY, cullCenterZ, cullRadius;
+        std::vector<uint8_t> cullVisible;
+        RenderStats renderStats;
 
         std::vector<VkSemaphore> imageAvailableSemaphores;
         std::vector<VkSemaphore> renderFinishedSemaphores;
         std::vector<VkFence> inFlightFences;
         std::vector<VkFence> imagesInFlight;
         size_t currentFrame = 0;
+        std::atomic<uint64_t> frameCounter{0};
+        FrameTimings frameTimings;
+        float fixedTimeStep = 0.0f;
+
+        // Ønsket fra setPresentMode()/setFramesInFlight(), tas i bruk av applyFrameSettings().
+        // Startverdiene kommer fra BBL_FRAMES_IN_FLIGHT og BBL_PRESENT_MODE i konstruktøren.
+        std::atomic<PresentMode> requestedPresentMode{PresentMode::Mailbox};
+        std::atomic<uint32_t> requestedFramesInFlight{0};
+        PresentMode presentMode = PresentMode::Mailbox;
+        uint32_t framesInFlight = 0;
+        void applyFrameSettings();
+
+        // Input-tiden til hver frame in flight, til fencen dens er sett signalert
+        bbl::FramePacer framePacer;
+        std::vector<std::chrono::steady_clock::time_point> pacingInputTimes;
+        void pollFrameCompletions();
 
-        bool framebufferResized = false;
+        std::atomic<bool> framebufferResized{false};
 
         // void initWindow();
 
@@ -204,10 +475,11 @@
         void pickPhysicalDevice();
         void createLogicalDevice();
         void createSwapChain();
+        void createOffscreenTarget();
         void createImageViews();
         void createRenderPass();
         void createDescriptorSetLayout();
-        void createGraphicsPipeline(std::string, std::string, VkPipeline&, VkPrimitiveTopology);
+        void createPipelines();
         void createFramebuffers();
         void createCommandPool();
         void createColorResources();
@@ -223,23 +495,35 @@
         VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels);
         void createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkSampleCountFlagBits numSamples,
                          VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties,
-                         VkImage& image, VkDeviceMemory& imageMemory);
+                         VkImage& image, bbl::DeviceAllocation& imageAllocation);
         void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels);
         void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
         void loadModel();
         void createVertexBuffer();
         void createIndexBuffer();
-        void createUniformBuffers();
-        void createDescriptorPool();
-        void createDescriptorSets();
-        void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
+        void createFrameResources();
+        void destroyFrameResources();
+        void refreshRenderList();
+        void prepareFrameResources(FrameData& frame);
+        void buildDrawBatches();
+        void cullInstances();
+        void cullInstancesOnGpu(FrameData& frame);
+        bool useGpuCulling() const;
+        void writeDescriptorSets(FrameData& frame);
+        void recordCommandBuffer(FrameData& frame, uint32_t imageIndex);
+        VkCommandBuffer recordDrawChunk(FrameData& frame, uint32_t imageIndex, size_t firstBatch, size_t lastBatch);
+        void recordIndirectDraws(FrameData& frame, VkCommandBuffer commandBuffer);
+        PipelineVariant pipelineVariantFor(const bbl::Render& render) const;
+        VkPipeline getPipeline(const PipelineVariant& variant) const;
+        std::string pipelineScopeName(const PipelineVariant& variant) const;
+        void updateScene();
+        void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, bbl::DeviceAllocation& bufferAllocation);
         VkCommandBuffer beginSingleTimeCommands();
         void endSingleTimeCommands(VkCommandBuffer commandBuffer);
         void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
-        uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
-        void createCommandBuffers();
         void createSyncObjects();
-        void updateUniformBuffer(uint32_t currentImage);
+        void destroySyncObjects();
+        void updateUniformBuffer(FrameData& frame);
         VkShaderModule createShaderModule(const std::vector<char>& code);
         VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
         VkPresentModeKHR chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes);
@@ -8,6 +8,11 @@ class Camera;
 class MainWindow;
 class ResourceManager;
 
+namespace bbl
+{
+class JobSystem;
+}
+
 class BBLHub
 {
 public:
@@ -28,6 +33,7 @@ public:
     void SetPhysics(Physics* p) { physics = p; }
     void setRenderer(Renderer* _renderer){ renderer = _renderer;}
     void setLuaManager(LuaManager* lua){luamanager = lua;}
+    void setJobSystem(bbl::JobSystem* jobs){ jobSystem = jobs; }
 
     MainWindow* GetMainWindow() const { return mainWindow; }
     ResourceManager* GetResourceManager() const { return resourceManager; }
@@ -35,6 +41,8 @@ public:
     Physics* GetPhysics() const { return physics; }
     Renderer* getRenderer() const {return renderer; }
     LuaManager* getLuaManager() const {return luamanager;}
+    // Felles trådpool for alle systemer, nullptr betyr at alt kjøres serielt
+    bbl::JobSystem* getJobSystem() const { return jobSystem; }
 
 private:
     BBLHub() = default; // private constructor
@@ -46,6 +54,7 @@ private:
     Physics* physics = nullptr;
     Renderer* renderer = nullptr;
     LuaManager * luamanager = nullptr;
+    bbl::JobSystem* jobSystem = nullptr;
 };
 
 #endif // BBLHUB_H
@@ -0,0 +1,143 @@
+#ifndef BINARYSTREAM_H
+#define BINARYSTREAM_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace bbl
+{
+
+// Enkle hjelpere for binære formater (snapshot, replay). Native endian, POD via memcpy.
+class BinaryWriter
+{
+public:
+    explicit BinaryWriter(std::vector<uint8_t>& out) : mOut(out) {}
+
+    template <typename T>
+    void write(const T& value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "BinaryWriter::write needs a POD type");
+        writeBytes(&value, sizeof(T));
+    }
+
+    template <typename T>
+    void writeArray(const T* values, size_t count)
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "BinaryWriter::writeArray needs a POD type");
+        writeBytes(values, sizeof(T) * count);
+    }
+
+    void writeBytes(const void* data, size_t size)
+    {
+        if (size == 0) return;
+        size_t offset = mOut.size();
+        mOut.resize(offset + size);
+        std::memcpy(mOut.data() + offset, data, size);
+    }
+
+    void writeString(const std::string& value)
+    {
+        write(static_cast<uint32_t>(value.size()));
+        writeBytes(value.data(), value.size());
+    }
+
+    void writeVarUInt(uint64_t value)
+    {
+        while (value >= 0x80) {
+            mOut.push_back(static_cast<uint8_t>(value) | 0x80);
+            value >>= 7;
+        }
+        mOut.push_back(static_cast<uint8_t>(value));
+    }
+
+private:
+    std::vector<uint8_t>& mOut;
+};
+
+// Leser med grensesjekk. Etter første feil returneres nullverdier og ok() blir false.
+class BinaryReader
+{
+public:
+    BinaryReader(const uint8_t* data, size_t size) : mData(data), mSize(size) {}
+
+    template <typename T>
+    T read()
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "BinaryReader::read needs a POD type");
+        T value{};
+        readBytes(&value, sizeof(T));
+        return value;
+    }
+
+    template <typename T>
+    void readArray(std::vector<T>& values, size_t count)
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "BinaryReader::readArray needs a POD type");
+        if (!canRead(sizeof(T) * count)) {
+            values.clear();
+            return;
+        }
+        values.resize(count);
+        readBytes(values.data(), sizeof(T) * count);
+    }
+
+    bool readBytes(void* data, size_t size)
+    {
+        if (!canRead(size)) {
+            std::memset(data, 0, size);
+            return false;
+        }
+        if (size > 0) {
+            std::memcpy(data, mData + mPos, size);
+        }
+        mPos += size;
+        return true;
+    }
+
+    std::string readString()
+    {
+        uint32_t length = read<uint32_t>();
+        if (!canRead(length)) return {};
+        std::string value(reinterpret_cast<const char*>(mData + mPos), length);
+        mPos += length;
+        return value;
+    }
+
+    uint64_t readVarUInt()
+    {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint8_t byte = read<uint8_t>();
+            if (!mOk) return 0;
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return value;
+        }
+        mOk = false;
+        return 0;
+    }
+
+    bool ok() const { return mOk; }
+    bool atEnd() const { return mPos >= mSize; }
+
+private:
+    const uint8_t* mData;
+    size_t mSize;
+    size_t mPos = 0;
+    bool mOk = true;
+
+    bool canRead(size_t size)
+    {
+        if (!mOk || size > mSize - mPos) {
+            mOk = false;
+            return false;
+        }
+        return true;
+    }
+};
+
+} // namespace bbl
+
+#endif // BINARYSTREAM_H
@@ -0,0 +1,376 @@
+#include "DeviceMemoryAllocator.h"
+#include <qdebug.h>
+#include <algorithm>
+#include <stdexcept>
+
+namespace bbl
+{
+namespace
+{
+uint32_t orderFor(VkDeviceSize size)
+{
+    uint32_t order = 0;
+    while ((VkDeviceSize(1) << order) < size) {
+        ++order;
+    }
+    return order;
+}
+}
+
+DeviceMemoryAllocator::DeviceMemoryAllocator(VkDevice device,
+                                             const VkPhysicalDeviceProperties& properties,
+                                             const VkPhysicalDeviceMemoryProperties& memoryProperties)
+    : mDevice(device)
+    , mProperties(properties)
+    , mMemoryProperties(memoryProperties)
+    , mSeparateImagePools(properties.limits.bufferImageGranularity > 1)
+{
+    mPools.resize(memoryProperties.memoryTypeCount * 2);
+    for (uint32_t type = 0; type < memoryProperties.memoryTypeCount; ++type) {
+        // Små heaps (f.eks. 256 MB BAR) skal ikke fylles av én blokk
+        VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[type].heapIndex].size;
+        VkDeviceSize blockSize = kDefaultBlockSize;
+        while (blockSize > (VkDeviceSize(1) << 20) && blockSize > heapSize / 8) {
+            blockSize /= 2;
+        }
+
+        for (uint32_t kind = 0; kind < 2; ++kind) {
+            mPools[type * 2 + kind].memoryType = type;
+            mPools[type * 2 + kind].blockSize = blockSize;
+        }
+    }
+}
+
+DeviceMemoryAllocator::~DeviceMemoryAllocator()
+{
+    cleanup();
+}
+
+DeviceAllocation DeviceMemoryAllocator::allocate(const VkMemoryRequirements& requirements,
+                                                 VkMemoryPropertyFlags properties,
+                                                 ResourceType type)
+{
+    uint32_t memoryType = findMemoryType(requirements.memoryTypeBits, properties);
+    uint32_t poolIndex = memoryType * 2 + ((mSeparateImagePools && type == ResourceType::Image) ? 1 : 0);
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    Pool& pool = mPools[poolIndex];
+
+    DeviceAllocation allocation;
+    allocation.pool = poolIndex;
+    allocation.size = requirements.size;
+
+    // Store ressurser ville kastet bort det meste av en blokk, de får eget minne
+    if (requirements.size > pool.blockSize / 2) {
+        VkMemoryAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = requirements.size;
+        allocInfo.memoryTypeIndex = memoryType;
+
+        if (vkAllocateMemory(mDevice, &allocInfo, nullptr, &allocation.memory) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate dedicated device memory!");
+        }
+        if (isHostVisible(memoryType)) {
+            vkMapMemory(mDevice, allocation.memory, 0, VK_WHOLE_SIZE, 0, &allocation.mapped);
+        }
+
+        allocation.dedicated = true;
+        ++mDedicatedCount;
+        mDedicatedBytes += requirements.size;
+        return allocation;
+    }
+
+    uint32_t order = std::max(orderFor(std::max(requirements.size, requirements.alignment)), kMinOrder);
+
+    for (size_t blockIndex = 0; blockIndex <= pool.blocks.size(); ++blockIndex) {
+        if (blockIndex == pool.blocks.size()) {
+            // Første ledige plass i en tom slot, ellers bakerst
+            auto emptySlot = std::find(pool.blocks.begin(), pool.blocks.end(), nullptr);
+            if (emptySlot != pool.blocks.end()) {
+                blockIndex = static_cast<size_t>(emptySlot - pool.blocks.begin());
+                *emptySlot = createBlock(pool);
+            } else {
+                pool.blocks.push_back(createBlock(pool));
+            }
+        }
+
+        Block* block = pool.blocks[blockIndex].get();
+        VkDeviceSize offset = 0;
+        if (!block || !allocateFromBlock(*block, order, offset)) {
+            continue;
+        }
+
+        block->requestedBytes += requirements.size;
+        allocation.memory = block->memory;
+        allocation.offset = offset;
+        allocation.block = static_cast<uint32_t>(blockIndex);
+        allocation.mapped = block->mapped ? static_cast<char*>(block->mapped) + offset : nullptr;
+        return allocation;
+    }
+
+    throw std::runtime_error("failed to suballocate device memory!");
+}
+
+void DeviceMemoryAllocator::free(DeviceAllocation& allocation)
+{
+    if (!allocation.isValid()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    if (allocation.dedicated) {
+        if (allocation.mapped) {
+            vkUnmapMemory(mDevice, allocation.memory);
+        }
+        vkFreeMemory(mDevice, allocation.memory, nullptr);
+        --mDedicatedCount;
+        mDedicatedBytes -= allocation.size;
+        allocation = DeviceAllocation{};
+        return;
+    }
+
+    Pool& pool = mPools[allocation.pool];
+    Block& block = *pool.blocks[allocation.block];
+    block.requestedBytes -= allocation.size;
+    freeToBlock(block, allocation.offset);
+
+    // Tomme blokker gis tilbake, men behold én per pool så spawn/slett ikke allokerer hver gang
+    if (block.allocatedOrders.empty()) {
+        size_t liveBlocks = std::count_if(pool.blocks.begin(), pool.blocks.end(),
+                                          [](const std::unique_ptr<Block>& b) { return b != nullptr; });
+        if (liveBlocks > 1) {
+            destroyBlock(block);
+            pool.blocks[allocation.block].reset();
+        }
+    }
+
+    allocation = DeviceAllocation{};
+}
+
+void DeviceMemoryAllocator::createBuffer(const VkBufferCreateInfo& bufferInfo, VkMemoryPropertyFlags properties,
+                                         VkBuffer& buffer, DeviceAllocation& allocation)
+{
+    if (vkCreateBuffer(mDevice, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create buffer!");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(mDevice, buffer, &memRequirements);
+
+    try {
+        allocation = allocate(memRequirements, properties, ResourceType::Buffer);
+    } catch (...) {
+        vkDestroyBuffer(mDevice, buffer, nullptr);
+        buffer = VK_NULL_HANDLE;
+        throw;
+    }
+
+    vkBindBufferMemory(mDevice, buffer, allocation.memory, allocation.offset);
+}
+
+void DeviceMemoryAllocator::createImage(const VkImageCreateInfo& imageInfo, VkMemoryPropertyFlags properties,
+                                        VkImage& image, DeviceAllocation& allocation)
+{
+    if (vkCreateImage(mDevice, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create image!");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(mDevice, image, &memRequirements);
+
+    // Lineære images oppfører seg som buffere med tanke på granularity
+    ResourceType type = imageInfo.tiling == VK_IMAGE_TILING_OPTIMAL ? ResourceType::Image : ResourceType::Buffer;
+    try {
+        allocation = allocate(memRequirements, properties, type);
+    } catch (...) {
+        vkDestroyImage(mDevice, image, nullptr);
+        image = VK_NULL_HANDLE;
+        throw;
+    }
+
+    vkBindImageMemory(mDevice, image, allocation.memory, allocation.offset);
+}
+
+void DeviceMemoryAllocator::destroyBuffer(VkBuffer& buffer, DeviceAllocation& allocation)
+{
+    if (buffer != VK_NULL_HANDLE) {
+        vkDestroyBuffer(mDevice, buffer, nullptr);
+        buffer = VK_NULL_HANDLE;
+    }
+    free(allocation);
+}
+
+void DeviceMemoryAllocator::destroyImage(VkImage& image, DeviceAllocation& allocation)
+{
+    if (image != VK_NULL_HANDLE) {
+        vkDestroyImage(mDevice, image, nullptr);
+        image = VK_NULL_HANDLE;
+    }
+    free(allocation);
+}
+
+DeviceMemoryAllocator::Stats DeviceMemoryAllocator::getStats() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    Stats stats;
+    stats.dedicatedCount = mDedicatedCount;
+    stats.dedicatedBytes = mDedicatedBytes;
+    stats.allocationCount = mDedicatedCount;
+
+    for (const Pool& pool : mPools) {
+        for (const std::unique_ptr<Block>& block : pool.blocks) {
+            if (!block) {
+                continue;
+            }
+
+            ++stats.blockCount;
+            stats.blockBytes += VkDeviceSize(1) << block->maxOrder;
+            stats.allocationCount += static_cast<uint32_t>(block->allocatedOrders.size());
+            stats.allocatedBytes += block->allocatedBytes;
+            stats.requestedBytes += block->requestedBytes;
+
+            for (uint32_t order = block->maxOrder + 1; order-- > kMinOrder;) {
+                if (!block->freeLists[order - kMinOrder].empty()) {
+                    stats.largestFreeBytes = std::max(stats.largestFreeBytes, VkDeviceSize(1) << order);
+                    break;
+                }
+            }
+        }
+    }
+    return stats;
+}
+
+void DeviceMemoryAllocator::cleanup()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+
+    for (Pool& pool : mPools) {
+        for (std::unique_ptr<Block>& block : pool.blocks) {
+            if (block) {
+                if (!block->allocatedOrders.empty()) {
+                    qWarning() << "DeviceMemoryAllocator: freeing block with"
+                               << block->allocatedOrders.size() << "live allocations";
+                }
+                destroyBlock(*block);
+            }
+        }
+        pool.blocks.clear();
+    }
+}
+
+uint32_t DeviceMemoryAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const
+{
+    for (uint32_t i = 0; i < mMemoryProperties.memoryTypeCount; i++) {
+        if ((typeFilter & (1 << i)) &&
+            (mMemoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+
+    throw std::runtime_error("failed to find suitable memory type!");
+}
+
+bool DeviceMemoryAllocator::isHostVisible(uint32_t memoryType) const
+{
+    return (mMemoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+}
+
+std::unique_ptr<DeviceMemoryAllocator::Block> DeviceMemoryAllocator::createBlock(const Pool& pool)
+{
+    auto block = std::make_unique<Block>();
+    block->maxOrder = orderFor(pool.blockSize);
+    block->freeLists.resize(block->maxOrder - kMinOrder + 1);
+    block->freeLists.back().insert(0);
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = VkDeviceSize(1) << block->maxOrder;
+    allocInfo.memoryTypeIndex = pool.memoryType;
+
+    if (vkAllocateMemory(mDevice, &allocInfo, nullptr, &block->memory) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate device memory block!");
+    }
+
+    // Host-visible blokker mappes én gang, alle suballokeringer deler mappingen
+    if (isHostVisible(pool.memoryType)) {
+        vkMapMemory(mDevice, block->memory, 0, VK_WHOLE_SIZE, 0, &block->mapped);
+    }
+
+    qDebug() << "DeviceMemoryAllocator: new" << (allocInfo.allocationSize >> 20)
+             << "MB block for memory type" << pool.memoryType;
+    return block;
+}
+
+void DeviceMemoryAllocator::destroyBlock(Block& block)
+{
+    if (block.mapped) {
+        vkUnmapMemory(mDevice, block.memory);
+        block.mapped = nullptr;
+    }
+    if (block.memory != VK_NULL_HANDLE) {
+        vkFreeMemory(mDevice, block.memory, nullptr);
+        block.memory = VK_NULL_HANDLE;
+    }
+}
+
+bool DeviceMemoryAllocator::allocateFromBlock(Block& block, uint32_t order, VkDeviceSize& offset)
+{
+    if (order > block.maxOrder) {
+        return false;
+    }
+
+    // Minste ledige node som er stor nok
+    uint32_t found = order;
+    while (found <= block.maxOrder && block.freeLists[found - kMinOrder].empty()) {
+        ++found;
+    }
+    if (found > block.maxOrder) {
+        return false;
+    }
+
+    std::set<VkDeviceSize>& freeList = block.freeLists[found - kMinOrder];
+    offset = *freeList.begin();
+    freeList.erase(freeList.begin());
+
+    // Del opp til riktig størrelse, øvre halvdel legges tilbake som ledig
+    while (found > order) {
+        --found;
+        block.freeLists[found - kMinOrder].insert(offset + (VkDeviceSize(1) << found));
+    }
+
+    block.allocatedOrders[offset] = order;
+    block.allocatedBytes += VkDeviceSize(1) << order;
+    return true;
+}
+
+void DeviceMemoryAllocator::freeToBlock(Block& block, VkDeviceSize offset)
+{
+    auto it = block.allocatedOrders.find(offset);
+    if (it == block.allocatedOrders.end()) {
+        qWarning() << "DeviceMemoryAllocator: free of unknown offset" << offset;
+        return;
+    }
+
+    uint32_t order = it->second;
+    block.allocatedOrders.erase(it);
+    block.allocatedBytes -= VkDeviceSize(1) << order;
+
+    // Slå sammen med buddy så lenge den også er ledig
+    while (order < block.maxOrder) {
+        VkDeviceSize buddy = offset ^ (VkDeviceSize(1) << order);
+        std::set<VkDeviceSize>& freeList = block.freeLists[order - kMinOrder];
+        auto buddyIt = freeList.find(buddy);
+        if (buddyIt == freeList.end()) {
+            break;
+        }
+        freeList.erase(buddyIt);
+        offset = std::min(offset, buddy);
+        ++order;
+    }
+
+    block.freeLists[order - kMinOrder].insert(offset);
+}
+
+} // namespace bbl
@@ -0,0 +1,139 @@
+#ifndef DEVICEMEMORYALLOCATOR_H
+#define DEVICEMEMORYALLOCATOR_H
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+namespace bbl
+{
+// Minne for én buffer eller ett image. offset er relativt til memory, og mapped peker
+// allerede på offset for host-visible minne.
+struct DeviceAllocation
+{
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    void* mapped = nullptr;
+
+    // Hvor allokeringen kom fra, brukes av DeviceMemoryAllocator::free()
+    uint32_t pool = 0;
+    uint32_t block = 0;
+    bool dedicated = false;
+
+    bool isValid() const { return memory != VK_NULL_HANDLE; }
+};
+
+// Buddy-allokator over store VkDeviceMemory-blokker, én pool per minnetype.
+// Én vkAllocateMemory per blokk (64 MB, mindre på små heaps) i stedet for én per
+// buffer/image, så vi holder oss langt under maxMemoryAllocationCount.
+//
+// Buddy-noder er potenser av to og ligger på offset delelig med egen størrelse, så
+// Vulkan-alignment kommer gratis. Buffere og images får egne pools når
+// bufferImageGranularity > 1, så lineære og optimale ressurser aldri deler side.
+// Store ressurser (over halv blokk) får egen dedikert allokering.
+//
+// Trådsikker; opplasting kan skje fra jobbsystemet.
+class DeviceMemoryAllocator
+{
+public:
+    enum class ResourceType : uint8_t { Buffer, Image };
+
+    struct Stats
+    {
+        uint32_t blockCount = 0;
+        uint32_t dedicatedCount = 0;
+        uint32_t allocationCount = 0;
+        VkDeviceSize blockBytes = 0;       // Reservert i blokker
+        VkDeviceSize dedicatedBytes = 0;
+        VkDeviceSize requestedBytes = 0;   // Det ressursene ba om
+        VkDeviceSize allocatedBytes = 0;   // Buddy-noder, inkludert avrunding
+        VkDeviceSize largestFreeBytes = 0; // Største ledige node i noen blokk
+
+        // Andel av tildelte noder som er avrunding til potens av to
+        float internalFragmentation() const
+        {
+            return allocatedBytes > 0 ? 1.0f - float(requestedBytes) / float(allocatedBytes) : 0.0f;
+        }
+
+        // 0 når all ledig plass er ett sammenhengende område, mot 1 når den er spredt
+        float externalFragmentation() const
+        {
+            VkDeviceSize freeBytes = blockBytes - allocatedBytes;
+            return freeBytes > 0 ? 1.0f - float(largestFreeBytes) / float(freeBytes) : 0.0f;
+        }
+    };
+
+    DeviceMemoryAllocator(VkDevice device,
+                          const VkPhysicalDeviceProperties& properties,
+                          const VkPhysicalDeviceMemoryProperties& memoryProperties);
+    ~DeviceMemoryAllocator();
+
+    DeviceMemoryAllocator(const DeviceMemoryAllocator&) = delete;
+    DeviceMemoryAllocator& operator=(const DeviceMemoryAllocator&) = delete;
+
+    // Kaster runtime_error hvis det ikke finnes passende minne
+    DeviceAllocation allocate(const VkMemoryRequirements& requirements,
+                              VkMemoryPropertyFlags properties,
+                              ResourceType type);
+    void free(DeviceAllocation& allocation);
+
+    // Lager ressursen og binder minne fra allokatoren. Ved feil er ingenting opprettet.
+    void createBuffer(const VkBufferCreateInfo& bufferInfo, VkMemoryPropertyFlags properties,
+                      VkBuffer& buffer, DeviceAllocation& allocation);
+    void createImage(const VkImageCreateInfo& imageInfo, VkMemoryPropertyFlags properties,
+                     VkImage& image, DeviceAllocation& allocation);
+    void destroyBuffer(VkBuffer& buffer, DeviceAllocation& allocation);
+    void destroyImage(VkImage& image, DeviceAllocation& allocation);
+
+    Stats getStats() const;
+
+    // Frigjør alle blokker. Alle ressurser må være slettet først.
+    void cleanup();
+
+private:
+    static constexpr uint32_t kMinOrder = 8;   // 256 bytes
+    static constexpr VkDeviceSize kDefaultBlockSize = VkDeviceSize(64) * 1024 * 1024;
+
+    struct Block
+    {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        void* mapped = nullptr;
+        uint32_t maxOrder = 0;
+        std::vector<std::set<VkDeviceSize>> freeLists;             // Per orden, laveste offset først
+        std::unordered_map<VkDeviceSize, uint32_t> allocatedOrders; // offset -> orden
+        VkDeviceSize allocatedBytes = 0;
+        VkDeviceSize requestedBytes = 0;
+    };
+
+    struct Pool
+    {
+        uint32_t memoryType = 0;
+        VkDeviceSize blockSize = 0;
+        std::vector<std::unique_ptr<Block>> blocks;
+    };
+
+    VkDevice mDevice;
+    VkPhysicalDeviceProperties mProperties;
+    VkPhysicalDeviceMemoryProperties mMemoryProperties;
+    bool mSeparateImagePools = false;
+
+    mutable std::mutex mMutex;
+    std::vector<Pool> mPools;   // Indeks: memoryType * 2 + (image-pool ? 1 : 0)
+    uint32_t mDedicatedCount = 0;
+    VkDeviceSize mDedicatedBytes = 0;
+
+    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+    bool isHostVisible(uint32_t memoryType) const;
+    std::unique_ptr<Block> createBlock(const Pool& pool);
+    void destroyBlock(Block& block);
+    static bool allocateFromBlock(Block& block, uint32_t order, VkDeviceSize& offset);
+    static void freeToBlock(Block& block, VkDeviceSize offset);
+};
+}
+
+#endif // DEVICEMEMORYALLOCATOR_H
@@ -0,0 +1,78 @@
+#include "FramePacer.h"
+#include <algorithm>
+#include <thread>
+
+namespace bbl
+{
+
+namespace
+{
+double toMilliseconds(FramePacer::Clock::duration duration)
+{
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+}
+
+void FramePacer::setTargetLatency(double milliseconds)
+{
+    mTargetMs.store(std::max(milliseconds, 0.0), std::memory_order_relaxed);
+}
+
+FramePacer::Clock::time_point FramePacer::wait(Clock::duration blocked, const std::function<void()>& poll)
+{
+    const double target = mTargetMs.load(std::memory_order_relaxed);
+    if (target <= 0.0) {
+        mDelayMs = 0.0;
+    } else if (mHasLatency) {
+        // Ventetiden kan øke med slakken framen hadde, minus marginen. Har slakken gått
+        // under marginen trekkes den ned igjen, uansett hva latency sier.
+        const double limit = mDelayMs + toMilliseconds(blocked) - kMarginMs;
+        mDelayMs = std::clamp(mDelayMs + kGain * (mLatencyMs - target), 0.0, std::max(limit, 0.0));
+    }
+
+    Clock::time_point now = Clock::now();
+    if (mDelayMs > 0.0) {
+        const Clock::time_point until =
+            now + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(mDelayMs));
+        while (now < until) {
+            poll();
+            std::this_thread::sleep_for(std::min<Clock::duration>(kPollInterval, until - now));
+            now = Clock::now();
+        }
+        poll();
+    }
+
+    if (mLastStart != Clock::time_point{}) {
+        const double interval = toMilliseconds(now - mLastStart);
+        mFrameIntervalMs = mFrameIntervalMs == 0.0 ? interval : mFrameIntervalMs + kSmoothing * (interval - mFrameIntervalMs);
+    }
+    mLastStart = now;
+    return now;
+}
+
+void FramePacer::frameCompleted(Clock::time_point inputTime, Clock::time_point completedTime)
+{
+    const double latency = toMilliseconds(completedTime - inputTime);
+    mLatencyMs = mHasLatency ? mLatencyMs + kSmoothing * (latency - mLatencyMs) : latency;
+    mHasLatency = true;
+}
+
+void FramePacer::reset()
+{
+    mDelayMs = 0.0;
+    mLatencyMs = 0.0;
+    mFrameIntervalMs = 0.0;
+    mHasLatency = false;
+    mLastStart = Clock::time_point{};
+}
+
+FramePacer::Stats FramePacer::getStats() const
+{
+    Stats stats;
+    stats.targetMs = mTargetMs.load(std::memory_order_relaxed);
+    stats.latencyMs = mLatencyMs;
+    stats.delayMs = mDelayMs;
+    stats.frameIntervalMs = mFrameIntervalMs;
+    return stats;
+}
+}
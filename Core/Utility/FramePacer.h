@@ -0,0 +1,65 @@
+#ifndef FRAMEPACER_H
+#define FRAMEPACER_H
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+
+namespace bbl
+{
+// Holder tiden fra input leses til framen er ferdig på GPU-en rundt et mål. I stedet for å
+// ligge flere frames foran GPU-en venter rendertråden litt før input leses, så framen som
+// tas opp bruker ferskere input. Regulatoren er integrerende: ventetiden flyttes med
+// kGain * (målt - mål) per frame.
+//
+// Ventetiden tas bare fra tid rendertråden ellers ville stått og ventet på fence eller
+// acquire, så raten går ikke ned selv om målet er lavere enn det som er mulig. Ferdig-
+// tidspunktet er når rendereren så at fencen var signalert; mens vi venter polles fencene
+// (poll i wait()), ellers er målingen opp til en frame for høy.
+//
+// Eies av rendertråden. Bare setTargetLatency() kan kalles fra andre tråder.
+class FramePacer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Stats
+    {
+        double targetMs = 0.0;
+        double latencyMs = 0.0;        // Glidende snitt, input til GPU ferdig
+        double delayMs = 0.0;          // Ventetiden før input nå
+        double frameIntervalMs = 0.0;  // Glidende snitt mellom framestarter
+    };
+
+    // 0 = av, framene starter så fort rendertråden kommer til
+    void setTargetLatency(double milliseconds);
+    double getTargetLatency() const { return mTargetMs.load(std::memory_order_relaxed); }
+
+    // Rett før input leses. blocked er hvor lenge framen har ventet på fence og acquire.
+    // Returnerer tidspunktet framen regnes som startet (input-tiden).
+    Clock::time_point wait(Clock::duration blocked, const std::function<void()>& poll);
+
+    // En frame med input fra inputTime ble sett ferdig på GPU-en ved completedTime
+    void frameCompleted(Clock::time_point inputTime, Clock::time_point completedTime);
+
+    // Ny swapchain eller nytt antall frames in flight: gamle målinger gjelder ikke lenger
+    void reset();
+
+    Stats getStats() const;
+
+private:
+    static constexpr double kGain = 0.2;
+    static constexpr double kSmoothing = 0.25;
+    static constexpr double kMarginMs = 1.0;   // Slakk som alltid står igjen, mot jitter
+    static constexpr std::chrono::microseconds kPollInterval{250};
+
+    std::atomic<double> mTargetMs{0.0};
+    double mDelayMs = 0.0;
+    double mLatencyMs = 0.0;
+    double mFrameIntervalMs = 0.0;
+    bool mHasLatency = false;
+    Clock::time_point mLastStart{};
+};
+}
+
+#endif // FRAMEPACER_H
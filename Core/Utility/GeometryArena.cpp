@@ -0,0 +1,137 @@
+#include "GeometryArena.h"
+#include <qdebug.h>
+#include <iterator>
+#include <stdexcept>
+
+namespace bbl
+{
+GeometryArena::GeometryArena(VkDevice device, DeviceMemoryAllocator* allocator,
+                             VkBufferUsageFlags usage, VkDeviceSize elementSize)
+    : mDevice(device)
+    , mAllocator(allocator)
+    , mUsage(usage)
+    , mElementSize(elementSize)
+{
+}
+
+GeometryArena::~GeometryArena()
+{
+    cleanup();
+}
+
+bool GeometryArena::allocate(uint32_t count, uint32_t& firstElement)
+{
+    if (count == 0) {
+        return false;
+    }
+
+    for (auto it = mFreeRanges.begin(); it != mFreeRanges.end(); ++it) {
+        if (it->second < count) {
+            continue;
+        }
+
+        firstElement = it->first;
+        uint32_t remaining = it->second - count;
+        mFreeRanges.erase(it);
+        if (remaining > 0) {
+            mFreeRanges[firstElement + count] = remaining;
+        }
+
+        mAllocations[firstElement] = count;
+        mUsedElements += count;
+        return true;
+    }
+    return false;
+}
+
+void GeometryArena::free(uint32_t firstElement)
+{
+    auto it = mAllocations.find(firstElement);
+    if (it == mAllocations.end()) {
+        qWarning() << "GeometryArena: free of unknown range" << firstElement;
+        return;
+    }
+
+    uint32_t count = it->second;
+    mAllocations.erase(it);
+    mUsedElements -= count;
+    insertFreeRange(firstElement, count);
+}
+
+void GeometryArena::grow(uint32_t capacity, VkBuffer& oldBuffer, DeviceAllocation& oldAllocation)
+{
+    oldBuffer = mBuffer;
+    oldAllocation = mAllocation;
+
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = static_cast<VkDeviceSize>(capacity) * mElementSize;
+    // TRANSFER_SRC så innholdet kan kopieres videre neste gang arenaen vokser
+    bufferInfo.usage = mUsage | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (mQueueFamilies.size() > 1) {
+        bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(mQueueFamilies.size());
+        bufferInfo.pQueueFamilyIndices = mQueueFamilies.data();
+    }
+
+    mBuffer = VK_NULL_HANDLE;
+    mAllocation = DeviceAllocation{};
+    try {
+        mAllocator->createBuffer(bufferInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mBuffer, mAllocation);
+    } catch (...) {
+        mBuffer = oldBuffer;
+        mAllocation = oldAllocation;
+        oldBuffer = VK_NULL_HANDLE;
+        oldAllocation = DeviceAllocation{};
+        throw;
+    }
+
+    // Den nye halen er ledig, slås sammen med en ledig rekke som slutter ved gammel kapasitet
+    uint32_t oldCapacity = mCapacity;
+    mCapacity = capacity;
+    insertFreeRange(oldCapacity, capacity - oldCapacity);
+
+    qDebug() << "GeometryArena grown to" << capacity << "elements ("
+             << (bufferInfo.size >> 10) << "KB)";
+}
+
+void GeometryArena::cleanup()
+{
+    if (mBuffer != VK_NULL_HANDLE) {
+        mAllocator->destroyBuffer(mBuffer, mAllocation);
+    }
+    mCapacity = 0;
+    mUsedElements = 0;
+    mFreeRanges.clear();
+    mAllocations.clear();
+}
+
+void GeometryArena::insertFreeRange(uint32_t first, uint32_t count)
+{
+    if (count == 0) {
+        return;
+    }
+
+    auto next = mFreeRanges.lower_bound(first);
+
+    // Slå sammen med forrige rekke hvis den slutter der denne starter
+    if (next != mFreeRanges.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == first) {
+            first = prev->first;
+            count += prev->second;
+            mFreeRanges.erase(prev);
+        }
+    }
+
+    // og med neste hvis den starter der denne slutter
+    if (next != mFreeRanges.end() && first + count == next->first) {
+        count += next->second;
+        mFreeRanges.erase(next);
+    }
+
+    mFreeRanges[first] = count;
+}
+
+} // namespace bbl
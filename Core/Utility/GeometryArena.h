@@ -0,0 +1,67 @@
+#ifndef GEOMETRYARENA_H
+#define GEOMETRYARENA_H
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include "DeviceMemoryAllocator.h"
+
+namespace bbl
+{
+// Ett stort device-local buffer som mange mesher deler, delt opp i elementer (vertices
+// eller indekser). Mesher får en rekke elementer og tegnes med firstIndex/vertexOffset,
+// så Renderer kan binde bufferet én gang for all statisk geometri.
+//
+// Selve kopieringen gjøres av GPUResourceManager, som allerede har single-time commands.
+// grow() lager et større buffer og gir tilbake det gamle, så eieren kan kopiere innholdet
+// over og slette det.
+class GeometryArena
+{
+public:
+    GeometryArena(VkDevice device, DeviceMemoryAllocator* allocator,
+                  VkBufferUsageFlags usage, VkDeviceSize elementSize);
+    ~GeometryArena();
+
+    GeometryArena(const GeometryArena&) = delete;
+    GeometryArena& operator=(const GeometryArena&) = delete;
+
+    // First-fit. Returnerer false hvis ingen ledig rekke er stor nok, da må grow() kalles.
+    bool allocate(uint32_t count, uint32_t& firstElement);
+    void free(uint32_t firstElement);
+
+    // Bytter til et buffer med plass til minst capacity elementer. Det gamle bufferet
+    // (VK_NULL_HANDLE første gang) overtas av kalleren, innholdet er ikke kopiert.
+    void grow(uint32_t capacity, VkBuffer& oldBuffer, DeviceAllocation& oldAllocation);
+
+    // Køfamiliene bufferet deles mellom (CONCURRENT). Tom liste gir EXCLUSIVE.
+    void setQueueFamilies(const std::vector<uint32_t>& families) { mQueueFamilies = families; }
+
+    VkBuffer getBuffer() const { return mBuffer; }
+    VkDeviceSize getElementSize() const { return mElementSize; }
+    uint32_t getCapacity() const { return mCapacity; }
+    uint32_t getUsedElements() const { return mUsedElements; }
+
+    void cleanup();
+
+private:
+    VkDevice mDevice;
+    DeviceMemoryAllocator* mAllocator;
+    VkBufferUsageFlags mUsage;
+    VkDeviceSize mElementSize;
+
+    VkBuffer mBuffer = VK_NULL_HANDLE;
+    DeviceAllocation mAllocation;
+    uint32_t mCapacity = 0;
+    uint32_t mUsedElements = 0;
+    std::vector<uint32_t> mQueueFamilies;
+
+    std::map<uint32_t, uint32_t> mFreeRanges;            // første element -> antall
+    std::unordered_map<uint32_t, uint32_t> mAllocations; // første element -> antall
+
+    void insertFreeRange(uint32_t first, uint32_t count);
+};
+}
+
+#endif // GEOMETRYARENA_H
@@ -0,0 +1,332 @@
+#include "GpuCulling.h"
+#include "Vertex.h"
+#include <qdebug.h>
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+namespace bbl
+{
+namespace
+{
+struct PushConstants
+{
+    glm::vec4 planes[6];
+    uint32_t instanceCount;
+    uint32_t batchCount;
+    uint32_t pass;
+    uint32_t compact;
+};
+
+constexpr uint32_t kWorkgroupSize = 64;   // local_size_x i Cull.comp
+
+static_assert(sizeof(GpuCulling::ObjectData) == 32, "ObjectData må stemme med Cull.comp");
+static_assert(sizeof(GpuCulling::BatchData) == 32, "BatchData må stemme med Cull.comp");
+static_assert(sizeof(InstanceData) == 112, "InstanceData må stemme med Cull.comp");
+static_assert(sizeof(PushConstants) == 112, "PushConstants må stemme med Cull.comp");
+}
+
+GpuCulling::GpuCulling(VkDevice device, DeviceMemoryAllocator* allocator, uint32_t frameCount, bool drawIndirectCount)
+    : mDevice(device)
+    , mAllocator(allocator)
+    , mFrames(frameCount)
+{
+    if (drawIndirectCount) {
+        mCmdDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCount>(
+            vkGetDeviceProcAddr(mDevice, "vkCmdDrawIndexedIndirectCount"));
+    }
+
+    // 0-2 er input i upload-bufferet (dynamic offset), 3-6 er output per frame
+    std::array<VkDescriptorSetLayoutBinding, 7> bindings{};
+    for (uint32_t i = 0; i < bindings.size(); ++i) {
+        bindings[i].binding = i;
+        bindings[i].descriptorCount = 1;
+        bindings[i].descriptorType = i < 3 ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC
+                                           : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+
+    if (vkCreateDescriptorSetLayout(mDevice, &layoutInfo, nullptr, &mDescriptorSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create culling descriptor set layout!");
+    }
+
+    std::array<VkDescriptorPoolSize, 2> poolSizes{};
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    poolSizes[0].descriptorCount = 3;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[1].descriptorCount = 4;
+
+    for (FrameSlot& slot : mFrames) {
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        poolInfo.pPoolSizes = poolSizes.data();
+        poolInfo.maxSets = 1;
+
+        if (vkCreateDescriptorPool(mDevice, &poolInfo, nullptr, &slot.descriptorPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create culling descriptor pool!");
+        }
+
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = slot.descriptorPool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &mDescriptorSetLayout;
+
+        if (vkAllocateDescriptorSets(mDevice, &allocInfo, &slot.descriptorSet) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate culling descriptor set!");
+        }
+    }
+}
+
+GpuCulling::~GpuCulling()
+{
+    cleanup();
+}
+
+void GpuCulling::createPipeline(const std::vector<char>& code, VkPipelineCache cache)
+{
+    VkPushConstantRange pushRange{};
+    pushRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushRange.offset = 0;
+    pushRange.size = sizeof(PushConstants);
+
+    VkPipelineLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layoutInfo.setLayoutCount = 1;
+    layoutInfo.pSetLayouts = &mDescriptorSetLayout;
+    layoutInfo.pushConstantRangeCount = 1;
+    layoutInfo.pPushConstantRanges = &pushRange;
+
+    if (vkCreatePipelineLayout(mDevice, &layoutInfo, nullptr, &mPipelineLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create culling pipeline layout!");
+    }
+
+    VkShaderModuleCreateInfo moduleInfo{};
+    moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    moduleInfo.codeSize = code.size();
+    moduleInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+    VkShaderModule shaderModule = VK_NULL_HANDLE;
+    if (vkCreateShaderModule(mDevice, &moduleInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create culling shader module!");
+    }
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = shaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = mPipelineLayout;
+
+    VkResult result = vkCreateComputePipelines(mDevice, cache, 1, &pipelineInfo, nullptr, &mPipeline);
+    vkDestroyShaderModule(mDevice, shaderModule, nullptr);
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create culling pipeline!");
+    }
+}
+
+void GpuCulling::beginFrame(uint32_t frameIndex)
+{
+    mCurrentFrame = frameIndex;
+
+    // Fencen er ventet på, så resultatet fra forrige gang slotten ble brukt er klart
+    const FrameSlot& slot = mFrames[mCurrentFrame];
+    if (slot.groupCounts.allocation.mapped && slot.inputs.instanceCount > 0) {
+        mVisibleCount = *static_cast<const uint32_t*>(slot.groupCounts.allocation.mapped);
+    }
+}
+
+void GpuCulling::prepare(const Inputs& inputs)
+{
+    FrameSlot& slot = mFrames[mCurrentFrame];
+    slot.inputs = inputs;
+    if (inputs.instanceCount == 0) {
+        return;
+    }
+
+    bool replaced = false;
+    replaced |= ensureBuffer(slot.visibleInstances, sizeof(InstanceData) * inputs.instanceCount,
+                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    replaced |= ensureBuffer(slot.commands, sizeof(VkDrawIndexedIndirectCommand) * inputs.batchCount,
+                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    replaced |= ensureBuffer(slot.batchCounts, sizeof(uint32_t) * inputs.batchCount,
+                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    // Lite, og leses av CPU-en for statistikk
+    replaced |= ensureBuffer(slot.groupCounts, sizeof(uint32_t) * (inputs.groupCount + 1),
+                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                                 VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    // Range for dynamic-bindingene følger antallet, så settet skrives på nytt når det endres
+    const Inputs& written = slot.writtenInputs;
+    if (replaced || slot.descriptorsDirty || written.buffer != inputs.buffer ||
+        written.instanceCount != inputs.instanceCount || written.batchCount != inputs.batchCount ||
+        written.groupCount != inputs.groupCount) {
+        writeDescriptorSet(slot);
+    }
+}
+
+void GpuCulling::recordCull(VkCommandBuffer commandBuffer, const glm::vec4 planes[6])
+{
+    const FrameSlot& slot = mFrames[mCurrentFrame];
+    const Inputs& inputs = slot.inputs;
+    if (inputs.instanceCount == 0) {
+        return;
+    }
+
+    vkCmdFillBuffer(commandBuffer, slot.batchCounts.buffer, 0, sizeof(uint32_t) * inputs.batchCount, 0);
+    vkCmdFillBuffer(commandBuffer, slot.groupCounts.buffer, 0, sizeof(uint32_t) * (inputs.groupCount + 1), 0);
+
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mPipeline);
+    uint32_t dynamicOffsets[] = {static_cast<uint32_t>(inputs.objectsOffset),
+                                 static_cast<uint32_t>(inputs.batchesOffset),
+                                 static_cast<uint32_t>(inputs.instancesOffset)};
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mPipelineLayout,
+                            0, 1, &slot.descriptorSet, 3, dynamicOffsets);
+
+    PushConstants push{};
+    std::copy(planes, planes + 6, push.planes);
+    push.instanceCount = inputs.instanceCount;
+    push.batchCount = inputs.batchCount;
+    push.compact = mCmdDrawIndexedIndirectCount ? 1u : 0u;
+
+    // Pass 0: én tråd per instans
+    push.pass = 0;
+    vkCmdPushConstants(commandBuffer, mPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+    vkCmdDispatch(commandBuffer, (inputs.instanceCount + kWorkgroupSize - 1) / kWorkgroupSize, 1, 1);
+
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    // Pass 1: én tråd per batch
+    push.pass = 1;
+    vkCmdPushConstants(commandBuffer, mPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+    vkCmdDispatch(commandBuffer, (inputs.batchCount + kWorkgroupSize - 1) / kWorkgroupSize, 1, 1);
+
+    // Kommandoer og tellere leses av indirect draw, matrisene som vertex input, og
+    // totalen av CPU-en etter fencen
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT |
+                            VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+                             VK_PIPELINE_STAGE_HOST_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void GpuCulling::drawGroup(VkCommandBuffer commandBuffer, uint32_t groupIndex,
+                           uint32_t firstCommand, uint32_t commandCount)
+{
+    const FrameSlot& slot = mFrames[mCurrentFrame];
+    VkDeviceSize commandOffset = sizeof(VkDrawIndexedIndirectCommand) * firstCommand;
+    uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+
+    if (mCmdDrawIndexedIndirectCount) {
+        VkDeviceSize countOffset = sizeof(uint32_t) * (groupIndex + 1);
+        mCmdDrawIndexedIndirectCount(commandBuffer, slot.commands.buffer, commandOffset,
+                                     slot.groupCounts.buffer, countOffset, commandCount, stride);
+    } else {
+        // Alle batchene i gruppen, tomme har instanceCount 0
+        vkCmdDrawIndexedIndirect(commandBuffer, slot.commands.buffer, commandOffset, commandCount, stride);
+    }
+}
+
+void GpuCulling::cleanup()
+{
+    for (FrameSlot& slot : mFrames) {
+        for (OutputBuffer* output : {&slot.visibleInstances, &slot.commands, &slot.batchCounts, &slot.groupCounts}) {
+            mAllocator->destroyBuffer(output->buffer, output->allocation);
+            output->capacity = 0;
+        }
+        if (slot.descriptorPool != VK_NULL_HANDLE) {
+            vkDestroyDescriptorPool(mDevice, slot.descriptorPool, nullptr);
+            slot.descriptorPool = VK_NULL_HANDLE;
+        }
+    }
+    mFrames.clear();
+
+    if (mPipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(mDevice, mPipeline, nullptr);
+        mPipeline = VK_NULL_HANDLE;
+    }
+    if (mPipelineLayout != VK_NULL_HANDLE) {
+        vkDestroyPipelineLayout(mDevice, mPipelineLayout, nullptr);
+        mPipelineLayout = VK_NULL_HANDLE;
+    }
+    if (mDescriptorSetLayout != VK_NULL_HANDLE) {
+        vkDestroyDescriptorSetLayout(mDevice, mDescriptorSetLayout, nullptr);
+        mDescriptorSetLayout = VK_NULL_HANDLE;
+    }
+}
+
+bool GpuCulling::ensureBuffer(OutputBuffer& output, VkDeviceSize size, VkBufferUsageFlags usage,
+                              VkMemoryPropertyFlags properties)
+{
+    size = std::max<VkDeviceSize>(size, 256);
+    if (size <= output.capacity) {
+        return false;
+    }
+
+    // Slotten er ledig (fencen er ventet på), det gamle bufferet kan slettes med en gang
+    VkDeviceSize capacity = std::max(size, output.capacity * 2);
+    mAllocator->destroyBuffer(output.buffer, output.allocation);
+
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = capacity;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    mAllocator->createBuffer(bufferInfo, properties, output.buffer, output.allocation);
+    output.capacity = capacity;
+    return true;
+}
+
+void GpuCulling::writeDescriptorSet(FrameSlot& slot)
+{
+    const Inputs& inputs = slot.inputs;
+
+    std::array<VkDescriptorBufferInfo, 7> bufferInfos{};
+    bufferInfos[0] = {inputs.buffer, 0, sizeof(ObjectData) * inputs.instanceCount};
+    bufferInfos[1] = {inputs.buffer, 0, sizeof(BatchData) * inputs.batchCount};
+    bufferInfos[2] = {inputs.buffer, 0, sizeof(InstanceData) * inputs.instanceCount};
+    bufferInfos[3] = {slot.visibleInstances.buffer, 0, VK_WHOLE_SIZE};
+    bufferInfos[4] = {slot.commands.buffer, 0, VK_WHOLE_SIZE};
+    bufferInfos[5] = {slot.batchCounts.buffer, 0, VK_WHOLE_SIZE};
+    bufferInfos[6] = {slot.groupCounts.buffer, 0, VK_WHOLE_SIZE};
+
+    std::array<VkWriteDescriptorSet, 7> writes{};
+    for (uint32_t i = 0; i < writes.size(); ++i) {
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = slot.descriptorSet;
+        writes[i].dstBinding = i;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = i < 3 ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC
+                                         : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[i].pBufferInfo = &bufferInfos[i];
+    }
+
+    vkUpdateDescriptorSets(mDevice, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    slot.writtenInputs = inputs;
+    slot.descriptorsDirty = false;
+}
+
+} // namespace bbl
@@ -0,0 +1,124 @@
+#ifndef GPUCULLING_H
+#define GPUCULLING_H
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+#include "DeviceMemoryAllocator.h"
+
+namespace bbl
+{
+// GPU-drevet culling: Shaders/Cull.comp tester alle instanser mot frustumet, pakker de
+// synlige matrisene og skriver VkDrawIndexedIndirectCommand per batch. Renderer tegner så
+// hver gruppe (samme pipeline og tekstur) med ett indirect-kall, uansett antall entiteter.
+//
+// Input (kuler, batcher, matriser) ligger i upload-bufferet og bindes med dynamic offsets.
+// Output-bufferne er per frame in flight og vokser ved behov. Krever multiDrawIndirect og
+// drawIndirectFirstInstance; med drawIndirectCount (Vulkan 1.2) hoppes tomme batcher over.
+class GpuCulling
+{
+public:
+    // Layout må stemme med Shaders/Cull.comp (std430)
+    struct ObjectData
+    {
+        glm::vec4 sphere;   // Lokal omsluttende kule (senter, radius)
+        uint32_t batch = 0;
+        uint32_t pad[3] = {};
+    };
+
+    struct BatchData
+    {
+        uint32_t indexCount = 0;
+        uint32_t firstIndex = 0;
+        int32_t vertexOffset = 0;
+        uint32_t firstInstance = 0;
+        uint32_t group = 0;
+        uint32_t firstCommand = 0;
+        uint32_t pad[2] = {};
+    };
+
+    struct Inputs
+    {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceSize objectsOffset = 0;
+        VkDeviceSize batchesOffset = 0;
+        VkDeviceSize instancesOffset = 0;
+        uint32_t instanceCount = 0;
+        uint32_t batchCount = 0;
+        uint32_t groupCount = 0;
+    };
+
+    GpuCulling(VkDevice device, DeviceMemoryAllocator* allocator, uint32_t frameCount, bool drawIndirectCount);
+    ~GpuCulling();
+
+    GpuCulling(const GpuCulling&) = delete;
+    GpuCulling& operator=(const GpuCulling&) = delete;
+
+    // SPIR-V for Cull.comp. Kaster runtime_error hvis pipelinen ikke kan lages.
+    void createPipeline(const std::vector<char>& code, VkPipelineCache cache = VK_NULL_HANDLE);
+
+    // Kalles etter vkWaitForFences for slotten; leser antall synlige fra forrige gang
+    void beginFrame(uint32_t frameIndex);
+
+    // Sørger for output-buffere og descriptor set for denne framens input
+    void prepare(const Inputs& inputs);
+
+    // Upload-bufferet til slotten er laget på nytt, settet må skrives selv om handlen er lik
+    void invalidateInputs() { mFrames[mCurrentFrame].descriptorsDirty = true; }
+
+    // Utenfor render pass: nullstiller tellere, kjører begge passene og barrierer frem til
+    // indirect draw og vertex input
+    void recordCull(VkCommandBuffer commandBuffer, const glm::vec4 planes[6]);
+
+    // Inne i render pass, med pipeline, descriptor set og buffere bundet
+    void drawGroup(VkCommandBuffer commandBuffer, uint32_t groupIndex,
+                   uint32_t firstCommand, uint32_t commandCount);
+
+    // Synlige matriser, bindes som instance-buffer (binding 1)
+    VkBuffer getVisibleInstanceBuffer() const { return mFrames[mCurrentFrame].visibleInstances.buffer; }
+
+    // Fra forrige gang denne slotten ble tegnet, dvs. frameCount frames gammelt
+    uint32_t getVisibleCount() const { return mVisibleCount; }
+
+    void cleanup();
+
+private:
+    struct OutputBuffer
+    {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        DeviceAllocation allocation;
+        VkDeviceSize capacity = 0;
+    };
+
+    struct FrameSlot
+    {
+        OutputBuffer visibleInstances;
+        OutputBuffer commands;
+        OutputBuffer batchCounts;
+        OutputBuffer groupCounts;    // Host-visible, [0] er totalt antall synlige
+        VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+        Inputs inputs;
+        Inputs writtenInputs;        // Det descriptor settet sist ble skrevet for
+        bool descriptorsDirty = true;
+    };
+
+    VkDevice mDevice;
+    DeviceMemoryAllocator* mAllocator;
+    std::vector<FrameSlot> mFrames;
+    uint32_t mCurrentFrame = 0;
+    uint32_t mVisibleCount = 0;
+
+    VkDescriptorSetLayout mDescriptorSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout mPipelineLayout = VK_NULL_HANDLE;
+    VkPipeline mPipeline = VK_NULL_HANDLE;
+    PFN_vkCmdDrawIndexedIndirectCount mCmdDrawIndexedIndirectCount = nullptr;
+
+    bool ensureBuffer(OutputBuffer& output, VkDeviceSize size, VkBufferUsageFlags usage,
+                      VkMemoryPropertyFlags properties);
+    void writeDescriptorSet(FrameSlot& slot);
+};
+}
+
+#endif // GPUCULLING_H
@@ -0,0 +1,210 @@
+#include "GpuProfiler.h"
+#include <QDebug>
+#include <stdexcept>
+
+namespace bbl
+{
+
+GpuProfiler::GpuProfiler(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t queueFamily,
+                         bool statistics, uint32_t frameCount, uint32_t maxScopes)
+    : mDevice(device), mMaxScopes(maxScopes), mSlots(frameCount)
+{
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+
+    const uint32_t validBits = queueFamily < familyCount ? families[queueFamily].timestampValidBits : 0;
+    if (validBits == 0 || properties.limits.timestampPeriod <= 0.0f) {
+        qDebug() << "GpuProfiler: queue has no timestamps, GPU timing disabled";
+        return;
+    }
+    mSupported = true;
+    mNanosecondsPerTick = properties.limits.timestampPeriod;
+    mTimestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+    VkQueryPoolCreateInfo timestampInfo{};
+    timestampInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    timestampInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    timestampInfo.queryCount = mMaxScopes * 2;
+
+    VkQueryPoolCreateInfo statisticsInfo{};
+    statisticsInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    statisticsInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+    statisticsInfo.queryCount = 1;
+    statisticsInfo.pipelineStatistics = kStatisticFlags;
+
+    mTimestampPools.resize(frameCount, VK_NULL_HANDLE);
+    if (statistics) {
+        mStatisticsPools.resize(frameCount, VK_NULL_HANDLE);
+    }
+    for (uint32_t i = 0; i < frameCount; ++i) {
+        if (vkCreateQueryPool(mDevice, &timestampInfo, nullptr, &mTimestampPools[i]) != VK_SUCCESS
+            || (statistics && vkCreateQueryPool(mDevice, &statisticsInfo, nullptr, &mStatisticsPools[i]) != VK_SUCCESS)) {
+            throw std::runtime_error("failed to create GPU profiler query pools!");
+        }
+    }
+}
+
+GpuProfiler::~GpuProfiler()
+{
+    for (VkQueryPool pool : mTimestampPools) {
+        vkDestroyQueryPool(mDevice, pool, nullptr);
+    }
+    for (VkQueryPool pool : mStatisticsPools) {
+        vkDestroyQueryPool(mDevice, pool, nullptr);
+    }
+}
+
+void GpuProfiler::beginFrame(uint32_t slot, uint64_t frameNumber)
+{
+    if (!mSupported) {
+        return;
+    }
+
+    collect(slot);
+
+    mCurrentSlot = slot;
+    mOpenDepth = 0;
+    Slot& current = mSlots[slot];
+    current.frame = frameNumber;
+    current.scopes.clear();
+    current.statisticsWritten = false;
+}
+
+void GpuProfiler::resetQueries(VkCommandBuffer commandBuffer)
+{
+    if (!mSupported) {
+        return;
+    }
+    vkCmdResetQueryPool(commandBuffer, mTimestampPools[mCurrentSlot], 0, mMaxScopes * 2);
+    if (hasStatistics()) {
+        vkCmdResetQueryPool(commandBuffer, mStatisticsPools[mCurrentSlot], 0, 1);
+    }
+}
+
+GpuProfiler::ScopeId GpuProfiler::reserveScope(std::string name)
+{
+    Slot& current = mSlots[mCurrentSlot];
+    if (!mSupported || current.scopes.size() >= mMaxScopes) {
+        return InvalidScope;
+    }
+    current.scopes.push_back({std::move(name), mOpenDepth});
+    return static_cast<ScopeId>(current.scopes.size() - 1);
+}
+
+GpuProfiler::ScopeId GpuProfiler::beginScope(VkCommandBuffer commandBuffer, std::string name)
+{
+    ScopeId scope = reserveScope(std::move(name));
+    if (scope != InvalidScope) {
+        writeBegin(commandBuffer, scope);
+        ++mOpenDepth;
+    }
+    return scope;
+}
+
+void GpuProfiler::endScope(VkCommandBuffer commandBuffer, ScopeId scope)
+{
+    if (scope == InvalidScope) {
+        return;
+    }
+    writeEnd(commandBuffer, scope);
+    --mOpenDepth;
+}
+
+void GpuProfiler::writeBegin(VkCommandBuffer commandBuffer, ScopeId scope) const
+{
+    if (scope != InvalidScope) {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                            mTimestampPools[mCurrentSlot], scope * 2);
+    }
+}
+
+void GpuProfiler::writeEnd(VkCommandBuffer commandBuffer, ScopeId scope) const
+{
+    if (scope != InvalidScope) {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                            mTimestampPools[mCurrentSlot], scope * 2 + 1);
+    }
+}
+
+void GpuProfiler::beginStatistics(VkCommandBuffer commandBuffer)
+{
+    if (hasStatistics()) {
+        vkCmdBeginQuery(commandBuffer, mStatisticsPools[mCurrentSlot], 0, 0);
+    }
+}
+
+void GpuProfiler::endStatistics(VkCommandBuffer commandBuffer)
+{
+    if (hasStatistics()) {
+        vkCmdEndQuery(commandBuffer, mStatisticsPools[mCurrentSlot], 0);
+        mSlots[mCurrentSlot].statisticsWritten = true;
+    }
+}
+
+void GpuProfiler::collect(uint32_t slotIndex)
+{
+    const Slot& slot = mSlots[slotIndex];
+    if (slot.frame == 0 || slot.scopes.empty()) {
+        return;
+    }
+
+    // Verdi og tilgjengelighet per query; uten WAIT_BIT, så et scope som aldri ble
+    // skrevet (eller ikke er ferdig) hoppes over i stedet for å blokkere
+    const uint32_t queryCount = static_cast<uint32_t>(slot.scopes.size()) * 2;
+    std::vector<uint64_t> timestamps(queryCount * 2);
+    VkResult result = vkGetQueryPoolResults(mDevice, mTimestampPools[slotIndex], 0, queryCount,
+                                            timestamps.size() * sizeof(uint64_t), timestamps.data(),
+                                            sizeof(uint64_t) * 2,
+                                            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    if (result != VK_SUCCESS && result != VK_NOT_READY) {
+        return;
+    }
+
+    Results results;
+    results.frame = slot.frame;
+    results.scopes.reserve(slot.scopes.size());
+    for (size_t i = 0; i < slot.scopes.size(); ++i) {
+        const uint64_t* begin = &timestamps[i * 4];
+        const uint64_t* end = &timestamps[i * 4 + 2];
+        if (begin[1] == 0 || end[1] == 0) {
+            continue;
+        }
+
+        Scope scope;
+        scope.name = slot.scopes[i].name;
+        scope.depth = slot.scopes[i].depth;
+        const uint64_t ticks = ((end[0] & mTimestampMask) - (begin[0] & mTimestampMask)) & mTimestampMask;
+        scope.ms = ticks * mNanosecondsPerTick * 1e-6;
+
+        auto [average, inserted] = mAverages.try_emplace(scope.name, scope.ms);
+        if (!inserted) {
+            average->second += (scope.ms - average->second) * 0.1;
+        }
+        scope.averageMs = average->second;
+        results.scopes.push_back(std::move(scope));
+    }
+
+    if (slot.statisticsWritten) {
+        // Samme rekkefølge som bitene i kStatisticFlags, pluss tilgjengelighet til slutt
+        uint64_t values[7] = {};
+        result = vkGetQueryPoolResults(mDevice, mStatisticsPools[slotIndex], 0, 1, sizeof(values), values,
+                                       sizeof(values), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+        if ((result == VK_SUCCESS || result == VK_NOT_READY) && values[6] != 0) {
+            results.hasStatistics = true;
+            results.statistics.inputVertices = values[0];
+            results.statistics.inputPrimitives = values[1];
+            results.statistics.vertexInvocations = values[2];
+            results.statistics.clippingPrimitives = values[3];
+            results.statistics.fragmentInvocations = values[4];
+            results.statistics.computeInvocations = values[5];
+        }
+    }
+
+    mResults = std::move(results);
+}
+}
@@ -0,0 +1,130 @@
+#ifndef GPUPROFILER_H
+#define GPUPROFILER_H
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace bbl
+{
+// GPU-tid for navngitte scopes og pipeline-statistikk per frame. Hver frame in flight har
+// egne query pools (en ring). Resultatene leses når slotten tas i bruk igjen, etter at
+// fencen er ventet på, så lesingen blokkerer aldri; tallene er derfor frameCount frames gamle.
+//
+// beginScope()/endScope() brukes i primary command buffer på hovedtråden. Opptak på workers
+// reserverer scopet på hovedtråden med reserveScope(), og workeren skriver bare
+// tidsstemplene med writeBegin()/writeEnd(). Hvert scope skrives nøyaktig én gang.
+class GpuProfiler
+{
+public:
+    using ScopeId = uint32_t;
+    static constexpr ScopeId InvalidScope = ~0u;
+
+    struct Scope
+    {
+        std::string name;
+        uint32_t depth = 0;        // Nesting, 0 = hele framen
+        double ms = 0.0;
+        double averageMs = 0.0;    // Glidende snitt per navn, roligere å lese i editoren
+    };
+
+    struct PipelineStatistics
+    {
+        uint64_t inputVertices = 0;
+        uint64_t inputPrimitives = 0;
+        uint64_t vertexInvocations = 0;
+        uint64_t clippingPrimitives = 0;
+        uint64_t fragmentInvocations = 0;
+        uint64_t computeInvocations = 0;
+    };
+
+    struct Results
+    {
+        uint64_t frame = 0;          // Framen tallene er fra, 0 = ingen ennå
+        std::vector<Scope> scopes;   // I opptaksrekkefølge, første er hele framen
+        bool hasStatistics = false;
+        PipelineStatistics statistics;
+
+        double frameMs() const { return scopes.empty() ? 0.0 : scopes.front().ms; }
+    };
+
+    // statistics krever pipelineStatisticsQuery (og inheritedQueries for secondary buffers)
+    GpuProfiler(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t queueFamily,
+                bool statistics, uint32_t frameCount, uint32_t maxScopes = 128);
+    ~GpuProfiler();
+
+    GpuProfiler(const GpuProfiler&) = delete;
+    GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+    // False når køen ikke har tidsstempler; da gjør alle kall ingenting
+    bool isSupported() const { return mSupported; }
+    bool hasStatistics() const { return mSupported && mStatisticsPools.size() > 0; }
+
+    // Flaggene statistikk-queryen bruker, til VkCommandBufferInheritanceInfo::pipelineStatistics
+    VkQueryPipelineStatisticFlags getStatisticFlags() const { return hasStatistics() ? kStatisticFlags : 0; }
+
+    // Etter fence-ventingen for slotten: leser det slotten målte sist og gjør den klar
+    void beginFrame(uint32_t slot, uint64_t frameNumber);
+
+    // Først i primary command buffer, utenfor render pass
+    void resetQueries(VkCommandBuffer commandBuffer);
+
+    ScopeId beginScope(VkCommandBuffer commandBuffer, std::string name);
+    void endScope(VkCommandBuffer commandBuffer, ScopeId scope);
+
+    // Hovedtråden, før opptaket deles ut. Nestes under scopet som er åpent nå.
+    ScopeId reserveScope(std::string name);
+    // Trådsikre så lenge hver tråd skriver sine egne scopes
+    void writeBegin(VkCommandBuffer commandBuffer, ScopeId scope) const;
+    void writeEnd(VkCommandBuffer commandBuffer, ScopeId scope) const;
+
+    // Rundt alt som skal telles, i primary
+    void beginStatistics(VkCommandBuffer commandBuffer);
+    void endStatistics(VkCommandBuffer commandBuffer);
+
+    const Results& getResults() const { return mResults; }
+
+private:
+    static constexpr VkQueryPipelineStatisticFlags kStatisticFlags =
+        VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+
+    struct SlotScope
+    {
+        std::string name;
+        uint32_t depth = 0;
+    };
+
+    struct Slot
+    {
+        uint64_t frame = 0;   // 0 = ingenting å lese
+        std::vector<SlotScope> scopes;
+        bool statisticsWritten = false;
+    };
+
+    VkDevice mDevice;
+    bool mSupported = false;
+    double mNanosecondsPerTick = 1.0;
+    uint64_t mTimestampMask = ~0ull;
+    uint32_t mMaxScopes;
+
+    std::vector<VkQueryPool> mTimestampPools;    // Én per slot, 2 queries per scope
+    std::vector<VkQueryPool> mStatisticsPools;   // Én query per slot, tom uten statistikk
+    std::vector<Slot> mSlots;
+    uint32_t mCurrentSlot = 0;
+    uint32_t mOpenDepth = 0;
+
+    Results mResults;
+    std::unordered_map<std::string, double> mAverages;
+
+    void collect(uint32_t slot);
+};
+}
+
+#endif // GPUPROFILER_H
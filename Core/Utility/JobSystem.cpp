@@ -0,0 +1,279 @@
+#include "JobSystem.h"
+#include <QCoreApplication>
+#include <QDebug>
+#include <QMetaObject>
+#include <exception>
+
+namespace bbl
+{
+
+namespace
+{
+thread_local int tlsWorkerIndex = -1;
+}
+
+//=============================================================================
+// TaskGroup
+//=============================================================================
+
+void TaskGroup::run(std::function<void()> job)
+{
+    if (!mJobs) {
+        job();
+        return;
+    }
+    mPending.fetch_add(1, std::memory_order_relaxed);
+    mJobs->push(JobSystem::Task{std::move(job), this});
+}
+
+void TaskGroup::runOnMainThread(std::function<void()> job)
+{
+    if (!mJobs) {
+        job();
+        return;
+    }
+    mPending.fetch_add(1, std::memory_order_relaxed);
+    mJobs->pushMainThread(JobSystem::Task{std::move(job), this});
+}
+
+void TaskGroup::runInBackground(std::function<void()> job)
+{
+    if (!mJobs) {
+        job();
+        return;
+    }
+    mPending.fetch_add(1, std::memory_order_relaxed);
+    mJobs->pushBackground(JobSystem::Task{std::move(job), this});
+}
+
+void TaskGroup::wait()
+{
+    if (!mJobs) {
+        return;
+    }
+
+    // Hjelp til i stedet for å blokkere, ellers kan nøstede grupper låse alle workers
+    while (!isDone()) {
+        if (mJobs->isMainThread()) {
+            mJobs->processMainThreadJobs();
+        }
+        if (!mJobs->tryRunOne()) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+//=============================================================================
+// JobSystem
+//=============================================================================
+
+JobSystem::JobSystem(unsigned workerCount)
+    : mMainThreadId(std::this_thread::get_id())
+{
+    if (workerCount == 0) {
+        unsigned cores = std::thread::hardware_concurrency();
+        workerCount = cores > 1 ? cores - 1 : 1;
+    }
+
+    mWorkers.reserve(workerCount);
+    for (unsigned i = 0; i < workerCount; ++i) {
+        mWorkers.push_back(std::make_unique<Worker>());
+    }
+    // Alle deques må finnes før første worker begynner å stjele
+    for (unsigned i = 0; i < workerCount; ++i) {
+        mWorkers[i]->thread = std::thread(&JobSystem::workerLoop, this, static_cast<int>(i));
+    }
+
+    qDebug() << "JobSystem started with" << workerCount << "workers";
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(mSleepMutex);
+        mRunning.store(false);
+    }
+    mWake.notify_all();
+
+    for (auto& worker : mWorkers) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+
+    // Hovedtråd-jobber som aldri ble kjørt, ingen kommer til å vente på dem nå
+    processMainThreadJobs();
+}
+
+int JobSystem::currentWorkerIndex()
+{
+    return tlsWorkerIndex;
+}
+
+void JobSystem::push(Task task)
+{
+    if (mWorkers.empty()) {
+        execute(task);
+        return;
+    }
+
+    int workerIndex = currentWorkerIndex();
+    size_t target = workerIndex >= 0
+                        ? static_cast<size_t>(workerIndex)
+                        : mNextWorker.fetch_add(1, std::memory_order_relaxed) % mWorkers.size();
+    {
+        std::lock_guard<std::mutex> lock(mWorkers[target]->mutex);
+        mWorkers[target]->tasks.push_back(std::move(task));
+    }
+
+    mQueuedTasks.fetch_add(1, std::memory_order_release);
+    {
+        // Tom lås hindrer at en worker sjekker predikatet og sovner mellom økning og notify
+        std::lock_guard<std::mutex> lock(mSleepMutex);
+    }
+    mWake.notify_one();
+}
+
+void JobSystem::pushMainThread(Task task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMainMutex);
+        mMainQueue.push_back(std::move(task));
+    }
+
+    // Be Qt-løkka tømme køen, én gang per batch
+    QCoreApplication* app = QCoreApplication::instance();
+    if (app && !mMainWakePending.exchange(true)) {
+        QMetaObject::invokeMethod(app, [this] { processMainThreadJobs(); }, Qt::QueuedConnection);
+    }
+}
+
+void JobSystem::pushBackground(Task task)
+{
+    if (mWorkers.empty()) {
+        execute(task);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mBackgroundMutex);
+        mBackgroundQueue.push_back(std::move(task));
+    }
+
+    mQueuedTasks.fetch_add(1, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(mSleepMutex);
+    }
+    mWake.notify_one();
+}
+
+void JobSystem::processMainThreadJobs()
+{
+    std::deque<Task> tasks;
+    {
+        std::lock_guard<std::mutex> lock(mMainMutex);
+        tasks.swap(mMainQueue);
+        mMainWakePending.store(false);
+    }
+
+    for (Task& task : tasks) {
+        execute(task);
+    }
+}
+
+bool JobSystem::tryRunOne(bool allowBackground)
+{
+    Task task;
+    if (!popTask(currentWorkerIndex(), task, allowBackground)) {
+        return false;
+    }
+    execute(task);
+    return true;
+}
+
+bool JobSystem::popTask(int workerIndex, Task& task, bool allowBackground)
+{
+    if (mWorkers.empty() || mQueuedTasks.load(std::memory_order_acquire) == 0) {
+        return false;
+    }
+
+    // Egen deque først, nyeste jobb
+    if (workerIndex >= 0) {
+        Worker& own = *mWorkers[workerIndex];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            mQueuedTasks.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    // Stjel eldste jobb fra de andre
+    size_t count = mWorkers.size();
+    size_t start = workerIndex >= 0 ? static_cast<size_t>(workerIndex) + 1
+                                    : mNextWorker.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < count; ++i) {
+        size_t victim = (start + i) % count;
+        if (static_cast<int>(victim) == workerIndex) {
+            continue;
+        }
+
+        Worker& other = *mWorkers[victim];
+        std::lock_guard<std::mutex> lock(other.mutex);
+        if (!other.tasks.empty()) {
+            task = std::move(other.tasks.front());
+            other.tasks.pop_front();
+            mQueuedTasks.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    // Bakgrunnsjobber sist, og bare for workers som ellers ville sovet
+    if (allowBackground && workerIndex >= 0) {
+        std::lock_guard<std::mutex> lock(mBackgroundMutex);
+        if (!mBackgroundQueue.empty()) {
+            task = std::move(mBackgroundQueue.front());
+            mBackgroundQueue.pop_front();
+            mQueuedTasks.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobSystem::execute(Task& task)
+{
+    try {
+        task.job();
+    } catch (const std::exception& e) {
+        qWarning() << "Job threw an exception:" << e.what();
+    } catch (...) {
+        qWarning() << "Job threw an unknown exception";
+    }
+
+    if (task.group) {
+        task.group->mPending.fetch_sub(1, std::memory_order_acq_rel);
+    }
+}
+
+void JobSystem::workerLoop(int workerIndex)
+{
+    tlsWorkerIndex = workerIndex;
+
+    while (true) {
+        if (tryRunOne(true)) {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mSleepMutex);
+        mWake.wait(lock, [this] {
+            return mQueuedTasks.load(std::memory_order_acquire) > 0 || !mRunning.load();
+        });
+        if (!mRunning.load() && mQueuedTasks.load(std::memory_order_acquire) == 0) {
+            return;
+        }
+    }
+}
+
+} // namespace bbl
@@ -0,0 +1,161 @@
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace bbl
+{
+class JobSystem;
+
+// Samling jobber som kan ventes på. wait() hjelper til med å kjøre jobber mens den
+// venter, så grupper kan nøstes (en jobb kan selv starte og vente på en gruppe).
+// Uten JobSystem kjøres alt direkte på kallende tråd.
+class TaskGroup
+{
+public:
+    explicit TaskGroup(JobSystem* jobs) : mJobs(jobs) {}
+    ~TaskGroup() { wait(); }
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    void run(std::function<void()> job);
+
+    // For Qt/Vulkan-kall som må gjøres fra hovedtråden
+    void runOnMainThread(std::function<void()> job);
+
+    // Lang jobb som ikke haster, se JobSystem::scheduleBackground
+    void runInBackground(std::function<void()> job);
+
+    void wait();
+    bool isDone() const { return mPending.load(std::memory_order_acquire) == 0; }
+
+private:
+    friend class JobSystem;
+    JobSystem* mJobs;
+    std::atomic<uint32_t> mPending{0};
+};
+
+// Work-stealing jobbsystem. Hver worker har sin egen deque: eieren tar nyeste jobb
+// (LIFO, varm cache), ledige workers stjeler eldste jobb fra de andre (FIFO).
+// Jobber fra andre tråder fordeles round-robin. Hovedtråd-jobber ligger i en egen kø
+// som tømmes av processMainThreadJobs(), eller av TaskGroup::wait() på hovedtråden.
+// Bakgrunnsjobber (f.eks. pipeline-kompilering) tas bare av ledige workers, aldri av en
+// tråd som hjelper til i TaskGroup::wait(), så de kan ikke forsinke en frame.
+//
+// Opprettes én gang i main() og deles av alle systemer via BBLHub::getJobSystem().
+class JobSystem
+{
+public:
+    using Job = std::function<void()>;
+
+    // 0 = én worker per kjerne, minus hovedtråden
+    explicit JobSystem(unsigned workerCount = 0);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // Fire-and-forget. Bruk TaskGroup når resultatet skal ventes på.
+    void schedule(Job job) { push(Task{std::move(job), nullptr}); }
+    void runOnMainThread(Job job) { pushMainThread(Task{std::move(job), nullptr}); }
+    void scheduleBackground(Job job) { pushBackground(Task{std::move(job), nullptr}); }
+    void processMainThreadJobs();
+
+    // fn(first, last) kalles for delområder av [begin, end) på maks grainSize elementer.
+    // Kallende tråd tar første del selv og returnerer når alt er ferdig.
+    template <typename Fn>
+    void parallelFor(size_t begin, size_t end, size_t grainSize, Fn&& fn);
+
+    unsigned getWorkerCount() const { return static_cast<unsigned>(mWorkers.size()); }
+    bool isMainThread() const { return std::this_thread::get_id() == mMainThreadId; }
+
+    // Indeks til workeren som kjører kallet, -1 utenfor jobbsystemet
+    static int currentWorkerIndex();
+
+private:
+    friend class TaskGroup;
+
+    struct Task
+    {
+        Job job;
+        TaskGroup* group;
+    };
+
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+        std::thread thread;
+    };
+
+    std::vector<std::unique_ptr<Worker>> mWorkers;
+    std::mutex mMainMutex;
+    std::deque<Task> mMainQueue;
+    std::atomic<bool> mMainWakePending{false};
+    std::mutex mBackgroundMutex;
+    std::deque<Task> mBackgroundQueue;
+
+    std::mutex mSleepMutex;
+    std::condition_variable mWake;
+    std::atomic<uint32_t> mQueuedTasks{0};
+    std::atomic<uint32_t> mNextWorker{0};
+    std::atomic<bool> mRunning{true};
+    std::thread::id mMainThreadId;
+
+    void push(Task task);
+    void pushMainThread(Task task);
+    void pushBackground(Task task);
+    bool tryRunOne(bool allowBackground = false);
+    bool popTask(int workerIndex, Task& task, bool allowBackground);
+    void execute(Task& task);
+    void workerLoop(int workerIndex);
+};
+
+// Som JobSystem::parallelFor, men kjører serielt når det ikke finnes et jobbsystem
+// (headless replay, verktøy uten BBLHub).
+template <typename Fn>
+void parallelFor(JobSystem* jobs, size_t begin, size_t end, size_t grainSize, Fn&& fn)
+{
+    if (jobs) {
+        jobs->parallelFor(begin, end, grainSize, std::forward<Fn>(fn));
+    } else if (begin < end) {
+        fn(begin, end);
+    }
+}
+
+template <typename Fn>
+void JobSystem::parallelFor(size_t begin, size_t end, size_t grainSize, Fn&& fn)
+{
+    if (begin >= end) {
+        return;
+    }
+
+    grainSize = std::max<size_t>(grainSize, 1);
+    if (end - begin <= grainSize || mWorkers.empty()) {
+        fn(begin, end);
+        return;
+    }
+
+    TaskGroup group(this);
+    for (size_t first = begin + grainSize; first < end; first += grainSize) {
+        size_t last = std::min(first + grainSize, end);
+        group.run([&fn, first, last] { fn(first, last); });
+    }
+    fn(begin, begin + grainSize);
+    group.wait();
+}
+
+} // namespace bbl
+
+#endif // JOBSYSTEM_H
@@ -5,6 +5,7 @@
 #include <string>
 #include <vulkan/vulkan.h>
 #include "Vertex.h"
+#include "DeviceMemoryAllocator.h"
 #include <glm/glm.hpp>
 
 namespace bbl
@@ -42,20 +43,37 @@ struct ModelData
 struct MeshGPUResources
 {
     VkBuffer vertexBuffer = VK_NULL_HANDLE;
-    VkDeviceMemory vertexBufferMemory = VK_NULL_HANDLE;
+    DeviceAllocation vertexAllocation;
     VkBuffer indexBuffer = VK_NULL_HANDLE;
-    VkDeviceMemory indexBufferMemory = VK_NULL_HANDLE;
+    DeviceAllocation indexAllocation;
     size_t indexCount = 0;
     size_t vertexCount = 0;
+
+    // Hvor meshet ligger i bufferne. 0 for mesher med egne buffere, ellers rekka i
+    // GeometryArena; da deler vertexBuffer/indexBuffer handle med andre mesher.
+    uint32_t firstIndex = 0;
+    int32_t vertexOffset = 0;
+    bool inGeometryArena = false;
+
+    // UploadQueue-ticket for kopieringen av vertices og indekser
+    uint64_t uploadTicket = 0;
+
+    // Lokale grenser regnet ut i uploadMesh, brukes til frustum culling
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    glm::vec3 boundsCenter = glm::vec3(0.0f);
+    float boundsRadius = 0.0f;
 };
 
 struct TextureGPUResources
 {
     VkImage textureImage = VK_NULL_HANDLE;
-    VkDeviceMemory textureImageMemory = VK_NULL_HANDLE;
+    DeviceAllocation textureAllocation;
     VkImageView textureImageView = VK_NULL_HANDLE;
     VkSampler textureSampler = VK_NULL_HANDLE;
     VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+    uint32_t mipLevels = 1;
+    uint64_t uploadTicket = 0;
 };
 }
 
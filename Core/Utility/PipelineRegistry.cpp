@@ -0,0 +1,461 @@
+#include "PipelineRegistry.h"
+#include "JobSystem.h"
+#include "Vertex.h"
+#include <qdebug.h>
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace
+{
+constexpr uint32_t kCacheMagic = 0x4342424C;   // "BBLC"
+constexpr uint32_t kCacheVersion = 1;
+}
+
+namespace bbl
+{
+PipelineRegistry::PipelineRegistry(VkDevice device, const VkPhysicalDeviceProperties& properties, std::string cachePath,
+                                   JobSystem* jobs)
+    : mDevice(device), mProperties(properties), mCachePath(std::move(cachePath)), mJobs(jobs),
+      mCompileJobs(std::make_unique<TaskGroup>(jobs))
+{
+    std::vector<char> initialData = loadCacheFile();
+
+    VkPipelineCacheCreateInfo cacheInfo{};
+    cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheInfo.initialDataSize = initialData.size();
+    cacheInfo.pInitialData = initialData.empty() ? nullptr : initialData.data();
+
+    if (vkCreatePipelineCache(mDevice, &cacheInfo, nullptr, &mCache) != VK_SUCCESS) {
+        // Driveren kan avvise data selv om headeren vår stemmer, prøv uten
+        cacheInfo.initialDataSize = 0;
+        cacheInfo.pInitialData = nullptr;
+        if (vkCreatePipelineCache(mDevice, &cacheInfo, nullptr, &mCache) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline cache!");
+        }
+        initialData.clear();
+    }
+
+    mSavedSize = initialData.size();
+    qDebug() << "PipelineRegistry:" << (initialData.empty() ? "empty cache" : "loaded cache")
+             << initialData.size() << "bytes from" << mCachePath.c_str();
+}
+
+PipelineRegistry::~PipelineRegistry()
+{
+    cleanup();
+}
+
+const std::vector<char>& PipelineRegistry::getShaderCode(const std::string& path)
+{
+    auto it = mShaderCode.find(path);
+    if (it != mShaderCode.end()) {
+        return it->second;
+    }
+
+    std::ifstream file(path, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open shader file: " + path);
+    }
+
+    std::vector<char> code(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(code.data(), static_cast<std::streamsize>(code.size()));
+
+    return mShaderCode.emplace(path, std::move(code)).first->second;
+}
+
+PipelineRegistry::ShaderSetId PipelineRegistry::addShaderSet(const std::string& vertPath, const std::string& fragPath)
+{
+    auto shaders = std::make_shared<ShaderSet>();
+    shaders->vertCode = getShaderCode(vertPath);
+    shaders->fragCode = getShaderCode(fragPath);
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mShaderSets.push_back(std::move(shaders));
+    return static_cast<ShaderSetId>(mShaderSets.size() - 1);
+}
+
+void PipelineRegistry::beginRebuild(const RenderPassKey& key, VkRenderPass renderPass, VkPipelineLayout layout)
+{
+    destroyPipelines();
+    mKey = key;
+    mRenderPass = renderPass;
+    mLayout = layout;
+}
+
+VkPipeline PipelineRegistry::compile(const VariantKey& key)
+{
+    std::shared_ptr<const ShaderSet> shaders;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto it = mVariants.find(key.pack());
+        if (it != mVariants.end() && it->second.pipeline != VK_NULL_HANDLE) {
+            return it->second.pipeline;
+        }
+        shaders = mShaderSets.at(key.shaderSet);
+    }
+
+    // En asynkron kompilering av samme variant kan pågå, vent på den først
+    waitForCompiles();
+
+    VkPipeline pipeline = buildPipeline(key, *shaders);
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    Variant& variant = mVariants[key.pack()];
+    variant.key = key;
+    variant.pipeline = pipeline;
+    variant.pending = false;
+    variant.failed = false;
+    return pipeline;
+}
+
+VkPipeline PipelineRegistry::request(const VariantKey& key)
+{
+    std::shared_ptr<const ShaderSet> shaders;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto [it, inserted] = mVariants.try_emplace(key.pack());
+        Variant& variant = it->second;
+        if (variant.pipeline != VK_NULL_HANDLE) {
+            return variant.pipeline;
+        }
+        if (!inserted) {
+            // Kompileres allerede, eller feilet
+            return findFallback(key);
+        }
+
+        variant.key = key;
+        variant.pending = true;
+        shaders = mShaderSets.at(key.shaderSet);
+    }
+
+    // Kompileringen tar fort flere millisekunder. Som bakgrunnsjobb kjøres den aldri av
+    // hovedtråden mens den venter på opptak eller culling.
+    mCompileJobs->runInBackground([this, key, shaders]() {
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        try {
+            pipeline = buildPipeline(key, *shaders);
+        } catch (const std::exception& e) {
+            qWarning() << "PipelineRegistry: variant" << key.pack() << "failed:" << e.what();
+        }
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        Variant& variant = mVariants[key.pack()];
+        variant.pipeline = pipeline;
+        variant.pending = false;
+        variant.failed = pipeline == VK_NULL_HANDLE;
+    });
+
+    // Uten jobbsystem kjørte jobben over direkte
+    std::lock_guard<std::mutex> lock(mMutex);
+    const Variant& variant = mVariants[key.pack()];
+    return variant.pipeline != VK_NULL_HANDLE ? variant.pipeline : findFallback(key);
+}
+
+VkPipeline PipelineRegistry::findFallback(const VariantKey& key) const
+{
+    // Samme shader-sett og topologi først, ellers hva som helst med riktig topologi.
+    // Vertex-input og descriptor-layout er felles for alle varianter.
+    VkPipeline sameTopology = VK_NULL_HANDLE;
+    for (const auto& [packed, variant] : mVariants) {
+        if (variant.pipeline == VK_NULL_HANDLE || variant.key.topology != key.topology) {
+            continue;
+        }
+        if (variant.key.shaderSet == key.shaderSet) {
+            return variant.pipeline;
+        }
+        sameTopology = variant.pipeline;
+    }
+    return sameTopology;
+}
+
+void PipelineRegistry::waitForCompiles()
+{
+    mCompileJobs->wait();
+}
+
+bool PipelineRegistry::hasPendingCompiles() const
+{
+    return !mCompileJobs->isDone();
+}
+
+void PipelineRegistry::destroyPipelines()
+{
+    waitForCompiles();
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (const auto& [packed, variant] : mVariants) {
+        if (variant.pipeline != VK_NULL_HANDLE) {
+            vkDestroyPipeline(mDevice, variant.pipeline, nullptr);
+        }
+    }
+    mVariants.clear();
+}
+
+void PipelineRegistry::save()
+{
+    if (mCache == VK_NULL_HANDLE || mCachePath.empty()) {
+        return;
+    }
+
+    size_t dataSize = 0;
+    if (vkGetPipelineCacheData(mDevice, mCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0) {
+        return;
+    }
+    // Cachen vokser bare, samme størrelse betyr ingen nye pipelines
+    if (dataSize == mSavedSize) {
+        return;
+    }
+
+    std::vector<char> data(dataSize);
+    if (vkGetPipelineCacheData(mDevice, mCache, &dataSize, data.data()) != VK_SUCCESS) {
+        return;
+    }
+
+    // Skriv til en midlertidig fil først, så en krasj midt i ikke etterlater en halv cache
+    const std::string tempPath = mCachePath + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            qWarning() << "PipelineRegistry: could not write" << tempPath.c_str();
+            return;
+        }
+        FileHeader header = makeHeader(dataSize);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(data.data(), static_cast<std::streamsize>(dataSize));
+        if (!file) {
+            qWarning() << "PipelineRegistry: failed writing" << tempPath.c_str();
+            return;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempPath, mCachePath, error);
+    if (error) {
+        qWarning() << "PipelineRegistry: could not replace" << mCachePath.c_str() << error.message().c_str();
+        return;
+    }
+
+    mSavedSize = dataSize;
+    qDebug() << "PipelineRegistry: saved" << dataSize << "bytes";
+}
+
+void PipelineRegistry::cleanup()
+{
+    if (mCache == VK_NULL_HANDLE) {
+        return;
+    }
+
+    destroyPipelines();
+    save();
+    mShaderSets.clear();
+    mShaderCode.clear();
+    mRenderPass = VK_NULL_HANDLE;
+
+    vkDestroyPipelineCache(mDevice, mCache, nullptr);
+    mCache = VK_NULL_HANDLE;
+}
+
+VkPipeline PipelineRegistry::buildPipeline(const VariantKey& key, const ShaderSet& shaders) const
+{
+    // Kan kjøre på en worker: bruker bare verdier som er faste til neste beginRebuild
+    VkShaderModule vertShaderModule = createShaderModule(shaders.vertCode);
+    VkShaderModule fragShaderModule = createShaderModule(shaders.fragCode);
+
+    // Hver feature-bit blir en bool-konstant med constant_id lik bitnummeret
+    std::array<VkBool32, 32> featureValues{};
+    std::array<VkSpecializationMapEntry, 32> featureEntries{};
+    for (uint32_t bit = 0; bit < 32; ++bit) {
+        featureValues[bit] = (key.features >> bit) & 1u ? VK_TRUE : VK_FALSE;
+        featureEntries[bit].constantID = bit;
+        featureEntries[bit].offset = bit * sizeof(VkBool32);
+        featureEntries[bit].size = sizeof(VkBool32);
+    }
+    VkSpecializationInfo specialization{};
+    specialization.mapEntryCount = static_cast<uint32_t>(featureEntries.size());
+    specialization.pMapEntries = featureEntries.data();
+    specialization.dataSize = sizeof(featureValues);
+    specialization.pData = featureValues.data();
+
+    VkPipelineShaderStageCreateInfo shaderStages[2]{};
+    shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    shaderStages[0].module = vertShaderModule;
+    shaderStages[0].pName = "main";
+    shaderStages[0].pSpecializationInfo = &specialization;
+    shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    shaderStages[1].module = fragShaderModule;
+    shaderStages[1].pName = "main";
+    shaderStages[1].pSpecializationInfo = &specialization;
+
+    // Binding 0 er mesh-vertekser, binding 1 er model- og normalmatrisen per instans
+    std::array<VkVertexInputBindingDescription, 2> bindingDescriptions = {
+        Vertex::getBindingDescription(),
+        InstanceData::getBindingDescription()
+    };
+    std::array<VkVertexInputAttributeDescription, 4> vertexAttributes = Vertex::getAttributeDescriptions();
+    std::array<VkVertexInputAttributeDescription, 7> instanceAttributes = InstanceData::getAttributeDescriptions();
+    std::array<VkVertexInputAttributeDescription, 11> attributeDescriptions{};
+    std::copy(vertexAttributes.begin(), vertexAttributes.end(), attributeDescriptions.begin());
+    std::copy(instanceAttributes.begin(), instanceAttributes.end(), attributeDescriptions.begin() + vertexAttributes.size());
+
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
+    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
+    vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
+    vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = key.topology;
+    inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+    // Viewport og scissor er dynamiske, derfor overlever pipelines en resize
+    VkPipelineViewportStateCreateInfo viewportState{};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+
+    std::array<VkDynamicState, 2> dynamicStates = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamicState{};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+    dynamicState.pDynamicStates = dynamicStates.data();
+
+    VkPipelineRasterizationStateCreateInfo rasterizer{};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.depthClampEnable = VK_FALSE;
+    rasterizer.rasterizerDiscardEnable = VK_FALSE;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.lineWidth = 1.0f;
+    rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+    rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rasterizer.depthBiasEnable = VK_FALSE;
+
+    VkPipelineMultisampleStateCreateInfo multisampling{};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.sampleShadingEnable = VK_FALSE;
+    multisampling.rasterizationSamples = mKey.samples;
+
+    // Gjennomsiktige varianter tester mot dybden, men skriver den ikke
+    const bool alphaBlend = key.blend == BlendMode::Alpha;
+    VkPipelineDepthStencilStateCreateInfo depthStencil{};
+    depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencil.depthTestEnable = VK_TRUE;
+    depthStencil.depthWriteEnable = alphaBlend ? VK_FALSE : VK_TRUE;
+    depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+    depthStencil.depthBoundsTestEnable = VK_FALSE;
+    depthStencil.stencilTestEnable = VK_FALSE;
+
+    VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    colorBlendAttachment.blendEnable = alphaBlend ? VK_TRUE : VK_FALSE;
+    colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+    colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+    VkPipelineColorBlendStateCreateInfo colorBlending{};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.logicOpEnable = VK_FALSE;
+    colorBlending.logicOp = VK_LOGIC_OP_COPY;
+    colorBlending.attachmentCount = 1;
+    colorBlending.pAttachments = &colorBlendAttachment;
+
+    VkGraphicsPipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineInfo.stageCount = 2;
+    pipelineInfo.pStages = shaderStages;
+    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pInputAssemblyState = &inputAssembly;
+    pipelineInfo.pViewportState = &viewportState;
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisampling;
+    pipelineInfo.pDepthStencilState = &depthStencil;
+    pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.layout = mLayout;
+    pipelineInfo.renderPass = mRenderPass;
+    pipelineInfo.subpass = 0;
+
+    // Cachen er internt synkronisert, så flere workers kan bruke den samtidig
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkResult result = vkCreateGraphicsPipelines(mDevice, mCache, 1, &pipelineInfo, nullptr, &pipeline);
+
+    vkDestroyShaderModule(mDevice, fragShaderModule, nullptr);
+    vkDestroyShaderModule(mDevice, vertShaderModule, nullptr);
+
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create graphics pipeline!");
+    }
+    return pipeline;
+}
+
+VkShaderModule PipelineRegistry::createShaderModule(const std::vector<char>& code) const
+{
+    VkShaderModuleCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    createInfo.codeSize = code.size();
+    createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+    VkShaderModule shaderModule;
+    if (vkCreateShaderModule(mDevice, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create shader module!");
+    }
+    return shaderModule;
+}
+
+std::vector<char> PipelineRegistry::loadCacheFile() const
+{
+    std::ifstream file(mCachePath, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) {
+        return {};
+    }
+
+    const size_t fileSize = static_cast<size_t>(file.tellg());
+    if (fileSize < sizeof(FileHeader)) {
+        return {};
+    }
+
+    FileHeader header;
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+    // Ny driver eller annet kort gir ubrukelig data, bygg cachen på nytt
+    const FileHeader expected = makeHeader(fileSize - sizeof(FileHeader));
+    if (std::memcmp(&header, &expected, sizeof(FileHeader)) != 0) {
+        qDebug() << "PipelineRegistry: discarding cache from another device or driver";
+        return {};
+    }
+
+    std::vector<char> data(static_cast<size_t>(header.dataSize));
+    file.read(data.data(), static_cast<std::streamsize>(data.size()));
+    if (!file) {
+        return {};
+    }
+    return data;
+}
+
+PipelineRegistry::FileHeader PipelineRegistry::makeHeader(uint64_t dataSize) const
+{
+    // Nullstilt med memset så padding blir lik og memcmp i loadCacheFile fungerer
+    FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.magic = kCacheMagic;
+    header.version = kCacheVersion;
+    header.vendorID = mProperties.vendorID;
+    header.deviceID = mProperties.deviceID;
+    header.driverVersion = mProperties.driverVersion;
+    std::memcpy(header.cacheUUID, mProperties.pipelineCacheUUID, VK_UUID_SIZE);
+    header.dataSize = dataSize;
+    return header;
+}
+}
@@ -0,0 +1,173 @@
+#ifndef PIPELINEREGISTRY_H
+#define PIPELINEREGISTRY_H
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace bbl
+{
+class JobSystem;
+class TaskGroup;
+
+// Eier VkPipelineCache og alle grafikk-pipelines. Cachen lastes fra disk ved oppstart og
+// lagres igjen etter at pipelines er bygget, så kald start slipper å kompilere shaderne på
+// nytt. Filen har en egen header med vendor, device, driverversjon og pipelineCacheUUID;
+// stemmer ikke den med enheten forkastes filen.
+//
+// Pipelines er varianter med nøkkel (shader-sett, topologi, blending, features). Features
+// er spesialiseringskonstanter, så nye materialvarianter trenger ingen nye shaderfiler.
+// request() gir en ferdig variant, eller starter kompilering på en worker og gir en
+// fallback (samme shader-sett og topologi) til varianten er klar. Variantene som brukes
+// ved oppstart bygges med compile(), resten når de først trengs.
+//
+// Pipelines bygges mot et render pass, men kan brukes med alle kompatible render pass
+// (samme formater og samples). Viewport og scissor er dynamiske, så en resize trenger ikke
+// nye pipelines. needsRebuild() sier om formatet faktisk har endret seg.
+class PipelineRegistry
+{
+public:
+    // Det som avgjør kompatibilitet for render passet vårt
+    struct RenderPassKey
+    {
+        VkFormat colorFormat = VK_FORMAT_UNDEFINED;
+        VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+        VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+
+        bool operator==(const RenderPassKey& other) const
+        {
+            return colorFormat == other.colorFormat && depthFormat == other.depthFormat
+                   && samples == other.samples;
+        }
+        bool operator!=(const RenderPassKey& other) const { return !(*this == other); }
+    };
+
+    using ShaderSetId = uint16_t;
+
+    enum class BlendMode : uint8_t { Opaque, Alpha };
+
+    // Bit i blir spesialiseringskonstant constant_id = i (bool) i begge shaderne.
+    // Må stemme med layout(constant_id) i Shader.frag og Phong.frag.
+    enum MaterialFeature : uint32_t
+    {
+        FeatureTexture = 1u << 0,   // Sampler teksturen, ellers bare vertex-farge
+        FeatureBlinn = 1u << 1,     // Blinn-Phong spekulær i stedet for Phong
+    };
+
+    struct VariantKey
+    {
+        ShaderSetId shaderSet = 0;
+        VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+        BlendMode blend = BlendMode::Opaque;
+        uint32_t features = 0;
+
+        uint64_t pack() const
+        {
+            return (uint64_t(shaderSet) << 48) | (uint64_t(topology) << 40)
+                   | (uint64_t(blend) << 32) | features;
+        }
+        bool operator==(const VariantKey& other) const { return pack() == other.pack(); }
+        bool operator!=(const VariantKey& other) const { return pack() != other.pack(); }
+        bool operator<(const VariantKey& other) const { return pack() < other.pack(); }
+    };
+
+    // jobs kan være null, da kompileres varianter på kallende tråd
+    PipelineRegistry(VkDevice device, const VkPhysicalDeviceProperties& properties, std::string cachePath,
+                     JobSystem* jobs);
+    ~PipelineRegistry();
+
+    PipelineRegistry(const PipelineRegistry&) = delete;
+    PipelineRegistry& operator=(const PipelineRegistry&) = delete;
+
+    VkPipelineCache getCache() const { return mCache; }
+
+    // SPIR-V leses fra disk én gang. Kaster runtime_error hvis filen ikke finnes.
+    const std::vector<char>& getShaderCode(const std::string& path);
+
+    // Vertex- og fragment-shader som brukes sammen. Lastes med en gang.
+    ShaderSetId addShaderSet(const std::string& vertPath, const std::string& fragPath);
+
+    // True første gang og når formatene er endret siden forrige build
+    bool needsRebuild(const RenderPassKey& key) const { return mRenderPass == VK_NULL_HANDLE || key != mKey; }
+
+    // Venter på kompileringer og sletter alle varianter (kalleren har ventet på GPU-en).
+    // Nye varianter bygges mot renderPass og layout.
+    void beginRebuild(const RenderPassKey& key, VkRenderPass renderPass, VkPipelineLayout layout);
+
+    // Bygger varianten nå hvis den ikke finnes. Kaster runtime_error ved feil.
+    VkPipeline compile(const VariantKey& key);
+
+    // Trådsikker, kan kalles fra opptak på workers. VK_NULL_HANDLE når verken varianten
+    // eller en fallback er klar; da hoppes tegningen over denne framen.
+    VkPipeline request(const VariantKey& key);
+
+    void waitForCompiles();
+    // True mens varianter kompileres i bakgrunnen og fallbacks tegnes i stedet
+    bool hasPendingCompiles() const;
+    void destroyPipelines();
+
+    // Skriver cachen til disk hvis den har vokst siden sist
+    void save();
+
+    void cleanup();
+
+private:
+    // Ligger først i filen, foran dataene fra vkGetPipelineCacheData
+    // Ingen initialiserere: triviell type, så hele structen (med padding) kan memcmp-es
+    struct FileHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t vendorID;
+        uint32_t deviceID;
+        uint32_t driverVersion;
+        uint8_t cacheUUID[VK_UUID_SIZE];
+        uint64_t dataSize;
+    };
+
+    struct ShaderSet
+    {
+        std::vector<char> vertCode;
+        std::vector<char> fragCode;
+    };
+
+    struct Variant
+    {
+        VariantKey key;
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        bool pending = false;
+        bool failed = false;   // Prøves ikke igjen, fallbacken brukes
+    };
+
+    VkDevice mDevice;
+    VkPhysicalDeviceProperties mProperties;
+    std::string mCachePath;
+    VkPipelineCache mCache = VK_NULL_HANDLE;
+    size_t mSavedSize = 0;
+
+    RenderPassKey mKey;
+    VkRenderPass mRenderPass = VK_NULL_HANDLE;
+    VkPipelineLayout mLayout = VK_NULL_HANDLE;
+
+    JobSystem* mJobs;
+    std::unique_ptr<TaskGroup> mCompileJobs;
+
+    // Beskytter mVariants og mShaderSets; selve kompileringen skjer uten lås
+    std::mutex mMutex;
+    std::unordered_map<uint64_t, Variant> mVariants;
+    std::vector<std::shared_ptr<const ShaderSet>> mShaderSets;
+    std::unordered_map<std::string, std::vector<char>> mShaderCode;
+
+    VkPipeline buildPipeline(const VariantKey& key, const ShaderSet& shaders) const;
+    VkShaderModule createShaderModule(const std::vector<char>& code) const;
+    VkPipeline findFallback(const VariantKey& key) const;
+    std::vector<char> loadCacheFile() const;
+    FileHeader makeHeader(uint64_t dataSize) const;
+};
+}
+
+#endif // PIPELINEREGISTRY_H
@@ -0,0 +1,47 @@
+#include "RadixSort.h"
+#include <array>
+#include <stdexcept>
+
+namespace bbl
+{
+
+void radixSort(std::vector<uint64_t>& keys, std::vector<uint32_t>& values, unsigned keyBits)
+{
+    if (keys.size() != values.size()) {
+        throw std::runtime_error("radixSort: keys and values differ in size");
+    }
+    const size_t count = keys.size();
+    if (count < 2) {
+        return;
+    }
+
+    std::vector<uint64_t> keyScratch(count);
+    std::vector<uint32_t> valueScratch(count);
+
+    for (unsigned shift = 0; shift < keyBits && shift < 64; shift += 8) {
+        std::array<size_t, 256> offsets{};
+        for (uint64_t key : keys) {
+            ++offsets[(key >> shift) & 0xff];
+        }
+        // Alle har samme byte: rekkefølgen endres ikke av denne runden
+        if (offsets[(keys[0] >> shift) & 0xff] == count) {
+            continue;
+        }
+
+        size_t sum = 0;
+        for (size_t& offset : offsets) {
+            size_t bucket = offset;
+            offset = sum;
+            sum += bucket;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            size_t target = offsets[(keys[i] >> shift) & 0xff]++;
+            keyScratch[target] = keys[i];
+            valueScratch[target] = values[i];
+        }
+        keys.swap(keyScratch);
+        values.swap(valueScratch);
+    }
+}
+
+} // namespace bbl
@@ -0,0 +1,15 @@
+#ifndef RADIXSORT_H
+#define RADIXSORT_H
+
+#include <cstdint>
+#include <vector>
+
+namespace bbl
+{
+// LSD radix sort av 64-bits nøkler med en 32-bits verdi (typisk en indeks) som følger med.
+// Stabil, 8 bit per runde. Bare de nederste keyBits sorteres, så nøkler som er pakket tett
+// tar færre runder; runder der alle nøklene har samme byte hoppes over.
+void radixSort(std::vector<uint64_t>& keys, std::vector<uint32_t>& values, unsigned keyBits = 64);
+}
+
+#endif // RADIXSORT_H
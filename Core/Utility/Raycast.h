@@ -0,0 +1,86 @@
+#ifndef RAYCAST_H
+#define RAYCAST_H
+
+#include "../../ECS/Entity/Entity.h"
+#include <glm/glm.hpp>
+#include <cfloat>
+#include <cstdint>
+#include <utility>
+
+namespace bbl
+{
+
+// Stråle i verdenskoordinater. direction trenger ikke være normalisert,
+// men distance i RaycastHit er alltid i verdensenheter.
+struct Ray
+{
+    glm::vec3 origin{0.0f};
+    glm::vec3 direction{0.0f, -1.0f, 0.0f};
+    float maxDistance{FLT_MAX};
+};
+
+struct RaycastHit
+{
+    bool hasHit{false};
+    EntityID entity{INVALID_ENTITY};   // Terreng-entiteten ved treff på terrenget
+    int32_t triangleIndex{-1};         // Indeks i Terrain::getIndices() / 3, -1 for collider-treff
+    glm::vec3 point{0.0f};
+    glm::vec3 normal{0.0f, 1.0f, 0.0f};
+    float distance{FLT_MAX};
+};
+
+// Slab test mot en AABB. Returnerer inngangsnormalen, eller utgangen hvis
+// origin ligger inne i boksen.
+inline bool intersectRayAABB(const glm::vec3& origin, const glm::vec3& invDir,
+                             const glm::vec3& boxMin, const glm::vec3& boxMax,
+                             float maxDistance, float& tHit, glm::vec3& normal)
+{
+    float tMin = 0.0f;
+    float tMax = maxDistance;
+    int enterAxis = -1;
+    float enterSign = 0.0f;
+
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        float t0 = (boxMin[axis] - origin[axis]) * invDir[axis];
+        float t1 = (boxMax[axis] - origin[axis]) * invDir[axis];
+        float sign = -1.0f;
+        if (t0 > t1)
+        {
+            std::swap(t0, t1);
+            sign = 1.0f;
+        }
+
+        // NaN (0 * inf) betyr at strålen er parallell og ligger på planet, ignorer aksen
+        if (t0 == t0 && t0 > tMin)
+        {
+            tMin = t0;
+            enterAxis = axis;
+            enterSign = sign;
+        }
+        if (t1 == t1 && t1 < tMax)
+        {
+            tMax = t1;
+        }
+        if (tMin > tMax)
+        {
+            return false;
+        }
+    }
+
+    tHit = tMin;
+    normal = glm::vec3(0.0f);
+    if (enterAxis >= 0)
+    {
+        normal[enterAxis] = enterSign;
+    }
+    else
+    {
+        normal = glm::vec3(0.0f, 1.0f, 0.0f);
+    }
+    return true;
+}
+
+} // namespace bbl
+
+#endif // RAYCAST_H
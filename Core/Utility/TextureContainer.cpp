@@ -0,0 +1,218 @@
+#include "TextureContainer.h"
+#include "JobSystem.h"
+#include <QDebug>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace bbl
+{
+
+namespace
+{
+constexpr uint32_t kContainerMagic = 0x5442424C;   // "BBLT"
+constexpr uint32_t kContainerVersion = 1;
+constexpr uint32_t kFormatRGBA8Srgb = 0;
+
+struct FileHeader
+{
+    uint32_t magic = kContainerMagic;
+    uint32_t version = kContainerVersion;
+    uint32_t format = kFormatRGBA8Srgb;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t mipLevels = 0;
+    uint64_t dataSize = 0;
+};
+
+// Bildene er sRGB, så snittet tas i lineært rom som en blit fra et _SRGB-format gjør
+float srgbToLinear(uint8_t value)
+{
+    static const std::array<float, 256> table = [] {
+        std::array<float, 256> result{};
+        for (int i = 0; i < 256; ++i) {
+            float c = i / 255.0f;
+            result[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        return result;
+    }();
+    return table[value];
+}
+
+uint8_t linearToSrgb(float value)
+{
+    static const std::array<uint8_t, 4096> table = [] {
+        std::array<uint8_t, 4096> result{};
+        for (int i = 0; i < 4096; ++i) {
+            float l = i / 4095.0f;
+            float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+            result[i] = static_cast<uint8_t>(std::clamp(c * 255.0f + 0.5f, 0.0f, 255.0f));
+        }
+        return result;
+    }();
+    return table[static_cast<size_t>(std::clamp(value, 0.0f, 1.0f) * 4095.0f + 0.5f)];
+}
+}
+
+uint32_t mipLevelCount(uint32_t width, uint32_t height)
+{
+    return static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+}
+
+size_t mipChainSize(uint32_t width, uint32_t height, uint32_t mipLevels)
+{
+    size_t size = 0;
+    for (uint32_t level = 0; level < mipLevels; ++level) {
+        size += static_cast<size_t>(std::max(width >> level, 1u)) * std::max(height >> level, 1u) * 4;
+    }
+    return size;
+}
+
+std::vector<unsigned char> buildMipChain(JobSystem* jobs, const unsigned char* pixels,
+                                         uint32_t width, uint32_t height, uint32_t mipLevels)
+{
+    std::vector<unsigned char> chain(mipChainSize(width, height, mipLevels));
+    std::memcpy(chain.data(), pixels, static_cast<size_t>(width) * height * 4);
+
+    size_t srcOffset = 0;
+    for (uint32_t level = 1; level < mipLevels; ++level) {
+        const uint32_t srcWidth = std::max(width >> (level - 1), 1u);
+        const uint32_t srcHeight = std::max(height >> (level - 1), 1u);
+        const uint32_t dstWidth = std::max(width >> level, 1u);
+        const uint32_t dstHeight = std::max(height >> level, 1u);
+        const size_t dstOffset = srcOffset + static_cast<size_t>(srcWidth) * srcHeight * 4;
+        const unsigned char* src = chain.data() + srcOffset;
+        unsigned char* dst = chain.data() + dstOffset;
+
+        // Siste rad/kolonne gjentas ved odde mål; radene fordeles på jobbsystemet
+        parallelFor(jobs, 0, dstHeight, 32, [&](size_t firstRow, size_t lastRow) {
+            for (size_t y = firstRow; y < lastRow; ++y) {
+                const size_t y0 = std::min<size_t>(y * 2, srcHeight - 1);
+                const size_t y1 = std::min<size_t>(y * 2 + 1, srcHeight - 1);
+                for (size_t x = 0; x < dstWidth; ++x) {
+                    const size_t x0 = std::min<size_t>(x * 2, srcWidth - 1);
+                    const size_t x1 = std::min<size_t>(x * 2 + 1, srcWidth - 1);
+                    const unsigned char* samples[4] = {
+                        src + (y0 * srcWidth + x0) * 4, src + (y0 * srcWidth + x1) * 4,
+                        src + (y1 * srcWidth + x0) * 4, src + (y1 * srcWidth + x1) * 4
+                    };
+
+                    unsigned char* out = dst + (y * dstWidth + x) * 4;
+                    for (int c = 0; c < 3; ++c) {
+                        float sum = 0.0f;
+                        for (const unsigned char* sample : samples) {
+                            sum += srgbToLinear(sample[c]);
+                        }
+                        out[c] = linearToSrgb(sum * 0.25f);
+                    }
+                    // Alfa er lineær fra før
+                    out[3] = static_cast<unsigned char>(
+                        (samples[0][3] + samples[1][3] + samples[2][3] + samples[3][3] + 2) / 4);
+                }
+            }
+        });
+
+        srcOffset = dstOffset;
+    }
+    return chain;
+}
+
+std::string bakedTexturePath(const std::string& sourcePath)
+{
+    return std::filesystem::path(sourcePath).replace_extension(".bbltex").string();
+}
+
+bool saveTextureContainer(const std::string& path, const TextureContainer& texture)
+{
+    if (texture.data.size() != mipChainSize(texture.width, texture.height, texture.mipLevels)) {
+        qWarning() << "TextureContainer: level data does not match" << texture.width << "x" << texture.height;
+        return false;
+    }
+
+    const std::string tempPath = path + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            qWarning() << "TextureContainer: could not write" << tempPath.c_str();
+            return false;
+        }
+        FileHeader header;
+        header.width = texture.width;
+        header.height = texture.height;
+        header.mipLevels = texture.mipLevels;
+        header.dataSize = texture.data.size();
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(texture.data.data()),
+                   static_cast<std::streamsize>(texture.data.size()));
+        if (!file) {
+            qWarning() << "TextureContainer: failed writing" << tempPath.c_str();
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempPath, path, error);
+    if (error) {
+        qWarning() << "TextureContainer: could not replace" << path.c_str() << error.message().c_str();
+        return false;
+    }
+    return true;
+}
+
+bool loadTextureContainer(const std::string& path, TextureContainer& texture)
+{
+    std::ifstream file(path, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    const size_t fileSize = static_cast<size_t>(file.tellg());
+    if (fileSize < sizeof(FileHeader)) {
+        return false;
+    }
+
+    FileHeader header;
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+    const bool valid = header.magic == kContainerMagic && header.version == kContainerVersion
+                       && header.format == kFormatRGBA8Srgb && header.width > 0 && header.height > 0
+                       && header.mipLevels > 0 && header.mipLevels <= mipLevelCount(header.width, header.height)
+                       && header.dataSize == mipChainSize(header.width, header.height, header.mipLevels)
+                       && header.dataSize == fileSize - sizeof(FileHeader);
+    if (!valid) {
+        qWarning() << "TextureContainer: ignoring invalid or outdated" << path.c_str();
+        return false;
+    }
+
+    // Én lesing rett inn i nivådataene
+    texture.width = header.width;
+    texture.height = header.height;
+    texture.mipLevels = header.mipLevels;
+    texture.data.resize(static_cast<size_t>(header.dataSize));
+    file.read(reinterpret_cast<char*>(texture.data.data()), static_cast<std::streamsize>(texture.data.size()));
+    return static_cast<bool>(file);
+}
+
+bool loadBakedTexture(const std::string& sourcePath, TextureContainer& texture)
+{
+    const std::string bakedPath = bakedTexturePath(sourcePath);
+
+    std::error_code error;
+    const auto bakedTime = std::filesystem::last_write_time(bakedPath, error);
+    if (error) {
+        return false;
+    }
+    // Kildebildet er endret etter baking, dekod det i stedet for å vise et gammelt bilde
+    const auto sourceTime = std::filesystem::last_write_time(sourcePath, error);
+    if (!error && sourceTime > bakedTime) {
+        qDebug() << "TextureContainer: stale" << bakedPath.c_str() << "- run TextureBaker";
+        return false;
+    }
+
+    return loadTextureContainer(bakedPath, texture);
+}
+}
@@ -0,0 +1,51 @@
+#ifndef TEXTURECONTAINER_H
+#define TEXTURECONTAINER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace bbl
+{
+class JobSystem;
+
+// .bbltex: ferdig bakte RGBA8 sRGB-teksturer med hele mip-kjeden, så lasting er én
+// fillesing og én kopi til GPU-en uten dekoding eller mip-generering. Lages av
+// TextureBaker fra bildene i Assets/Textures og ligger ved siden av kildebildet
+// (ball.jpg -> ball.bbltex).
+//
+// Filen er en header fulgt av nivåene tett etter hverandre fra nivå 0, samme pakking
+// som UploadQueue::copyToImage forventer. Native endian.
+struct TextureContainer
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t mipLevels = 0;
+    std::vector<unsigned char> data;   // Alle nivåer
+};
+
+// floor(log2(max(w, h))) + 1
+uint32_t mipLevelCount(uint32_t width, uint32_t height);
+
+// Bytes for nivå 0 til mipLevels - 1, 4 bytes per texel
+size_t mipChainSize(uint32_t width, uint32_t height, uint32_t mipLevels);
+
+// Hele kjeden fra et RGBA8 sRGB-bilde (nivå 0). Hvert nivå er 2x2-snittet av nivået over
+// i lineært rom. jobs kan være null, da kjøres det serielt.
+std::vector<unsigned char> buildMipChain(JobSystem* jobs, const unsigned char* pixels,
+                                         uint32_t width, uint32_t height, uint32_t mipLevels);
+
+std::string bakedTexturePath(const std::string& sourcePath);
+
+// Skriver via en midlertidig fil. False ved feil.
+bool saveTextureContainer(const std::string& path, const TextureContainer& texture);
+
+// False hvis filen mangler eller ikke er en gyldig .bbltex
+bool loadTextureContainer(const std::string& path, TextureContainer& texture);
+
+// Leser den bakte utgaven av sourcePath hvis den finnes og ikke er eldre enn kilden
+bool loadBakedTexture(const std::string& sourcePath, TextureContainer& texture);
+}
+
+#endif // TEXTURECONTAINER_H
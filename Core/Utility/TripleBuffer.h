@@ -0,0 +1,54 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace bbl
+{
+// Tre kopier av T delt mellom én skriver og én leser uten lås. Skriveren fyller back() og
+// kaller publish(), leseren kaller acquire() og leser front() frem til neste acquire().
+// Ingen av dem venter på den andre, og leseren får alltid den nyeste publiserte kopien;
+// kopier leseren ikke rakk å hente blir bare overskrevet.
+//
+// Kopiene gjenbrukes, så back() inneholder en gammel verdi etter publish() og må skrives
+// helt på nytt. Skal flere tråder skrive, må de holde samme lås rundt back()/publish().
+template <typename T>
+class TripleBuffer
+{
+public:
+    T& back() { return mBuffers[mBack]; }
+
+    void publish()
+    {
+        // Back blir den nye midten (merket som ny), den gamle midten blir neste back
+        uint8_t previous = mMiddle.exchange(static_cast<uint8_t>(mBack | kFresh), std::memory_order_acq_rel);
+        mBack = previous & kIndexMask;
+    }
+
+    // True hvis en nyere kopi ble hentet, ellers peker front() på samme kopi som før
+    bool acquire()
+    {
+        if ((mMiddle.load(std::memory_order_relaxed) & kFresh) == 0) {
+            return false;
+        }
+        uint8_t previous = mMiddle.exchange(mFront, std::memory_order_acq_rel);
+        mFront = previous & kIndexMask;
+        return true;
+    }
+
+    const T& front() const { return mBuffers[mFront]; }
+
+private:
+    static constexpr uint8_t kIndexMask = 0x3;
+    static constexpr uint8_t kFresh = 0x4;
+
+    std::array<T, 3> mBuffers{};
+    uint8_t mBack = 0;                // Bare skriveren
+    uint8_t mFront = 1;               // Bare leseren
+    std::atomic<uint8_t> mMiddle{2};  // Indeks og kFresh, byttes av begge
+};
+}
+
+#endif // TRIPLEBUFFER_H
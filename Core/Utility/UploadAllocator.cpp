@@ -0,0 +1,146 @@
+#include "UploadAllocator.h"
+#include <qdebug.h>
+#include <algorithm>
+#include <stdexcept>
+
+namespace bbl
+{
+UploadAllocator::UploadAllocator(VkDevice device,
+                                 const VkPhysicalDeviceLimits& limits,
+                                 const VkPhysicalDeviceMemoryProperties& memoryProperties,
+                                 uint32_t frameCount)
+    : mDevice(device)
+    , mLimits(limits)
+    , mMemoryProperties(memoryProperties)
+    , mFrames(frameCount)
+{
+}
+
+UploadAllocator::~UploadAllocator()
+{
+    cleanup();
+}
+
+void UploadAllocator::beginFrame(uint32_t frameIndex)
+{
+    mCurrentFrame = frameIndex;
+    mFrames[mCurrentFrame].offset = 0;
+}
+
+bool UploadAllocator::reserve(VkDeviceSize size)
+{
+    FrameBlock& block = mFrames[mCurrentFrame];
+    if (size <= block.capacity) {
+        return false;
+    }
+
+    // Dobler, så en scene som vokser litt hver frame ikke allokerer hver gang.
+    // Slotten er ledig (fencen er ventet på), så det gamle bufferet kan slettes med en gang.
+    VkDeviceSize newCapacity = std::max({size, block.capacity * 2, VkDeviceSize(64 * 1024)});
+    destroyBlock(block);
+    createBlock(block, newCapacity);
+
+    qDebug() << "Upload buffer for frame" << mCurrentFrame << "grown to" << newCapacity << "bytes";
+    return true;
+}
+
+UploadAllocator::Allocation UploadAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment)
+{
+    FrameBlock& block = mFrames[mCurrentFrame];
+
+    // Vulkan-grensene for offset-alignment er alltid potenser av to
+    alignment = std::max<VkDeviceSize>(alignment, 1);
+    VkDeviceSize offset = (block.offset + alignment - 1) & ~(alignment - 1);
+    if (offset + size > block.capacity) {
+        throw std::runtime_error("upload allocator is out of space, reserve() more for this frame!");
+    }
+    block.offset = offset + size;
+
+    Allocation allocation;
+    allocation.buffer = block.buffer;
+    allocation.offset = offset;
+    allocation.data = static_cast<char*>(block.mapped) + offset;
+    return allocation;
+}
+
+void UploadAllocator::cleanup()
+{
+    for (FrameBlock& block : mFrames) {
+        destroyBlock(block);
+    }
+}
+
+void UploadAllocator::createBlock(FrameBlock& block, VkDeviceSize capacity)
+{
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = capacity;
+    bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                       VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(mDevice, &bufferInfo, nullptr, &block.buffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create upload buffer!");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(mDevice, block.buffer, &memRequirements);
+
+    // Device-local + host-visible (ReBAR/UMA) der det finnes, ellers vanlig systemminne
+    uint32_t typeIndex = 0;
+    if (!findMemoryType(memRequirements.memoryTypeBits,
+                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                        typeIndex) &&
+        !findMemoryType(memRequirements.memoryTypeBits,
+                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                        typeIndex)) {
+        vkDestroyBuffer(mDevice, block.buffer, nullptr);
+        block.buffer = VK_NULL_HANDLE;
+        throw std::runtime_error("failed to find suitable memory type!");
+    }
+
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = typeIndex;
+
+    if (vkAllocateMemory(mDevice, &allocInfo, nullptr, &block.memory) != VK_SUCCESS) {
+        vkDestroyBuffer(mDevice, block.buffer, nullptr);
+        block.buffer = VK_NULL_HANDLE;
+        throw std::runtime_error("failed to allocate upload buffer memory!");
+    }
+
+    vkBindBufferMemory(mDevice, block.buffer, block.memory, 0);
+
+    // Mappes én gang og forblir mappet til bufferet slettes
+    vkMapMemory(mDevice, block.memory, 0, VK_WHOLE_SIZE, 0, &block.mapped);
+    block.capacity = capacity;
+    block.offset = 0;
+}
+
+void UploadAllocator::destroyBlock(FrameBlock& block)
+{
+    if (block.memory != VK_NULL_HANDLE) {
+        vkUnmapMemory(mDevice, block.memory);
+        vkFreeMemory(mDevice, block.memory, nullptr);
+    }
+    if (block.buffer != VK_NULL_HANDLE) {
+        vkDestroyBuffer(mDevice, block.buffer, nullptr);
+    }
+    block = FrameBlock{};
+}
+
+bool UploadAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties, uint32_t& typeIndex) const
+{
+    for (uint32_t i = 0; i < mMemoryProperties.memoryTypeCount; i++) {
+        if ((typeFilter & (1 << i)) &&
+            (mMemoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            typeIndex = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace bbl
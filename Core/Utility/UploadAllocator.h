@@ -0,0 +1,79 @@
+#ifndef UPLOADALLOCATOR_H
+#define UPLOADALLOCATOR_H
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <vector>
+
+namespace bbl
+{
+// Lineær allokator for data CPU-en skriver hver frame (UBO, instansdata, input til GPU-culling).
+// Ett persistent mappet, host-coherent buffer per frame in flight: allocate() flytter
+// bare en offset, og beginFrame() nullstiller den når fencen til slotten er ventet på.
+// Ingen vkMapMemory/vkUnmapMemory per frame, og ingen flush siden minnet er coherent.
+class UploadAllocator
+{
+public:
+    struct Allocation
+    {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;
+        void* data = nullptr;
+    };
+
+    // Grensene og minnetypene hentes én gang av Renderer ved oppstart
+    UploadAllocator(VkDevice device,
+                    const VkPhysicalDeviceLimits& limits,
+                    const VkPhysicalDeviceMemoryProperties& memoryProperties,
+                    uint32_t frameCount);
+    ~UploadAllocator();
+
+    UploadAllocator(const UploadAllocator&) = delete;
+    UploadAllocator& operator=(const UploadAllocator&) = delete;
+
+    // Velger slot og nullstiller den. Kalles etter vkWaitForFences for slotten.
+    void beginFrame(uint32_t frameIndex);
+
+    // Sørger for at slotten har plass til minst size bytes. Returnerer true hvis bufferet
+    // ble byttet ut, da må descriptor sets som peker på det skrives på nytt.
+    bool reserve(VkDeviceSize size);
+
+    // Kaster runtime_error hvis det ikke er plass, reserve() må dekke hele framen
+    Allocation allocate(VkDeviceSize size, VkDeviceSize alignment);
+    Allocation allocateUniform(VkDeviceSize size) { return allocate(size, mLimits.minUniformBufferOffsetAlignment); }
+    Allocation allocateVertex(VkDeviceSize size) { return allocate(size, 16); }
+    Allocation allocateStorage(VkDeviceSize size) { return allocate(size, mLimits.minStorageBufferOffsetAlignment); }
+
+    // Plass en allokering av size bytes kan ta, inkludert verste padding
+    VkDeviceSize uniformFootprint(VkDeviceSize size) const { return size + mLimits.minUniformBufferOffsetAlignment; }
+    VkDeviceSize vertexFootprint(VkDeviceSize size) const { return size + 16; }
+    VkDeviceSize storageFootprint(VkDeviceSize size) const { return size + mLimits.minStorageBufferOffsetAlignment; }
+
+    VkBuffer getBuffer() const { return mFrames[mCurrentFrame].buffer; }
+    VkDeviceSize getUsedBytes() const { return mFrames[mCurrentFrame].offset; }
+
+    void cleanup();
+
+private:
+    struct FrameBlock
+    {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        void* mapped = nullptr;
+        VkDeviceSize capacity = 0;
+        VkDeviceSize offset = 0;
+    };
+
+    VkDevice mDevice;
+    VkPhysicalDeviceLimits mLimits;
+    VkPhysicalDeviceMemoryProperties mMemoryProperties;
+    std::vector<FrameBlock> mFrames;
+    uint32_t mCurrentFrame = 0;
+
+    void createBlock(FrameBlock& block, VkDeviceSize capacity);
+    void destroyBlock(FrameBlock& block);
+    bool findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties, uint32_t& typeIndex) const;
+};
+}
+
+#endif // UPLOADALLOCATOR_H
@@ -0,0 +1,507 @@
+#include "UploadQueue.h"
+#include <qdebug.h>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace bbl
+{
+namespace
+{
+// Holder for buffer-til-image (texelstørrelse og komprimerte blokker) og vertex-data
+constexpr VkDeviceSize kStagingAlignment = 16;
+}
+
+UploadQueue::UploadQueue(VkDevice device, DeviceMemoryAllocator* allocator,
+                         VkQueue queue, uint32_t queueFamily, uint32_t graphicsFamily,
+                         VkDeviceSize stagingSize)
+    : mDevice(device)
+    , mAllocator(allocator)
+    , mQueue(queue)
+    , mQueueFamily(queueFamily)
+    , mGraphicsFamily(graphicsFamily)
+{
+    if (isDedicated()) {
+        mSharingFamilies = {mGraphicsFamily, mQueueFamily};
+    }
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = mQueueFamily;
+    // Command buffers gjenbrukes enkeltvis når batchen deres er ferdig
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+    if (vkCreateCommandPool(mDevice, &poolInfo, nullptr, &mCommandPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create upload command pool!");
+    }
+
+    if (isDedicated()) {
+        VkSemaphoreTypeCreateInfo typeInfo{};
+        typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        typeInfo.initialValue = 0;
+
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphoreInfo.pNext = &typeInfo;
+
+        if (vkCreateSemaphore(mDevice, &semaphoreInfo, nullptr, &mTimeline) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create upload timeline semaphore!");
+        }
+    }
+
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = stagingSize;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    mAllocator->createBuffer(bufferInfo,
+                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                             mRing.buffer, mRing.allocation);
+    mRingSize = stagingSize;
+
+    qDebug() << "UploadQueue:" << (isDedicated() ? "dedicated transfer queue" : "graphics queue")
+             << "staging ring" << (stagingSize >> 20) << "MB";
+}
+
+UploadQueue::~UploadQueue()
+{
+    cleanup();
+}
+
+UploadQueue::Ticket UploadQueue::copyToBuffer(const void* data, VkDeviceSize size,
+                                              VkBuffer dstBuffer, VkDeviceSize dstOffset)
+{
+    StagingSlice staging = allocateStaging(size);
+    memcpy(staging.mapped, data, static_cast<size_t>(size));
+
+    VkBufferCopy region{};
+    region.srcOffset = staging.offset;
+    region.dstOffset = dstOffset;
+    region.size = size;
+    vkCmdCopyBuffer(mOpen.commandBuffer, staging.buffer, dstBuffer, 1, &region);
+    return mOpen.ticket;
+}
+
+UploadQueue::Ticket UploadQueue::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
+{
+    Batch& batch = openBatch();
+
+    // Kilden kan være skrevet av en tidligere kopi på samme kø
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    VkBufferCopy region{};
+    region.size = size;
+    vkCmdCopyBuffer(batch.commandBuffer, srcBuffer, dstBuffer, 1, &region);
+
+    // Senere kopier i samme batch kan skrive inn i det kopierte området (f.eks. en ny mesh
+    // i ledig plass som var med i kopien), de må vente til denne kopien er ferdig
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+    return batch.ticket;
+}
+
+UploadQueue::Ticket UploadQueue::copyToImage(const void* data, VkDeviceSize size, VkImage image,
+                                             uint32_t width, uint32_t height,
+                                             uint32_t mipLevels, bool generateMips)
+{
+    if (generateMips && isDedicated()) {
+        throw std::runtime_error("UploadQueue: mip blits need a graphics queue!");
+    }
+
+    StagingSlice staging = allocateStaging(size);
+    memcpy(staging.mapped, data, static_cast<size_t>(size));
+    VkCommandBuffer commandBuffer = mOpen.commandBuffer;
+
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = mipLevels;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    // Uten generateMips ligger alle nivåene tett etter hverandre i data (RGBA8)
+    const uint32_t copiedLevels = generateMips ? 1 : mipLevels;
+    std::vector<VkBufferImageCopy> regions(copiedLevels);
+    VkDeviceSize levelOffset = staging.offset;
+    for (uint32_t level = 0; level < copiedLevels; ++level) {
+        uint32_t levelWidth = std::max(width >> level, 1u);
+        uint32_t levelHeight = std::max(height >> level, 1u);
+
+        VkBufferImageCopy& region = regions[level];
+        region.bufferOffset = levelOffset;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = level;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = {0, 0, 0};
+        region.imageExtent = {levelWidth, levelHeight, 1};
+        levelOffset += static_cast<VkDeviceSize>(levelWidth) * levelHeight * 4;
+    }
+    vkCmdCopyBufferToImage(commandBuffer, staging.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           static_cast<uint32_t>(regions.size()), regions.data());
+
+    barrier.subresourceRange.levelCount = 1;
+    uint32_t firstFinalLevel = 0;
+    if (generateMips) {
+        // Hvert nivå blittes fra nivået over, som så går rett til SHADER_READ_ONLY
+        int32_t srcWidth = static_cast<int32_t>(width);
+        int32_t srcHeight = static_cast<int32_t>(height);
+        for (uint32_t level = 1; level < mipLevels; ++level) {
+            int32_t dstWidth = std::max(srcWidth / 2, 1);
+            int32_t dstHeight = std::max(srcHeight / 2, 1);
+
+            barrier.subresourceRange.baseMipLevel = level - 1;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+            VkImageBlit blit{};
+            blit.srcOffsets[0] = {0, 0, 0};
+            blit.srcOffsets[1] = {srcWidth, srcHeight, 1};
+            blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            blit.srcSubresource.mipLevel = level - 1;
+            blit.srcSubresource.baseArrayLayer = 0;
+            blit.srcSubresource.layerCount = 1;
+            blit.dstOffsets[0] = {0, 0, 0};
+            blit.dstOffsets[1] = {dstWidth, dstHeight, 1};
+            blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            blit.dstSubresource.mipLevel = level;
+            blit.dstSubresource.baseArrayLayer = 0;
+            blit.dstSubresource.layerCount = 1;
+            vkCmdBlitImage(commandBuffer,
+                           image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           1, &blit, VK_FILTER_LINEAR);
+
+            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                                 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+            srcWidth = dstWidth;
+            srcHeight = dstHeight;
+        }
+        firstFinalLevel = mipLevels - 1;
+    }
+
+    // Resten (alle nivåer, eller bare det siste etter blits) står fortsatt i TRANSFER_DST.
+    // Transfer-køen kan ikke vente på fragment-steget; der sørger semaphoren Renderer
+    // venter på for synligheten.
+    barrier.subresourceRange.baseMipLevel = firstFinalLevel;
+    barrier.subresourceRange.levelCount = mipLevels - firstFinalLevel;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = isDedicated() ? 0 : VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         isDedicated() ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                         0, 0, nullptr, 0, nullptr, 1, &barrier);
+    return mOpen.ticket;
+}
+
+UploadQueue::Ticket UploadQueue::flush()
+{
+    if (!mRecording) {
+        return mLastSubmitted;
+    }
+
+    Batch& batch = mOpen;
+
+    // Samme kø som Renderer: senere submits ser kopiene gjennom denne barrieren
+    if (!isDedicated()) {
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+                                VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                                 VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+
+    if (vkEndCommandBuffer(batch.commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record upload command buffer!");
+    }
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &batch.commandBuffer;
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    if (mTimeline != VK_NULL_HANDLE) {
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfo.signalSemaphoreValueCount = 1;
+        timelineInfo.pSignalSemaphoreValues = &batch.ticket;
+        submitInfo.pNext = &timelineInfo;
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &mTimeline;
+    }
+
+    if (vkQueueSubmit(mQueue, 1, &submitInfo, batch.fence) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit uploads!");
+    }
+
+    mLastSubmitted = batch.ticket;
+    mInFlight.push_back(std::move(batch));
+    mOpen = Batch{};
+    mRecording = false;
+    return mLastSubmitted;
+}
+
+bool UploadQueue::isComplete(Ticket ticket)
+{
+    collect();
+    return ticket <= mCompleted;
+}
+
+void UploadQueue::wait(Ticket ticket)
+{
+    if (ticket > mLastSubmitted) {
+        flush();
+    }
+    while (mCompleted < ticket && !mInFlight.empty()) {
+        waitOldest();
+    }
+}
+
+void UploadQueue::waitIdle()
+{
+    flush();
+    while (!mInFlight.empty()) {
+        waitOldest();
+    }
+}
+
+void UploadQueue::collect()
+{
+    // Fencene signaliseres i submit-rekkefølge på én kø
+    while (!mInFlight.empty() && vkGetFenceStatus(mDevice, mInFlight.front().fence) == VK_SUCCESS) {
+        retire(mInFlight.front());
+        mInFlight.pop_front();
+    }
+}
+
+void UploadQueue::applySharing(VkBufferCreateInfo& info) const
+{
+    if (mSharingFamilies.size() > 1) {
+        info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        info.queueFamilyIndexCount = static_cast<uint32_t>(mSharingFamilies.size());
+        info.pQueueFamilyIndices = mSharingFamilies.data();
+    }
+}
+
+void UploadQueue::applySharing(VkImageCreateInfo& info) const
+{
+    if (mSharingFamilies.size() > 1) {
+        info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        info.queueFamilyIndexCount = static_cast<uint32_t>(mSharingFamilies.size());
+        info.pQueueFamilyIndices = mSharingFamilies.data();
+    }
+}
+
+void UploadQueue::cleanup()
+{
+    if (mCommandPool == VK_NULL_HANDLE) {
+        return;
+    }
+
+    waitIdle();
+
+    for (Batch& batch : mRecycled) {
+        vkDestroyFence(mDevice, batch.fence, nullptr);
+    }
+    mRecycled.clear();
+
+    // Command buffers frigjøres sammen med poolen
+    vkDestroyCommandPool(mDevice, mCommandPool, nullptr);
+    mCommandPool = VK_NULL_HANDLE;
+
+    if (mTimeline != VK_NULL_HANDLE) {
+        vkDestroySemaphore(mDevice, mTimeline, nullptr);
+        mTimeline = VK_NULL_HANDLE;
+    }
+
+    mAllocator->destroyBuffer(mRing.buffer, mRing.allocation);
+    mRingSize = 0;
+}
+
+UploadQueue::Batch& UploadQueue::openBatch()
+{
+    if (mRecording) {
+        return mOpen;
+    }
+
+    if (!mRecycled.empty()) {
+        mOpen.commandBuffer = mRecycled.back().commandBuffer;
+        mOpen.fence = mRecycled.back().fence;
+        mRecycled.pop_back();
+    } else {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = mCommandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+
+        if (vkAllocateCommandBuffers(mDevice, &allocInfo, &mOpen.commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate upload command buffer!");
+        }
+
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        if (vkCreateFence(mDevice, &fenceInfo, nullptr, &mOpen.fence) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create upload fence!");
+        }
+    }
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    if (vkBeginCommandBuffer(mOpen.commandBuffer, &beginInfo) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin upload command buffer!");
+    }
+
+    mOpen.ticket = mNextTicket++;
+    mRecording = true;
+    return mOpen;
+}
+
+UploadQueue::StagingSlice UploadQueue::allocateStaging(VkDeviceSize size)
+{
+    VkDeviceSize offset = 0;
+    bool allocated = false;
+    if (size <= mRingSize) {
+        allocated = tryAllocateRing(size, offset);
+
+        // Full ring: vent på den eldste batchen. Er det bare den åpne som holder plass,
+        // sendes den først.
+        while (!allocated && (mRecording || !mInFlight.empty())) {
+            if (mInFlight.empty()) {
+                flush();
+            }
+            waitOldest();
+            allocated = tryAllocateRing(size, offset);
+        }
+    }
+
+    Batch& batch = openBatch();
+    StagingSlice slice;
+
+    if (allocated) {
+        if (!batch.usesRing) {
+            batch.usesRing = true;
+            ++mRingUsers;
+        }
+        mHead = offset + size;
+        batch.ringEnd = mHead;
+
+        slice.buffer = mRing.buffer;
+        slice.offset = offset;
+        slice.mapped = static_cast<char*>(mRing.allocation.mapped) + offset;
+        return slice;
+    }
+
+    // Større enn hele ringen: eget buffer som slettes når batchen er ferdig
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    StagingBuffer staging;
+    mAllocator->createBuffer(bufferInfo,
+                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                             staging.buffer, staging.allocation);
+    batch.dedicatedStaging.push_back(staging);
+
+    slice.buffer = staging.buffer;
+    slice.offset = 0;
+    slice.mapped = staging.allocation.mapped;
+    return slice;
+}
+
+bool UploadQueue::tryAllocateRing(VkDeviceSize size, VkDeviceSize& offset)
+{
+    bool empty = mRingUsers == 0;
+    if (empty) {
+        mHead = 0;
+        mTail = 0;
+    }
+
+    VkDeviceSize aligned = (mHead + kStagingAlignment - 1) & ~(kStagingAlignment - 1);
+    if (empty || mHead > mTail) {
+        // Ledig er [head, slutt) og [0, tail)
+        if (aligned + size <= mRingSize) {
+            offset = aligned;
+            return true;
+        }
+        if (size <= mTail) {
+            offset = 0;
+            return true;
+        }
+        return false;
+    }
+
+    // Head har gått rundt (eller ringen er full): ledig er [head, tail)
+    if (aligned + size <= mTail) {
+        offset = aligned;
+        return true;
+    }
+    return false;
+}
+
+void UploadQueue::waitOldest()
+{
+    Batch& batch = mInFlight.front();
+    vkWaitForFences(mDevice, 1, &batch.fence, VK_TRUE, UINT64_MAX);
+    retire(batch);
+    mInFlight.pop_front();
+}
+
+void UploadQueue::retire(Batch& batch)
+{
+    mCompleted = batch.ticket;
+
+    if (batch.usesRing) {
+        mTail = batch.ringEnd;
+        --mRingUsers;
+    }
+    for (StagingBuffer& staging : batch.dedicatedStaging) {
+        mAllocator->destroyBuffer(staging.buffer, staging.allocation);
+    }
+
+    vkResetFences(mDevice, 1, &batch.fence);
+    Batch recycled;
+    recycled.commandBuffer = batch.commandBuffer;
+    recycled.fence = batch.fence;
+    mRecycled.push_back(recycled);
+}
+
+} // namespace bbl
@@ -0,0 +1,136 @@
+#ifndef UPLOADQUEUE_H
+#define UPLOADQUEUE_H
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include "DeviceMemoryAllocator.h"
+
+namespace bbl
+{
+// Asynkron opplasting av mesher og teksturer. Data kopieres inn i en staging-ring (ett
+// persistent mappet buffer) med en gang, og kopieringene samles i ett command buffer som
+// sendes med flush(). Ingen vkQueueWaitIdle: hver submit har en fence, og kalleren får en
+// ticket som kan polles med isComplete() eller ventes på med wait().
+//
+// Har enheten en egen transfer-kø (og timeline semaphores) brukes den. Hver submit
+// signaliserer da timeline-semaphoren med ticketen, og Renderer venter på siste ticket i
+// sin egen submit. Ressurser som lastes opp må i så fall lages med applySharing().
+//
+// Ikke trådsikker. Brukes fra GUI-, simulerings- og rendertråden, så alle kall må skje
+// med Renderer::gpuMutex holdt, samme regel som for GPUResourceManager.
+class UploadQueue
+{
+public:
+    using Ticket = uint64_t;
+
+    UploadQueue(VkDevice device, DeviceMemoryAllocator* allocator,
+                VkQueue queue, uint32_t queueFamily, uint32_t graphicsFamily,
+                VkDeviceSize stagingSize = 32ull * 1024 * 1024);
+    ~UploadQueue();
+
+    UploadQueue(const UploadQueue&) = delete;
+    UploadQueue& operator=(const UploadQueue&) = delete;
+
+    // Dataene kopieres til staging nå, så kalleren kan frigjøre dem med en gang.
+    // Returnerer ticketen til batchen kopien havner i.
+    Ticket copyToBuffer(const void* data, VkDeviceSize size, VkBuffer dstBuffer, VkDeviceSize dstOffset);
+
+    // Device til device, f.eks. når en GeometryArena vokser
+    Ticket copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+
+    // RGBA8-bilde fra UNDEFINED til SHADER_READ_ONLY_OPTIMAL. data har alle mipLevels nivåer
+    // tett etter hverandre, eller bare nivå 0 med generateMips: da blittes resten på GPU-en,
+    // noe som krever grafikk-køen (ikke isDedicated()) og TRANSFER_SRC på bildet.
+    Ticket copyToImage(const void* data, VkDeviceSize size, VkImage image, uint32_t width, uint32_t height,
+                       uint32_t mipLevels = 1, bool generateMips = false);
+
+    // Sender det som er tatt opp. Returnerer siste sendte ticket, også når ingenting var åpent.
+    Ticket flush();
+
+    // Ticketen til batchen som tas opp nå, eller siste sendte hvis ingen er åpen
+    Ticket getRecordingTicket() const { return mRecording ? mOpen.ticket : mLastSubmitted; }
+    Ticket getLastSubmittedTicket() const { return mLastSubmitted; }
+
+    // Ikke-blokkerende; frigjør samtidig ferdige batcher
+    bool isComplete(Ticket ticket);
+    // Sender batchen hvis ticketen ikke er sendt ennå, og venter på fencen
+    void wait(Ticket ticket);
+    void waitIdle();
+
+    // Gir tilbake ring-plass, fences og store staging-buffere fra ferdige batcher
+    void collect();
+
+    bool isDedicated() const { return mQueueFamily != mGraphicsFamily; }
+
+    // VK_NULL_HANDLE uten egen transfer-kø, da holder rekkefølgen på grafikk-køen
+    VkSemaphore getTimelineSemaphore() const { return mTimeline; }
+
+    // CONCURRENT mellom transfer- og grafikk-køen når de er forskjellige, slik at ingen
+    // ownership transfer trengs
+    void applySharing(VkBufferCreateInfo& info) const;
+    void applySharing(VkImageCreateInfo& info) const;
+    const std::vector<uint32_t>& getSharingFamilies() const { return mSharingFamilies; }
+
+    void cleanup();
+
+private:
+    struct StagingBuffer
+    {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        DeviceAllocation allocation;
+    };
+
+    struct Batch
+    {
+        Ticket ticket = 0;
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+        bool usesRing = false;
+        VkDeviceSize ringEnd = 0;                      // Ringens head etter siste kopi
+        std::vector<StagingBuffer> dedicatedStaging;   // For kopier større enn ringen
+    };
+
+    struct StagingSlice
+    {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;
+        void* mapped = nullptr;
+    };
+
+    VkDevice mDevice;
+    DeviceMemoryAllocator* mAllocator;
+    VkQueue mQueue;
+    uint32_t mQueueFamily;
+    uint32_t mGraphicsFamily;
+    std::vector<uint32_t> mSharingFamilies;
+
+    VkCommandPool mCommandPool = VK_NULL_HANDLE;
+    VkSemaphore mTimeline = VK_NULL_HANDLE;
+
+    // Ringen: [tail, head) er i bruk av batcher som ikke er ferdige, head kan ha gått rundt
+    StagingBuffer mRing;
+    VkDeviceSize mRingSize = 0;
+    VkDeviceSize mHead = 0;
+    VkDeviceSize mTail = 0;
+    uint32_t mRingUsers = 0;   // Batcher med plass i ringen
+
+    Batch mOpen;
+    bool mRecording = false;
+    std::deque<Batch> mInFlight;   // Sendt, i rekkefølge
+    std::vector<Batch> mRecycled;  // Command buffer og fence til gjenbruk
+
+    Ticket mNextTicket = 1;
+    Ticket mLastSubmitted = 0;
+    Ticket mCompleted = 0;
+
+    Batch& openBatch();
+    StagingSlice allocateStaging(VkDeviceSize size);
+    bool tryAllocateRing(VkDeviceSize size, VkDeviceSize& offset);
+    void waitOldest();
+    void retire(Batch& batch);
+};
+}
+
+#endif // UPLOADQUEUE_H
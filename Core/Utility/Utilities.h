@@ -21,7 +21,9 @@ const std::string PATH = "../../";  //"../../../"; if using Visual Studio
 const std::string MODEL_PATH = PATH + "Assets/Models/viking_room.obj";
 const std::string TEXTURE_PATH = PATH + "Assets/Textures/viking_room.png";
 
-const int MAX_FRAMES_IN_FLIGHT = 2;
+// Øvre grense; antallet som brukes velges med Renderer::setFramesInFlight()
+const int MAX_FRAMES_IN_FLIGHT = 3;
+const int DEFAULT_FRAMES_IN_FLIGHT = 2;
 
 const std::vector<const char*> validationLayers = { "VK_LAYER_KHRONOS_validation" };
 
@@ -52,6 +54,7 @@ void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT
 struct QueueFamilyIndices {
     std::optional<uint32_t> graphicsFamily;
     std::optional<uint32_t> presentFamily;
+    std::optional<uint32_t> transferFamily;   // Egen transfer-familie uten grafikk, valgfri
 
     bool isComplete() {
         return graphicsFamily.has_value() && presentFamily.has_value();
@@ -72,9 +75,9 @@ template<> struct hash<Vertex> {
 };
 }
 
+// Felles for hele framen. Model-matrisene ligger i instance-bufferet (InstanceData).
 struct UniformBufferObject
 {
-    alignas(16) glm::mat4 model;
     alignas(16) glm::mat4 view;
     alignas(16) glm::mat4 proj;
     alignas(16) glm::vec3 lightPos;
@@ -51,4 +51,41 @@ struct Vertex {
     }
 };
 
+// Per-instans data for instanced tegning, leses fra binding 1 med input rate INSTANCE.
+// model bruker lokasjon 4-7, normalMatrix 8-10 (mat3-kolonner utvidet til vec4,
+// w brukes ikke). 112 bytes per objekt.
+struct InstanceData {
+    glm::mat4 model;
+    glm::vec4 normalMatrix[3];
+
+    static VkVertexInputBindingDescription getBindingDescription() {
+        VkVertexInputBindingDescription bindingDescription{};
+        bindingDescription.binding = 1;
+        bindingDescription.stride = sizeof(InstanceData);
+        bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+        return bindingDescription;
+    }
+
+    static std::array<VkVertexInputAttributeDescription, 7> getAttributeDescriptions() {
+        std::array<VkVertexInputAttributeDescription, 7> attributeDescriptions{};
+
+        for (uint32_t column = 0; column < 4; ++column) {
+            attributeDescriptions[column].binding = 1;
+            attributeDescriptions[column].location = 4 + column;
+            attributeDescriptions[column].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+            attributeDescriptions[column].offset = offsetof(InstanceData, model) + sizeof(glm::vec4) * column;
+        }
+
+        for (uint32_t column = 0; column < 3; ++column) {
+            attributeDescriptions[4 + column].binding = 1;
+            attributeDescriptions[4 + column].location = 8 + column;
+            attributeDescriptions[4 + column].format = VK_FORMAT_R32G32B32_SFLOAT;
+            attributeDescriptions[4 + column].offset = offsetof(InstanceData, normalMatrix) + sizeof(glm::vec4) * column;
+        }
+
+        return attributeDescriptions;
+    }
+};
+
 #endif // VERTEX_H
@@ -5,18 +5,46 @@
 #include <qdebug.h>
 #include <cstring>
 #include <stdexcept>
+#include <algorithm>
+#include <cmath>
+#include "JobSystem.h"
+#include "BblHub.h"
+#include "TextureContainer.h"
+
+namespace
+{
+constexpr VkFormat kTextureFormat = VK_FORMAT_R8G8B8A8_SRGB;
+}
 
 namespace bbl
 {
 GPUResourceManager::GPUResourceManager(VkDevice device,
                                  VkPhysicalDevice physicalDevice,
-                                 VkCommandPool commandPool,
-                                 VkQueue graphicsQueue)
+                                 UploadQueue* uploads,
+                                 DeviceMemoryAllocator* allocator)
     : mDevice(device)
     , mPhysicalDevice(physicalDevice)
-    , mCommandPool(commandPool)
-    , mGraphicsQueue(graphicsQueue)
+    , mUploads(uploads)
+    , mAllocator(allocator)
 {
+    // Grensene endrer seg ikke, hentes én gang i stedet for per tekstur
+    vkGetPhysicalDeviceProperties(mPhysicalDevice, &mDeviceProperties);
+
+    // Blit trenger grafikk-køen; en egen transfer-kø kan bare kopiere
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(mPhysicalDevice, kTextureFormat, &formatProperties);
+    const VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                                              VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    mBlitMipmaps = !mUploads->isDedicated() &&
+                   (formatProperties.optimalTilingFeatures & blitFeatures) == blitFeatures;
+    qDebug() << "GPUResourceManager: texture mips generated on" << (mBlitMipmaps ? "GPU" : "CPU");
+
+    mVertexArena = std::make_unique<GeometryArena>(mDevice, mAllocator, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                                                   sizeof(Vertex));
+    mIndexArena = std::make_unique<GeometryArena>(mDevice, mAllocator, VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                                                  sizeof(uint32_t));
+    mVertexArena->setQueueFamilies(mUploads->getSharingFamilies());
+    mIndexArena->setQueueFamilies(mUploads->getSharingFamilies());
 }
 
 GPUResourceManager::~GPUResourceManager()
@@ -32,24 +60,68 @@ GPUResourceManager::MeshResourceID GPUResourceManager::uploadMesh(const MeshData
         return 0;
     }
 
+    // Samme geometri (f.eks. hundre baller fra Ball2.obj) deler ett sett buffere,
+    // så Renderer kan tegne dem som instanser av samme mesh
+    uint64_t contentKey = hashMeshContent(meshData);
+    bool cacheable = true;
+    auto cacheIt = mMeshContentCache.find(contentKey);
+    if (cacheIt != mMeshContentCache.end()) {
+        if (sameMeshContent(cacheIt->second, meshData)) {
+            ++mMeshRefCounts[cacheIt->second.id];
+            return cacheIt->second.id;
+        }
+        // Hash-kollisjon: lastes opp som egen mesh, men havner ikke i cachen
+        qWarning() << "uploadMesh: content hash collision with mesh" << cacheIt->second.id
+                   << ", uploading without sharing";
+        cacheable = false;
+    }
+
     auto meshResources = std::make_unique<MeshGPUResources>();
 
-    // Create vertex buffer
-    createVertexBuffer(meshData.vertices,
-                       meshResources->vertexBuffer,
-                       meshResources->vertexBufferMemory);
+    if (mUseGeometryArena) {
+        uploadToGeometryArena(meshData, *meshResources);
+    } else {
+        // Create vertex buffer
+        createVertexBuffer(meshData.vertices,
+                           meshResources->vertexBuffer,
+                           meshResources->vertexAllocation);
 
-    // Create index buffer
-    createIndexBuffer(meshData.indices,
-                      meshResources->indexBuffer,
-                      meshResources->indexBufferMemory);
+        // Create index buffer
+        createIndexBuffer(meshData.indices,
+                          meshResources->indexBuffer,
+                          meshResources->indexAllocation);
+    }
 
     meshResources->vertexCount = meshData.vertices.size();
     meshResources->indexCount = meshData.indices.size();
+    meshResources->uploadTicket = mUploads->getRecordingTicket();
+
+    // AABB og omsluttende kule rundt AABB-senteret, i meshets eget rom
+    glm::vec3 boundsMin = meshData.vertices[0].pos;
+    glm::vec3 boundsMax = meshData.vertices[0].pos;
+    for (const Vertex& vertex : meshData.vertices) {
+        boundsMin = glm::min(boundsMin, vertex.pos);
+        boundsMax = glm::max(boundsMax, vertex.pos);
+    }
+    glm::vec3 boundsCenter = (boundsMin + boundsMax) * 0.5f;
+    float radiusSquared = 0.0f;
+    for (const Vertex& vertex : meshData.vertices) {
+        glm::vec3 offset = vertex.pos - boundsCenter;
+        radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+    }
+    meshResources->boundsMin = boundsMin;
+    meshResources->boundsMax = boundsMax;
+    meshResources->boundsCenter = boundsCenter;
+    meshResources->boundsRadius = std::sqrt(radiusSquared);
 
     // Generate unique ID and store
     MeshResourceID id = mNextMeshID++;
     mMeshResources[id] = std::move(meshResources);
+    mMeshRefCounts[id] = 1;
+    if (cacheable) {
+        mMeshContentCache[contentKey] = CachedMeshContent{id, meshData.vertices, meshData.indices};
+        mMeshContentKeys[id] = contentKey;
+    }
 
     qDebug() << "Uploaded mesh with ID:" << id
              << "Vertices:" << meshData.vertices.size()
@@ -64,28 +136,115 @@ GPUResourceManager::TextureResourceID GPUResourceManager::uploadTexture(const st
     auto cacheIt = mTexturePathCache.find(texturePath);
     if (cacheIt != mTexturePathCache.end()) {
         qDebug() << "Texture already loaded, returning cached ID:" << cacheIt->second;
+        ++mTextureRefCounts[cacheIt->second];
         return cacheIt->second;
     }
 
+    // Bakt .bbltex ved siden av bildet slipper dekoding og mip-generering
+    TextureResourceID id;
+    TextureContainer baked;
+    if (loadBakedTexture(texturePath, baked)) {
+        id = storeTexture(texturePath, baked.data.data(), static_cast<int>(baked.width),
+                          static_cast<int>(baked.height), baked.mipLevels);
+    } else {
+        int texWidth = 0, texHeight = 0, texChannels = 0;
+        stbi_uc* pixels = stbi_load(texturePath.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+        std::unique_ptr<stbi_uc, void (*)(void*)> pixelGuard(pixels, stbi_image_free);
+        id = storeTexture(texturePath, pixels, texWidth, texHeight);
+    }
+    ++mTextureRefCounts[id];
+    return id;
+}
+
+void GPUResourceManager::preloadTextures(const std::vector<std::string>& texturePaths)
+{
+    struct DecodedTexture
+    {
+        std::string path;
+        stbi_uc* pixels = nullptr;
+        int width = 0;
+        int height = 0;
+        TextureContainer baked;   // Brukes når mipLevels > 0
+    };
+
+    std::vector<DecodedTexture> decoded;
+    for (const std::string& path : texturePaths) {
+        if (path.empty() || mTexturePathCache.count(path)) {
+            continue;
+        }
+        bool duplicate = std::any_of(decoded.begin(), decoded.end(),
+                                     [&](const DecodedTexture& t) { return t.path == path; });
+        if (!duplicate) {
+            decoded.push_back({path});
+        }
+    }
+
+    if (decoded.empty()) {
+        return;
+    }
+
+    // Filinnlesing og dekoding er det trege, Vulkan-kallene gjøres etterpå på denne tråden
+    parallelFor(BBLHub::Instance().getJobSystem(), 0, decoded.size(), 1, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            if (loadBakedTexture(decoded[i].path, decoded[i].baked)) {
+                continue;
+            }
+            int channels = 0;
+            decoded[i].pixels = stbi_load(decoded[i].path.c_str(), &decoded[i].width, &decoded[i].height,
+                                          &channels, STBI_rgb_alpha);
+        }
+    });
+
+    // Eierskap til alle pikslene før første Vulkan-kall, så et kast ikke lekker resten
+    std::vector<std::unique_ptr<stbi_uc, void (*)(void*)>> pixelGuards;
+    pixelGuards.reserve(decoded.size());
+    for (DecodedTexture& texture : decoded) {
+        pixelGuards.emplace_back(texture.pixels, stbi_image_free);
+    }
+
+    for (const DecodedTexture& texture : decoded) {
+        if (texture.baked.mipLevels > 0) {
+            storeTexture(texture.path, texture.baked.data.data(), static_cast<int>(texture.baked.width),
+                         static_cast<int>(texture.baked.height), texture.baked.mipLevels);
+        } else {
+            storeTexture(texture.path, texture.pixels, texture.width, texture.height);
+        }
+    }
+
+    qDebug() << "Preloaded" << decoded.size() << "textures";
+}
+
+GPUResourceManager::TextureResourceID GPUResourceManager::storeTexture(const std::string& texturePath,
+                                                                       const unsigned char* pixels,
+                                                                       int texWidth, int texHeight,
+                                                                       uint32_t bakedMipLevels)
+{
     auto textureResources = std::make_unique<TextureGPUResources>();
 
     // Create texture image
-    createTextureImage(texturePath,
+    createTextureImage(pixels, texWidth, texHeight, bakedMipLevels,
                        textureResources->textureImage,
-                       textureResources->textureImageMemory);
+                       textureResources->textureAllocation,
+                       textureResources->mipLevels);
 
     if (textureResources->textureImage != VK_NULL_HANDLE) {
         // Create image view
-        createTextureImageView(textureResources->textureImage,
+        createTextureImageView(textureResources->textureImage, textureResources->mipLevels,
                                textureResources->textureImageView);
 
         // Create sampler
-        createTextureSampler(textureResources->textureSampler);
+        createTextureSampler(textureResources->mipLevels, textureResources->textureSampler);
+        textureResources->uploadTicket = mUploads->getRecordingTicket();
+    } else {
+        qDebug() << "createTextureImage: Failed to load texture or invalid dimensions for"
+                 << texturePath.c_str();
     }
 
-    // Generate unique ID and store
+    // Generate unique ID and store. Referansene telles av uploadTexture(), preloadede
+    // teksturer har ingen eier før noen ber om dem.
     TextureResourceID id = mNextTextureID++;
     mTextureResources[id] = std::move(textureResources);
+    mTextureRefCounts[id] = 0;
 
     // Cache the path
     mTexturePathCache[texturePath] = id;
@@ -113,25 +272,56 @@ const TextureGPUResources* GPUResourceManager::getTextureResources(TextureResour
     return nullptr;
 }
 
+bool GPUResourceManager::isMeshReady(MeshResourceID id)
+{
+    const MeshGPUResources* resources = getMeshResources(id);
+    return resources && mUploads->isComplete(resources->uploadTicket);
+}
+
+bool GPUResourceManager::isTextureReady(TextureResourceID id)
+{
+    const TextureGPUResources* resources = getTextureResources(id);
+    return resources && mUploads->isComplete(resources->uploadTicket);
+}
+
+void GPUResourceManager::retainMeshResources(MeshResourceID id)
+{
+    if (mMeshResources.count(id)) {
+        ++mMeshRefCounts[id];
+    }
+}
+
+void GPUResourceManager::retainTextureResources(TextureResourceID id)
+{
+    if (mTextureResources.count(id)) {
+        ++mTextureRefCounts[id];
+    }
+}
+
 void GPUResourceManager::releaseMeshResources(MeshResourceID id)
 {
     auto it = mMeshResources.find(id);
     if (it != mMeshResources.end()) {
-        auto& resources = it->second;
-
-        if (resources->indexBuffer != VK_NULL_HANDLE) {
-            vkDestroyBuffer(mDevice, resources->indexBuffer, nullptr);
-        }
-        if (resources->indexBufferMemory != VK_NULL_HANDLE) {
-            vkFreeMemory(mDevice, resources->indexBufferMemory, nullptr);
+        uint32_t& refs = mMeshRefCounts[id];
+        if (refs > 1) {
+            --refs;
+            return;
         }
-        if (resources->vertexBuffer != VK_NULL_HANDLE) {
-            vkDestroyBuffer(mDevice, resources->vertexBuffer, nullptr);
-        }
-        if (resources->vertexBufferMemory != VK_NULL_HANDLE) {
-            vkFreeMemory(mDevice, resources->vertexBufferMemory, nullptr);
+        mMeshRefCounts.erase(id);
+
+        auto keyIt = mMeshContentKeys.find(id);
+        if (keyIt != mMeshContentKeys.end()) {
+            mMeshContentCache.erase(keyIt->second);
+            mMeshContentKeys.erase(keyIt);
         }
 
+        // Frames som fortsatt er på GPU-en kan bruke bufferne, slettes i advanceFrame()
+        PendingRelease release;
+        release.retireFrame = mFrameIndex + mFramesInFlight;
+        release.uploadTicket = it->second->uploadTicket;
+        release.mesh = std::move(it->second);
+        mPendingReleases.push_back(std::move(release));
+
         mMeshResources.erase(it);
         qDebug() << "Released mesh resources for ID:" << id;
     }
@@ -141,20 +331,18 @@ void GPUResourceManager::releaseTextureResources(TextureResourceID id)
 {
     auto it = mTextureResources.find(id);
     if (it != mTextureResources.end()) {
-        auto& resources = it->second;
-
-        if (resources->textureSampler != VK_NULL_HANDLE) {
-            vkDestroySampler(mDevice, resources->textureSampler, nullptr);
-        }
-        if (resources->textureImageView != VK_NULL_HANDLE) {
-            vkDestroyImageView(mDevice, resources->textureImageView, nullptr);
-        }
-        if (resources->textureImage != VK_NULL_HANDLE) {
-            vkDestroyImage(mDevice, resources->textureImage, nullptr);
-        }
-        if (resources->textureImageMemory != VK_NULL_HANDLE) {
-            vkFreeMemory(mDevice, resources->textureImageMemory, nullptr);
+        uint32_t& refs = mTextureRefCounts[id];
+        if (refs > 1) {
+            --refs;
+            return;
         }
+        mTextureRefCounts.erase(id);
+
+        PendingRelease release;
+        release.retireFrame = mFrameIndex + mFramesInFlight;
+        release.uploadTicket = it->second->uploadTicket;
+        release.texture = std::move(it->second);
+        mPendingReleases.push_back(std::move(release));
 
         // Remove from cache
         for (auto cacheIt = mTexturePathCache.begin(); cacheIt != mTexturePathCache.end(); ++cacheIt) {
@@ -169,312 +357,277 @@ void GPUResourceManager::releaseTextureResources(TextureResourceID id)
     }
 }
 
-void GPUResourceManager::cleanup()
+void GPUResourceManager::advanceFrame()
 {
-    //std::cout << "GPUResourceManager::cleanup() called" << std::endl;
-    //std::cout << "Mesh resources count: " << mMeshResources.size() << std::endl;
-    //std::cout << "Texture resources count: " << mTextureResources.size() << std::endl;
-
-    // Clean up all mesh resources
-    for (auto& pair : mMeshResources) {
-        auto& resources = pair.second;
-        //std::cout << "Cleaning up mesh ID: " << pair.first << std::endl;
-
-        if (resources->indexBuffer != VK_NULL_HANDLE) {
-            vkDestroyBuffer(mDevice, resources->indexBuffer, nullptr);
-            //std::cout << "  Destroyed index buffer" << std::endl;
-        }
-        if (resources->indexBufferMemory != VK_NULL_HANDLE) {
-            vkFreeMemory(mDevice, resources->indexBufferMemory, nullptr);
-            //std::cout << "  Freed index buffer memory" << std::endl;
-        }
-        if (resources->vertexBuffer != VK_NULL_HANDLE) {
-            vkDestroyBuffer(mDevice, resources->vertexBuffer, nullptr);
-            //std::cout << "  Destroyed vertex buffer" << std::endl;
-        }
-        if (resources->vertexBufferMemory != VK_NULL_HANDLE) {
-            vkFreeMemory(mDevice, resources->vertexBufferMemory, nullptr);
-           // std::cout << "  Freed vertex buffer memory" << std::endl;
-        }
-    }
-    mMeshResources.clear();
-
-    //Clean up all texture resources
-    for (auto& pair : mTextureResources) {
-        auto& resources = pair.second;
-        //std::cout << "Cleaning up texture ID: " << pair.first << std::endl;
+    ++mFrameIndex;
+    mUploads->collect();
+
+    // Både framene og kopieringene som kan ha brukt ressursen må være ferdige
+    auto retired = std::stable_partition(mPendingReleases.begin(), mPendingReleases.end(),
+                                         [this](const PendingRelease& release) {
+                                             return release.retireFrame > mFrameIndex ||
+                                                    !mUploads->isComplete(release.uploadTicket);
+                                         });
+    for (auto it = retired; it != mPendingReleases.end(); ++it) {
+        destroyPendingRelease(*it);
+    }
+    mPendingReleases.erase(retired, mPendingReleases.end());
+}
 
-        if (resources->textureSampler != VK_NULL_HANDLE) {
-            vkDestroySampler(mDevice, resources->textureSampler, nullptr);
-            //std::cout << "  Destroyed sampler" << std::endl;
-        }
-        if (resources->textureImageView != VK_NULL_HANDLE) {
-            vkDestroyImageView(mDevice, resources->textureImageView, nullptr);
-            //std::cout << "  Destroyed image view" << std::endl;
-        }
-        if (resources->textureImage != VK_NULL_HANDLE) {
-            vkDestroyImage(mDevice, resources->textureImage, nullptr);
-            //std::cout << "  Destroyed image" << std::endl;  // THIS IS IMPORTANT
+uint64_t GPUResourceManager::hashMeshContent(const MeshData& meshData)
+{
+    // FNV-1a over antallene og vertex- og indeksbytene, 8 byte om gangen. Ulike mesher
+    // kan likevel gi samme hash, så et treff sjekkes med sameMeshContent().
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        size_t i = 0;
+        for (; i + 8 <= size; i += 8) {
+            uint64_t word;
+            std::memcpy(&word, bytes + i, 8);
+            hash = (hash ^ word) * 1099511628211ull;
         }
-        if (resources->textureImageMemory != VK_NULL_HANDLE) {
-            vkFreeMemory(mDevice, resources->textureImageMemory, nullptr);
-            //std::cout << "  Freed image memory" << std::endl;  // THIS IS IMPORTANT
+        for (; i < size; ++i) {
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
         }
-    }
+    };
 
-    //std::cout << "GPUResourceManager cleanup complete" << std::endl;
+    uint64_t counts[2] = {meshData.vertices.size(), meshData.indices.size()};
+    mix(counts, sizeof(counts));
+    mix(meshData.vertices.data(), meshData.vertices.size() * sizeof(Vertex));
+    mix(meshData.indices.data(), meshData.indices.size() * sizeof(uint32_t));
+    return hash;
 }
 
-// ============= Vulkan Helper Functions (moved from ModelLoader) =============
-
-void GPUResourceManager::createVertexBuffer(const std::vector<Vertex>& vertices,
-                                         VkBuffer& buffer,
-                                         VkDeviceMemory& memory)
+bool GPUResourceManager::sameMeshContent(const CachedMeshContent& cached, const MeshData& meshData)
 {
-    if (vertices.empty()) {
-        qDebug() << "createVertexBuffer: empty vertex array, skipping buffer creation.";
-        buffer = VK_NULL_HANDLE;
-        memory = VK_NULL_HANDLE;
-        return;
-    }
+    // Samme bytes som hashen leser, så memcmp gir samme svar som en hash uten kollisjoner
+    return cached.vertices.size() == meshData.vertices.size()
+           && cached.indices.size() == meshData.indices.size()
+           && std::memcmp(cached.vertices.data(), meshData.vertices.data(),
+                          meshData.vertices.size() * sizeof(Vertex)) == 0
+           && std::memcmp(cached.indices.data(), meshData.indices.data(),
+                          meshData.indices.size() * sizeof(uint32_t)) == 0;
+}
 
-    VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
-    if (bufferSize == 0) {
-        qDebug() << "createVertexBuffer: computed bufferSize == 0, skipping.";
-        buffer = VK_NULL_HANDLE;
-        memory = VK_NULL_HANDLE;
+void GPUResourceManager::destroyMesh(MeshGPUResources& resources)
+{
+    if (resources.inGeometryArena) {
+        // Bufferne eies av arenaen, bare rekkene gis tilbake
+        mVertexArena->free(static_cast<uint32_t>(resources.vertexOffset));
+        mIndexArena->free(resources.firstIndex);
+        resources.vertexBuffer = VK_NULL_HANDLE;
+        resources.indexBuffer = VK_NULL_HANDLE;
         return;
     }
 
-    qDebug() << "createVertexBuffer: bufferSize =" << static_cast<qulonglong>(bufferSize);
-
-    // Create staging buffer
-    VkBuffer stagingBuffer = VK_NULL_HANDLE;
-    VkDeviceMemory stagingBufferMemory = VK_NULL_HANDLE;
-    VkBufferCreateInfo bufferInfo{};
-    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferInfo.size = bufferSize;
-    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    mAllocator->destroyBuffer(resources.indexBuffer, resources.indexAllocation);
+    mAllocator->destroyBuffer(resources.vertexBuffer, resources.vertexAllocation);
+}
 
-    if (vkCreateBuffer(mDevice, &bufferInfo, nullptr, &stagingBuffer) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create staging buffer!");
+void GPUResourceManager::destroyTexture(TextureGPUResources& resources)
+{
+    if (resources.textureSampler != VK_NULL_HANDLE) {
+        vkDestroySampler(mDevice, resources.textureSampler, nullptr);
     }
-
-    VkMemoryRequirements memRequirements;
-    vkGetBufferMemoryRequirements(mDevice, stagingBuffer, &memRequirements);
-    qDebug() << "createVertexBuffer: staging memRequirements.size ="
-             << static_cast<qulonglong>(memRequirements.size);
-
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits,
-                                               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-    if (vkAllocateMemory(mDevice, &allocInfo, nullptr, &stagingBufferMemory) != VK_SUCCESS) {
-        vkDestroyBuffer(mDevice, stagingBuffer, nullptr);
-        throw std::runtime_error("failed to allocate staging buffer memory!");
+    if (resources.textureImageView != VK_NULL_HANDLE) {
+        vkDestroyImageView(mDevice, resources.textureImageView, nullptr);
     }
+    mAllocator->destroyImage(resources.textureImage, resources.textureAllocation);
+}
 
-    vkBindBufferMemory(mDevice, stagingBuffer, stagingBufferMemory, 0);
-
-    // Copy vertex data to staging buffer
-    void* data = nullptr;
-    vkMapMemory(mDevice, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, vertices.data(), static_cast<size_t>(bufferSize));
-    vkUnmapMemory(mDevice, stagingBufferMemory);
-
-    // Create device local vertex buffer
-    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
-    if (vkCreateBuffer(mDevice, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
-        vkDestroyBuffer(mDevice, stagingBuffer, nullptr);
-        vkFreeMemory(mDevice, stagingBufferMemory, nullptr);
-        throw std::runtime_error("failed to create vertex buffer!");
+void GPUResourceManager::destroyPendingRelease(PendingRelease& release)
+{
+    if (release.mesh) {
+        destroyMesh(*release.mesh);
     }
-
-    vkGetBufferMemoryRequirements(mDevice, buffer, &memRequirements);
-    qDebug() << "createVertexBuffer: vertex memRequirements.size ="
-             << static_cast<qulonglong>(memRequirements.size);
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits,
-                                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-    if (vkAllocateMemory(mDevice, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
-        vkDestroyBuffer(mDevice, buffer, nullptr);
-        vkDestroyBuffer(mDevice, stagingBuffer, nullptr);
-        vkFreeMemory(mDevice, stagingBufferMemory, nullptr);
-        throw std::runtime_error("failed to allocate vertex buffer memory!");
+    if (release.texture) {
+        destroyTexture(*release.texture);
     }
-
-    vkBindBufferMemory(mDevice, buffer, memory, 0);
-
-    // Copy from staging to device local buffer
-    copyBuffer(stagingBuffer, buffer, bufferSize);
-
-    // Clean up staging buffer
-    vkDestroyBuffer(mDevice, stagingBuffer, nullptr);
-    vkFreeMemory(mDevice, stagingBufferMemory, nullptr);
+    mAllocator->destroyBuffer(release.buffer, release.bufferAllocation);
 }
 
-void GPUResourceManager::createIndexBuffer(const std::vector<uint32_t>& indices,
-                                        VkBuffer& buffer,
-                                        VkDeviceMemory& memory)
+void GPUResourceManager::cleanup()
 {
-    if (indices.empty()) {
-        qDebug() << "createIndexBuffer: empty index array, skipping buffer creation.";
-        buffer = VK_NULL_HANDLE;
-        memory = VK_NULL_HANDLE;
-        return;
+    // Kalles etter vkDeviceWaitIdle, så utsatte slettinger kan tas med en gang. Opptatte
+    // kopieringer sendes og ventes på først.
+    mUploads->waitIdle();
+    for (auto& release : mPendingReleases) {
+        destroyPendingRelease(release);
     }
+    mPendingReleases.clear();
 
-    VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
-    if (bufferSize == 0) {
-        qDebug() << "createIndexBuffer: computed bufferSize == 0, skipping.";
-        buffer = VK_NULL_HANDLE;
-        memory = VK_NULL_HANDLE;
-        return;
+    // Clean up all mesh resources
+    for (auto& pair : mMeshResources) {
+        destroyMesh(*pair.second);
     }
+    mMeshResources.clear();
+    mMeshRefCounts.clear();
+    mMeshContentCache.clear();
+    mMeshContentKeys.clear();
+    mVertexArena->cleanup();
+    mIndexArena->cleanup();
 
-    qDebug() << "createIndexBuffer: bufferSize =" << static_cast<qulonglong>(bufferSize);
+    //Clean up all texture resources
+    for (auto& pair : mTextureResources) {
+        destroyTexture(*pair.second);
+    }
+    mTextureResources.clear();
+    mTexturePathCache.clear();
+    mTextureRefCounts.clear();
+}
+
+// ============= Vulkan Helper Functions (moved from ModelLoader) =============
 
-    // Create staging buffer
-    VkBuffer stagingBuffer = VK_NULL_HANDLE;
-    VkDeviceMemory stagingBufferMemory = VK_NULL_HANDLE;
+void GPUResourceManager::createDeviceLocalBuffer(const void* data, VkDeviceSize size,
+                                                 VkBufferUsageFlags usage,
+                                                 VkBuffer& buffer,
+                                                 DeviceAllocation& allocation)
+{
     VkBufferCreateInfo bufferInfo{};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferInfo.size = bufferSize;
-    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferInfo.size = size;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage;
     bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    mUploads->applySharing(bufferInfo);
 
-    if (vkCreateBuffer(mDevice, &bufferInfo, nullptr, &stagingBuffer) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create staging buffer!");
-    }
+    mAllocator->createBuffer(bufferInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, allocation);
 
-    VkMemoryRequirements memRequirements;
-    vkGetBufferMemoryRequirements(mDevice, stagingBuffer, &memRequirements);
-    qDebug() << "createIndexBuffer: staging memRequirements.size ="
-             << static_cast<qulonglong>(memRequirements.size);
+    // Kopieres via staging-ringen når batchen sendes
+    mUploads->copyToBuffer(data, size, buffer, 0);
+}
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits,
-                                               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+void GPUResourceManager::uploadToGeometryArena(const MeshData& meshData, MeshGPUResources& resources)
+{
+    uint32_t vertexCount = static_cast<uint32_t>(meshData.vertices.size());
+    uint32_t indexCount = static_cast<uint32_t>(meshData.indices.size());
+    uint32_t firstVertex = 0;
+    uint32_t firstIndex = 0;
+    allocateFromArena(*mVertexArena, vertexCount, firstVertex);
+    try {
+        allocateFromArena(*mIndexArena, indexCount, firstIndex);
+    } catch (...) {
+        mVertexArena->free(firstVertex);
+        throw;
+    }
+
+    // Havner i samme batch som resten av opplastingene, sendes samlet av flush()
+    mUploads->copyToBuffer(meshData.vertices.data(), sizeof(Vertex) * meshData.vertices.size(),
+                           mVertexArena->getBuffer(), firstVertex * mVertexArena->getElementSize());
+    mUploads->copyToBuffer(meshData.indices.data(), sizeof(uint32_t) * meshData.indices.size(),
+                           mIndexArena->getBuffer(), firstIndex * mIndexArena->getElementSize());
+
+    resources.vertexBuffer = mVertexArena->getBuffer();
+    resources.indexBuffer = mIndexArena->getBuffer();
+    resources.firstIndex = firstIndex;
+    resources.vertexOffset = static_cast<int32_t>(firstVertex);
+    resources.inGeometryArena = true;
+}
 
-    if (vkAllocateMemory(mDevice, &allocInfo, nullptr, &stagingBufferMemory) != VK_SUCCESS) {
-        vkDestroyBuffer(mDevice, stagingBuffer, nullptr);
-        throw std::runtime_error("failed to allocate staging buffer memory!");
+void GPUResourceManager::allocateFromArena(GeometryArena& arena, uint32_t count, uint32_t& firstElement)
+{
+    if (arena.allocate(count, firstElement)) {
+        return;
     }
 
-    vkBindBufferMemory(mDevice, stagingBuffer, stagingBufferMemory, 0);
-
-    // Copy index data to staging buffer
-    void* data = nullptr;
-    vkMapMemory(mDevice, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, indices.data(), static_cast<size_t>(bufferSize));
-    vkUnmapMemory(mDevice, stagingBufferMemory);
+    // Dobler, og den nye halen alene har alltid plass til meshet
+    uint32_t capacity = std::max({arena.getCapacity() * 2, arena.getCapacity() + count,
+                                  kInitialArenaElements});
+    VkDeviceSize oldBytes = arena.getCapacity() * arena.getElementSize();
+    VkBuffer oldBuffer = VK_NULL_HANDLE;
+    DeviceAllocation oldAllocation;
+    arena.grow(capacity, oldBuffer, oldAllocation);
+
+    if (oldBuffer != VK_NULL_HANDLE) {
+        // Kopien går i samme batch som opplastingene. Det gamle bufferet kan være i bruk av
+        // frames og av kopien, så det slettes utsatt som andre ressurser. Command buffers
+        // tas opp på nytt hver frame og får de nye handlene.
+        UploadQueue::Ticket copyTicket = mUploads->copyBuffer(oldBuffer, arena.getBuffer(), oldBytes);
+        PendingRelease oldArena;
+        oldArena.retireFrame = mFrameIndex + mFramesInFlight;
+        oldArena.uploadTicket = copyTicket;
+        oldArena.buffer = oldBuffer;
+        oldArena.bufferAllocation = oldAllocation;
+        mPendingReleases.push_back(std::move(oldArena));
+
+        // Meshene er først på plass i det nye bufferet når kopien er ferdig
+        bool isVertexArena = &arena == mVertexArena.get();
+        auto retarget = [&](MeshGPUResources& mesh) {
+            if (mesh.inGeometryArena) {
+                (isVertexArena ? mesh.vertexBuffer : mesh.indexBuffer) = arena.getBuffer();
+                mesh.uploadTicket = std::max(mesh.uploadTicket, copyTicket);
+            }
+        };
+        for (auto& pair : mMeshResources) {
+            retarget(*pair.second);
+        }
+        for (auto& release : mPendingReleases) {
+            if (release.mesh) {
+                retarget(*release.mesh);
+            }
+        }
+    }
 
-    // Create device local index buffer
-    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
-    if (vkCreateBuffer(mDevice, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
-        vkDestroyBuffer(mDevice, stagingBuffer, nullptr);
-        vkFreeMemory(mDevice, stagingBufferMemory, nullptr);
-        throw std::runtime_error("failed to create index buffer!");
+    if (!arena.allocate(count, firstElement)) {
+        throw std::runtime_error("failed to allocate from geometry arena!");
     }
+}
 
-    vkGetBufferMemoryRequirements(mDevice, buffer, &memRequirements);
-    qDebug() << "createIndexBuffer: index memRequirements.size ="
-             << static_cast<qulonglong>(memRequirements.size);
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits,
-                                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+void GPUResourceManager::createVertexBuffer(const std::vector<Vertex>& vertices,
+                                         VkBuffer& buffer,
+                                         DeviceAllocation& allocation)
+{
+    buffer = VK_NULL_HANDLE;
+    allocation = DeviceAllocation{};
 
-    if (vkAllocateMemory(mDevice, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
-        vkDestroyBuffer(mDevice, buffer, nullptr);
-        vkDestroyBuffer(mDevice, stagingBuffer, nullptr);
-        vkFreeMemory(mDevice, stagingBufferMemory, nullptr);
-        throw std::runtime_error("failed to allocate index buffer memory!");
+    if (vertices.empty()) {
+        qDebug() << "createVertexBuffer: empty vertex array, skipping buffer creation.";
+        return;
     }
 
-    vkBindBufferMemory(mDevice, buffer, memory, 0);
+    VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
+    createDeviceLocalBuffer(vertices.data(), bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                            buffer, allocation);
+}
+
+void GPUResourceManager::createIndexBuffer(const std::vector<uint32_t>& indices,
+                                        VkBuffer& buffer,
+                                        DeviceAllocation& allocation)
+{
+    buffer = VK_NULL_HANDLE;
+    allocation = DeviceAllocation{};
 
-    // Copy from staging to device local buffer
-    copyBuffer(stagingBuffer, buffer, bufferSize);
+    if (indices.empty()) {
+        qDebug() << "createIndexBuffer: empty index array, skipping buffer creation.";
+        return;
+    }
 
-    // Clean up staging buffer
-    vkDestroyBuffer(mDevice, stagingBuffer, nullptr);
-    vkFreeMemory(mDevice, stagingBufferMemory, nullptr);
+    VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
+    createDeviceLocalBuffer(indices.data(), bufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                            buffer, allocation);
 }
 
-void GPUResourceManager::createTextureImage(const std::string& path,
+void GPUResourceManager::createTextureImage(const unsigned char* pixels, int texWidth, int texHeight,
+                                         uint32_t bakedMipLevels,
                                          VkImage& image,
-                                         VkDeviceMemory& memory)
+                                         DeviceAllocation& allocation,
+                                         uint32_t& mipLevels)
 {
     image = VK_NULL_HANDLE;
-    memory = VK_NULL_HANDLE;
+    allocation = DeviceAllocation{};
+    mipLevels = 1;
 
-    int texWidth = 0, texHeight = 0, texChannels = 0;
-    stbi_uc* pixels = stbi_load(path.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
     if (!pixels || texWidth <= 0 || texHeight <= 0) {
-        qDebug() << "createTextureImage: Failed to load texture or invalid dimensions for"
-                 << path.c_str();
-        if (pixels) stbi_image_free(pixels);
         return;
     }
 
+    const uint32_t width = static_cast<uint32_t>(texWidth);
+    const uint32_t height = static_cast<uint32_t>(texHeight);
+    mipLevels = bakedMipLevels > 0 ? bakedMipLevels : mipLevelCount(width, height);
+    const bool blitMipmaps = bakedMipLevels == 0 && mBlitMipmaps;
+
     VkDeviceSize imageSize = static_cast<VkDeviceSize>(texWidth) *
                              static_cast<VkDeviceSize>(texHeight) * 4;
-    if (imageSize == 0) {
-        qDebug() << "createTextureImage: imageSize is zero, skipping texture for"
-                 << path.c_str();
-        stbi_image_free(pixels);
-        return;
-    }
-
-    qDebug() << "createTextureImage: imageSize =" << static_cast<qulonglong>(imageSize)
-             << "for" << path.c_str();
-
-    // Create staging buffer
-    VkBuffer stagingBuffer = VK_NULL_HANDLE;
-    VkDeviceMemory stagingBufferMemory = VK_NULL_HANDLE;
-    VkBufferCreateInfo bufferInfo{};
-    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferInfo.size = imageSize;
-    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-    if (vkCreateBuffer(mDevice, &bufferInfo, nullptr, &stagingBuffer) != VK_SUCCESS) {
-        stbi_image_free(pixels);
-        throw std::runtime_error("failed to create staging buffer!");
-    }
-
-    VkMemoryRequirements memRequirements;
-    vkGetBufferMemoryRequirements(mDevice, stagingBuffer, &memRequirements);
-    qDebug() << "createTextureImage: staging memRequirements.size ="
-             << static_cast<qulonglong>(memRequirements.size);
-
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits,
-                                               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-    if (vkAllocateMemory(mDevice, &allocInfo, nullptr, &stagingBufferMemory) != VK_SUCCESS) {
-        vkDestroyBuffer(mDevice, stagingBuffer, nullptr);
-        stbi_image_free(pixels);
-        throw std::runtime_error("failed to allocate staging buffer memory!");
-    }
-
-    vkBindBufferMemory(mDevice, stagingBuffer, stagingBufferMemory, 0);
-
-    // Copy pixel data to staging buffer
-    void* data = nullptr;
-    vkMapMemory(mDevice, stagingBufferMemory, 0, imageSize, 0, &data);
-    memcpy(data, pixels, static_cast<size_t>(imageSize));
-    vkUnmapMemory(mDevice, stagingBufferMemory);
-
-    stbi_image_free(pixels);
 
     // Create image
     VkImageCreateInfo imageInfo{};
@@ -483,52 +636,34 @@ void GPUResourceManager::createTextureImage(const std::string& path,
     imageInfo.extent.width = static_cast<uint32_t>(texWidth);
     imageInfo.extent.height = static_cast<uint32_t>(texHeight);
     imageInfo.extent.depth = 1;
-    imageInfo.mipLevels = 1;
+    imageInfo.mipLevels = mipLevels;
     imageInfo.arrayLayers = 1;
-    imageInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
+    imageInfo.format = kTextureFormat;
     imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
     imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    if (blitMipmaps) {
+        imageInfo.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    }
     imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
     imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    mUploads->applySharing(imageInfo);
 
-    if (vkCreateImage(mDevice, &imageInfo, nullptr, &image) != VK_SUCCESS) {
-        vkDestroyBuffer(mDevice, stagingBuffer, nullptr);
-        vkFreeMemory(mDevice, stagingBufferMemory, nullptr);
-        throw std::runtime_error("failed to create image!");
-    }
-
-    vkGetImageMemoryRequirements(mDevice, image, &memRequirements);
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits,
-                                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    mAllocator->createImage(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, allocation);
 
-    if (vkAllocateMemory(mDevice, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
-        vkDestroyImage(mDevice, image, nullptr);
-        vkDestroyBuffer(mDevice, stagingBuffer, nullptr);
-        vkFreeMemory(mDevice, stagingBufferMemory, nullptr);
-        throw std::runtime_error("failed to allocate image memory!");
+    // Overganger, kopi og blits tas opp i upload-batchen, ingen venting her
+    if (bakedMipLevels > 0) {
+        mUploads->copyToImage(pixels, mipChainSize(width, height, mipLevels), image, width, height, mipLevels);
+    } else if (blitMipmaps) {
+        mUploads->copyToImage(pixels, imageSize, image, width, height, mipLevels, true);
+    } else {
+        std::vector<unsigned char> chain =
+            buildMipChain(BBLHub::Instance().getJobSystem(), pixels, width, height, mipLevels);
+        mUploads->copyToImage(chain.data(), chain.size(), image, width, height, mipLevels);
     }
-
-    vkBindImageMemory(mDevice, image, memory, 0);
-
-    // Transition image layout and copy buffer to image
-    transitionImageLayout(image, VK_FORMAT_R8G8B8A8_SRGB,
-                          VK_IMAGE_LAYOUT_UNDEFINED,
-                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-    copyBufferToImage(stagingBuffer, image,
-                      static_cast<uint32_t>(texWidth),
-                      static_cast<uint32_t>(texHeight));
-    transitionImageLayout(image, VK_FORMAT_R8G8B8A8_SRGB,
-                          VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                          VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-    // Clean up staging buffer
-    vkDestroyBuffer(mDevice, stagingBuffer, nullptr);
-    vkFreeMemory(mDevice, stagingBufferMemory, nullptr);
 }
 
-void GPUResourceManager::createTextureImageView(VkImage image, VkImageView& view)
+void GPUResourceManager::createTextureImageView(VkImage image, uint32_t mipLevels, VkImageView& view)
 {
     view = VK_NULL_HANDLE;
     if (image == VK_NULL_HANDLE) {
@@ -540,10 +675,10 @@ void GPUResourceManager::createTextureImageView(VkImage image, VkImageView& view
     viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
     viewInfo.image = image;
     viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    viewInfo.format = VK_FORMAT_R8G8B8A8_SRGB;
+    viewInfo.format = kTextureFormat;
     viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     viewInfo.subresourceRange.baseMipLevel = 0;
-    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.levelCount = mipLevels;
     viewInfo.subresourceRange.baseArrayLayer = 0;
     viewInfo.subresourceRange.layerCount = 1;
 
@@ -552,7 +687,7 @@ void GPUResourceManager::createTextureImageView(VkImage image, VkImageView& view
     }
 }
 
-void GPUResourceManager::createTextureSampler(VkSampler& sampler)
+void GPUResourceManager::createTextureSampler(uint32_t mipLevels, VkSampler& sampler)
 {
     sampler = VK_NULL_HANDLE;
 
@@ -565,10 +700,8 @@ void GPUResourceManager::createTextureSampler(VkSampler& sampler)
     samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
     samplerInfo.anisotropyEnable = VK_TRUE;
 
-    VkPhysicalDeviceProperties properties{};
-    vkGetPhysicalDeviceProperties(mPhysicalDevice, &properties);
-    float maxAniso = properties.limits.maxSamplerAnisotropy > 0.0f ?
-                         properties.limits.maxSamplerAnisotropy : 1.0f;
+    float maxAniso = mDeviceProperties.limits.maxSamplerAnisotropy > 0.0f ?
+                         mDeviceProperties.limits.maxSamplerAnisotropy : 1.0f;
     samplerInfo.maxAnisotropy = maxAniso;
 
     samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
@@ -578,167 +711,11 @@ void GPUResourceManager::createTextureSampler(VkSampler& sampler)
     samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
     samplerInfo.mipLodBias = 0.0f;
     samplerInfo.minLod = 0.0f;
-    samplerInfo.maxLod = 0.0f;
+    samplerInfo.maxLod = static_cast<float>(mipLevels);
 
     if (vkCreateSampler(mDevice, &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
         throw std::runtime_error("failed to create texture sampler!");
     }
 }
 
-void GPUResourceManager::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
-{
-    if (srcBuffer == VK_NULL_HANDLE || dstBuffer == VK_NULL_HANDLE || size == 0) {
-        qDebug() << "copyBuffer: invalid arguments, skipping copy";
-        return;
-    }
-
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-    VkBufferCopy copyRegion{};
-    copyRegion.size = size;
-    vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-    endSingleTimeCommands(commandBuffer);
-}
-
-void GPUResourceManager::transitionImageLayout(VkImage image, VkFormat format,
-                                            VkImageLayout oldLayout,
-                                            VkImageLayout newLayout)
-{
-    if (image == VK_NULL_HANDLE) {
-        qDebug() << "transitionImageLayout: image is VK_NULL_HANDLE, skipping.";
-        return;
-    }
-
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-    VkImageMemoryBarrier barrier{};
-    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    barrier.oldLayout = oldLayout;
-    barrier.newLayout = newLayout;
-    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.image = image;
-    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = 1;
-    barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount = 1;
-
-    VkPipelineStageFlags sourceStage;
-    VkPipelineStageFlags destinationStage;
-
-    if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED &&
-        newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-        barrier.srcAccessMask = 0;
-        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-        destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-    } else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL &&
-               newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-        sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-        destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    } else {
-        throw std::invalid_argument("unsupported layout transition!");
-    }
-
-    vkCmdPipelineBarrier(
-        commandBuffer,
-        sourceStage, destinationStage,
-        0,
-        0, nullptr,
-        0, nullptr,
-        1, &barrier
-        );
-
-    endSingleTimeCommands(commandBuffer);
-}
-
-void GPUResourceManager::copyBufferToImage(VkBuffer buffer, VkImage image,
-                                        uint32_t width, uint32_t height)
-{
-    if (buffer == VK_NULL_HANDLE || image == VK_NULL_HANDLE || width == 0 || height == 0) {
-        qDebug() << "copyBufferToImage: invalid arguments, skipping.";
-        return;
-    }
-
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-    VkBufferImageCopy region{};
-    region.bufferOffset = 0;
-    region.bufferRowLength = 0;
-    region.bufferImageHeight = 0;
-    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel = 0;
-    region.imageSubresource.baseArrayLayer = 0;
-    region.imageSubresource.layerCount = 1;
-    region.imageOffset = {0, 0, 0};
-    region.imageExtent = {width, height, 1};
-
-    vkCmdCopyBufferToImage(
-        commandBuffer,
-        buffer,
-        image,
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        1,
-        &region
-        );
-
-    endSingleTimeCommands(commandBuffer);
-}
-
-VkCommandBuffer GPUResourceManager::beginSingleTimeCommands()
-{
-    VkCommandBufferAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandPool = mCommandPool;
-    allocInfo.commandBufferCount = 1;
-
-    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
-    vkAllocateCommandBuffers(mDevice, &allocInfo, &commandBuffer);
-
-    VkCommandBufferBeginInfo beginInfo{};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-    vkBeginCommandBuffer(commandBuffer, &beginInfo);
-    return commandBuffer;
-}
-
-void GPUResourceManager::endSingleTimeCommands(VkCommandBuffer commandBuffer)
-{
-    if (commandBuffer == VK_NULL_HANDLE) return;
-
-    vkEndCommandBuffer(commandBuffer);
-
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffer;
-
-    vkQueueSubmit(mGraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(mGraphicsQueue);
-
-    vkFreeCommandBuffers(mDevice, mCommandPool, 1, &commandBuffer);
-}
-
-uint32_t GPUResourceManager::findMemoryType(uint32_t typeFilter,
-                                         VkMemoryPropertyFlags properties)
-{
-    VkPhysicalDeviceMemoryProperties memProperties;
-    vkGetPhysicalDeviceMemoryProperties(mPhysicalDevice, &memProperties);
-
-    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-        if ((typeFilter & (1 << i)) &&
-            (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-            return i;
-        }
-    }
-
-    throw std::runtime_error("failed to find suitable memory type!");
-}
-
 } // namespace bbl
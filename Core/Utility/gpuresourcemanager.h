@@ -2,47 +2,92 @@
 #define GPURESOURCE_MANAGER_H
 
 #include <vulkan/vulkan.h>
+#include <cstdint>
 #include <unordered_map>
 #include <memory>
 #include <string>
+#include <vector>
 #include "ModelData.h"
+#include "DeviceMemoryAllocator.h"
+#include "GeometryArena.h"
+#include "UploadQueue.h"
 
 namespace bbl
 {
 // Manages all GPU resources separately from ECS, AS IT SHOULD
+// Ikke trådsikker: alle kall må skje med Renderer::gpuMutex holdt (se Renderer.h).
 class GPUResourceManager
 {
 public:
     GPUResourceManager(VkDevice device,
                     VkPhysicalDevice physicalDevice,
-                    VkCommandPool commandPool,
-                    VkQueue graphicsQueue);
+                    UploadQueue* uploads,
+                    DeviceMemoryAllocator* allocator);
     ~GPUResourceManager();
 
     // Resource IDs for referencing GPU resources
     using MeshResourceID = size_t;
     using TextureResourceID = size_t;
 
-    // Upload model data to GPU and get resource IDs
+    // Upload model data to GPU and get resource IDs. Lik geometri og samme teksturfil
+    // gir samme ID; hvert kall teller som én referanse som må slippes med release*().
+    // Finnes en oppdatert .bbltex ved siden av teksturfilen lastes den i stedet.
     MeshResourceID uploadMesh(const MeshData& meshData);
     TextureResourceID uploadTexture(const std::string& texturePath);
 
+    // Dekoder alle teksturer som ikke er i cachen parallelt på jobbsystemet og laster
+    // dem opp. Etterpå treffer uploadTexture() cachen for disse stiene.
+    void preloadTextures(const std::vector<std::string>& texturePaths);
+
     // Get GPU resources by ID
     const MeshGPUResources* getMeshResources(MeshResourceID id) const;
     const TextureGPUResources* getTextureResources(TextureResourceID id) const;
 
-    // Clean up specific resources
+    // Opplastingen er asynkron: ressursen kan brukes i en frame med en gang (Renderer venter
+    // på GPU-en), men dataene er først på plass når disse returnerer true
+    bool isMeshReady(MeshResourceID id);
+    bool isTextureReady(TextureResourceID id);
+
+    // Ekstra referanse til en ID som allerede er lastet opp (f.eks. ved snapshot restore)
+    void retainMeshResources(MeshResourceID id);
+    void retainTextureResources(TextureResourceID id);
+
+    // Slipper én referanse. Når siste referanse er borte slettes Vulkan-objektene, men
+    // først når frames som kan ha brukt dem er ferdige på GPU-en, se advanceFrame().
     void releaseMeshResources(MeshResourceID id);
     void releaseTextureResources(TextureResourceID id);
 
+    // Kalles av Renderer én gang per frame, etter at fencen til frame-slotten er ventet på
+    void advanceFrame();
+    void setFramesInFlight(uint32_t count) { mFramesInFlight = count; }
+
+    // Nye mesher legges i to delte buffere (én for vertices, én for indekser) i stedet for
+    // egne buffere per mesh. Påvirker bare mesher som lastes opp etter kallet.
+    void setGeometryArenaEnabled(bool enabled) { mUseGeometryArena = enabled; }
+    const GeometryArena* getVertexArena() const { return mVertexArena.get(); }
+    const GeometryArena* getIndexArena() const { return mIndexArena.get(); }
+
     // Clean up all resources
     void cleanup();
 
 private:
     VkDevice mDevice;
     VkPhysicalDevice mPhysicalDevice;
-    VkCommandPool mCommandPool;
-    VkQueue mGraphicsQueue;
+    VkPhysicalDeviceProperties mDeviceProperties{};
+    // Mip-kjeden blittes på GPU-en når upload-køen er grafikk-køen og formatet støtter
+    // lineær filtrering, ellers nedskaleres den på CPU-en før opplasting
+    bool mBlitMipmaps = false;
+
+    // Eies av Renderer, alle kopieringer til GPU-en går hit
+    UploadQueue* mUploads = nullptr;
+
+    // Eies av Renderer, alle buffere og images her suballokeres fra den
+    DeviceMemoryAllocator* mAllocator = nullptr;
+
+    static constexpr uint32_t kInitialArenaElements = 64 * 1024;
+    std::unique_ptr<GeometryArena> mVertexArena;
+    std::unique_ptr<GeometryArena> mIndexArena;
+    bool mUseGeometryArena = true;
 
     // Storage for GPU resources
     std::unordered_map<MeshResourceID, std::unique_ptr<MeshGPUResources>> mMeshResources;
@@ -55,28 +100,67 @@ private:
     // Texture cache to avoid loading the same texture multiple times
     std::unordered_map<std::string, TextureResourceID> mTexturePathCache;
 
+    // Mesh-cache på innhold, og antall eiere per ressurs. Hashen finner kandidaten,
+    // CPU-kopien av innholdet avgjør om det faktisk er samme mesh
+    struct CachedMeshContent
+    {
+        MeshResourceID id = 0;
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+    };
+    std::unordered_map<uint64_t, CachedMeshContent> mMeshContentCache;
+    std::unordered_map<MeshResourceID, uint64_t> mMeshContentKeys;
+    std::unordered_map<MeshResourceID, uint32_t> mMeshRefCounts;
+    std::unordered_map<TextureResourceID, uint32_t> mTextureRefCounts;
+
+    static uint64_t hashMeshContent(const MeshData& meshData);
+    static bool sameMeshContent(const CachedMeshContent& cached, const MeshData& meshData);
+
+    // Ressurser som er sluppet men kan være i bruk av en frame eller en opplasting som
+    // ikke er ferdig
+    struct PendingRelease
+    {
+        uint64_t retireFrame = 0;
+        UploadQueue::Ticket uploadTicket = 0;
+        std::unique_ptr<MeshGPUResources> mesh;
+        std::unique_ptr<TextureGPUResources> texture;
+        VkBuffer buffer = VK_NULL_HANDLE;   // F.eks. en GeometryArena som har vokst
+        DeviceAllocation bufferAllocation;
+    };
+    std::vector<PendingRelease> mPendingReleases;
+    uint64_t mFrameIndex = 0;
+    uint32_t mFramesInFlight = 2;
+
+    void destroyMesh(MeshGPUResources& resources);
+    void destroyTexture(TextureGPUResources& resources);
+    void destroyPendingRelease(PendingRelease& release);
+
+    void uploadToGeometryArena(const MeshData& meshData, MeshGPUResources& resources);
+    void allocateFromArena(GeometryArena& arena, uint32_t count, uint32_t& firstElement);
+
     // Vulkan helper functions (moved from ModelLoader)
+    void createDeviceLocalBuffer(const void* data, VkDeviceSize size,
+                                 VkBufferUsageFlags usage,
+                                 VkBuffer& buffer,
+                                 DeviceAllocation& allocation);
     void createVertexBuffer(const std::vector<Vertex>& vertices,
                             VkBuffer& buffer,
-                            VkDeviceMemory& memory);
+                            DeviceAllocation& allocation);
     void createIndexBuffer(const std::vector<uint32_t>& indices,
                            VkBuffer& buffer,
-                           VkDeviceMemory& memory);
-    void createTextureImage(const std::string& path,
+                           DeviceAllocation& allocation);
+    // bakedMipLevels > 0: pixels har alle nivåene (fra .bbltex), ellers bare nivå 0 og
+    // resten genereres
+    void createTextureImage(const unsigned char* pixels, int texWidth, int texHeight,
+                            uint32_t bakedMipLevels,
                             VkImage& image,
-                            VkDeviceMemory& memory);
-    void createTextureImageView(VkImage image, VkImageView& view);
-    void createTextureSampler(VkSampler& sampler);
-
-    // Helper functions
-    void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
-    void transitionImageLayout(VkImage image, VkFormat format,
-                               VkImageLayout oldLayout, VkImageLayout newLayout);
-    void copyBufferToImage(VkBuffer buffer, VkImage image,
-                           uint32_t width, uint32_t height);
-    VkCommandBuffer beginSingleTimeCommands();
-    void endSingleTimeCommands(VkCommandBuffer commandBuffer);
-    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+                            DeviceAllocation& allocation,
+                            uint32_t& mipLevels);
+    TextureResourceID storeTexture(const std::string& texturePath,
+                                   const unsigned char* pixels, int texWidth, int texHeight,
+                                   uint32_t bakedMipLevels = 0);
+    void createTextureImageView(VkImage image, uint32_t mipLevels, VkImageView& view);
+    void createTextureSampler(uint32_t mipLevels, VkSampler& sampler);
 };
 }
 
@@ -2,6 +2,8 @@
 #include "../../External/tiny_obj_loader.h"
 #include <qdebug.h>
 #include <unordered_map>
+#include "JobSystem.h"
+#include "BblHub.h"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
@@ -72,6 +74,23 @@ std::unique_ptr<ModelData> ModelLoader::loadModel(const std::string& modelPath,
     return modelData;
 }
 
+std::vector<std::unique_ptr<ModelData>> ModelLoader::loadModels(const std::vector<std::string>& modelPaths)
+{
+    std::vector<std::unique_ptr<ModelData>> models(modelPaths.size());
+
+    parallelFor(BBLHub::Instance().getJobSystem(), 0, modelPaths.size(), 1, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            try {
+                models[i] = loadModel(modelPaths[i], "");
+            } catch (const std::exception& e) {
+                qWarning() << "Failed to load model" << modelPaths[i].c_str() << ":" << e.what();
+            }
+        }
+    });
+
+    return models;
+}
+
 void ModelLoader::loadOBJ(const std::string& modelPath,
                           ModelData& modelData,
                           const std::string& customTexturePath)
@@ -125,103 +144,111 @@ void ModelLoader::loadOBJ(const std::string& modelPath,
     }
 
     //  Normal face-based mesh loading with normals
-    for (size_t s = 0; s < shapes.size(); ++s)
-    {
-        const auto& shape = shapes[s];
-
-        if (shape.mesh.indices.empty()) {
-            qDebug() << "Skipping shape" << (int)s << " — empty indices";
-            continue;
-        }
-
-        MeshData meshData;
-
-        int chosenMat = -1;
-        if (!shape.mesh.material_ids.empty()) {
-            for (int id : shape.mesh.material_ids) {
-                if (id >= 0) { chosenMat = id; break; }
-            }
-        }
-        if (chosenMat < 0 && !modelData.materials.empty()) {
-            qDebug() << "Shape" << (int)s << ": no per-face material; falling back to material 0.";
-            chosenMat = 0;
-        }
-        meshData.materialIndex = chosenMat;
-
-        std::unordered_map<Vertex, uint32_t> uniqueVertices;
-
-        for (const auto& index : shape.mesh.indices)
+    // Hver shape er uavhengig, så de bygges parallelt og legges til i fil-rekkefølge etterpå
+    std::vector<MeshData> shapeMeshes(shapes.size());
+    parallelFor(BBLHub::Instance().getJobSystem(), 0, shapes.size(), 1, [&](size_t first, size_t last) {
+        for (size_t s = first; s < last; ++s)
         {
-            if (!safe_attrib_vertex_exists(attrib, index.vertex_index)) {
-                qDebug() << "Warning: skipping index with invalid vertex_index ="
-                         << index.vertex_index;
+            const auto& shape = shapes[s];
+
+            if (shape.mesh.indices.empty()) {
+                qDebug() << "Skipping shape" << (int)s << " — empty indices";
                 continue;
             }
 
-            Vertex vertex{};
-            int vi = index.vertex_index;
-
-            // Position
-            vertex.pos = {
-                attrib.vertices[3 * vi + 0],
-                attrib.vertices[3 * vi + 1],
-                attrib.vertices[3 * vi + 2]
-            };
+            MeshData& meshData = shapeMeshes[s];
 
-            // Normal
-            if (safe_attrib_normal_exists(attrib, index.normal_index)) {
-                vertex.normal = {
-                    attrib.normals[3 * index.normal_index + 0],
-                    attrib.normals[3 * index.normal_index + 1],
-                    attrib.normals[3 * index.normal_index + 2]
-                };
-            } else {
-                // Fallback: default upward normal
-                vertex.normal = {0.0f, 1.0f, 0.0f};
+            int chosenMat = -1;
+            if (!shape.mesh.material_ids.empty()) {
+                for (int id : shape.mesh.material_ids) {
+                    if (id >= 0) { chosenMat = id; break; }
+                }
             }
-
-            // UV
-            if (safe_attrib_texcoord_exists(attrib, index.texcoord_index)) {
-                vertex.texCoord = {
-                    attrib.texcoords[2 * index.texcoord_index + 0],
-                    1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
-                };
-            } else {
-                vertex.texCoord = {0.0f, 0.0f};
+            if (chosenMat < 0 && !modelData.materials.empty()) {
+                qDebug() << "Shape" << (int)s << ": no per-face material; falling back to material 0.";
+                chosenMat = 0;
             }
-
-            // Color from v x y z r g b
-            if (vi >= 0 && attrib.colors.size() > 3 * vi + 2) {
-                vertex.color = {
-                    attrib.colors[3 * vi + 0],
-                    attrib.colors[3 * vi + 1],
-                    attrib.colors[3 * vi + 2]
+            meshData.materialIndex = chosenMat;
+
+            std::unordered_map<Vertex, uint32_t> uniqueVertices;
+
+            for (const auto& index : shape.mesh.indices)
+            {
+                if (!safe_attrib_vertex_exists(attrib, index.vertex_index)) {
+                    qDebug() << "Warning: skipping index with invalid vertex_index ="
+                             << index.vertex_index;
+                    continue;
+                }
+
+                Vertex vertex{};
+                int vi = index.vertex_index;
+
+                // Position
+                vertex.pos = {
+                    attrib.vertices[3 * vi + 0],
+                    attrib.vertices[3 * vi + 1],
+                    attrib.vertices[3 * vi + 2]
                 };
-            } else {
-                vertex.color = {1.0f, 1.0f, 1.0f};
+
+                // Normal
+                if (safe_attrib_normal_exists(attrib, index.normal_index)) {
+                    vertex.normal = {
+                        attrib.normals[3 * index.normal_index + 0],
+                        attrib.normals[3 * index.normal_index + 1],
+                        attrib.normals[3 * index.normal_index + 2]
+                    };
+                } else {
+                    // Fallback: default upward normal
+                    vertex.normal = {0.0f, 1.0f, 0.0f};
+                }
+
+                // UV
+                if (safe_attrib_texcoord_exists(attrib, index.texcoord_index)) {
+                    vertex.texCoord = {
+                        attrib.texcoords[2 * index.texcoord_index + 0],
+                        1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
+                    };
+                } else {
+                    vertex.texCoord = {0.0f, 0.0f};
+                }
+
+                // Color from v x y z r g b
+                if (vi >= 0 && attrib.colors.size() > 3 * vi + 2) {
+                    vertex.color = {
+                        attrib.colors[3 * vi + 0],
+                        attrib.colors[3 * vi + 1],
+                        attrib.colors[3 * vi + 2]
+                    };
+                } else {
+                    vertex.color = {1.0f, 1.0f, 1.0f};
+                }
+
+                auto it = uniqueVertices.find(vertex);
+                if (it == uniqueVertices.end()) {
+                    uint32_t newIndex = static_cast<uint32_t>(meshData.vertices.size());
+                    uniqueVertices[vertex] = newIndex;
+                    meshData.vertices.push_back(vertex);
+                    meshData.indices.push_back(newIndex);
+                } else {
+                    meshData.indices.push_back(it->second);
+                }
             }
 
-            auto it = uniqueVertices.find(vertex);
-            if (it == uniqueVertices.end()) {
-                uint32_t newIndex = static_cast<uint32_t>(meshData.vertices.size());
-                uniqueVertices[vertex] = newIndex;
-                meshData.vertices.push_back(vertex);
-                meshData.indices.push_back(newIndex);
-            } else {
-                meshData.indices.push_back(it->second);
+            qDebug() << "Shape" << (int)s
+                     << "vertices:" << meshData.vertices.size()
+                     << "indices:" << meshData.indices.size()
+                     << "material:" << meshData.materialIndex;
+
+            if (meshData.vertices.empty() || meshData.indices.empty()) {
+                qDebug() << "Skipping shape" << (int)s
+                         << " — produced zero vertices or indices";
             }
         }
+    });
 
-        qDebug() << "Shape" << (int)s
-                 << "vertices:" << meshData.vertices.size()
-                 << "indices:" << meshData.indices.size()
-                 << "material:" << meshData.materialIndex;
-
+    for (MeshData& meshData : shapeMeshes) {
         if (!meshData.vertices.empty() && !meshData.indices.empty()) {
             modelData.meshes.push_back(std::move(meshData));
-        } else {
-            qDebug() << "Skipping shape" << (int)s
-                     << " — produced zero vertices or indices";
         }
     }
 
@@ -3,6 +3,7 @@
 
 #include <string>
 #include <memory>
+#include <vector>
 #include "Modeldata.h"
 
 namespace bbl
@@ -17,6 +18,9 @@ public:
     std::unique_ptr<ModelData> loadModel(const std::string& modelPath,
                                          const std::string& customTexturePath = "");
 
+    // Laster flere filer parallelt på jobbsystemet. Filer som feiler gir nullptr på samme indeks.
+    std::vector<std::unique_ptr<ModelData>> loadModels(const std::vector<std::string>& modelPaths);
+
 private:
     // Internal loading helper
     void loadOBJ(const std::string& modelPath,
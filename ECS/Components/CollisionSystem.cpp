@@ -19,26 +19,27 @@ void CollisionSystem::update(float dt)
     // Get all entities with collision components
     std::vector<EntityID> collisionEntities = m_entityManager->getEntitiesWith<Collision, Transform>();
 
-    // Reset collision (blud)
-    for (EntityID entity : collisionEntities) {
-        Collision* collision = m_entityManager->getComponent<Collision>(entity);
-        if (collision) {
-            collision->isGrounded = false;
-            collision->isColliding = false;
-        }
-    }
-
-    // Check terrain collisions first(Before rest)
-    if (m_terrainCollisionEnabled && m_terrain) {
-        for (EntityID entity : collisionEntities) {
+    // Reset collision (blud) og terrengsjekk, hver entitet for seg så den kan kjøres parallelt
+    bool checkTerrain = m_terrainCollisionEnabled && m_terrain;
+    parallelFor(m_jobSystem, 0, collisionEntities.size(), 64, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            EntityID entity = collisionEntities[i];
             Transform* transform = m_entityManager->getComponent<Transform>(entity);
             Collision* collision = m_entityManager->getComponent<Collision>(entity);
+            if (!collision) {
+                continue;
+            }
 
-            if (transform && collision) {
+            collision->isGrounded = false;
+            collision->isColliding = false;
+
+            // Check terrain collisions first(Before rest). Terrenget selv hoppes over, alle
+            // andre leser transformen dens samtidig
+            if (checkTerrain && transform && entity != m_terrainEntityID) {
                 checkTerrainCollision(entity, transform, collision);
             }
         }
-    }
+    });
 
     if (m_entityCollisionEnabled) {
         checkEntityCollisions();
@@ -56,17 +57,22 @@ AABB CollisionSystem::calculateAABB(const Transform& transform, const Collision&
     return aabb;
 }
 
-void CollisionSystem::checkTerrainCollision(EntityID entity, Transform* transform, Collision* collision)
+glm::vec3 CollisionSystem::getTerrainPosition() const
 {
-    if (!m_terrain || !transform || !collision) {
-        return;
-    }
-    glm::vec3 terrainPosition(0.0f);
     if (m_terrainEntityID != INVALID_ENTITY) {
         if (auto* terrainTransform = m_entityManager->getComponent<Transform>(m_terrainEntityID)) {
-            terrainPosition = terrainTransform->position;
+            return terrainTransform->position;
         }
     }
+    return glm::vec3(0.0f);
+}
+
+void CollisionSystem::checkTerrainCollision(EntityID entity, Transform* transform, Collision* collision)
+{
+    if (!m_terrain || !transform || !collision) {
+        return;
+    }
+    glm::vec3 terrainPosition = getTerrainPosition();
 
     float terrainHeight = m_terrain->getHeightAt(transform->position.x,transform->position.z,  terrainPosition);
 
@@ -99,6 +105,9 @@ void CollisionSystem::checkEntityCollisions()
 
     std::vector<EntityID> collisionEntities = m_entityManager->getEntitiesWith<Collision, Transform>();
 
+    // Resolution order matters for the result, keep it stable (deterministic replay)
+    std::sort(collisionEntities.begin(), collisionEntities.end());
+
     // Check all pairs of entities
     for (size_t i = 0; i < collisionEntities.size(); ++i) {
         EntityID entityA = collisionEntities[i];
@@ -222,3 +231,125 @@ void CollisionSystem::resolveCollision(EntityID entityA, EntityID entityB,
         }
     }
 }
+
+//=============================================================================
+// Raycast
+//=============================================================================
+
+void CollisionSystem::gatherColliders(std::vector<ColliderAABB>& colliders, bool includeTriggers) const
+{
+    colliders.clear();
+    if (!m_entityManager) {
+        return;
+    }
+
+    for (EntityID entity : m_entityManager->getEntitiesWith<Collision, Transform>()) {
+        // Terrenget har egen trekant-test
+        if (entity == m_terrainEntityID) {
+            continue;
+        }
+
+        const Transform* transform = m_entityManager->getComponent<Transform>(entity);
+        const Collision* collision = m_entityManager->getComponent<Collision>(entity);
+        if (!transform || !collision || (collision->isTrigger && !includeTriggers)) {
+            continue;
+        }
+
+        colliders.push_back({entity, calculateAABB(*transform, *collision)});
+    }
+}
+
+bool CollisionSystem::raycastColliders(const Ray& ray, const std::vector<ColliderAABB>& colliders, RaycastHit& hit) const
+{
+    float dirLength = glm::length(ray.direction);
+    if (dirLength <= 0.0f) {
+        return false;
+    }
+
+    glm::vec3 dir = ray.direction / dirLength;
+    glm::vec3 invDir = 1.0f / dir;
+    float closest = std::min(ray.maxDistance, hit.hasHit ? hit.distance : FLT_MAX);
+    bool found = false;
+
+    for (const ColliderAABB& collider : colliders) {
+        float t;
+        glm::vec3 normal;
+        if (intersectRayAABB(ray.origin, invDir, collider.bounds.min, collider.bounds.max, closest, t, normal)
+            && t < closest) {
+            closest = t;
+            hit.hasHit = true;
+            hit.entity = collider.entity;
+            hit.triangleIndex = -1;
+            hit.distance = t;
+            hit.point = ray.origin + dir * t;
+            hit.normal = normal;
+            found = true;
+        }
+    }
+    return found;
+}
+
+bool CollisionSystem::raycast(const Ray& ray, RaycastHit& hit, bool includeTriggers) const
+{
+    std::vector<ColliderAABB> colliders;
+    gatherColliders(colliders, includeTriggers);
+
+    hit = RaycastHit{};
+    if (m_terrain && m_terrain->raycast(ray, hit, getTerrainPosition())) {
+        hit.entity = m_terrainEntityID;
+    }
+    raycastColliders(ray, colliders, hit);
+    return hit.hasHit;
+}
+
+size_t CollisionSystem::raycastAll(const Ray& ray, std::vector<RaycastHit>& hits, bool includeTriggers) const
+{
+    size_t first = hits.size();
+
+    if (m_terrain) {
+        m_terrain->raycastAll(ray, hits, getTerrainPosition());
+        for (size_t i = first; i < hits.size(); ++i) {
+            hits[i].entity = m_terrainEntityID;
+        }
+    }
+
+    std::vector<ColliderAABB> colliders;
+    gatherColliders(colliders, includeTriggers);
+
+    float dirLength = glm::length(ray.direction);
+    if (dirLength > 0.0f) {
+        glm::vec3 dir = ray.direction / dirLength;
+        glm::vec3 invDir = 1.0f / dir;
+        for (const ColliderAABB& collider : colliders) {
+            RaycastHit hit;
+            if (intersectRayAABB(ray.origin, invDir, collider.bounds.min, collider.bounds.max,
+                                 ray.maxDistance, hit.distance, hit.normal)) {
+                hit.hasHit = true;
+                hit.entity = collider.entity;
+                hit.point = ray.origin + dir * hit.distance;
+                hits.push_back(hit);
+            }
+        }
+    }
+
+    std::sort(hits.begin() + first, hits.end(),
+              [](const RaycastHit& a, const RaycastHit& b) { return a.distance < b.distance; });
+    return hits.size() - first;
+}
+
+void CollisionSystem::raycastBatch(const std::vector<Ray>& rays, std::vector<RaycastHit>& hits, bool includeTriggers) const
+{
+    std::vector<ColliderAABB> colliders;
+    gatherColliders(colliders, includeTriggers);
+    glm::vec3 terrainPosition = getTerrainPosition();
+
+    hits.assign(rays.size(), RaycastHit{});
+    parallelFor(m_jobSystem, 0, rays.size(), 16, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i) {
+            if (m_terrain && m_terrain->raycast(rays[i], hits[i], terrainPosition)) {
+                hits[i].entity = m_terrainEntityID;
+            }
+            raycastColliders(rays[i], colliders, hits[i]);
+        }
+    });
+}
@@ -1,8 +1,10 @@
-// #ifndef COLLISIONSYSTEM_H
-// #define COLLISIONSYSTEM_H
+#ifndef COLLISIONSYSTEM_H
+#define COLLISIONSYSTEM_H
 
 #include "../Entity/EntityManager.h"
 #include "../../Game/Terrain.h"
+#include "../../Core/Utility/Raycast.h"
+#include "../../Core/Utility/JobSystem.h"
 #include <glm/glm.hpp>
 #include <vector>
 
@@ -34,22 +36,42 @@ public:
     void setEntityCollisionEnabled(bool enabled) { m_entityCollisionEnabled = enabled; }
     void setGroundCheckDistance(float distance) { m_groundCheckDistance = distance; }
     void setTerrainEntity(EntityID terrainID) { m_terrainEntityID = terrainID; }
+    EntityID getTerrainEntity() const { return m_terrainEntityID; }
+    // Terrengsjekk og raycastBatch fordeles på jobbsystemet når det er satt
+    void setJobSystem(JobSystem* jobs) { m_jobSystem = jobs; }
+
+    // Raycast mot terrenget og alle collidere (AABB). Triggere hoppes over med mindre includeTriggers.
+    bool raycast(const Ray& ray, RaycastHit& hit, bool includeTriggers = false) const;
+    size_t raycastAll(const Ray& ray, std::vector<RaycastHit>& hits, bool includeTriggers = false) const;
+    // Mange stråler på en gang (picking, AI, plassering av objekter). Collider-listen bygges
+    // én gang for hele batchen. hits får samme størrelse som rays, bom har hasHit == false.
+    void raycastBatch(const std::vector<Ray>& rays, std::vector<RaycastHit>& hits, bool includeTriggers = false) const;
 
 private:
     EntityManager* m_entityManager;
     Terrain* m_terrain;
     EntityID m_terrainEntityID = INVALID_ENTITY;
+    JobSystem* m_jobSystem = nullptr;
 
     bool m_terrainCollisionEnabled{true};
     bool m_entityCollisionEnabled{true};
     float m_groundCheckDistance{0.1f};
 
 
+    struct ColliderAABB
+    {
+        EntityID entity;
+        AABB bounds;
+    };
+
     AABB calculateAABB(const Transform& transform, const Collision& collision) const;
+    glm::vec3 getTerrainPosition() const;
+    void gatherColliders(std::vector<ColliderAABB>& colliders, bool includeTriggers) const;
+    bool raycastColliders(const Ray& ray, const std::vector<ColliderAABB>& colliders, RaycastHit& hit) const;
     void checkTerrainCollision(EntityID entity, Transform* transform, Collision* collision);
     void checkEntityCollisions();
     void resolveCollision(EntityID entityA, EntityID entityB,Transform* transformA, Transform* transformB);
 };
 
 } // namespace bbl
-// #endif // COLLISIONSYSTEM_H
+#endif // COLLISIONSYSTEM_H
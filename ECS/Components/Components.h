@@ -133,13 +133,8 @@ struct Tracking
     EntityID traceEntityID = 0;
 
 
-    std::chrono::steady_clock::time_point lastSampleTime;
-
-    Tracking()
-    {
-        lastSampleTime = std::chrono::steady_clock::now();
-    }
-
+    // Simuleringstid siden forrige sample, ikke veggklokke (se GameWorld fixed step)
+    float timeSinceLastSample = 0.0f;
 };
 
 // struct Input
@@ -1,6 +1,7 @@
 #include "Physics.h"
 
 #include <qdebug.h>
+#include <algorithm>
 
 using namespace bbl;
 
@@ -22,6 +23,19 @@ void PhysicsSystem::update(float dt)
 
     std::vector<bbl::EntityID> physicsEntities = m_entityManager->getEntitiesWith<bbl::Physics, bbl::Transform>();
 
+    // Fast rekkefølge uavhengig av hash-tabellen, kreves for deterministisk replay
+    std::sort(physicsEntities.begin(), physicsEntities.end());
+
+    for (uint32_t& count : m_lodStats.entitiesPerTier) {
+        count = 0;
+    }
+    m_lodStats.stepsTaken = 0;
+    m_lodStats.stepsDeferred = 0;
+
+    // LOD-bokføringen gjøres serielt, selve stegene er uavhengige per entitet
+    m_pendingSteps.clear();
+    m_pendingSteps.reserve(physicsEntities.size());
+
     for (EntityID entity : physicsEntities)
     {
         bbl::Physics* physics = m_entityManager->getComponent<bbl::Physics>(entity);
@@ -32,40 +46,129 @@ void PhysicsSystem::update(float dt)
             continue;
         }
 
-        bbl::Collision* collision = m_entityManager->getComponent<bbl::Collision>(entity);
+        if (!m_lodSettings.enabled || !m_hasLODViewer)
+        {
+            ++m_lodStats.entitiesPerTier[static_cast<int>(SimulationLOD::Near)];
+            ++m_lodStats.stepsTaken;
+            m_pendingSteps.push_back({entity, physics, transform, dt});
+            continue;
+        }
+
+        LODState& lod = m_lodStates[entity];
+        SimulationLOD tier = selectLODTier(lod.tier, transform->position);
+        if (tier != lod.tier)
+        {
+            lod.tier = tier;
+            ++m_lodStats.tierChanges;
+        }
+        ++m_lodStats.entitiesPerTier[static_cast<int>(tier)];
+
+        lod.accumulatedDt += dt;
+        float interval = 0.0f;
+        if (tier == SimulationLOD::Mid) interval = m_lodSettings.midInterval;
+        else if (tier == SimulationLOD::Far) interval = m_lodSettings.farInterval;
+
+        if (lod.accumulatedDt < interval)
+        {
+            ++m_lodStats.stepsDeferred;
+            continue;
+        }
+
+        // Ett steg dekker minst et helt intervall, resten tas med til neste steg.
+        // Bare etterslep utover ett intervall kastes, ellers eksploderer integrasjonen etter lange pauser
+        float stepDt = std::min(lod.accumulatedDt, std::max({dt, interval, m_lodSettings.maxStepDt}));
+        lod.accumulatedDt = std::min(lod.accumulatedDt - stepDt, interval);
+        ++m_lodStats.stepsTaken;
+        m_pendingSteps.push_back({entity, physics, transform, stepDt});
+    }
+
+    // Hvert steg leser bare terrenget og skriver bare sin egen entitet, så resultatet
+    // er det samme uansett hvordan stegene fordeles på trådene
+    parallelFor(m_jobSystem, 0, m_pendingSteps.size(), 32, [this](size_t first, size_t last) {
+        for (size_t i = first; i < last; ++i)
+        {
+            const PendingStep& step = m_pendingSteps[i];
+            stepEntity(step.entity, step.physics, step.transform, step.dt);
+        }
+    });
+
+    // Rydd bort LOD-tilstand for entiteter som ikke lenger har fysikk
+    if (m_lodStates.size() > physicsEntities.size())
+    {
+        for (auto it = m_lodStates.begin(); it != m_lodStates.end();)
+        {
+            if (!m_entityManager->hasComponent<bbl::Physics>(it->first)) it = m_lodStates.erase(it);
+            else ++it;
+        }
+    }
+}
+
+void PhysicsSystem::setLODViewer(const glm::vec3& viewerPosition, const Frustum* frustum)
+{
+    m_lodViewerPosition = viewerPosition;
+    m_lodFrustum = frustum;
+    m_hasLODViewer = true;
+}
+
+SimulationLOD PhysicsSystem::selectLODTier(SimulationLOD current, const glm::vec3& position) const
+{
+    float distance = glm::length(position - m_lodViewerPosition);
+    int currentTier = static_cast<int>(current);
+
+    // Hysterese: grensen flyttes bort fra tieret vi allerede er i
+    auto crosses = [&](float threshold, int boundary) {
+        float scale = (currentTier <= boundary) ? 1.0f + m_lodSettings.hysteresis
+                                                : 1.0f - m_lodSettings.hysteresis;
+        return distance > threshold * scale;
+    };
+
+    int tier = 0;
+    if (crosses(m_lodSettings.midDistance, 0)) tier = 1;
+    if (crosses(m_lodSettings.farDistance, 1)) tier = 2;
 
-        // Sjekker først om vår entity kan bruke rulle fysikk
-        bool useRollingPhysics = m_rollingPhysicsEnabled && collision && collision->isGrounded && m_terrain;
+    if (m_lodSettings.demoteOutsideFrustum && m_lodFrustum && !m_lodFrustum->containsPoint(position))
+    {
+        tier = std::min(tier + 1, static_cast<int>(SimulationLOD::Far));
+    }
+
+    return static_cast<SimulationLOD>(tier);
+}
 
-        if (useRollingPhysics)
+void PhysicsSystem::stepEntity(EntityID entity, Physics* physics, Transform* transform, float dt)
+{
+    bbl::Collision* collision = m_entityManager->getComponent<bbl::Collision>(entity);
+
+    // Sjekker først om vår entity kan bruke rulle fysikk
+    bool useRollingPhysics = m_rollingPhysicsEnabled && collision && collision->isGrounded && m_terrain;
+
+    if (useRollingPhysics)
+    {
+        // Bruk rulling av ball fysikk fra Algoritme 9.6
+        updateRollingPhysics(entity, dt);
+    }
+    else
+    {
+        // Bruk gravitasjon hvis det er påskrudd og entitien ikke er isGrounded
+        if (physics->useGravity && collision && !collision->isGrounded)
         {
-            // Bruk rulling av ball fysikk fra Algoritme 9.6
-            updateRollingPhysics(entity, dt);
+            physics->acceleration += m_gravity;
         }
-        else
+
+        else if (collision && collision->isGrounded)
         {
-            // Bruk gravitasjon hvis det er påskrudd og entitien ikke er isGrounded
-            if (physics->useGravity && collision && !collision->isGrounded)
-            {
-                physics->acceleration += m_gravity;
-            }
-
-            else if (collision && collision->isGrounded)
-            {
-                // Tilbakestiller vertical velocity når grounded
-                physics->acceleration.y = 0.0f;
-                physics->velocity.y = 0.0f;
-            }
-
-            // Oppdaterer hastighet: v = v + a * dt
-            physics->velocity += physics->acceleration * dt;
-
-            // Oppdaterer position: p = p + v * dt
-            transform->position += physics->velocity * dt;
-
-            // Tilbakestiller akselerasjon for neste frame
-            physics->acceleration = glm::vec3(0.0f);
+            // Tilbakestiller vertical velocity når grounded
+            physics->acceleration.y = 0.0f;
+            physics->velocity.y = 0.0f;
         }
+
+        // Oppdaterer hastighet: v = v + a * dt
+        physics->velocity += physics->acceleration * dt;
+
+        // Oppdaterer position: p = p + v * dt
+        transform->position += physics->velocity * dt;
+
+        // Tilbakestiller akselerasjon for neste frame
+        physics->acceleration = glm::vec3(0.0f);
     }
 }
 
@@ -298,6 +401,30 @@ float PhysicsSystem::getFrictionCoefficient() const
     return frictionCoefficient;
 }
 
+PhysicsParameters PhysicsSystem::getParameters() const
+{
+    PhysicsParameters parameters;
+    parameters.gravity = m_gravity;
+    parameters.frictionCoefficient = frictionCoefficient;
+    parameters.zoneFrictionCoefficient = zone_frictionCoefficient;
+    parameters.zoneFrictionCenter = zone_frictionCenter;
+    parameters.zoneFrictionRadius = zone_frictionRadius;
+    parameters.rollingPhysicsEnabled = m_rollingPhysicsEnabled;
+    parameters.lod = m_lodSettings;
+    return parameters;
+}
+
+void PhysicsSystem::setParameters(const PhysicsParameters& parameters)
+{
+    m_gravity = parameters.gravity;
+    frictionCoefficient = parameters.frictionCoefficient;
+    zone_frictionCoefficient = parameters.zoneFrictionCoefficient;
+    zone_frictionCenter = parameters.zoneFrictionCenter;
+    zone_frictionRadius = parameters.zoneFrictionRadius;
+    m_rollingPhysicsEnabled = parameters.rollingPhysicsEnabled;
+    m_lodSettings = parameters.lod;
+}
+
 float PhysicsSystem::getFrictionAtPosition(const glm::vec3& position)
 {
     // Ballens posisjon vil påvirke hvor mye friksjon som virker på den
@@ -2,11 +2,51 @@
 #define PHYSICSSYSTEM_H
 #include "../../ECS/Entity/EntityManager.h"
 #include "../../Game/Terrain.h"
+#include "../../Core/Camera.h"
+#include "../../Core/Utility/JobSystem.h"
 #include <glm/glm.hpp>
 #include <vector>
+#include <unordered_map>
 
 namespace bbl
 {
+
+// Simulerings-LOD: legemer langt unna kameraet (eller utenfor frustum) steppes
+// sjeldnere med større, klampet dt. Avstandene er i verdensenheter.
+enum class SimulationLOD : uint8_t { Near = 0, Mid, Far, Count };
+
+struct SimulationLODSettings
+{
+    bool enabled = true;
+    float midDistance = 150.0f;      // Near -> Mid
+    float farDistance = 600.0f;      // Mid -> Far
+    float hysteresis = 0.1f;         // Andel av terskelen som må krysses før tier byttes
+    bool demoteOutsideFrustum = true;// Utenfor frustum flyttes ett tier ut
+    float midInterval = 1.0f / 20.0f;// Sekunder mellom steg per tier
+    float farInterval = 1.0f / 5.0f;
+    float maxStepDt = 0.1f;          // Øvre grense for dt i ett LOD-steg, men aldri under tierens intervall
+};
+
+struct SimulationLODStats
+{
+    uint32_t entitiesPerTier[static_cast<int>(SimulationLOD::Count)] = {};
+    uint32_t stepsTaken = 0;         // Forrige update
+    uint32_t stepsDeferred = 0;      // Forrige update
+    uint64_t tierChanges = 0;        // Totalt siden reset
+};
+
+// Alle justerbare parametre i PhysicsSystem samlet, POD slik at den kan memcpy'es
+struct PhysicsParameters
+{
+    glm::vec3 gravity;
+    float frictionCoefficient;
+    float zoneFrictionCoefficient;
+    glm::vec3 zoneFrictionCenter;
+    float zoneFrictionRadius;
+    bool rollingPhysicsEnabled;
+    SimulationLODSettings lod;
+};
+
 class PhysicsSystem
 {
 public:
@@ -20,14 +60,33 @@ public:
 
 
     void setTerrain(Terrain* terrain) { m_terrain = terrain; }
+    // Entitetene steppes parallelt når et jobbsystem er satt
+    void setJobSystem(JobSystem* jobs) { m_jobSystem = jobs; }
 
     // Task 2.1
     void enableRollingPhysics(bool enable) { m_rollingPhysicsEnabled = enable; }
+    bool isRollingPhysicsEnabled() const { return m_rollingPhysicsEnabled; }
 
     void setFrictionCoefficient(float coefficient);
     float getFrictionCoefficient() const;
     float getFrictionAtPosition(const glm::vec3& position);
 
+    PhysicsParameters getParameters() const;
+    void setParameters(const PhysicsParameters& parameters);
+
+    // Simulerings-LOD. Viewer settes hver frame før update(), uten viewer er alt Near.
+    void setLODViewer(const glm::vec3& viewerPosition, const Frustum* frustum);
+    void clearLODViewer() { m_hasLODViewer = false; m_lodFrustum = nullptr; }
+    // Glemmer tier og akkumulert dt for alle legemer (f.eks. ved start av opptak)
+    void resetLODState() { m_lodStates.clear(); }
+    void setLODSettings(const SimulationLODSettings& settings) { m_lodSettings = settings; }
+    const SimulationLODSettings& getLODSettings() const { return m_lodSettings; }
+    const SimulationLODStats& getLODStats() const { return m_lodStats; }
+    bool hasLODViewer() const { return m_hasLODViewer; }
+    const glm::vec3& getLODViewerPosition() const { return m_lodViewerPosition; }
+    const Frustum* getLODFrustum() const { return m_lodFrustum; }
+    void resetLODStats() { m_lodStats = SimulationLODStats{}; }
+
     // Task 2.3
     float frictionCoefficient;
     float zone_frictionCoefficient;
@@ -39,6 +98,33 @@ private:
     Terrain* m_terrain = nullptr;
     glm::vec3 m_gravity{0.0f, -9.81f, 0.0f};
 
+    // Simulerings-LOD
+    struct LODState
+    {
+        SimulationLOD tier = SimulationLOD::Near;
+        float accumulatedDt = 0.0f;
+    };
+    SimulationLODSettings m_lodSettings;
+    SimulationLODStats m_lodStats;
+    std::unordered_map<EntityID, LODState> m_lodStates;
+    glm::vec3 m_lodViewerPosition{0.0f};
+    const Frustum* m_lodFrustum = nullptr;
+    bool m_hasLODViewer = false;
+
+    JobSystem* m_jobSystem = nullptr;
+
+    struct PendingStep
+    {
+        EntityID entity;
+        Physics* physics;
+        Transform* transform;
+        float dt;
+    };
+    std::vector<PendingStep> m_pendingSteps;
+
+    SimulationLOD selectLODTier(SimulationLOD current, const glm::vec3& position) const;
+    void stepEntity(EntityID entity, Physics* physics, Transform* transform, float dt);
+
     // Task 2.1
     bool m_rollingPhysicsEnabled = false;
     glm::vec3 calculateFrictionForce(const glm::vec3& velocity, const glm::vec3& surfaceNormal, const glm::vec3 &position);
@@ -5,23 +5,25 @@ namespace bbl
 {
     namespace TrackingSystem
     {
+    void advanceSampleTime(Tracking& tracking, float deltaTime)
+    {
+        tracking.timeSinceLastSample += deltaTime;
+    }
+
     bool shouldSample(const Tracking& tracking)
     {
         // Enkel sjekk for å se om vi skal sample en ny posisjon til Tracking systemet
         if (!tracking.isTracking || tracking.controlPoints.empty())
             return true;
 
-        // For å Beregne tiden siden siste sampling for å kontrollere samplingshastigheten
-        auto now = std::chrono::steady_clock::now();
-        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
-                           now - tracking.lastSampleTime).count();
-        return elapsed >= (tracking.samplingInterval * 1000.0f);
+        // Simuleringstid siden siste sampling kontrollerer samplingshastigheten
+        return tracking.timeSinceLastSample >= tracking.samplingInterval;
     }
 
     void updateSampleTime(Tracking& tracking)
     {
-         // Oppdaterer tidspunktet for siste sampling
-        tracking.lastSampleTime = std::chrono::steady_clock::now();
+         // Nullstiller tiden siden siste sampling
+        tracking.timeSinceLastSample = 0.0f;
     }
 
     void addControlPoint(Tracking& tracking, const glm::vec3& position)
@@ -3,7 +3,6 @@
 
 #include <glm/glm.hpp>
 #include <vector>
-#include <chrono>
 
 // Task 2.5
 namespace bbl
@@ -14,7 +13,8 @@ namespace bbl
     namespace TrackingSystem
     {
 
-    // Tids baserte funksjoner
+    // Tids baserte funksjoner, drevet av simuleringens dt
+    void advanceSampleTime(Tracking& tracking, float deltaTime);
     bool shouldSample(const Tracking& tracking);
     void updateSampleTime(Tracking& tracking);
 
@@ -32,6 +32,7 @@ public:
             bbl::Tracking* tracking = mEntityManager->getComponent<Tracking>(entity);
 
             if (transform && tracking && tracking->isTracking) {
+                TrackingSystem::advanceSampleTime(*tracking, deltaTime);
                 updateTracking(entity, *transform, *tracking);
             }
         }
@@ -142,6 +143,15 @@ public:
         }
     }
 
+    // True hvis update() har lagt til punkter siden sist, da må updateTraceRenderData() kjøres
+    bool takePendingRenderUpdates()
+    {
+        bool pending = mRenderPending;
+        mRenderPending = false;
+        return pending;
+    }
+
+    // Laster opp trace-meshene, må kjøres der GPU-opplasting er lov (render-tråden)
     void updateTraceRenderData()
     {
         if (!mEntityManager) return;
@@ -167,6 +177,7 @@ public:
 
 private:
     EntityManager* mEntityManager;
+    bool mRenderPending = false;
 
     void updateTracking(EntityID entity, const Transform& transform, Tracking& tracking)
     {
@@ -177,6 +188,7 @@ private:
             TrackingSystem::addControlPoint(tracking, transform.position);
             TrackingSystem::updateSampleTime(tracking);
             tracking.shouldUpdateRender = true;
+            mRenderPending = true;
         }
     }
 
@@ -5,6 +5,7 @@
 #include "../Components/Components.h"
 #include "../../Core/Utility/gpuresourcemanager.h"
 #include "../../Core/Utility/ModelData.h"
+#include <array>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -14,6 +15,31 @@
 
 namespace bbl
 {
+// Mesh- og tekstur-IDene en entitet holder én referanse til i GPUResourceManager.
+// Mesh og Render deler vanligvis mesh-ID, Texture og Render tekstur-ID, så hver ID
+// telles bare én gang. Render::textureResourceID 0 betyr "ingen tekstur".
+struct GPUResourceReferences
+{
+    std::array<size_t, 2> meshes{};
+    size_t meshCount = 0;
+    std::array<size_t, 2> textures{};
+    size_t textureCount = 0;
+
+    GPUResourceReferences(const Mesh* mesh, const Texture* texture, const Render* render)
+    {
+        if (mesh) addUnique(meshes, meshCount, mesh->meshResourceID);
+        if (render) addUnique(meshes, meshCount, render->meshResourceID);
+        if (texture) addUnique(textures, textureCount, texture->textureResourceID);
+        if (render && render->textureResourceID != 0) addUnique(textures, textureCount, render->textureResourceID);
+    }
+
+private:
+    static void addUnique(std::array<size_t, 2>& ids, size_t& count, size_t id)
+    {
+        if (count == 0 || ids[0] != id) ids[count++] = id;
+    }
+};
+
 class EntityManager
 {
 public:
@@ -70,25 +96,7 @@ public:
         }
 
         // Clean up GPU resources if we have them
-        if (mResourceManager) {
-            // Check for mesh component
-            if (auto* meshComp = getComponent<Mesh>(entity)) {
-                mResourceManager->releaseMeshResources(meshComp->meshResourceID);
-            }
-
-            // Check for texture component
-            if (auto* texComp = getComponent<Texture>(entity)) {
-                mResourceManager->releaseTextureResources(texComp->textureResourceID);
-            }
-
-            // Check for render component (might have both mesh and texture)
-            if (auto* renderComp = getComponent<Render>(entity)) {
-                mResourceManager->releaseMeshResources(renderComp->meshResourceID);
-                if (renderComp->textureResourceID != 0) {
-                    mResourceManager->releaseTextureResources(renderComp->textureResourceID);
-                }
-            }
-        }
+        releaseGPUResources(entity);
 
         // Remove all components for this entity
         removeAllComponents(entity);
@@ -199,22 +207,8 @@ public:
     // Clear all entities and components
     void clear() {
         // Clean up GPU resources for all entities
-        if (mResourceManager) {
-            for (EntityID entity : mActiveEntities) {
-                // Clean up mesh resources
-                if (auto* meshComp = getComponent<Mesh>(entity)) {
-                    mResourceManager->releaseMeshResources(meshComp->meshResourceID);
-                }
-                if (auto* texComp = getComponent<Texture>(entity)) {
-                    mResourceManager->releaseTextureResources(texComp->textureResourceID);
-                }
-                if (auto* renderComp = getComponent<Render>(entity)) {
-                    mResourceManager->releaseMeshResources(renderComp->meshResourceID);
-                    if (renderComp->textureResourceID != 0) {
-                        mResourceManager->releaseTextureResources(renderComp->textureResourceID);
-                    }
-                }
-            }
+        for (EntityID entity : mActiveEntities) {
+            releaseGPUResources(entity);
         }
 
         // Clear all component storage
@@ -250,6 +244,21 @@ private:
     // GPU resource manager
     GPUResourceManager* mResourceManager;
 
+    // Meshes og teksturer deles mellom entiteter, så hver entitet slipper bare sin referanse
+    void releaseGPUResources(EntityID entity) {
+        if (!mResourceManager) {
+            return;
+        }
+
+        GPUResourceReferences refs(getComponent<Mesh>(entity), getComponent<Texture>(entity), getComponent<Render>(entity));
+        for (size_t i = 0; i < refs.meshCount; ++i) {
+            mResourceManager->releaseMeshResources(refs.meshes[i]);
+        }
+        for (size_t i = 0; i < refs.textureCount; ++i) {
+            mResourceManager->releaseTextureResources(refs.textures[i]);
+        }
+    }
+
     void removeAllComponents(EntityID entity) {
         mTransforms.erase(entity);
         mMeshes.erase(entity);
@@ -1,6 +1,7 @@
 #include "SceneSerializer.h"
 #include <QDebug>
 #include <fstream>
+#include <algorithm>
 #include "../Core/Utility/modelloader.h"
 #include "../Game/Terrain.h"
 
@@ -127,6 +128,38 @@ bool SceneSerializer::loadScene(EntityManager* entityManager,
         json entitiesArray = sceneJson["entities"];
         int loadedCount = 0;
 
+        // Parse alle modellfiler og dekod alle teksturer parallelt før entitetene opprettes.
+        // Hver fil lastes én gang selv om flere entiteter bruker den.
+        std::vector<std::string> modelPaths;
+        std::vector<std::string> texturePaths;
+        if (gpuResources) {
+            for (const auto& entityJson : entitiesArray) {
+                if (entityJson.contains("Mesh")) {
+                    std::string meshPath = entityJson["Mesh"].value("modelPath", "");
+                    if (!meshPath.empty() && meshPath.find("heightmap") == std::string::npos &&
+                        std::find(modelPaths.begin(), modelPaths.end(), meshPath) == modelPaths.end()) {
+                        modelPaths.push_back(meshPath);
+                    }
+                }
+                if (entityJson.contains("Texture")) {
+                    std::string texPath = entityJson["Texture"].value("texturePath", "");
+                    if (!texPath.empty()) {
+                        texturePaths.push_back(texPath);
+                    }
+                }
+            }
+        }
+
+        bbl::ModelLoader loader;
+        std::vector<std::unique_ptr<ModelData>> loadedModels = loader.loadModels(modelPaths);
+        std::unordered_map<std::string, const ModelData*> modelCache;
+        for (size_t i = 0; i < modelPaths.size(); ++i) {
+            modelCache[modelPaths[i]] = loadedModels[i].get();
+        }
+        if (gpuResources) {
+            gpuResources->preloadTextures(texturePaths);
+        }
+
         for (const auto& entityJson : entitiesArray) {
             deserializeEntity(entityManager, entityJson);
 
@@ -171,8 +204,8 @@ bool SceneSerializer::loadScene(EntityManager* entityManager,
 
                     } else {
 
-                        bbl::ModelLoader loader;
-                        auto model = loader.loadModel(meshPath, "");
+                        auto cached = modelCache.find(meshPath);
+                        const ModelData* model = cached != modelCache.end() ? cached->second : nullptr;
 
                         if (model && meshIndex < model->meshes.size()) {
 
@@ -447,7 +480,7 @@ json SceneSerializer::serializeTracking(const Tracking& tracking)
         {"lineWidth", tracking.lineWidth},
         {"controlPoints", controlPointsArray},
         {"curvePoints", curvePointsArray}
-        // Note: lastSampleTime is not serialized as it will be reset when the component is loaded
+        // Note: timeSinceLastSample is not serialized as it will be reset when the component is loaded
     };
 }
 
@@ -563,8 +596,8 @@ Tracking SceneSerializer::deserializeTracking(const json& j)
         }
     }
 
-    // Reset lastSampleTime to current time
-    tracking.lastSampleTime = std::chrono::steady_clock::now();
+    // Start sampling from scratch
+    tracking.timeSinceLastSample = 0.0f;
 
     return tracking;
 }
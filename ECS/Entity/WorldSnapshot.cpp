@@ -0,0 +1,609 @@
+#include "WorldSnapshot.h"
+#include "../../Core/Utility/BinaryStream.h"
+#include "../../Core/Utility/gpuresourcemanager.h"
+#include "../../Core/Utility/modelloader.h"
+#include <QDebug>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <type_traits>
+
+namespace bbl
+{
+
+namespace
+{
+constexpr uint32_t SnapshotMagic = 0x534C4242; // "BBLS"
+constexpr uint16_t SnapshotVersion = 1;
+
+// Format (native endian):
+//   header:   magic, u16 version, u16 reserved, u32 EntityIDGenerator, u32 antall, EntityID[antall]
+//   POD-pool: u32 sizeof(T), u32 antall, EntityID[antall], T[antall]
+//   pools:    Transform, Render, Physics, Collision (POD), så Mesh, Texture, Audio, Tracking
+//   slutt:    PhysicsParameters, Terrain::Parameters, navn (hver med u8 present-flagg)
+
+template <typename T>
+void writePODPool(BinaryWriter& writer, const std::unordered_map<EntityID, T>& pool)
+{
+    static_assert(std::is_trivially_copyable_v<T>, "POD pools must be trivially copyable");
+
+    std::vector<EntityID> ids;
+    std::vector<T> components;
+    ids.reserve(pool.size());
+    components.reserve(pool.size());
+    for (const auto& [entity, component] : pool) {
+        ids.push_back(entity);
+        components.push_back(component);
+    }
+
+    writer.write(static_cast<uint32_t>(sizeof(T)));
+    writer.write(static_cast<uint32_t>(ids.size()));
+    writer.writeArray(ids.data(), ids.size());
+    writer.writeArray(components.data(), components.size());
+}
+
+template <typename T>
+bool readPODPool(BinaryReader& reader, std::unordered_map<EntityID, T>& pool)
+{
+    uint32_t componentSize = reader.read<uint32_t>();
+    uint32_t count = reader.read<uint32_t>();
+    if (!reader.ok() || componentSize != sizeof(T)) {
+        return false;
+    }
+
+    std::vector<EntityID> ids;
+    std::vector<T> components;
+    reader.readArray(ids, count);
+    reader.readArray(components, count);
+    if (!reader.ok()) {
+        return false;
+    }
+
+    pool.clear();
+    pool.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        pool.emplace(ids[i], components[i]);
+    }
+    return true;
+}
+
+// Komponenter med strenger/vektorer: u32 antall, så (EntityID, felter) per entitet
+template <typename T, typename WriteFn>
+void writePool(BinaryWriter& writer, const std::unordered_map<EntityID, T>& pool, WriteFn writeComponent)
+{
+    writer.write(static_cast<uint32_t>(pool.size()));
+    for (const auto& [entity, component] : pool) {
+        writer.write(entity);
+        writeComponent(writer, component);
+    }
+}
+
+template <typename T, typename ReadFn>
+bool readPool(BinaryReader& reader, std::unordered_map<EntityID, T>& pool, ReadFn readComponent)
+{
+    uint32_t count = reader.read<uint32_t>();
+    if (!reader.ok()) {
+        return false;
+    }
+
+    pool.clear();
+    pool.reserve(count);
+    for (uint32_t i = 0; i < count && reader.ok(); ++i) {
+        EntityID entity = reader.read<EntityID>();
+        T component;
+        readComponent(reader, component);
+        pool[entity] = std::move(component);
+    }
+    return reader.ok();
+}
+
+template <typename T>
+void writeVector(BinaryWriter& writer, const std::vector<T>& values)
+{
+    writer.write(static_cast<uint32_t>(values.size()));
+    writer.writeArray(values.data(), values.size());
+}
+
+template <typename T>
+void readVector(BinaryReader& reader, std::vector<T>& values)
+{
+    uint32_t count = reader.read<uint32_t>();
+    reader.readArray(values, count);
+}
+
+template <typename T>
+void writeOptionalPOD(BinaryWriter& writer, const T* value)
+{
+    writer.write(static_cast<uint8_t>(value != nullptr));
+    if (value) {
+        writer.write(static_cast<uint32_t>(sizeof(T)));
+        writer.write(*value);
+    }
+}
+
+// Returnerer false ved feil størrelse, present settes til om verdien fantes
+template <typename T>
+bool readOptionalPOD(BinaryReader& reader, T& value, bool& present)
+{
+    present = reader.read<uint8_t>() != 0;
+    if (!present) {
+        return reader.ok();
+    }
+    if (reader.read<uint32_t>() != sizeof(T)) {
+        return false;
+    }
+    value = reader.read<T>();
+    return reader.ok();
+}
+
+void writeMesh(BinaryWriter& writer, const Mesh& mesh)
+{
+    writer.write(static_cast<uint64_t>(mesh.meshResourceID));
+    writer.writeString(mesh.modelPath);
+    writer.write(static_cast<uint64_t>(mesh.meshIndex));
+}
+
+void readMesh(BinaryReader& reader, Mesh& mesh)
+{
+    mesh.meshResourceID = static_cast<size_t>(reader.read<uint64_t>());
+    mesh.modelPath = reader.readString();
+    mesh.meshIndex = static_cast<size_t>(reader.read<uint64_t>());
+}
+
+void writeTexture(BinaryWriter& writer, const Texture& texture)
+{
+    writer.write(static_cast<uint64_t>(texture.textureResourceID));
+    writer.writeString(texture.texturePath);
+}
+
+void readTexture(BinaryReader& reader, Texture& texture)
+{
+    texture.textureResourceID = static_cast<size_t>(reader.read<uint64_t>());
+    texture.texturePath = reader.readString();
+}
+
+// OpenAL-handles lagres ikke, de tilhører den kjørende prosessen
+void writeAudio(BinaryWriter& writer, const Audio& audio)
+{
+    writer.write(audio.volume);
+    writer.write(static_cast<uint8_t>(audio.muted));
+    writer.write(static_cast<uint8_t>(audio.looping));
+    writer.writeString(audio.attackSound);
+    writer.writeString(audio.deathSound);
+}
+
+void readAudio(BinaryReader& reader, Audio& audio)
+{
+    audio.volume = reader.read<float>();
+    audio.muted = reader.read<uint8_t>() != 0;
+    audio.looping = reader.read<uint8_t>() != 0;
+    audio.attackSound = reader.readString();
+    audio.deathSound = reader.readString();
+}
+
+void writeTracking(BinaryWriter& writer, const Tracking& tracking)
+{
+    writer.write(tracking.samplingInterval);
+    writer.write(static_cast<uint64_t>(tracking.maxControlPoints));
+    writer.write(static_cast<uint64_t>(tracking.curveResolution));
+    writer.write(static_cast<uint8_t>(tracking.isTracking));
+    writeVector(writer, tracking.controlPoints);
+    writeVector(writer, tracking.curvePoints);
+    writer.write(tracking.traceColor);
+    writer.write(tracking.lineWidth);
+    writer.write(static_cast<uint8_t>(tracking.shouldUpdateRender));
+    writer.write(tracking.lastMeshID);
+    writer.write(tracking.traceEntityID);
+    writer.write(tracking.timeSinceLastSample);
+}
+
+void readTracking(BinaryReader& reader, Tracking& tracking)
+{
+    tracking.samplingInterval = reader.read<float>();
+    tracking.maxControlPoints = static_cast<size_t>(reader.read<uint64_t>());
+    tracking.curveResolution = static_cast<size_t>(reader.read<uint64_t>());
+    tracking.isTracking = reader.read<uint8_t>() != 0;
+    readVector(reader, tracking.controlPoints);
+    readVector(reader, tracking.curvePoints);
+    tracking.traceColor = reader.read<glm::vec3>();
+    tracking.lineWidth = reader.read<float>();
+    tracking.shouldUpdateRender = reader.read<uint8_t>() != 0;
+    tracking.lastMeshID = reader.read<uint32_t>();
+    tracking.traceEntityID = reader.read<EntityID>();
+    tracking.timeSinceLastSample = reader.read<float>();
+}
+
+template <typename T>
+const T* findComponent(const std::unordered_map<EntityID, T>& pool, EntityID entity)
+{
+    auto it = pool.find(entity);
+    return it != pool.end() ? &it->second : nullptr;
+}
+
+// Antall entiteter som holder hver mesh-/tekstur-ID, etter samme regel som EntityManager
+struct ReferenceCounts
+{
+    std::unordered_map<size_t, int> meshes;
+    std::unordered_map<size_t, int> textures;
+};
+
+ReferenceCounts countGPUReferences(const std::vector<EntityID>& entities,
+                                   const std::unordered_map<EntityID, Mesh>& meshes,
+                                   const std::unordered_map<EntityID, Texture>& textures,
+                                   const std::unordered_map<EntityID, Render>& renders)
+{
+    ReferenceCounts counts;
+    for (EntityID entity : entities) {
+        GPUResourceReferences refs(findComponent(meshes, entity), findComponent(textures, entity),
+                                   findComponent(renders, entity));
+        for (size_t i = 0; i < refs.meshCount; ++i) ++counts.meshes[refs.meshes[i]];
+        for (size_t i = 0; i < refs.textureCount; ++i) ++counts.textures[refs.textures[i]];
+    }
+    return counts;
+}
+
+// Finnes aldri i GPUResourceManager, så reloadMissingGPUResources() laster ressursen på nytt
+constexpr size_t UnresolvedResourceID = std::numeric_limits<size_t>::max();
+
+// Ressurs-IDene er tellere fra økten som tok snapshotet. I en ny økt kan samme ID
+// peke på en helt annen mesh/tekstur, så snapshots fra fil løses opp fra stiene.
+// Render::textureResourceID == 0 betyr ingen tekstur og beholdes.
+void clearSessionResourceIDs(std::unordered_map<EntityID, Mesh>& meshes,
+                             std::unordered_map<EntityID, Texture>& textures,
+                             std::unordered_map<EntityID, Render>& renders)
+{
+    for (auto& [entity, mesh] : meshes) mesh.meshResourceID = UnresolvedResourceID;
+    for (auto& [entity, texture] : textures) texture.textureResourceID = UnresolvedResourceID;
+    for (auto& [entity, render] : renders) {
+        render.meshResourceID = UnresolvedResourceID;
+        if (render.textureResourceID != 0) render.textureResourceID = UnresolvedResourceID;
+    }
+}
+
+template <typename RetainFn, typename ReleaseFn>
+void adjustReferences(std::unordered_map<size_t, int>& before, std::unordered_map<size_t, int>& after,
+                      RetainFn retain, ReleaseFn release)
+{
+    // Øk først, så en ID som bare flyttes mellom entiteter aldri når null underveis
+    for (const auto& [id, count] : after) {
+        for (int i = before[id]; i < count; ++i) retain(id);
+    }
+    for (const auto& [id, count] : before) {
+        auto it = after.find(id);
+        for (int i = it != after.end() ? it->second : 0; i < count; ++i) release(id);
+    }
+}
+
+} // namespace
+
+//=============================================================================
+// Capture
+//=============================================================================
+
+void WorldSnapshot::capture(const EntityManager& entityManager,
+                            const PhysicsSystem* physics,
+                            const Terrain* terrain,
+                            const std::unordered_map<EntityID, std::string>* entityNames)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    mData.clear();
+    mResolveResourcesByPath = false;
+    BinaryWriter writer(mData);
+
+    std::vector<EntityID> entities = entityManager.getAllEntities();
+    std::sort(entities.begin(), entities.end());
+
+    writer.write(SnapshotMagic);
+    writer.write(SnapshotVersion);
+    writer.write(uint16_t{0});
+    writer.write(EntityIDGenerator::getLastID());
+    writer.write(static_cast<uint32_t>(entities.size()));
+    writer.writeArray(entities.data(), entities.size());
+
+    writePODPool(writer, entityManager.getComponentMap<Transform>());
+    writePODPool(writer, entityManager.getComponentMap<Render>());
+    writePODPool(writer, entityManager.getComponentMap<Physics>());
+    writePODPool(writer, entityManager.getComponentMap<Collision>());
+
+    writePool(writer, entityManager.getComponentMap<Mesh>(), writeMesh);
+    writePool(writer, entityManager.getComponentMap<Texture>(), writeTexture);
+    writePool(writer, entityManager.getComponentMap<Audio>(), writeAudio);
+    writePool(writer, entityManager.getComponentMap<Tracking>(), writeTracking);
+
+    PhysicsParameters physicsParameters{};
+    if (physics) {
+        physicsParameters = physics->getParameters();
+    }
+    writeOptionalPOD(writer, physics ? &physicsParameters : nullptr);
+
+    Terrain::Parameters terrainParameters{};
+    if (terrain) {
+        terrainParameters = terrain->getParameters();
+    }
+    writeOptionalPOD(writer, terrain ? &terrainParameters : nullptr);
+
+    writer.write(static_cast<uint8_t>(entityNames != nullptr));
+    if (entityNames) {
+        writer.write(static_cast<uint32_t>(entityNames->size()));
+        for (const auto& [entity, name] : *entityNames) {
+            writer.write(entity);
+            writer.writeString(name);
+        }
+    }
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    qDebug() << "Snapshot captured:" << entities.size() << "entities," << mData.size() << "bytes in" << ms << "ms";
+}
+
+//=============================================================================
+// Restore
+//=============================================================================
+
+bool WorldSnapshot::restore(EntityManager& entityManager,
+                            PhysicsSystem* physics,
+                            Terrain* terrain,
+                            std::unordered_map<EntityID, std::string>* entityNames)
+{
+    if (mData.empty()) {
+        setError("Snapshot is empty");
+        return false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    // Les og valider alt til midlertidige pools før verden endres, slik at en
+    // korrupt fil ikke etterlater en halvveis gjenopprettet verden
+    BinaryReader reader(mData.data(), mData.size());
+
+    uint32_t magic = reader.read<uint32_t>();
+    uint16_t version = reader.read<uint16_t>();
+    reader.read<uint16_t>();
+    EntityID lastGeneratedID = reader.read<EntityID>();
+    uint32_t entityCount = reader.read<uint32_t>();
+
+    if (!reader.ok() || magic != SnapshotMagic) {
+        setError("Not a world snapshot");
+        return false;
+    }
+    if (version != SnapshotVersion) {
+        setError("Unsupported snapshot version " + std::to_string(version));
+        return false;
+    }
+
+    std::vector<EntityID> entities;
+    reader.readArray(entities, entityCount);
+
+    std::unordered_map<EntityID, Transform> transforms;
+    std::unordered_map<EntityID, Render> renders;
+    std::unordered_map<EntityID, Physics> physicsComponents;
+    std::unordered_map<EntityID, Collision> collisions;
+    std::unordered_map<EntityID, Mesh> meshes;
+    std::unordered_map<EntityID, Texture> textures;
+    std::unordered_map<EntityID, Audio> audios;
+    std::unordered_map<EntityID, Tracking> trackingComponents;
+
+    bool ok = reader.ok()
+              && readPODPool(reader, transforms)
+              && readPODPool(reader, renders)
+              && readPODPool(reader, physicsComponents)
+              && readPODPool(reader, collisions)
+              && readPool(reader, meshes, readMesh)
+              && readPool(reader, textures, readTexture)
+              && readPool(reader, audios, readAudio)
+              && readPool(reader, trackingComponents, readTracking);
+
+    PhysicsParameters physicsParameters{};
+    Terrain::Parameters terrainParameters{};
+    bool hasPhysicsParameters = false;
+    bool hasTerrainParameters = false;
+    ok = ok && readOptionalPOD(reader, physicsParameters, hasPhysicsParameters)
+            && readOptionalPOD(reader, terrainParameters, hasTerrainParameters);
+
+    std::unordered_map<EntityID, std::string> names;
+    bool hasNames = ok && reader.read<uint8_t>() != 0;
+    if (hasNames) {
+        uint32_t nameCount = reader.read<uint32_t>();
+        names.reserve(nameCount);
+        for (uint32_t i = 0; i < nameCount && reader.ok(); ++i) {
+            EntityID entity = reader.read<EntityID>();
+            names[entity] = reader.readString();
+        }
+    }
+
+    if (!ok || !reader.ok()) {
+        setError("Snapshot is corrupt or was written by a different build");
+        return false;
+    }
+
+    // Slett entiteter som ikke fantes da snapshotet ble tatt (frigjør GPU-ressursene deres)
+    std::vector<EntityID> sortedEntities = entities;
+    std::sort(sortedEntities.begin(), sortedEntities.end());
+    for (EntityID entity : entityManager.getAllEntities()) {
+        if (!std::binary_search(sortedEntities.begin(), sortedEntities.end(), entity)) {
+            entityManager.destroyEntity(entity);
+        }
+    }
+
+    for (EntityID entity : entities) {
+        if (!entityManager.isValidEntity(entity)) {
+            entityManager.createEntityWithID(entity);
+        }
+    }
+    EntityIDGenerator::generateSpecificID(lastGeneratedID);
+
+    // Meshes og teksturer er referansetelt og deles mellom entiteter. Tellingen flyttes
+    // fra dagens pools til snapshotets før poolene overskrives, så ressurser lastet opp
+    // etter capture (f.eks. oppdaterte trace-linjer) frigjøres og delte ressurser overlever.
+    // IDer som ikke lenger finnes lastes inn igjen av reloadMissingGPUResources().
+    if (mResolveResourcesByPath) {
+        clearSessionResourceIDs(meshes, textures, renders);
+    }
+    if (GPUResourceManager* gpuResources = entityManager.getGPUResourceManager()) {
+        ReferenceCounts before = countGPUReferences(entityManager.getAllEntities(),
+                                                    entityManager.getComponentMap<Mesh>(),
+                                                    entityManager.getComponentMap<Texture>(),
+                                                    entityManager.getComponentMap<Render>());
+        ReferenceCounts after = countGPUReferences(entities, meshes, textures, renders);
+
+        adjustReferences(before.meshes, after.meshes,
+                         [gpuResources](size_t id) { gpuResources->retainMeshResources(id); },
+                         [gpuResources](size_t id) { gpuResources->releaseMeshResources(id); });
+        adjustReferences(before.textures, after.textures,
+                         [gpuResources](size_t id) { gpuResources->retainTextureResources(id); },
+                         [gpuResources](size_t id) { gpuResources->releaseTextureResources(id); });
+    }
+
+    // AL-handles følger entiteten som fortsatt lever, ikke snapshotet
+    for (auto& [entity, audio] : audios) {
+        if (const Audio* current = entityManager.getComponent<Audio>(entity)) {
+            audio.attackBuffer = current->attackBuffer;
+            audio.attackSource = current->attackSource;
+            audio.deathBuffer = current->deathBuffer;
+            audio.deathSource = current->deathSource;
+        }
+    }
+
+    entityManager.getComponentMap<Transform>() = std::move(transforms);
+    entityManager.getComponentMap<Render>() = std::move(renders);
+    entityManager.getComponentMap<Physics>() = std::move(physicsComponents);
+    entityManager.getComponentMap<Collision>() = std::move(collisions);
+    entityManager.getComponentMap<Mesh>() = std::move(meshes);
+    entityManager.getComponentMap<Texture>() = std::move(textures);
+    entityManager.getComponentMap<Audio>() = std::move(audios);
+    entityManager.getComponentMap<Tracking>() = std::move(trackingComponents);
+
+    if (physics) {
+        if (hasPhysicsParameters) {
+            physics->setParameters(physicsParameters);
+        }
+        physics->resetLODState();
+    }
+    if (terrain && hasTerrainParameters) {
+        terrain->setParameters(terrainParameters);
+    }
+    if (entityNames && hasNames) {
+        *entityNames = std::move(names);
+    }
+
+    reloadMissingGPUResources(entityManager, entityManager.getGPUResourceManager());
+
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    qDebug() << "Snapshot restored:" << entities.size() << "entities in" << ms << "ms";
+    return true;
+}
+
+// Entiteter som ble slettet etter capture har mistet meshen/teksturen sin.
+// Last dem inn igjen fra stiene, samme fremgangsmåte som SceneSerializer::loadScene.
+void WorldSnapshot::reloadMissingGPUResources(EntityManager& entityManager, GPUResourceManager* gpuResources)
+{
+    if (!gpuResources) {
+        return;
+    }
+
+    // Mange entiteter deler samme modellfil, les hver fil bare én gang
+    std::unordered_map<std::string, std::unique_ptr<ModelData>> loadedModels;
+
+    for (auto& [entity, mesh] : entityManager.getComponentMap<Mesh>()) {
+        if (gpuResources->getMeshResources(mesh.meshResourceID) || mesh.modelPath.empty()) {
+            continue;
+        }
+
+        size_t newMeshID = 0;
+        bool uploaded = false;
+        if (mesh.modelPath.find("heightmap") != std::string::npos) {
+            Terrain tempTerrain;
+            if (tempTerrain.loadFromOBJ(mesh.modelPath)) {
+                MeshData terrainMeshData;
+                terrainMeshData.vertices = tempTerrain.getVertices();
+                terrainMeshData.indices = tempTerrain.getIndices();
+                terrainMeshData.materialIndex = -1;
+                newMeshID = gpuResources->uploadMesh(terrainMeshData);
+                uploaded = true;
+            }
+        } else {
+            auto modelIt = loadedModels.find(mesh.modelPath);
+            if (modelIt == loadedModels.end()) {
+                ModelLoader loader;
+                modelIt = loadedModels.emplace(mesh.modelPath, loader.loadModel(mesh.modelPath, "")).first;
+            }
+            const auto& model = modelIt->second;
+            if (model && mesh.meshIndex < model->meshes.size()) {
+                newMeshID = gpuResources->uploadMesh(model->meshes[mesh.meshIndex]);
+                uploaded = true;
+            }
+        }
+
+        if (!uploaded) {
+            qWarning() << "Snapshot: failed to reload mesh from" << QString::fromStdString(mesh.modelPath);
+            continue;
+        }
+
+        mesh.meshResourceID = newMeshID;
+        if (auto* render = entityManager.getComponent<Render>(entity)) {
+            render->meshResourceID = newMeshID;
+        }
+    }
+
+    for (auto& [entity, texture] : entityManager.getComponentMap<Texture>()) {
+        if (gpuResources->getTextureResources(texture.textureResourceID) || texture.texturePath.empty()) {
+            continue;
+        }
+
+        size_t newTexID = gpuResources->uploadTexture(texture.texturePath);
+        texture.textureResourceID = newTexID;
+        if (auto* render = entityManager.getComponent<Render>(entity)) {
+            render->textureResourceID = newTexID;
+        }
+    }
+}
+
+//=============================================================================
+// File I/O
+//=============================================================================
+
+bool WorldSnapshot::saveToFile(const std::string& filepath) const
+{
+    if (mData.empty()) {
+        setError("Snapshot is empty");
+        return false;
+    }
+
+    std::ofstream file(filepath, std::ios::binary);
+    if (!file.is_open()) {
+        setError("Failed to open file for writing: " + filepath);
+        return false;
+    }
+
+    file.write(reinterpret_cast<const char*>(mData.data()), static_cast<std::streamsize>(mData.size()));
+    if (!file) {
+        setError("Failed to write snapshot: " + filepath);
+        return false;
+    }
+    return true;
+}
+
+bool WorldSnapshot::loadFromFile(const std::string& filepath)
+{
+    std::ifstream file(filepath, std::ios::binary);
+    if (!file.is_open()) {
+        setError("Failed to open snapshot: " + filepath);
+        return false;
+    }
+
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    BinaryReader reader(data.data(), data.size());
+    if (reader.read<uint32_t>() != SnapshotMagic) {
+        setError("Not a world snapshot: " + filepath);
+        return false;
+    }
+
+    mData = std::move(data);
+    mResolveResourcesByPath = true;
+    return true;
+}
+
+} // namespace bbl
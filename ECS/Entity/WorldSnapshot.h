@@ -0,0 +1,60 @@
+#ifndef WORLDSNAPSHOT_H
+#define WORLDSNAPSHOT_H
+
+#include "Entity.h"
+#include "EntityManager.h"
+#include "../Components/Physics.h"
+#include "../../Game/Terrain.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace bbl
+{
+class GPUResourceManager;
+
+// Binært øyeblikksbilde av hele verden: alle komponent-pools i EntityManager,
+// PhysicsSystem- og Terrain-parametre og (valgfritt) entitetsnavn.
+//
+// POD-pools (Transform, Render, Physics, Collision) skrives som to sammenhengende
+// arrays (IDer + komponenter) med memcpy. Komponenter med strenger/vektorer skrives
+// felt for felt. Samme buffer brukes i minnet og på disk, så save/load er én write/read.
+// Filene er knyttet til bygget (struct-layout), ikke ment for lagring av scener - bruk
+// SceneSerializer til det.
+class WorldSnapshot
+{
+public:
+    void capture(const EntityManager& entityManager,
+                 const PhysicsSystem* physics,
+                 const Terrain* terrain,
+                 const std::unordered_map<EntityID, std::string>* entityNames = nullptr);
+
+    // Entiteter som ikke finnes i snapshotet slettes. GPU-ressurser som ikke lenger
+    // finnes lastes inn på nytt fra Mesh::modelPath / Texture::texturePath. Etter
+    // loadFromFile løses alle ressurser opp fra stiene, IDene gjelder bare økten de ble tatt i.
+    bool restore(EntityManager& entityManager,
+                 PhysicsSystem* physics,
+                 Terrain* terrain,
+                 std::unordered_map<EntityID, std::string>* entityNames = nullptr);
+
+    bool saveToFile(const std::string& filepath) const;
+    bool loadFromFile(const std::string& filepath);
+
+    bool isEmpty() const { return mData.empty(); }
+    size_t getSizeBytes() const { return mData.size(); }
+    void clear() { mData.clear(); }
+    std::string getLastError() const { return mLastError; }
+
+private:
+    std::vector<uint8_t> mData;
+    mutable std::string mLastError;
+    bool mResolveResourcesByPath = false;
+
+    void setError(const std::string& error) const { mLastError = error; }
+    void reloadMissingGPUResources(EntityManager& entityManager, GPUResourceManager* gpuResources);
+};
+
+} // namespace bbl
+
+#endif // WORLDSNAPSHOT_H
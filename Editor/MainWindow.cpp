@@ -8,6 +8,7 @@
 
 #include <QTimer>
 #include <QFileDialog>
+#include <QFontDatabase>
 #include <QApplication>
 #include <QDateTime>
 #include <QDebug>
@@ -72,6 +73,13 @@ MainWindow::MainWindow(ResourceManager* resourceManager, QWidget* parent)
     // Status bar message
     statusBar()->showMessage("Don't be afraid of slow progress, be afraid of standing still.");
 
+    // Culling-tall fra Renderer, oppdateres to ganger i sekundet
+    renderStatsLabel = new QLabel(this);
+    statusBar()->addPermanentWidget(renderStatsLabel);
+    QTimer* renderStatsTimer = new QTimer(this);
+    connect(renderStatsTimer, &QTimer::timeout, this, &MainWindow::updateRenderStats);
+    renderStatsTimer->start(500);
+
     // Background music
     //resourceManager->toggleBackgroundMusic();
 }
@@ -133,6 +141,50 @@ void MainWindow::initLogger()
     qInstallMessageHandler(MainWindow::messageHandler);
 }
 
+void MainWindow::updateRenderStats()
+{
+    Renderer::RenderStats stats = mVulkanWindow->getRenderStats();
+    bbl::DeviceMemoryAllocator::Stats memory = mVulkanWindow->getMemoryStats();
+    renderStatsLabel->setText(QString("Drawn: %1  Culled: %2  Draw calls: %3 (%4/%5 binds)  GPU mem: %6/%7 MB (%8 blocks, %9% frag)")
+                                  .arg(stats.drawnEntities)
+                                  .arg(stats.culledEntities)
+                                  .arg(stats.drawCalls)
+                                  .arg(stats.pipelineBinds)
+                                  .arg(stats.descriptorBinds)
+                                  .arg((memory.allocatedBytes + memory.dedicatedBytes) >> 20)
+                                  .arg((memory.blockBytes + memory.dedicatedBytes) >> 20)
+                                  .arg(memory.blockCount)
+                                  .arg(qRound(memory.externalFragmentation() * 100.0f)));
+
+    // Fra input ble lest til framen var ferdig på GPU-en, målt på rendertråden
+    bbl::FramePacer::Stats pacing = mVulkanWindow->getPacingStats();
+    renderStatsLabel->setText(renderStatsLabel->text() + QString("  Latency: %1 ms").arg(pacing.latencyMs, 0, 'f', 1));
+
+    // Tallene er noen frames gamle, GPU-en leses aldri mens den jobber
+    bbl::GpuProfiler::Results profile = mVulkanWindow->getGpuProfile();
+    if (profile.frame == 0) {
+        gpuProfilerView->setPlainText(tr("No GPU timings (timestamps not supported or no frames yet)"));
+        return;
+    }
+    renderStatsLabel->setText(renderStatsLabel->text() + QString("  GPU: %1 ms").arg(profile.frameMs(), 0, 'f', 2));
+
+    QString text = QString("Frame %1\n\n%2 %3 %4\n").arg(profile.frame)
+                       .arg(tr("Scope"), -32).arg(tr("ms"), 9).arg(tr("avg ms"), 9);
+    for (const bbl::GpuProfiler::Scope& scope : profile.scopes) {
+        QString name = QString(scope.depth * 2, ' ') + QString::fromStdString(scope.name);
+        text += QString("%1 %2 %3\n").arg(name, -32).arg(scope.ms, 9, 'f', 3).arg(scope.averageMs, 9, 'f', 3);
+    }
+
+    if (profile.hasStatistics) {
+        const bbl::GpuProfiler::PipelineStatistics& stats = profile.statistics;
+        text += QString("\nInput vertices        %1\nInput primitives      %2\nVertex invocations    %3\n"
+                        "Clipped primitives    %4\nFragment invocations  %5\nCompute invocations   %6\n")
+                    .arg(stats.inputVertices).arg(stats.inputPrimitives).arg(stats.vertexInvocations)
+                    .arg(stats.clippingPrimitives).arg(stats.fragmentInvocations).arg(stats.computeInvocations);
+    }
+    gpuProfilerView->setPlainText(text);
+}
+
 //=============================================================================
 // UI Creation Helpers
 //=============================================================================
@@ -195,6 +247,18 @@ QWidget* MainWindow::createTopBar()
     playButton->setStyleSheet(playButtonStyle(false));
     connect(playButton, &QPushButton::clicked, this, &MainWindow::onPlayToggled);
 
+    // -----Reset button------
+    resetButton = new QPushButton("⟲ Reset", topBar);
+    resetButton->setFixedSize(80, 40);
+    resetButton->setToolTip("Reset the world to how it was before Play");
+    resetButton->setEnabled(false);
+    resetButton->setStyleSheet(
+        "QPushButton { background-color: #6c757d; color: white; border-radius: 6px; }"
+        "QPushButton:hover { background-color: #868e96; }"
+        "QPushButton:disabled { background-color: #3a3f44; color: #888888; }"
+        );
+    connect(resetButton, &QPushButton::clicked, this, &MainWindow::onResetClicked);
+
     // ----Button layout-----
     topLayout->addWidget(button1);
     topLayout->addWidget(button2);
@@ -204,6 +268,7 @@ QWidget* MainWindow::createTopBar()
     topLayout->addWidget(button6);
     topLayout->addStretch();
     topLayout->addWidget(playButton);
+    topLayout->addWidget(resetButton);
     topLayout->addStretch();
 
     // ----Connect buttons------
@@ -236,6 +301,16 @@ QTabWidget* MainWindow::createTabWidget()
     QWidget* secondTab = new QWidget(tabWidget);
     tabWidget->addTab(secondTab, tr("Second Tab"));
 
+    // --- GPU Profiler Tab ---
+    QWidget* profilerTab = new QWidget(tabWidget);
+    QVBoxLayout* profilerLayout = new QVBoxLayout(profilerTab);
+    gpuProfilerView = new QPlainTextEdit(profilerTab);
+    gpuProfilerView->setReadOnly(true);
+    gpuProfilerView->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    profilerLayout->setContentsMargins(4, 4, 4, 4);
+    profilerLayout->addWidget(gpuProfilerView);
+    tabWidget->addTab(profilerTab, tr("GPU Profiler"));
+
     return tabWidget;
 }
 
@@ -350,31 +425,34 @@ void MainWindow::onButton1Clicked()
     bbl::SceneManager* sceneManager = mVulkanWindow->getSceneManager();
     bbl::GameWorld* gameWorld = mVulkanWindow->getGameWorld();
 
-    if (entityManager && entityID != bbl::INVALID_ENTITY) {
-        entityManager->addComponent(entityID, bbl::Physics{});
-        entityManager->addComponent(entityID, bbl::Collision{});
-        entityManager->addComponent(entityID, bbl::Audio{});
+    // Alle komponentene legges til mellom to simuleringssteg
+    mVulkanWindow->getSimulation()->execute([&] {
+        if (entityManager && entityID != bbl::INVALID_ENTITY) {
+            entityManager->addComponent(entityID, bbl::Physics{});
+            entityManager->addComponent(entityID, bbl::Collision{});
+            entityManager->addComponent(entityID, bbl::Audio{});
 
-        // Legger til at ballen blir tracket
-        if (gameWorld && gameWorld->getTrackingSystem())
-        {
-            gameWorld->getTrackingSystem()->enableTracking(
-                entityID,
-                0.5f, // Sampler hvert 500ms
-                glm::vec3(1.0f, 0.0f, 0.0f) // Setter fargen på tracen, fungerer ikke helt optimalt
-                );
-        }
+            // Legger til at ballen blir tracket
+            if (gameWorld && gameWorld->getTrackingSystem())
+            {
+                gameWorld->getTrackingSystem()->enableTracking(
+                    entityID,
+                    0.5f, // Sampler hvert 500ms
+                    glm::vec3(1.0f, 0.0f, 0.0f) // Setter fargen på tracen, fungerer ikke helt optimalt
+                    );
+            }
 
-        if (sceneManager)
-        {
-            sceneManager->setEntityName(entityID, "ball");
-            sceneManager->markSceneDirty();
-        }
+            if (sceneManager)
+            {
+                sceneManager->setEntityName(entityID, "ball");
+                sceneManager->markSceneDirty();
+            }
 
-        qInfo() << "Spawned ball with EntityID:" << entityID;
-    }
+            qInfo() << "Spawned ball with EntityID:" << entityID;
+        }
+    });
 
-    mVulkanWindow->recreateSwapChain();
+    mVulkanWindow->markSceneChanged();
     mVulkanWindow->requestUpdate();
     updateSceneObjectList();
 }
@@ -412,17 +490,19 @@ void MainWindow::onButton4Clicked()
 
     bbl::EntityManager* entityManager = mVulkanWindow->getEntityManager();
 
-    bbl::Render* renderComp = entityManager->getComponent<bbl::Render>(entityID);
-    bbl::Transform* transformComp = entityManager->getComponent<bbl::Transform>(entityID);
+    mVulkanWindow->getSimulation()->execute([&] {
+        bbl::Render* renderComp = entityManager->getComponent<bbl::Render>(entityID);
+        bbl::Transform* transformComp = entityManager->getComponent<bbl::Transform>(entityID);
 
-    renderComp->usePoint = true;
-    renderComp->useLine = false;
-    renderComp->usePhong = false;
+        renderComp->usePoint = true;
+        renderComp->useLine = false;
+        renderComp->usePhong = false;
 
-    transformComp->rotation.x = -1.6;
-    transformComp->position.y = -10;
+        transformComp->rotation.x = -1.6;
+        transformComp->position.y = -10;
+    });
 
-    mVulkanWindow->recreateSwapChain();
+    mVulkanWindow->markSceneChanged();
     updateSceneObjectList();
 }
 
@@ -430,28 +510,31 @@ void MainWindow::onButton5Clicked()
 {
     mVulkanWindow->spawnTerrain();
 
-    for (int i = 0; i < 8; i++)
-    {
-    bbl::EntityID entityID = mVulkanWindow->spawnModel(
-        "../../Assets/Models/Cube.obj",
-        "../../Assets/Textures/notexture.jpg",
-        glm::vec3(0.f, 0.f, 0.f)
-        );
+    // Alle kubene kommer med i samme snapshot
+    mVulkanWindow->getSimulation()->execute([&] {
+        for (int i = 0; i < 8; i++)
+        {
+        bbl::EntityID entityID = mVulkanWindow->spawnModel(
+            "../../Assets/Models/Cube.obj",
+            "../../Assets/Textures/notexture.jpg",
+            glm::vec3(0.f, 0.f, 0.f)
+            );
 
-    bbl::EntityManager* entityManager = mVulkanWindow->getEntityManager();
+        bbl::EntityManager* entityManager = mVulkanWindow->getEntityManager();
 
-    entityManager->addComponent(entityID, bbl::Collision{});
+        entityManager->addComponent(entityID, bbl::Collision{});
 
-    bbl::Collision* collisionComponent = entityManager->getComponent<bbl::Collision>(entityID);
-    bbl::Transform* transformComponent = entityManager->getComponent<bbl::Transform>(entityID);
+        bbl::Collision* collisionComponent = entityManager->getComponent<bbl::Collision>(entityID);
+        bbl::Transform* transformComponent = entityManager->getComponent<bbl::Transform>(entityID);
 
-    collisionComponent->isStatic = true;
-    collisionComponent->colliderSize = glm::vec3(3, 3, 3);
-    transformComponent->position = glm::vec3(glm::vec3(250 + (i * 5), 85, -250 + (i * 8)));
-    transformComponent->scale = glm::vec3(4, 4, 4);
-    }
+        collisionComponent->isStatic = true;
+        collisionComponent->colliderSize = glm::vec3(3, 3, 3);
+        transformComponent->position = glm::vec3(glm::vec3(250 + (i * 5), 85, -250 + (i * 8)));
+        transformComponent->scale = glm::vec3(4, 4, 4);
+        }
+    });
 
-    mVulkanWindow->recreateSwapChain();
+    mVulkanWindow->markSceneChanged();
     updateSceneObjectList();
 }
 
@@ -481,8 +564,10 @@ void MainWindow::onButton6Clicked()
     bbl::SceneManager* sceneManager = mVulkanWindow->getSceneManager();
     if (sceneManager)
     {
-        sceneManager->createNewScene("New Scene");
+        mVulkanWindow->getSimulation()->execute([&] { sceneManager->createNewScene("New Scene"); });
     }
+    mPlaySnapshot.clear();
+    resetButton->setEnabled(false);
 
     // Slett ting i component panelet
     QLayoutItem* layoutItem;
@@ -503,7 +588,7 @@ void MainWindow::onButton6Clicked()
 
     // Oppdater bruker grensesnittet
     updateSceneObjectList();
-    mVulkanWindow->recreateSwapChain();
+    mVulkanWindow->markSceneChanged();
     mVulkanWindow->requestUpdate();
 
     qInfo() << "Slettet scenen";
@@ -528,44 +613,43 @@ void MainWindow::spawnBallsDelay()
         bbl::SceneManager* sceneManager = mVulkanWindow->getSceneManager();
         bbl::GameWorld* gameWorld = mVulkanWindow->getGameWorld();
 
-        if (entityManager && entityID != bbl::INVALID_ENTITY)
-        {
-            entityManager->addComponent(entityID, bbl::Physics{});
-            entityManager->addComponent(entityID, bbl::Collision{});
-
-            if (entityManager->hasComponent<bbl::Collision>(entityID))
+        mVulkanWindow->getSimulation()->execute([&] {
+            if (entityManager && entityID != bbl::INVALID_ENTITY)
             {
-                const auto& Collision = entityManager->getComponent<bbl::Collision>(entityID);
+                entityManager->addComponent(entityID, bbl::Physics{});
+                entityManager->addComponent(entityID, bbl::Collision{});
 
-                Collision->isStatic = true;
+                if (entityManager->hasComponent<bbl::Collision>(entityID))
+                {
+                    const auto& Collision = entityManager->getComponent<bbl::Collision>(entityID);
 
-            }
+                    Collision->isStatic = true;
 
-            // Legger til at ballen blir tracket
-            if (gameWorld && gameWorld->getTrackingSystem())
-            {
-                gameWorld->getTrackingSystem()->enableTracking(
-                    entityID,
-                    1.f, // Velg samplingfarten
-                    glm::vec3(1.0f, 0.0f, 0.0f) // Setter fargen på tracen
-                    );
-            }
+                }
 
-            if (sceneManager)
-            {
-                sceneManager->setEntityName(entityID, "ball_" + std::to_string(ballsSpawned + 1));
-                sceneManager->markSceneDirty();
-            }
+                // Legger til at ballen blir tracket
+                if (gameWorld && gameWorld->getTrackingSystem())
+                {
+                    gameWorld->getTrackingSystem()->enableTracking(
+                        entityID,
+                        1.f, // Velg samplingfarten
+                        glm::vec3(1.0f, 0.0f, 0.0f) // Setter fargen på tracen
+                        );
+                }
 
-            ballsSpawned++;
-            qInfo() << "Spawned ball" << ballsSpawned << "with EntityID:" << entityID;
-        }
+                if (sceneManager)
+                {
+                    sceneManager->setEntityName(entityID, "ball_" + std::to_string(ballsSpawned + 1));
+                    sceneManager->markSceneDirty();
+                }
 
-        if (ballsSpawned >= maxBallsSpawn)
-        {
-         mVulkanWindow->recreateSwapChain();
-        }
-        mVulkanWindow->requestUpdate();
+                ballsSpawned++;
+                qInfo() << "Spawned ball" << ballsSpawned << "with EntityID:" << entityID;
+            }
+        });
+
+        // Billig nå, så hver ball blir synlig med en gang
+        mVulkanWindow->markSceneChanged();
         updateSceneObjectList();
 
 
@@ -577,6 +661,18 @@ void MainWindow::spawnBallsDelay()
 
 }
 
+void MainWindow::selectEntity(bbl::EntityID entityID)
+{
+    for (int i = 0; i < sceneObjectList->count(); ++i) {
+        QListWidgetItem* item = sceneObjectList->item(i);
+        if (item && item->data(Qt::UserRole).toULongLong() == static_cast<qulonglong>(entityID)) {
+            sceneObjectList->setCurrentItem(item);
+            onSceneObjectSelected(item);
+            return;
+        }
+    }
+}
+
 void MainWindow::onSceneObjectSelected(QListWidgetItem* item)
 {
     if (!mVulkanWindow) {
@@ -606,114 +702,114 @@ void MainWindow::onSceneObjectSelected(QListWidgetItem* item)
         return;
     }
 
-    int componentCount = 0;
-
-    // Check for Transform component
-    if (entityManager->hasComponent<bbl::Transform>(selectedEntityID)) {
-        const auto& transform = entityManager->getComponent<bbl::Transform>(selectedEntityID);
-        QVariantMap transformFields;
-        transformFields["Position X"] = transform->position.x;
-        transformFields["Position Y"] = transform->position.y;
-        transformFields["Position Z"] = transform->position.z;
-        transformFields["Rotation X"] = transform->rotation.x;
-        transformFields["Rotation Y"] = transform->rotation.y;
-        transformFields["Rotation Z"] = transform->rotation.z;
-        transformFields["Scale X"] = transform->scale.x;
-        transformFields["Scale Y"] = transform->scale.y;
-        transformFields["Scale Z"] = transform->scale.z;
-        addComponentUI("Transform Component", transformFields);
-        componentCount++;
-    }
+    // Feltene kopieres mens simuleringen står mellom to steg; widgetene bygges etterpå,
+    // så simuleringen ikke venter på editoren
+    std::vector<std::pair<QString, QVariantMap>> panels;
+    mVulkanWindow->getSimulation()->execute([&] {
+        // Check for Transform component
+        if (entityManager->hasComponent<bbl::Transform>(selectedEntityID)) {
+            const auto& transform = entityManager->getComponent<bbl::Transform>(selectedEntityID);
+            QVariantMap transformFields;
+            transformFields["Position X"] = transform->position.x;
+            transformFields["Position Y"] = transform->position.y;
+            transformFields["Position Z"] = transform->position.z;
+            transformFields["Rotation X"] = transform->rotation.x;
+            transformFields["Rotation Y"] = transform->rotation.y;
+            transformFields["Rotation Z"] = transform->rotation.z;
+            transformFields["Scale X"] = transform->scale.x;
+            transformFields["Scale Y"] = transform->scale.y;
+            transformFields["Scale Z"] = transform->scale.z;
+            panels.emplace_back("Transform Component", transformFields);
+        }
 
-    // Check for Render component
-    if (entityManager->hasComponent<bbl::Render>(selectedEntityID)) {
-        const auto& render = entityManager->getComponent<bbl::Render>(selectedEntityID);
-        QVariantMap renderFields;
-        renderFields["Visible"] = render->visible;
-        renderFields["Use Phong"] = render->usePhong;
-        renderFields["Use Points"] = render->usePoint;
-        renderFields["Use Lines"] = render->useLine;
-        addComponentUI("Render Component", renderFields);
-        componentCount++;
-    }
+        // Check for Render component
+        if (entityManager->hasComponent<bbl::Render>(selectedEntityID)) {
+            const auto& render = entityManager->getComponent<bbl::Render>(selectedEntityID);
+            QVariantMap renderFields;
+            renderFields["Visible"] = render->visible;
+            renderFields["Use Phong"] = render->usePhong;
+            renderFields["Use Points"] = render->usePoint;
+            renderFields["Use Lines"] = render->useLine;
+            panels.emplace_back("Render Component", renderFields);
+        }
 
-    // Check for Mesh component
-    if (entityManager->hasComponent<bbl::Mesh>(selectedEntityID)) {
-        QVariantMap meshFields;
-        meshFields["Mesh Resource"] = "MeshID";
-        addComponentUI("Mesh Component", meshFields);
-        componentCount++;
-    }
+        // Check for Mesh component
+        if (entityManager->hasComponent<bbl::Mesh>(selectedEntityID)) {
+            QVariantMap meshFields;
+            meshFields["Mesh Resource"] = "MeshID";
+            panels.emplace_back("Mesh Component", meshFields);
+        }
 
-    // Check for Texture component
-    if (entityManager->hasComponent<bbl::Texture>(selectedEntityID)) {
-        QVariantMap textureFields;
-        textureFields["Texture Resource"] = "TextureID";
-        addComponentUI("Texture Component", textureFields);
-        componentCount++;
-    }
+        // Check for Texture component
+        if (entityManager->hasComponent<bbl::Texture>(selectedEntityID)) {
+            QVariantMap textureFields;
+            textureFields["Texture Resource"] = "TextureID";
+            panels.emplace_back("Texture Component", textureFields);
+        }
 
-    // Check for Physics component
-    if (entityManager->hasComponent<bbl::Physics>(selectedEntityID)) {
-        const auto& physics = entityManager->getComponent<bbl::Physics>(selectedEntityID);
-        QVariantMap physicsFields;
-        physicsFields["Velocity X"] = physics->velocity.x;
-        physicsFields["Velocity Y"] = physics->velocity.y;
-        physicsFields["Velocity Z"] = physics->velocity.z;
-        physicsFields["Acceleration X"] = physics->acceleration.x;
-        physicsFields["Acceleration Y"] = physics->acceleration.y;
-        physicsFields["Acceleration Z"] = physics->acceleration.z;
-        physicsFields["Mass"] = physics->mass;
-        physicsFields["Use Gravity"] = physics->useGravity;
-        addComponentUI("Physics Component", physicsFields);
-        componentCount++;
-    }
+        // Check for Physics component
+        if (entityManager->hasComponent<bbl::Physics>(selectedEntityID)) {
+            const auto& physics = entityManager->getComponent<bbl::Physics>(selectedEntityID);
+            QVariantMap physicsFields;
+            physicsFields["Velocity X"] = physics->velocity.x;
+            physicsFields["Velocity Y"] = physics->velocity.y;
+            physicsFields["Velocity Z"] = physics->velocity.z;
+            physicsFields["Acceleration X"] = physics->acceleration.x;
+            physicsFields["Acceleration Y"] = physics->acceleration.y;
+            physicsFields["Acceleration Z"] = physics->acceleration.z;
+            physicsFields["Mass"] = physics->mass;
+            physicsFields["Use Gravity"] = physics->useGravity;
+            panels.emplace_back("Physics Component", physicsFields);
+        }
 
-    // Check for Audio component
-    if (entityManager->hasComponent<bbl::Audio>(selectedEntityID)) {
-        const auto& audio = entityManager->getComponent<bbl::Audio>(selectedEntityID);
-        QVariantMap audioFields;
-        audioFields["Volume"] = audio->volume;
-        audioFields["Muted"] = audio->muted;
-        audioFields["Looping"] = audio->looping;
-        audioFields["Attack Sound"] = QString::fromStdString(audio->attackSound);
-        audioFields["Death Sound"] = QString::fromStdString(audio->deathSound);
-        addComponentUI("Audio Component", audioFields);
-        componentCount++;
-    }
+        // Check for Audio component
+        if (entityManager->hasComponent<bbl::Audio>(selectedEntityID)) {
+            const auto& audio = entityManager->getComponent<bbl::Audio>(selectedEntityID);
+            QVariantMap audioFields;
+            audioFields["Volume"] = audio->volume;
+            audioFields["Muted"] = audio->muted;
+            audioFields["Looping"] = audio->looping;
+            audioFields["Attack Sound"] = QString::fromStdString(audio->attackSound);
+            audioFields["Death Sound"] = QString::fromStdString(audio->deathSound);
+            panels.emplace_back("Audio Component", audioFields);
+        }
 
-    // Check for Collision component
-    if (entityManager->hasComponent<bbl::Collision>(selectedEntityID)) {
-        const auto& collision = entityManager->getComponent<bbl::Collision>(selectedEntityID);
-        QVariantMap collisionFields;
-        collisionFields["Size X"] = static_cast<float>(collision->colliderSize.x);
-        collisionFields["Size Y"] = static_cast<float>(collision->colliderSize.y);
-        collisionFields["Size Z"] = static_cast<float>(collision->colliderSize.z);
-        collisionFields["Is Grounded"] = collision->isGrounded;
-        collisionFields["Is Colliding"] = collision->isColliding;
-        collisionFields["Is Trigger"] = collision->isTrigger;
-        collisionFields["Is Static"] = collision->isStatic;
-        addComponentUI("Collision Component", collisionFields);
-        componentCount++;
-    }
+        // Check for Collision component
+        if (entityManager->hasComponent<bbl::Collision>(selectedEntityID)) {
+            const auto& collision = entityManager->getComponent<bbl::Collision>(selectedEntityID);
+            QVariantMap collisionFields;
+            collisionFields["Size X"] = static_cast<float>(collision->colliderSize.x);
+            collisionFields["Size Y"] = static_cast<float>(collision->colliderSize.y);
+            collisionFields["Size Z"] = static_cast<float>(collision->colliderSize.z);
+            collisionFields["Is Grounded"] = collision->isGrounded;
+            collisionFields["Is Colliding"] = collision->isColliding;
+            collisionFields["Is Trigger"] = collision->isTrigger;
+            collisionFields["Is Static"] = collision->isStatic;
+            panels.emplace_back("Collision Component", collisionFields);
+        }
 
-    // Check for Tracking component
-    if (entityManager->hasComponent<bbl::Tracking>(selectedEntityID)) {
-        const auto& tracking = entityManager->getComponent<bbl::Tracking>(selectedEntityID);
-        QVariantMap trackingFields;
-        trackingFields["Is Tracking"] = tracking->isTracking;
-        trackingFields["Sampling Interval"] = tracking->samplingInterval;
-        trackingFields["Max Control Points"] = static_cast<int>(tracking->maxControlPoints);
-        trackingFields["Curve Resolution"] = static_cast<int>(tracking->curveResolution);
-        trackingFields["Line Width"] = tracking->lineWidth;
-        trackingFields["Trace Color R"] = tracking->traceColor.r;
-        trackingFields["Trace Color G"] = tracking->traceColor.g;
-        trackingFields["Trace Color B"] = tracking->traceColor.b;
-        trackingFields["Control Points Count"] = static_cast<int>(tracking->controlPoints.size());
-        trackingFields["Curve Points Count"] = static_cast<int>(tracking->curvePoints.size());
-        addComponentUI("Tracking Component", trackingFields);
-        componentCount++;
+        // Check for Tracking component
+        if (entityManager->hasComponent<bbl::Tracking>(selectedEntityID)) {
+            const auto& tracking = entityManager->getComponent<bbl::Tracking>(selectedEntityID);
+            QVariantMap trackingFields;
+            trackingFields["Is Tracking"] = tracking->isTracking;
+            trackingFields["Sampling Interval"] = tracking->samplingInterval;
+            trackingFields["Max Control Points"] = static_cast<int>(tracking->maxControlPoints);
+            trackingFields["Curve Resolution"] = static_cast<int>(tracking->curveResolution);
+            trackingFields["Line Width"] = tracking->lineWidth;
+            trackingFields["Trace Color R"] = tracking->traceColor.r;
+            trackingFields["Trace Color G"] = tracking->traceColor.g;
+            trackingFields["Trace Color B"] = tracking->traceColor.b;
+            trackingFields["Control Points Count"] = static_cast<int>(tracking->controlPoints.size());
+            trackingFields["Curve Points Count"] = static_cast<int>(tracking->curvePoints.size());
+            panels.emplace_back("Tracking Component", trackingFields);
+        }
+    });
+
+    for (const auto& [title, fields] : panels) {
+        addComponentUI(title, fields);
     }
+    int componentCount = static_cast<int>(panels.size());
 
 
     // Get entity name for logging
@@ -751,36 +847,38 @@ void MainWindow::showAddComponentDialog()
 
     // Create list of available components (only show components that aren't already on the entity)
     QStringList availableComponents;
+    mVulkanWindow->getSimulation()->execute([&] {
 
-    if (!entityManager->hasComponent<bbl::Physics>(entityID))
-    {
-        availableComponents << "Physics Component";
-    }
-    if (!entityManager->hasComponent<bbl::Collision>(entityID))
-    {
-        availableComponents << "Collision Component";
-    }
-    if (!entityManager->hasComponent<bbl::Audio>(entityID))
-    {
-        availableComponents << "Audio Component";
-    }
-    if (!entityManager->hasComponent<bbl::Render>(entityID))
-    {
-        availableComponents << "Render Component";
-    }
-    if (!entityManager->hasComponent<bbl::Texture>(entityID))
-    {
-        availableComponents << "Texture Component";
-    }
-    if (!entityManager->hasComponent<bbl::Mesh>(entityID))
-    {
-        availableComponents << "Mesh Component";
-    }
+        if (!entityManager->hasComponent<bbl::Physics>(entityID))
+        {
+            availableComponents << "Physics Component";
+        }
+        if (!entityManager->hasComponent<bbl::Collision>(entityID))
+        {
+            availableComponents << "Collision Component";
+        }
+        if (!entityManager->hasComponent<bbl::Audio>(entityID))
+        {
+            availableComponents << "Audio Component";
+        }
+        if (!entityManager->hasComponent<bbl::Render>(entityID))
+        {
+            availableComponents << "Render Component";
+        }
+        if (!entityManager->hasComponent<bbl::Texture>(entityID))
+        {
+            availableComponents << "Texture Component";
+        }
+        if (!entityManager->hasComponent<bbl::Mesh>(entityID))
+        {
+            availableComponents << "Mesh Component";
+        }
 
-    if (!entityManager->hasComponent<bbl::Tracking>(entityID))
-    {
-        availableComponents << "Tracking Component";
-    }
+        if (!entityManager->hasComponent<bbl::Tracking>(entityID))
+        {
+            availableComponents << "Tracking Component";
+        }
+    });
 
     if (availableComponents.isEmpty()) {
         QMessageBox::information(this, "No Components Available",
@@ -823,130 +921,135 @@ void MainWindow::addComponentToEntity(const QString& componentName)
     bool added = false;
     QString message;
 
-    if (componentName == "Physics Component") {
-        if (!entityManager->hasComponent<bbl::Physics>(entityID)) {
-            bbl::Physics newPhysics{};
-            // Set default values
-            newPhysics.velocity = glm::vec3(0.0f);
-            newPhysics.acceleration = glm::vec3(0.0f);
-            newPhysics.mass = 1.0f;
-            newPhysics.useGravity = true;
-
-            entityManager->addComponent(entityID, newPhysics);
-            added = true;
-            message = "Added Physics component to entity";
-        } else {
-            message = "Entity already has Physics component";
-        }
-    }
-    else if (componentName == "Collision Component") {
-        if (!entityManager->hasComponent<bbl::Collision>(entityID)) {
-            bbl::Collision newCollision{};
-            // Set default values
-            newCollision.colliderSize = glm::vec3(1.0f);
-            newCollision.isGrounded = false;
-            newCollision.isTrigger = false;
-            newCollision.isStatic = true;
-
-            entityManager->addComponent(entityID, newCollision);
-            added = true;
-            message = "Added Collision component to entity";
-        } else {
-            message = "Entity already has Collision component";
+    bool known = mVulkanWindow->getSimulation()->execute([&] {
+        if (componentName == "Physics Component") {
+            if (!entityManager->hasComponent<bbl::Physics>(entityID)) {
+                bbl::Physics newPhysics{};
+                // Set default values
+                newPhysics.velocity = glm::vec3(0.0f);
+                newPhysics.acceleration = glm::vec3(0.0f);
+                newPhysics.mass = 1.0f;
+                newPhysics.useGravity = true;
+
+                entityManager->addComponent(entityID, newPhysics);
+                added = true;
+                message = "Added Physics component to entity";
+            } else {
+                message = "Entity already has Physics component";
+            }
         }
-    }
-    else if (componentName == "Audio Component") {
-        if (!entityManager->hasComponent<bbl::Audio>(entityID)) {
-            bbl::Audio newAudio{};
-            // Set default values
-            newAudio.volume = 1.0f;
-            newAudio.muted = false;
-            newAudio.looping = false;
-            newAudio.attackSound = "";
-            newAudio.deathSound = "";
-            newAudio.attackBuffer = 0;
-            newAudio.deathBuffer = 0;
-            newAudio.attackSource = 0;
-            newAudio.deathSource = 0;
-
-            entityManager->addComponent(entityID, newAudio);
-            added = true;
-            message = "Added Audio component to entity";
-        } else {
-            message = "Entity already has Audio component";
+        else if (componentName == "Collision Component") {
+            if (!entityManager->hasComponent<bbl::Collision>(entityID)) {
+                bbl::Collision newCollision{};
+                // Set default values
+                newCollision.colliderSize = glm::vec3(1.0f);
+                newCollision.isGrounded = false;
+                newCollision.isTrigger = false;
+                newCollision.isStatic = true;
+
+                entityManager->addComponent(entityID, newCollision);
+                added = true;
+                message = "Added Collision component to entity";
+            } else {
+                message = "Entity already has Collision component";
+            }
         }
-    }
-    else if (componentName == "Render Component") {
-        if (!entityManager->hasComponent<bbl::Render>(entityID)) {
-            // Check if entity has a mesh component to get mesh resource ID
-            uint32_t meshResourceID = 0;
-            if (auto* meshComp = entityManager->getComponent<bbl::Mesh>(entityID)) {
-                meshResourceID = meshComp->meshResourceID;
+        else if (componentName == "Audio Component") {
+            if (!entityManager->hasComponent<bbl::Audio>(entityID)) {
+                bbl::Audio newAudio{};
+                // Set default values
+                newAudio.volume = 1.0f;
+                newAudio.muted = false;
+                newAudio.looping = false;
+                newAudio.attackSound = "";
+                newAudio.deathSound = "";
+                newAudio.attackBuffer = 0;
+                newAudio.deathBuffer = 0;
+                newAudio.attackSource = 0;
+                newAudio.deathSource = 0;
+
+                entityManager->addComponent(entityID, newAudio);
+                added = true;
+                message = "Added Audio component to entity";
+            } else {
+                message = "Entity already has Audio component";
             }
+        }
+        else if (componentName == "Render Component") {
+            if (!entityManager->hasComponent<bbl::Render>(entityID)) {
+                // Check if entity has a mesh component to get mesh resource ID
+                uint32_t meshResourceID = 0;
+                if (auto* meshComp = entityManager->getComponent<bbl::Mesh>(entityID)) {
+                    meshResourceID = meshComp->meshResourceID;
+                }
 
-            bbl::Render newRender{};
-            // Set default values
-            newRender.meshResourceID = meshResourceID;
-            newRender.textureResourceID = 0;
-            newRender.visible = true;
-            newRender.usePhong = false;
-            newRender.usePoint = false;
-            newRender.useLine = false;
-
-            entityManager->addComponent(entityID, newRender);
-            added = true;
-            message = "Added Render component to entity";
-        } else {
-            message = "Entity already has Render component";
+                bbl::Render newRender{};
+                // Set default values
+                newRender.meshResourceID = meshResourceID;
+                newRender.textureResourceID = 0;
+                newRender.visible = true;
+                newRender.usePhong = false;
+                newRender.usePoint = false;
+                newRender.useLine = false;
+
+                entityManager->addComponent(entityID, newRender);
+                added = true;
+                message = "Added Render component to entity";
+            } else {
+                message = "Entity already has Render component";
+            }
         }
-    }
-    else if (componentName == "Texture Component") {
-        if (!entityManager->hasComponent<bbl::Texture>(entityID)) {
-            bbl::Texture newTexture{};
-            // Set default values
-            newTexture.textureResourceID = 0;  // No texture initially
-
-            entityManager->addComponent(entityID, newTexture);
-            added = true;
-            message = "Added Texture component to entity";
-        } else {
-            message = "Entity already has Texture component";
+        else if (componentName == "Texture Component") {
+            if (!entityManager->hasComponent<bbl::Texture>(entityID)) {
+                bbl::Texture newTexture{};
+                // Set default values
+                newTexture.textureResourceID = 0;  // No texture initially
+
+                entityManager->addComponent(entityID, newTexture);
+                added = true;
+                message = "Added Texture component to entity";
+            } else {
+                message = "Entity already has Texture component";
+            }
         }
-    }
-    else if (componentName == "Mesh Component") {
-        if (!entityManager->hasComponent<bbl::Mesh>(entityID)) {
-            bbl::Mesh newMesh{};
-            // Set default values
-            newMesh.meshResourceID = 0;  // No mesh initially
-
-            entityManager->addComponent(entityID, newMesh);
-            added = true;
-            message = "Added Mesh component to entity";
-        } else {
-            message = "Entity already has Mesh component";
+        else if (componentName == "Mesh Component") {
+            if (!entityManager->hasComponent<bbl::Mesh>(entityID)) {
+                bbl::Mesh newMesh{};
+                // Set default values
+                newMesh.meshResourceID = 0;  // No mesh initially
+
+                entityManager->addComponent(entityID, newMesh);
+                added = true;
+                message = "Added Mesh component to entity";
+            } else {
+                message = "Entity already has Mesh component";
+            }
         }
-    }
-    else if (componentName == "Tracking Component") {
-        if (!entityManager->hasComponent<bbl::Tracking>(entityID)) {
-            bbl::Tracking newTracking{};
-            // Set default values
-            newTracking.samplingInterval = 0.1f;
-            newTracking.maxControlPoints = 50;
-            newTracking.curveResolution = 20;
-            newTracking.isTracking = false; // Start disabled
-            newTracking.traceColor = glm::vec3(1.0f, 0.0f, 0.0f); // Red by default
-            newTracking.lineWidth = 2.0f;
-
-            entityManager->addComponent(entityID, newTracking);
-            added = true;
-            message = "Added Tracking component to entity";
-        } else {
-            message = "Entity already has Tracking component";
+        else if (componentName == "Tracking Component") {
+            if (!entityManager->hasComponent<bbl::Tracking>(entityID)) {
+                bbl::Tracking newTracking{};
+                // Set default values
+                newTracking.samplingInterval = 0.1f;
+                newTracking.maxControlPoints = 50;
+                newTracking.curveResolution = 20;
+                newTracking.isTracking = false; // Start disabled
+                newTracking.traceColor = glm::vec3(1.0f, 0.0f, 0.0f); // Red by default
+                newTracking.lineWidth = 2.0f;
+
+                entityManager->addComponent(entityID, newTracking);
+                added = true;
+                message = "Added Tracking component to entity";
+            } else {
+                message = "Entity already has Tracking component";
+            }
         }
-    }
-
+        else {
+            return false;
+        }
+        return true;
+    });
 
-    else {
+    if (!known) {
         QMessageBox::warning(this, "Unknown Component",
                              QString("Unknown component type: %1").arg(componentName));
         return;
@@ -1010,59 +1113,65 @@ void MainWindow::removeComponentFromEntity(const QString& componentName)
 
     bool removed = false;
 
-    // Remove the appropriate component based on name
-    if (componentName == "Physics Component") {
-        if (entityManager->hasComponent<bbl::Physics>(entityID)) {
-            entityManager->removeComponent<bbl::Physics>(entityID);
-            removed = true;
-            qInfo() << "Removed Physics component from entity" << entityID;
+    bool known = mVulkanWindow->getSimulation()->execute([&] {
+        // Remove the appropriate component based on name
+        if (componentName == "Physics Component") {
+            if (entityManager->hasComponent<bbl::Physics>(entityID)) {
+                entityManager->removeComponent<bbl::Physics>(entityID);
+                removed = true;
+                qInfo() << "Removed Physics component from entity" << entityID;
+            }
         }
-    }
-    else if (componentName == "Collision Component") {
-        if (entityManager->hasComponent<bbl::Collision>(entityID)) {
-            entityManager->removeComponent<bbl::Collision>(entityID);
-            removed = true;
-            qInfo() << "Removed Collision component from entity" << entityID;
+        else if (componentName == "Collision Component") {
+            if (entityManager->hasComponent<bbl::Collision>(entityID)) {
+                entityManager->removeComponent<bbl::Collision>(entityID);
+                removed = true;
+                qInfo() << "Removed Collision component from entity" << entityID;
+            }
         }
-    }
-    else if (componentName == "Audio Component") {
-        if (entityManager->hasComponent<bbl::Audio>(entityID)) {
-            entityManager->removeComponent<bbl::Audio>(entityID);
-            removed = true;
-            qInfo() << "Removed Audio component from entity" << entityID;
+        else if (componentName == "Audio Component") {
+            if (entityManager->hasComponent<bbl::Audio>(entityID)) {
+                entityManager->removeComponent<bbl::Audio>(entityID);
+                removed = true;
+                qInfo() << "Removed Audio component from entity" << entityID;
+            }
         }
-    }
-    else if (componentName == "Render Component") {
-        if (entityManager->hasComponent<bbl::Render>(entityID)) {
-            entityManager->removeComponent<bbl::Render>(entityID);
-            removed = true;
-            qInfo() << "Removed Render component from entity" << entityID;
+        else if (componentName == "Render Component") {
+            if (entityManager->hasComponent<bbl::Render>(entityID)) {
+                entityManager->removeComponent<bbl::Render>(entityID);
+                removed = true;
+                qInfo() << "Removed Render component from entity" << entityID;
+            }
         }
-    }
-    else if (componentName == "Texture Component") {
-        if (entityManager->hasComponent<bbl::Texture>(entityID)) {
-            entityManager->removeComponent<bbl::Texture>(entityID);
-            removed = true;
-            qInfo() << "Removed Texture component from entity" << entityID;
+        else if (componentName == "Texture Component") {
+            if (entityManager->hasComponent<bbl::Texture>(entityID)) {
+                entityManager->removeComponent<bbl::Texture>(entityID);
+                removed = true;
+                qInfo() << "Removed Texture component from entity" << entityID;
+            }
         }
-    }
-    else if (componentName == "Mesh Component") {
-        if (entityManager->hasComponent<bbl::Mesh>(entityID)) {
-            entityManager->removeComponent<bbl::Mesh>(entityID);
-            removed = true;
-            qInfo() << "Removed Mesh component from entity" << entityID;
+        else if (componentName == "Mesh Component") {
+            if (entityManager->hasComponent<bbl::Mesh>(entityID)) {
+                entityManager->removeComponent<bbl::Mesh>(entityID);
+                removed = true;
+                qInfo() << "Removed Mesh component from entity" << entityID;
+            }
         }
-    }
 
-    else if (componentName == "Tracking Component") {
-        if (entityManager->hasComponent<bbl::Tracking>(entityID)) {
-            entityManager->removeComponent<bbl::Tracking>(entityID);
-            removed = true;
-            qInfo() << "Removed Tracking component from entity" << entityID;
+        else if (componentName == "Tracking Component") {
+            if (entityManager->hasComponent<bbl::Tracking>(entityID)) {
+                entityManager->removeComponent<bbl::Tracking>(entityID);
+                removed = true;
+                qInfo() << "Removed Tracking component from entity" << entityID;
+            }
         }
-    }
+        else {
+            return false;
+        }
+        return true;
+    });
 
-    else {
+    if (!known) {
         qWarning() << "Unknown component type for removal:" << componentName;
         return;
     }
@@ -1147,16 +1256,19 @@ void MainWindow::addComponentUI(const QString& name, const QVariantMap& fields)
             bbl::EntityID entityID = selected.value();
 
             if (auto* gameWorld = mVulkanWindow->getGameWorld()) {
-                if (auto* trackingSystem = gameWorld->getTrackingSystem()) {
-                    trackingSystem->clearTracking(entityID);
-                    mVulkanWindow->requestUpdate();
-                }
+                mVulkanWindow->getSimulation()->submit([=] {
+                    if (auto* trackingSystem = gameWorld->getTrackingSystem()) {
+                        trackingSystem->clearTracking(entityID);
+                    }
+                });
+                mVulkanWindow->requestUpdate();
             }
         });
 
         formLayout->addRow("", clearTraceButton);
     }
 
+    // Endringer fra feltene sendes til simuleringen som kommandoer og brukes ved neste steg
     for (auto it = fields.begin(); it != fields.end(); it++) {
         QWidget* editor = nullptr;
         int typeId = it.value().metaType().id();
@@ -1176,11 +1288,13 @@ void MainWindow::addComponentUI(const QString& name, const QVariantMap& fields)
                     bbl::EntityID entityID = selected.value();
                     auto* em = mVulkanWindow->getEntityManager();
                     if (!em) return;
-                    auto* phys = em->getComponent<bbl::Physics>(entityID);
-                    if (!phys) {return;}
-                    if (field == "Use Gravity") {
-                        phys->useGravity = val;
-                    }
+                    mVulkanWindow->getSimulation()->submit([=] {
+                        auto* phys = em->getComponent<bbl::Physics>(entityID);
+                        if (!phys) {return;}
+                        if (field == "Use Gravity") {
+                            phys->useGravity = val;
+                        }
+                    });
                     mVulkanWindow->requestUpdate();
                 });
             }
@@ -1195,25 +1309,27 @@ void MainWindow::addComponentUI(const QString& name, const QVariantMap& fields)
                             bbl::EntityID entityID = selected.value();
                             auto* em = mVulkanWindow->getEntityManager();
                             if (!em) return;
-                            auto* render = em->getComponent<bbl::Render>(entityID);
-                            if (!render) {return;}
-                            if (field == "Visible")
-                            {
-                                render->visible = valid;
-                            }
-                            else if (field == "Use Phong")
-                            {
-                                render->usePhong = valid;
-                            }
-                            else if (field == "Use Points")
-                            {
-                                render->usePoint = valid;
-                            }
-                            else if (field == "Use Lines")
-                            {
-                                render->useLine = valid;
-                            }
-                            mVulkanWindow->recreateSwapChain();
+                            mVulkanWindow->getSimulation()->submit([=] {
+                                auto* render = em->getComponent<bbl::Render>(entityID);
+                                if (!render) {return;}
+                                if (field == "Visible")
+                                {
+                                    render->visible = valid;
+                                }
+                                else if (field == "Use Phong")
+                                {
+                                    render->usePhong = valid;
+                                }
+                                else if (field == "Use Points")
+                                {
+                                    render->usePoint = valid;
+                                }
+                                else if (field == "Use Lines")
+                                {
+                                    render->useLine = valid;
+                                }
+                            });
+                            mVulkanWindow->markSceneChanged();
                             mVulkanWindow->requestUpdate();
                         });
             }
@@ -1226,18 +1342,20 @@ void MainWindow::addComponentUI(const QString& name, const QVariantMap& fields)
                     bbl::EntityID entityID = selected.value();
                     auto* em = mVulkanWindow->getEntityManager();
                     if (!em) return;
-                    auto* collision = em->getComponent<bbl::Collision>(entityID);
-                    if (!collision) return;
-
-                    if (field == "Is Grounded") {
-                        collision->isGrounded = val;
-                    } else if (field == "Is Colliding") {
-                        collision->isColliding = val;
-                    } else if (field == "Is Trigger") {
-                        collision->isTrigger = val;
-                    } else if (field == "Is Static") {
-                        collision->isStatic = val;
-                    }
+                    mVulkanWindow->getSimulation()->submit([=] {
+                        auto* collision = em->getComponent<bbl::Collision>(entityID);
+                        if (!collision) return;
+
+                        if (field == "Is Grounded") {
+                            collision->isGrounded = val;
+                        } else if (field == "Is Colliding") {
+                            collision->isColliding = val;
+                        } else if (field == "Is Trigger") {
+                            collision->isTrigger = val;
+                        } else if (field == "Is Static") {
+                            collision->isStatic = val;
+                        }
+                    });
                     mVulkanWindow->requestUpdate();
                 });
             }
@@ -1251,22 +1369,24 @@ void MainWindow::addComponentUI(const QString& name, const QVariantMap& fields)
                     bbl::EntityID entityID = selected.value();
                     auto* em = mVulkanWindow->getEntityManager();
                     if (!em) return;
-                    auto* tracking = em->getComponent<bbl::Tracking>(entityID);
-                    if (!tracking) return;
-
-                    if (field == "Is Tracking") {
-                        tracking->isTracking = val;
-                        // Enable/disable tracking through the tracking system
-                        if (auto* gameWorld = mVulkanWindow->getGameWorld()) {
-                            if (auto* trackingSystem = gameWorld->getTrackingSystem()) {
-                                if (val) {
-                                    trackingSystem->enableTracking(entityID, tracking->samplingInterval, tracking->traceColor);
-                                } else {
-                                    trackingSystem->disableTracking(entityID);
+                    mVulkanWindow->getSimulation()->submit([=] {
+                        auto* tracking = em->getComponent<bbl::Tracking>(entityID);
+                        if (!tracking) return;
+
+                        if (field == "Is Tracking") {
+                            tracking->isTracking = val;
+                            // Enable/disable tracking through the tracking system
+                            if (auto* gameWorld = mVulkanWindow->getGameWorld()) {
+                                if (auto* trackingSystem = gameWorld->getTrackingSystem()) {
+                                    if (val) {
+                                        trackingSystem->enableTracking(entityID, tracking->samplingInterval, tracking->traceColor);
+                                    } else {
+                                        trackingSystem->disableTracking(entityID);
+                                    }
                                 }
                             }
                         }
-                    }
+                    });
                     mVulkanWindow->requestUpdate();
                 });
             }
@@ -1299,29 +1419,31 @@ void MainWindow::addComponentUI(const QString& name, const QVariantMap& fields)
                     bbl::EntityID entityID = selected.value();
                     auto* em = mVulkanWindow->getEntityManager();
                     if (!em) return;
-                    auto* transform = em->getComponent<bbl::Transform>(entityID);
-                    if (!transform) return;
-
-                    if (field.contains("Position"))
-                    {
-                        if (field.endsWith("X")) transform->position.x = val;
-                        else if (field.endsWith("Y")) transform->position.y = val;
-                        else if (field.endsWith("Z")) transform->position.z = val;
-                    }
+                    mVulkanWindow->getSimulation()->submit([=] {
+                        auto* transform = em->getComponent<bbl::Transform>(entityID);
+                        if (!transform) return;
 
-                    else if (field.contains("Rotation"))
-                    {
-                        if (field.endsWith("X")) transform->rotation.x = val;
-                        else if (field.endsWith("Y")) transform->rotation.y = val;
-                        else if (field.endsWith("Z")) transform->rotation.z = val;
-                    }
+                        if (field.contains("Position"))
+                        {
+                            if (field.endsWith("X")) transform->position.x = val;
+                            else if (field.endsWith("Y")) transform->position.y = val;
+                            else if (field.endsWith("Z")) transform->position.z = val;
+                        }
 
-                    else if (field.contains("Scale"))
-                    {
-                        if (field.endsWith("X")) transform->scale.x = val;
-                        else if (field.endsWith("Y")) transform->scale.y = val;
-                        else if (field.endsWith("Z")) transform->scale.z = val;
-                    }
+                        else if (field.contains("Rotation"))
+                        {
+                            if (field.endsWith("X")) transform->rotation.x = val;
+                            else if (field.endsWith("Y")) transform->rotation.y = val;
+                            else if (field.endsWith("Z")) transform->rotation.z = val;
+                        }
+
+                        else if (field.contains("Scale"))
+                        {
+                            if (field.endsWith("X")) transform->scale.x = val;
+                            else if (field.endsWith("Y")) transform->scale.y = val;
+                            else if (field.endsWith("Z")) transform->scale.z = val;
+                        }
+                    });
                     mVulkanWindow->requestUpdate();
                 });
             }
@@ -1336,26 +1458,28 @@ void MainWindow::addComponentUI(const QString& name, const QVariantMap& fields)
                             bbl::EntityID entityID = selected.value();
                             auto* em = mVulkanWindow->getEntityManager();
                             if (!em) {return;}
-                            auto* phys = em->getComponent<bbl::Physics>(entityID);
-                            if(!phys) {return;}
-
-                            if (field.contains("Velocity"))
-                            {
-                                if (field.endsWith("X")) phys->velocity.x = val;
-                                else if (field.endsWith("Y")) phys->velocity.y = val;
-                                else if (field.endsWith("Z")) phys->velocity.z = val;
-                            }
+                            mVulkanWindow->getSimulation()->submit([=] {
+                                auto* phys = em->getComponent<bbl::Physics>(entityID);
+                                if(!phys) {return;}
+
+                                if (field.contains("Velocity"))
+                                {
+                                    if (field.endsWith("X")) phys->velocity.x = val;
+                                    else if (field.endsWith("Y")) phys->velocity.y = val;
+                                    else if (field.endsWith("Z")) phys->velocity.z = val;
+                                }
 
-                            else if (field.contains("Acceleration"))
-                            {
-                                if(field.endsWith("X")) phys->acceleration.x = val;
-                                else if (field.endsWith("Y")) phys->acceleration.y = val;
-                                else if (field.endsWith("Z")) phys->acceleration.z = val;
-                            }
+                                else if (field.contains("Acceleration"))
+                                {
+                                    if(field.endsWith("X")) phys->acceleration.x = val;
+                                    else if (field.endsWith("Y")) phys->acceleration.y = val;
+                                    else if (field.endsWith("Z")) phys->acceleration.z = val;
+                                }
 
-                            else if(field == "Mass") {
-                                phys->mass = val;
-                            }
+                                else if(field == "Mass") {
+                                    phys->mass = val;
+                                }
+                            });
                             mVulkanWindow->requestUpdate();
                         });
             }
@@ -1368,15 +1492,17 @@ void MainWindow::addComponentUI(const QString& name, const QVariantMap& fields)
                     bbl::EntityID entityID = selected.value();
                     auto* em = mVulkanWindow->getEntityManager();
                     if (!em) return;
-                    auto* collision = em->getComponent<bbl::Collision>(entityID);
-                    if (!collision) return;
-
-                    if (field.contains("Size"))
-                    {
-                        if      (field.endsWith("X"))      collision->colliderSize.x = val;
-                        else if (field.endsWith("Y"))      collision->colliderSize.y = val;
-                        else if (field.endsWith("Z"))      collision->colliderSize.z = val;
-                    }
+                    mVulkanWindow->getSimulation()->submit([=] {
+                        auto* collision = em->getComponent<bbl::Collision>(entityID);
+                        if (!collision) return;
+
+                        if (field.contains("Size"))
+                        {
+                            if      (field.endsWith("X"))      collision->colliderSize.x = val;
+                            else if (field.endsWith("Y"))      collision->colliderSize.y = val;
+                            else if (field.endsWith("Z"))      collision->colliderSize.z = val;
+                        }
+                    });
                     mVulkanWindow->requestUpdate();
                 });
             }
@@ -1390,36 +1516,37 @@ void MainWindow::addComponentUI(const QString& name, const QVariantMap& fields)
                     bbl::EntityID entityID = selected.value();
                     auto* em = mVulkanWindow->getEntityManager();
                     if (!em) return;
-                    auto* tracking = em->getComponent<bbl::Tracking>(entityID);
-                    if (!tracking) return;
-
-                    if (field == "Sampling Interval") {
-                        tracking->samplingInterval = static_cast<float>(val);
-                    } else if (field == "Line Width") {
-                        tracking->lineWidth = static_cast<float>(val);
-                    } else if (field == "Trace Color R") {
-                        tracking->traceColor.r = static_cast<float>(val);
-                    } else if (field == "Trace Color G") {
-                        tracking->traceColor.g = static_cast<float>(val);
-                    } else if (field == "Trace Color B") {
-                        tracking->traceColor.b = static_cast<float>(val);
-                    } else if (field == "Max Control Points") {
-                        tracking->maxControlPoints = static_cast<size_t>(val);
-                    } else if (field == "Curve Resolution") {
-                        tracking->curveResolution = static_cast<size_t>(val);
-                    }
+                    mVulkanWindow->getSimulation()->submit([=] {
+                        auto* tracking = em->getComponent<bbl::Tracking>(entityID);
+                        if (!tracking) return;
+
+                        if (field == "Sampling Interval") {
+                            tracking->samplingInterval = static_cast<float>(val);
+                        } else if (field == "Line Width") {
+                            tracking->lineWidth = static_cast<float>(val);
+                        } else if (field == "Trace Color R") {
+                            tracking->traceColor.r = static_cast<float>(val);
+                        } else if (field == "Trace Color G") {
+                            tracking->traceColor.g = static_cast<float>(val);
+                        } else if (field == "Trace Color B") {
+                            tracking->traceColor.b = static_cast<float>(val);
+                        } else if (field == "Max Control Points") {
+                            tracking->maxControlPoints = static_cast<size_t>(val);
+                        } else if (field == "Curve Resolution") {
+                            tracking->curveResolution = static_cast<size_t>(val);
+                        }
 
-                    // Update tracking system parameters if tracking is enabled
-                    if (tracking->isTracking) {
-                        if (auto* gameWorld = mVulkanWindow->getGameWorld()) {
-                            if (auto* trackingSystem = gameWorld->getTrackingSystem()) {
-                                trackingSystem->setTrackingColor(entityID, tracking->traceColor);
-                                trackingSystem->setTrackingParameters(entityID, tracking->samplingInterval,
-                                                                      tracking->maxControlPoints, tracking->curveResolution);
+                        // Update tracking system parameters if tracking is enabled
+                        if (tracking->isTracking) {
+                            if (auto* gameWorld = mVulkanWindow->getGameWorld()) {
+                                if (auto* trackingSystem = gameWorld->getTrackingSystem()) {
+                                    trackingSystem->setTrackingColor(entityID, tracking->traceColor);
+                                    trackingSystem->setTrackingParameters(entityID, tracking->samplingInterval,
+                                                                          tracking->maxControlPoints, tracking->curveResolution);
+                                }
                             }
                         }
-                    }
-
+                    });
                     mVulkanWindow->requestUpdate();
                 });
             }
@@ -1439,19 +1566,26 @@ void MainWindow::addComponentUI(const QString& name, const QVariantMap& fields)
                     bbl::EntityID entityID = selected.value();
                     auto* em = mVulkanWindow->getEntityManager();
                     if(!em) {return;}
-                    auto* audio = em->getComponent<bbl::Audio>(entityID);
-                    if (!audio) {return;}
-
-                    QString value = lineEdit->text();
-                    if (field == "Attack Sound") {
-                        audio->attackSound = value.toStdString();
-                        audio->attackBuffer = resourceManager->loadSound(audio->attackSound);
-                        audio->attackSource = resourceManager->createSource(audio->attackBuffer);
-                    } else if (field == "Death Sound") {
-                        audio->deathSound = value.toStdString();
-                        audio->deathBuffer = resourceManager->loadSound(audio->deathSound);
-                        audio->deathSource = resourceManager->createSource(audio->deathBuffer);
-                    }
+                    if (field != "Attack Sound" && field != "Death Sound") {return;}
+
+                    // Lyden lastes her på GUI-tråden, bare id-ene sendes til simuleringen
+                    std::string path = lineEdit->text().toStdString();
+                    auto buffer = resourceManager->loadSound(path);
+                    auto source = resourceManager->createSource(buffer);
+                    mVulkanWindow->getSimulation()->submit([=] {
+                        auto* audio = em->getComponent<bbl::Audio>(entityID);
+                        if (!audio) {return;}
+
+                        if (field == "Attack Sound") {
+                            audio->attackSound = path;
+                            audio->attackBuffer = buffer;
+                            audio->attackSource = source;
+                        } else {
+                            audio->deathSound = path;
+                            audio->deathBuffer = buffer;
+                            audio->deathSource = source;
+                        }
+                    });
                     mVulkanWindow->requestUpdate();
                 });
             }
@@ -1539,17 +1673,59 @@ void MainWindow::onPlayToggled()
     auto* gWorld = mVulkanWindow->getGameWorld();
 
     isPlaying = !isPlaying;
+
     playButton->setText(isPlaying ? "⏹ Stop" : "▶ Play");
     playButton->setStyleSheet(playButtonStyle(isPlaying));
 
     if(gWorld)
     {
-        gWorld->setPaused(!isPlaying);
+        // Snapshot og pause i samme stopp, så Reset går tilbake til nøyaktig steget før Play
+        mVulkanWindow->getSimulation()->execute([&] {
+            // Ta snapshot første gang Play trykkes, Reset går tilbake hit
+            if (isPlaying && mPlaySnapshot.isEmpty())
+            {
+                auto* sceneManager = mVulkanWindow->getSceneManager();
+                gWorld->captureSnapshot(mPlaySnapshot, sceneManager ? &sceneManager->getEntityNames() : nullptr);
+            }
+            gWorld->setPaused(!isPlaying);
+        });
+        resetButton->setEnabled(!mPlaySnapshot.isEmpty());
     }
 
     qInfo() << (isPlaying ? "Play mode started." : "Play mode stopped.");
 }
 
+void MainWindow::onResetClicked()
+{
+    auto* gWorld = mVulkanWindow->getGameWorld();
+    if (!gWorld || mPlaySnapshot.isEmpty()) return;
+
+    if (isPlaying)
+    {
+        onPlayToggled();
+    }
+
+    auto* sceneManager = mVulkanWindow->getSceneManager();
+    mVulkanWindow->setSelectedEntity(bbl::EntityID{});
+
+    bool restored = mVulkanWindow->getSimulation()->execute([&] {
+        return gWorld->restoreSnapshot(mPlaySnapshot, sceneManager ? &sceneManager->getEntityNamesMap() : nullptr);
+    });
+    if (!restored)
+    {
+        QMessageBox::critical(this, "Error", QString::fromStdString(mPlaySnapshot.getLastError()));
+        return;
+    }
+
+    // Neste Play tar et nytt snapshot
+    mPlaySnapshot.clear();
+    resetButton->setEnabled(false);
+
+    updateSceneObjectList();
+    mVulkanWindow->markSceneChanged();
+    qInfo() << "World reset to before play.";
+}
+
 //=============================================================================
 // Scene Management
 //=============================================================================
@@ -1569,9 +1745,11 @@ void MainWindow::on_action_NewScene_triggered()
         if (reply == QMessageBox::No) return;
     }
 
-    sceneManager->createNewScene("New Scene");
+    mVulkanWindow->getSimulation()->execute([&] { sceneManager->createNewScene("New Scene"); });
+    mPlaySnapshot.clear();
+    resetButton->setEnabled(false);
     updateSceneObjectList();
-    mVulkanWindow->recreateSwapChain();
+    mVulkanWindow->markSceneChanged();
 }
 
 void MainWindow::on_action_SaveScene_triggered()
@@ -1586,7 +1764,8 @@ void MainWindow::on_action_SaveScene_triggered()
         return;
     }
 
-    if (sceneManager->saveCurrentScene()) {
+    // Lagringen leser komponentene, simuleringen må stå imens
+    if (mVulkanWindow->getSimulation()->execute([&] { return sceneManager->saveCurrentScene(); })) {
         QMessageBox::information(this, "Success", "Scene saved successfully!");
     } else {
         QMessageBox::critical(this, "Error", QString::fromStdString(sceneManager->getLastError()));
@@ -1610,7 +1789,7 @@ void MainWindow::on_action_SaveSceneAs_triggered()
 
     if (filepath.isEmpty()) return;
 
-    if (sceneManager->saveCurrentScene(filepath.toStdString())) {
+    if (mVulkanWindow->getSimulation()->execute([&] { return sceneManager->saveCurrentScene(filepath.toStdString()); })) {
         QMessageBox::information(this, "Success", "Scene saved successfully!");
     } else {
         QMessageBox::critical(this, "Error", QString::fromStdString(sceneManager->getLastError()));
@@ -1639,9 +1818,11 @@ void MainWindow::on_action_LoadScene_triggered()
 
     if (filepath.isEmpty()) return;
 
-    if (sceneManager->loadScene(filepath.toStdString())) {
-        QMessageBox::information(this, "Success", "Scene loaded successfully!");
-        updateSceneObjectList();
+    // Lasting og terreng i samme stopp, så simuleringen aldri ser scenen uten terreng
+    bool loaded = mVulkanWindow->getSimulation()->execute([&] {
+        if (!sceneManager->loadScene(filepath.toStdString())) {
+            return false;
+        }
 
         const auto& entityNames = sceneManager->getEntityNames();
         for (const auto& [id, name] : entityNames) {
@@ -1651,9 +1832,151 @@ void MainWindow::on_action_LoadScene_triggered()
                 break;
             }
         }
+        return true;
+    });
 
-        mVulkanWindow->recreateSwapChain();
+    if (loaded) {
+        mPlaySnapshot.clear();
+        resetButton->setEnabled(false);
+        QMessageBox::information(this, "Success", "Scene loaded successfully!");
+        updateSceneObjectList();
+        mVulkanWindow->markSceneChanged();
     }
 }
 
 
+
+//=============================================================================
+// Simulation Recording
+//=============================================================================
+
+void MainWindow::on_action_StartRecording_triggered()
+{
+    auto* gameWorld = mVulkanWindow ? mVulkanWindow->getGameWorld() : nullptr;
+    if (!gameWorld) return;
+
+    if (gameWorld->isRecording()) {
+        QMessageBox::information(this, "Recording", "A recording is already running.");
+        return;
+    }
+
+    mVulkanWindow->getSimulation()->execute([&] { gameWorld->startRecording(); });
+}
+
+void MainWindow::on_action_StopRecording_triggered()
+{
+    auto* gameWorld = mVulkanWindow ? mVulkanWindow->getGameWorld() : nullptr;
+    if (!gameWorld || !gameWorld->isRecording()) return;
+
+    QString recordingsPath = QDir(QCoreApplication::applicationDirPath()).filePath("../../Recordings/");
+    QDir().mkpath(recordingsPath);
+
+    QString filepath = QFileDialog::getSaveFileName(
+        this, "Save Recording", recordingsPath + "Run.bblrec",
+        "Simulation Recordings (*.bblrec);;All Files (*)"
+        );
+
+    if (filepath.isEmpty()) return;
+
+    if (!mVulkanWindow->getSimulation()->execute([&] { return gameWorld->stopRecording(filepath.toStdString()); })) {
+        QMessageBox::critical(this, "Error", "Failed to save recording.");
+    }
+}
+
+void MainWindow::on_action_ReplayRecording_triggered()
+{
+    auto* gameWorld = mVulkanWindow ? mVulkanWindow->getGameWorld() : nullptr;
+    if (!gameWorld) return;
+
+    QString recordingsPath = QDir(QCoreApplication::applicationDirPath()).filePath("../../Recordings/");
+    QString filepath = QFileDialog::getOpenFileName(
+        this, "Replay Recording", recordingsPath, "Simulation Recordings (*.bblrec);;All Files (*)"
+        );
+
+    if (filepath.isEmpty()) return;
+
+    bbl::ReplayResult result = gameWorld->replayRecording(filepath.toStdString());
+    if (!result.success) {
+        QMessageBox::critical(this, "Error", QString::fromStdString(result.error));
+        return;
+    }
+
+    QString summary = QString("%1 steps replayed in %2 ms (%3 us/step).\n%4 checksums verified.")
+                          .arg(result.steps)
+                          .arg(result.simulationMs, 0, 'f', 2)
+                          .arg(result.averageStepUs, 0, 'f', 2)
+                          .arg(result.checksumsVerified);
+    if (result.firstMismatchStep >= 0) {
+        summary += QString("\nDiverged at step %1.").arg(result.firstMismatchStep);
+        QMessageBox::warning(this, "Replay", summary);
+    } else {
+        QMessageBox::information(this, "Replay", summary);
+    }
+}
+
+//=============================================================================
+// World Snapshots
+//=============================================================================
+
+void MainWindow::on_action_SaveSnapshot_triggered()
+{
+    auto* gameWorld = mVulkanWindow ? mVulkanWindow->getGameWorld() : nullptr;
+    if (!gameWorld) return;
+
+    QString snapshotsPath = QDir(QCoreApplication::applicationDirPath()).filePath("../../Snapshots/");
+    QDir().mkpath(snapshotsPath);
+
+    QString filepath = QFileDialog::getSaveFileName(
+        this, "Save Snapshot", snapshotsPath + "World.bblsnap",
+        "World Snapshots (*.bblsnap);;All Files (*)"
+        );
+
+    if (filepath.isEmpty()) return;
+
+    auto* sceneManager = mVulkanWindow->getSceneManager();
+    bbl::WorldSnapshot snapshot;
+    mVulkanWindow->getSimulation()->execute([&] {
+        gameWorld->captureSnapshot(snapshot, sceneManager ? &sceneManager->getEntityNames() : nullptr);
+    });
+
+    if (!snapshot.saveToFile(filepath.toStdString())) {
+        QMessageBox::critical(this, "Error", QString::fromStdString(snapshot.getLastError()));
+    }
+}
+
+void MainWindow::on_action_LoadSnapshot_triggered()
+{
+    auto* gameWorld = mVulkanWindow ? mVulkanWindow->getGameWorld() : nullptr;
+    if (!gameWorld) return;
+
+    QString snapshotsPath = QDir(QCoreApplication::applicationDirPath()).filePath("../../Snapshots/");
+    QString filepath = QFileDialog::getOpenFileName(
+        this, "Load Snapshot", snapshotsPath, "World Snapshots (*.bblsnap);;All Files (*)"
+        );
+
+    if (filepath.isEmpty()) return;
+
+    bbl::WorldSnapshot snapshot;
+    if (!snapshot.loadFromFile(filepath.toStdString())) {
+        QMessageBox::critical(this, "Error", QString::fromStdString(snapshot.getLastError()));
+        return;
+    }
+
+    if (isPlaying)
+    {
+        onPlayToggled();
+    }
+    mVulkanWindow->setSelectedEntity(bbl::EntityID{});
+
+    auto* sceneManager = mVulkanWindow->getSceneManager();
+    bool restored = mVulkanWindow->getSimulation()->execute([&] {
+        return gameWorld->restoreSnapshot(snapshot, sceneManager ? &sceneManager->getEntityNamesMap() : nullptr);
+    });
+    if (!restored) {
+        QMessageBox::critical(this, "Error", QString::fromStdString(snapshot.getLastError()));
+        return;
+    }
+
+    updateSceneObjectList();
+    mVulkanWindow->markSceneChanged();
+}
@@ -5,6 +5,7 @@
 #include <QPointer>
 #include <QPlainTextEdit>
 #include <QPushButton>
+#include <QLabel>
 #include <QListWidget>
 #include <qboxlayout.h>
 #include <QInputDialog>
@@ -43,6 +44,9 @@ public:
     /// Starts the main rendering or simulation loop.
     void start();
 
+    /// Selects an entity in the scene list and shows its components (used by viewport picking).
+    void selectEntity(bbl::EntityID entityID);
+
     /// Pointer to the global message log text box (used by qInstallMessageHandler)
     static QPointer<QPlainTextEdit> messageLogWidget;
 
@@ -61,8 +65,14 @@ private:
     // UI Components
     //=========================================================================
     QPushButton* playButton = nullptr;
+    QPushButton* resetButton = nullptr;
     QPushButton* addComponentButton = nullptr;  // Component management button
+    QLabel* renderStatsLabel = nullptr;         // Tegnet/cullet fra Renderer, i statuslinja
+    QPlainTextEdit* gpuProfilerView = nullptr;  // GPU-tid per scope, fanen GPU Profiler
     bool isPlaying = false;
+
+    // Verden slik den var før første Play, brukes av Reset
+    bbl::WorldSnapshot mPlaySnapshot;
     int selectedEntityIndex = -1;
 
     // UI Widgets
@@ -87,6 +97,7 @@ private:
     QTabWidget* createTabWidget();
     QWidget* createRightPanel();
     QString playButtonStyle(bool playing) const;
+    void updateRenderStats();
 
     //=========================================================================
     // Helper Functions
@@ -109,6 +120,7 @@ private slots:
     // UI Buttons
     //=========================================================================
     void onPlayToggled();
+    void onResetClicked();
     void onButton1Clicked();
     void onButton2Clicked();
     void onButton3Clicked();
@@ -136,6 +148,19 @@ private slots:
     void on_action_SaveSceneAs_triggered();
     void on_action_LoadScene_triggered();
     void on_action_NewScene_triggered();
+
+    //=========================================================================
+    // Simulation Recording
+    //=========================================================================
+    void on_action_StartRecording_triggered();
+    void on_action_StopRecording_triggered();
+    void on_action_ReplayRecording_triggered();
+
+    //=========================================================================
+    // World Snapshots
+    //=========================================================================
+    void on_action_SaveSnapshot_triggered();
+    void on_action_LoadSnapshot_triggered();
 };
 
 #endif // MAINWINDOW_H
@@ -1,6 +1,7 @@
 #include "GameWorld.h"
 #include "../Editor/MainWindow.h"
 #include "../Core/Renderer.h"
+#include "../Core/Utility/BblHub.h"
 
 bbl::GameWorld::GameWorld()
 {
@@ -64,12 +65,14 @@ void bbl::GameWorld::initializeSystems(EntityManager* entityManager, Renderer* r
     }
 
     m_renderer = renderer;
+    m_entityManager = entityManager;
 
     // Physics System
     m_physicsSystem = std::make_unique<PhysicsSystem>(entityManager);
     m_physicsSystem->setGravity(glm::vec3(0.0f, -9.81f, 0.0f));
     m_physicsSystem->setTerrain(m_terrain.get());
     m_physicsSystem->enableRollingPhysics(true);
+    m_physicsSystem->setJobSystem(BBLHub::Instance().getJobSystem());
 
     if(enableFrictionZone)
     {
@@ -80,6 +83,7 @@ void bbl::GameWorld::initializeSystems(EntityManager* entityManager, Renderer* r
     m_collisionSystem = std::make_unique<CollisionSystem>(entityManager, m_terrain.get());
     m_collisionSystem->setTerrainCollisionEnabled(true);
     m_collisionSystem->setEntityCollisionEnabled(true);
+    m_collisionSystem->setJobSystem(BBLHub::Instance().getJobSystem());
 
     // Tracking System
     m_trackingsystem = std::make_unique<TrackingSystemClass>(entityManager);
@@ -93,20 +97,178 @@ void bbl::GameWorld::update(float dt)
         return;
     }
 
+    // Simulerings-LOD baseres på editor-kameraet, satt med setLODViewer()
+    if (m_physicsSystem && m_hasLODViewer)
+    {
+        m_physicsSystem->setLODViewer(m_lodViewerPosition, &m_lodFrustum);
+    }
+
+    // Fast tidssteg, veggklokken bestemmer bare hvor mange steg som kjøres
+    m_timeAccumulator += dt;
+    int steps = 0;
+    while (m_timeAccumulator >= m_fixedTimeStep && steps < m_maxStepsPerFrame)
+    {
+        stepSimulation();
+        m_timeAccumulator -= m_fixedTimeStep;
+        ++steps;
+    }
+
+    // Henger vi etter, kastes resten i stedet for å ta igjen over flere frames
+    if (steps == m_maxStepsPerFrame)
+    {
+        m_timeAccumulator = 0.0f;
+    }
+
+    if (steps > 0 && m_trackingsystem && m_trackingsystem->takePendingRenderUpdates())
+    {
+        ++m_traceVersion;
+    }
+}
+
+void bbl::GameWorld::setLODViewer(const glm::vec3& position, const Frustum& frustum)
+{
+    m_lodViewerPosition = position;
+    m_lodFrustum = frustum;
+    m_hasLODViewer = true;
+}
+
+void bbl::GameWorld::clearLODViewer()
+{
+    m_hasLODViewer = false;
+    if (m_physicsSystem)
+    {
+        m_physicsSystem->clearLODViewer();
+    }
+}
+
+void bbl::GameWorld::updateTraceRenderData()
+{
+    if (m_trackingsystem)
+    {
+        m_trackingsystem->updateTraceRenderData();
+    }
+}
+
+void bbl::GameWorld::stepSimulation()
+{
+    if (isRecording())
+    {
+        m_recorder->recordInputs(m_stepIndex - m_recordingStartStep, *m_entityManager, *m_physicsSystem, *m_collisionSystem);
+    }
+
     if (m_collisionSystem)
     {
-        m_collisionSystem->update(dt);
+        m_collisionSystem->update(m_fixedTimeStep);
     }
 
     if (m_physicsSystem)
     {
-        m_physicsSystem->update(dt);
+        m_physicsSystem->update(m_fixedTimeStep);
+    }
+
+    if (m_trackingsystem)
+    {
+        m_trackingsystem->update(m_fixedTimeStep);
     }
 
+    if (isRecording())
+    {
+        m_recorder->commitStep(*m_entityManager, *m_collisionSystem);
+    }
+
+    ++m_stepIndex;
+}
+
+void bbl::GameWorld::startRecording()
+{
+    if (!m_entityManager || !m_physicsSystem || !m_collisionSystem)
+    {
+        qWarning() << "Cannot start recording: systems are not initialized!";
+        return;
+    }
+
+    if (!m_recorder)
+    {
+        m_recorder = std::make_unique<SimulationRecorder>();
+    }
+
+    // Replay starter med tom LOD-tilstand, det må opptaket også
+    m_physicsSystem->resetLODState();
+    m_recordingStartStep = m_stepIndex;
+    m_recorder->begin(m_fixedTimeStep, m_terrain.get());
+    qInfo() << "Simulation recording started at step" << m_stepIndex;
+}
+
+bool bbl::GameWorld::stopRecording(const std::string& filepath)
+{
+    if (!isRecording())
+    {
+        return false;
+    }
+
+    m_recorder->end(m_stepIndex - m_recordingStartStep);
+    if (!m_recorder->saveToFile(filepath))
+    {
+        qWarning() << QString::fromStdString(m_recorder->getLastError());
+        return false;
+    }
+    return true;
+}
+
+bbl::ReplayResult bbl::GameWorld::replayRecording(const std::string& filepath)
+{
+    ReplayResult result = SimulationReplayer::replayFile(filepath, m_terrain.get(), BBLHub::Instance().getJobSystem());
+    if (!result.success)
+    {
+        qWarning() << "Replay failed:" << QString::fromStdString(result.error);
+        return result;
+    }
+
+    qInfo() << "Replay finished:" << result.steps << "steps," << result.checksumsVerified << "checksums verified,"
+            << "physics" << result.simulationMs << "ms (" << result.averageStepUs << "us/step)";
+    if (result.firstMismatchStep >= 0)
+    {
+        qWarning() << "Replay diverged from recording at step" << result.firstMismatchStep;
+    }
+    return result;
+}
+
+void bbl::GameWorld::captureSnapshot(WorldSnapshot& snapshot, const std::unordered_map<EntityID, std::string>* entityNames) const
+{
+    if (!m_entityManager)
+    {
+        qWarning() << "Cannot capture snapshot: systems are not initialized!";
+        return;
+    }
+
+    snapshot.capture(*m_entityManager, m_physicsSystem.get(), m_terrain.get(), entityNames);
+}
+
+bool bbl::GameWorld::restoreSnapshot(WorldSnapshot& snapshot, std::unordered_map<EntityID, std::string>* entityNames)
+{
+    if (!m_entityManager)
+    {
+        qWarning() << "Cannot restore snapshot: systems are not initialized!";
+        return false;
+    }
+
+    if (!snapshot.restore(*m_entityManager, m_physicsSystem.get(), m_terrain.get(), entityNames))
+    {
+        qWarning() << "Snapshot restore failed:" << QString::fromStdString(snapshot.getLastError());
+        return false;
+    }
+
+    // Delvis akkumulert tid hører til verdenen vi forlot
+    m_timeAccumulator = 0.0f;
+
+    // Trace-meshene lastes opp på nytt fra kurvepunktene i snapshotet
     if (m_trackingsystem)
     {
-        m_trackingsystem->update(dt);
+        for (auto& [entity, tracking] : m_entityManager->getComponentMap<Tracking>())
+        {
+            tracking.shouldUpdateRender = true;
+        }
         m_trackingsystem->updateTraceRenderData();
-        m_renderer->recreateSwapChain();
     }
+    return true;
 }
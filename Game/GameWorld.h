@@ -6,6 +6,10 @@
 #include "../ECS/Components/CollisionSystem.h"
 #include "../ECS/Entity/EntityManager.h"
 #include "../ECS/Components/trackingsystemclass.h"
+#include "SimulationRecorder.h"
+#include "../ECS/Entity/WorldSnapshot.h"
+#include "../Core/Camera.h"
+#include <atomic>
 #include <memory>
 
 class Renderer;
@@ -19,11 +23,37 @@ public:
     GameWorld();
 
     void Setup();
+    // Veggklokke-dt inn, simuleringen kjøres i faste steg av getFixedTimeStep()
     void update(float dt);
+    void stepSimulation();
+
+    void setFixedTimeStep(float step) { m_fixedTimeStep = step; }
+    float getFixedTimeStep() const { return m_fixedTimeStep; }
+    uint64_t getStepIndex() const { return m_stepIndex; }
+
+    // Deterministisk opptak/replay, se SimulationRecorder
+    void startRecording();
+    bool stopRecording(const std::string& filepath);
+    bool isRecording() const { return m_recorder && m_recorder->isRecording(); }
+    ReplayResult replayRecording(const std::string& filepath);
+
+    // Binært øyeblikksbilde av hele verden (reset til før play, hopp rett til en innsvingt tilstand)
+    void captureSnapshot(WorldSnapshot& snapshot, const std::unordered_map<EntityID, std::string>* entityNames = nullptr) const;
+    bool restoreSnapshot(WorldSnapshot& snapshot, std::unordered_map<EntityID, std::string>* entityNames = nullptr);
 
     void setPaused(bool paused) { mPaused = paused; }
     bool isPaused() const { return mPaused; }
 
+    // Simulerings-LOD regnes fra denne posisjonen og frustumet. Kopieres, så kameraet kan
+    // endres på GUI-tråden mens simuleringen kjører (se SimulationThread).
+    void setLODViewer(const glm::vec3& position, const Frustum& frustum);
+    void clearLODViewer();
+
+    // Øker når tracking har nye punkter. Meshene lastes opp med updateTraceRenderData(),
+    // av den som eier GPU-ressursene, ikke av update().
+    uint64_t getTraceVersion() const { return m_traceVersion; }
+    void updateTraceRenderData();
+
     Terrain* getTerrain() const { return m_terrain.get(); }
     bool isTerrainLoaded() const { return m_terrainLoaded; }
     void setTerrainEntity(EntityID terrainID)
@@ -40,6 +70,25 @@ public:
 
 
     TrackingSystemClass* getTrackingSystem() const { return m_trackingsystem.get(); }
+    PhysicsSystem* getPhysicsSystem() const { return m_physicsSystem.get(); }
+
+    // Raycast mot terreng og collidere, se CollisionSystem
+    bool raycast(const Ray& ray, RaycastHit& hit, bool includeTriggers = false) const
+    {
+        return m_collisionSystem && m_collisionSystem->raycast(ray, hit, includeTriggers);
+    }
+    size_t raycastAll(const Ray& ray, std::vector<RaycastHit>& hits, bool includeTriggers = false) const
+    {
+        return m_collisionSystem ? m_collisionSystem->raycastAll(ray, hits, includeTriggers) : 0;
+    }
+    void raycastBatch(const std::vector<Ray>& rays, std::vector<RaycastHit>& hits, bool includeTriggers = false) const
+    {
+        if (m_collisionSystem) {
+            m_collisionSystem->raycastBatch(rays, hits, includeTriggers);
+        } else {
+            hits.assign(rays.size(), RaycastHit{});
+        }
+    }
 
 
 
@@ -49,10 +98,23 @@ private:
     std::unique_ptr<PhysicsSystem> m_physicsSystem;
     std::unique_ptr<CollisionSystem> m_collisionSystem;
     std::unique_ptr<TrackingSystemClass> m_trackingsystem;
+    std::unique_ptr<SimulationRecorder> m_recorder;
     Renderer* m_renderer = nullptr;
+    EntityManager* m_entityManager = nullptr;
+
+    float m_fixedTimeStep{1.0f / 60.0f};
+    float m_timeAccumulator{0.0f};
+    int m_maxStepsPerFrame{8};
+    uint64_t m_stepIndex{0};
+    uint64_t m_recordingStartStep{0};
+    uint64_t m_traceVersion{0};
+
+    bool m_hasLODViewer{false};
+    glm::vec3 m_lodViewerPosition{0.0f};
+    Frustum m_lodFrustum{};
 
     bool m_terrainLoaded{false};
-    bool mPaused{true};
+    std::atomic<bool> mPaused{true};   // Settes fra GUI-tråden
 };
 
 } // namespace bbl
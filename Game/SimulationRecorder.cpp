@@ -0,0 +1,495 @@
+#include "SimulationRecorder.h"
+#include "../Core/Utility/BinaryStream.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <QDebug>
+
+using namespace bbl;
+
+namespace
+{
+constexpr uint32_t ReplayMagic = 0x524C4242; // "BBLR"
+constexpr uint16_t ReplayVersion = 1;
+constexpr uint64_t ChecksumInterval = 60;
+
+enum StateMask : uint8_t
+{
+    HasTransform = 1 << 0,
+    HasPhysics   = 1 << 1,
+    HasCollision = 1 << 2
+};
+
+template <typename T>
+void writePOD(std::vector<uint8_t>& out, const T& value)
+{
+    BinaryWriter(out).write(value);
+}
+
+void writeVarUInt(std::vector<uint8_t>& out, uint64_t value)
+{
+    BinaryWriter(out).writeVarUInt(value);
+}
+
+using Reader = BinaryReader;
+
+// Fast-størrelse skriving inn i EntityState::bytes
+struct StateWriter
+{
+    SimulationRecorder::EntityState& state;
+
+    template <typename T>
+    void write(const T& value)
+    {
+        std::memcpy(state.bytes + state.size, &value, sizeof(T));
+        state.size += sizeof(T);
+    }
+};
+
+SimulationRecorder::EntityState encodeState(const Transform* transform, const Physics* physics, const Collision* collision)
+{
+    SimulationRecorder::EntityState state;
+    StateWriter writer{state};
+
+    uint8_t mask = (transform ? HasTransform : 0) | (physics ? HasPhysics : 0) | (collision ? HasCollision : 0);
+    writer.write(mask);
+
+    if (transform) {
+        writer.write(transform->position);
+        writer.write(transform->rotation);
+        writer.write(transform->scale);
+    }
+    if (physics) {
+        writer.write(physics->velocity);
+        writer.write(physics->acceleration);
+        writer.write(physics->mass);
+        writer.write(static_cast<uint8_t>(physics->useGravity));
+    }
+    if (collision) {
+        writer.write(collision->colliderSize);
+        uint8_t flags = (collision->isGrounded ? 1 : 0) | (collision->isColliding ? 2 : 0)
+                      | (collision->isTrigger ? 4 : 0) | (collision->isStatic ? 8 : 0);
+        writer.write(flags);
+    }
+    return state;
+}
+
+// Leser én EntityState-payload og oppdaterer komponentene på entiteten
+void applyState(Reader& reader, EntityManager& entityManager, EntityID entity)
+{
+    uint8_t mask = reader.read<uint8_t>();
+
+    if (mask & HasTransform) {
+        Transform transform;
+        transform.position = reader.read<glm::vec3>();
+        transform.rotation = reader.read<glm::vec3>();
+        transform.scale = reader.read<glm::vec3>();
+        entityManager.addComponent(entity, transform);
+    } else {
+        entityManager.removeComponent<Transform>(entity);
+    }
+
+    if (mask & HasPhysics) {
+        Physics physics;
+        physics.velocity = reader.read<glm::vec3>();
+        physics.acceleration = reader.read<glm::vec3>();
+        physics.mass = reader.read<float>();
+        physics.useGravity = reader.read<uint8_t>() != 0;
+        entityManager.addComponent(entity, physics);
+    } else {
+        entityManager.removeComponent<Physics>(entity);
+    }
+
+    if (mask & HasCollision) {
+        Collision collision;
+        collision.colliderSize = reader.read<glm::vec3>();
+        uint8_t flags = reader.read<uint8_t>();
+        collision.isGrounded = flags & 1;
+        collision.isColliding = flags & 2;
+        collision.isTrigger = flags & 4;
+        collision.isStatic = flags & 8;
+        entityManager.addComponent(entity, collision);
+    } else {
+        entityManager.removeComponent<Collision>(entity);
+    }
+}
+
+std::vector<uint8_t> encodeParameters(const PhysicsSystem& physics, const CollisionSystem& collision)
+{
+    std::vector<uint8_t> out;
+    writePOD(out, physics.getGravity());
+    writePOD(out, physics.frictionCoefficient);
+    writePOD(out, physics.zone_frictionCoefficient);
+    writePOD(out, physics.zone_frictionCenter);
+    writePOD(out, physics.zone_frictionRadius);
+    writePOD(out, static_cast<uint8_t>(physics.isRollingPhysicsEnabled()));
+    writePOD(out, collision.getTerrainEntity());
+
+    const SimulationLODSettings& lod = physics.getLODSettings();
+    writePOD(out, static_cast<uint8_t>(lod.enabled));
+    writePOD(out, lod.midDistance);
+    writePOD(out, lod.farDistance);
+    writePOD(out, lod.hysteresis);
+    writePOD(out, static_cast<uint8_t>(lod.demoteOutsideFrustum));
+    writePOD(out, lod.midInterval);
+    writePOD(out, lod.farInterval);
+    writePOD(out, lod.maxStepDt);
+    return out;
+}
+
+void applyParameters(Reader& reader, PhysicsSystem& physics, CollisionSystem& collision)
+{
+    physics.setGravity(reader.read<glm::vec3>());
+    physics.frictionCoefficient = reader.read<float>();
+    physics.zone_frictionCoefficient = reader.read<float>();
+    physics.zone_frictionCenter = reader.read<glm::vec3>();
+    physics.zone_frictionRadius = reader.read<float>();
+    physics.enableRollingPhysics(reader.read<uint8_t>() != 0);
+    collision.setTerrainEntity(reader.read<EntityID>());
+
+    SimulationLODSettings lod;
+    lod.enabled = reader.read<uint8_t>() != 0;
+    lod.midDistance = reader.read<float>();
+    lod.farDistance = reader.read<float>();
+    lod.hysteresis = reader.read<float>();
+    lod.demoteOutsideFrustum = reader.read<uint8_t>() != 0;
+    lod.midInterval = reader.read<float>();
+    lod.farInterval = reader.read<float>();
+    lod.maxStepDt = reader.read<float>();
+    physics.setLODSettings(lod);
+}
+
+std::vector<uint8_t> encodeViewer(const PhysicsSystem& physics)
+{
+    std::vector<uint8_t> out;
+    writePOD(out, static_cast<uint8_t>(physics.hasLODViewer()));
+    writePOD(out, physics.getLODViewerPosition());
+
+    const Frustum* frustum = physics.getLODFrustum();
+    writePOD(out, static_cast<uint8_t>(frustum != nullptr));
+    if (frustum) {
+        for (const Plane& plane : frustum->planes) {
+            writePOD(out, plane.normal);
+            writePOD(out, plane.distance);
+        }
+    }
+    return out;
+}
+
+void applyViewer(Reader& reader, PhysicsSystem& physics, Frustum& frustumStorage)
+{
+    bool hasViewer = reader.read<uint8_t>() != 0;
+    glm::vec3 position = reader.read<glm::vec3>();
+    bool hasFrustum = reader.read<uint8_t>() != 0;
+    if (hasFrustum) {
+        for (Plane& plane : frustumStorage.planes) {
+            plane.normal = reader.read<glm::vec3>();
+            plane.distance = reader.read<float>();
+        }
+    }
+
+    if (hasViewer) {
+        physics.setLODViewer(position, hasFrustum ? &frustumStorage : nullptr);
+    } else {
+        physics.clearLODViewer();
+    }
+}
+
+// FNV-1a
+uint64_t hashBytes(uint64_t hash, const uint8_t* data, size_t size)
+{
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+uint64_t hashStates(const SimulationRecorder::EntityStateList& states)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (const auto& [entity, state] : states) {
+        hash = hashBytes(hash, reinterpret_cast<const uint8_t*>(&entity), sizeof(entity));
+        hash = hashBytes(hash, state.bytes, state.size);
+    }
+    return hash;
+}
+} // namespace
+
+//=============================================================================
+// SimulationRecorder
+//=============================================================================
+
+bool SimulationRecorder::EntityState::operator==(const EntityState& other) const
+{
+    return size == other.size && std::memcmp(bytes, other.bytes, size) == 0;
+}
+
+void SimulationRecorder::captureStates(EntityManager& entityManager, EntityID terrainEntity, EntityStateList& states)
+{
+    states.clear();
+    for (const auto& [entity, transform] : entityManager.getComponentMap<Transform>()) {
+        const Physics* physics = entityManager.getComponent<Physics>(entity);
+        const Collision* collision = entityManager.getComponent<Collision>(entity);
+        if (!physics && !collision && entity != terrainEntity) {
+            continue;
+        }
+        states.emplace_back(entity, encodeState(&transform, physics, collision));
+    }
+
+    std::sort(states.begin(), states.end(),
+              [](const auto& a, const auto& b) { return a.first < b.first; });
+}
+
+uint64_t SimulationRecorder::computeChecksum(EntityManager& entityManager, EntityID terrainEntity)
+{
+    EntityStateList states;
+    captureStates(entityManager, terrainEntity, states);
+    return hashStates(states);
+}
+
+void SimulationRecorder::begin(float fixedTimeStep, const Terrain* terrain)
+{
+    mData.clear();
+    mLastStates.clear();
+    mLastParameters.clear();
+    mLastViewer.clear();
+    mLastEventStep = 0;
+    mLastError.clear();
+
+    writePOD(mData, ReplayMagic);
+    writePOD(mData, ReplayVersion);
+    writePOD(mData, uint16_t{0});
+    writePOD(mData, fixedTimeStep);
+    writePOD(mData, static_cast<uint32_t>(terrain ? terrain->getIndices().size() / 3 : 0));
+
+    mRecording = true;
+}
+
+void SimulationRecorder::end(uint64_t totalSteps)
+{
+    if (!mRecording) {
+        return;
+    }
+
+    beginEvent(ReplayEventType::End, totalSteps);
+    mRecording = false;
+    mLastStates.clear();
+
+    qInfo() << "Simulation recording finished:" << totalSteps << "steps," << mData.size() << "bytes";
+}
+
+void SimulationRecorder::beginEvent(ReplayEventType type, uint64_t step)
+{
+    writePOD(mData, static_cast<uint8_t>(type));
+    writeVarUInt(mData, step - mLastEventStep);
+    mLastEventStep = step;
+}
+
+void SimulationRecorder::recordInputs(uint64_t step, EntityManager& entityManager,
+                                      const PhysicsSystem& physics, const CollisionSystem& collision)
+{
+    if (!mRecording) {
+        return;
+    }
+
+    EntityStateList current;
+    captureStates(entityManager, collision.getTerrainEntity(), current);
+
+    // Nye eller endret utenfra siden forrige step (spawn, editor)
+    for (const auto& [entity, state] : current) {
+        auto it = mLastStates.find(entity);
+        if (it == mLastStates.end() || it->second != state) {
+            beginEvent(ReplayEventType::EntityState, step);
+            writePOD(mData, entity);
+            mData.insert(mData.end(), state.bytes, state.bytes + state.size);
+        }
+    }
+
+    // Slettet, eller mistet Physics/Collision
+    for (const auto& [entity, state] : mLastStates) {
+        auto found = std::lower_bound(current.begin(), current.end(), entity,
+                                      [](const auto& a, EntityID id) { return a.first < id; });
+        if (found == current.end() || found->first != entity) {
+            beginEvent(ReplayEventType::EntityRemoved, step);
+            writePOD(mData, entity);
+        }
+    }
+
+    std::vector<uint8_t> parameters = encodeParameters(physics, collision);
+    if (parameters != mLastParameters) {
+        beginEvent(ReplayEventType::PhysicsParameters, step);
+        mData.insert(mData.end(), parameters.begin(), parameters.end());
+        mLastParameters = std::move(parameters);
+    }
+
+    std::vector<uint8_t> viewer = encodeViewer(physics);
+    if (viewer != mLastViewer) {
+        beginEvent(ReplayEventType::LODViewer, step);
+        mData.insert(mData.end(), viewer.begin(), viewer.end());
+        mLastViewer = std::move(viewer);
+    }
+
+    if (step % ChecksumInterval == 0) {
+        beginEvent(ReplayEventType::Checksum, step);
+        writePOD(mData, hashStates(current));
+    }
+}
+
+void SimulationRecorder::commitStep(EntityManager& entityManager, const CollisionSystem& collision)
+{
+    if (!mRecording) {
+        return;
+    }
+
+    EntityStateList states;
+    captureStates(entityManager, collision.getTerrainEntity(), states);
+
+    mLastStates.clear();
+    mLastStates.reserve(states.size());
+    for (const auto& [entity, state] : states) {
+        mLastStates.emplace(entity, state);
+    }
+}
+
+bool SimulationRecorder::saveToFile(const std::string& filepath)
+{
+    std::ofstream file(filepath, std::ios::binary);
+    if (!file.is_open()) {
+        mLastError = "Failed to open file for writing: " + filepath;
+        return false;
+    }
+
+    file.write(reinterpret_cast<const char*>(mData.data()), static_cast<std::streamsize>(mData.size()));
+    if (!file) {
+        mLastError = "Failed to write recording: " + filepath;
+        return false;
+    }
+    return true;
+}
+
+//=============================================================================
+// SimulationReplayer
+//=============================================================================
+
+ReplayResult SimulationReplayer::replayFile(const std::string& filepath, Terrain* terrain, JobSystem* jobs)
+{
+    std::ifstream file(filepath, std::ios::binary);
+    if (!file.is_open()) {
+        ReplayResult result;
+        result.error = "Failed to open recording: " + filepath;
+        return result;
+    }
+
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return replay(data, terrain, jobs);
+}
+
+ReplayResult SimulationReplayer::replay(const std::vector<uint8_t>& data, Terrain* terrain, JobSystem* jobs)
+{
+    ReplayResult result;
+    Reader reader(data.data(), data.size());
+
+    uint32_t magic = reader.read<uint32_t>();
+    uint16_t version = reader.read<uint16_t>();
+    reader.read<uint16_t>();
+    float fixedTimeStep = reader.read<float>();
+    uint32_t terrainTriangles = reader.read<uint32_t>();
+
+    if (!reader.ok() || magic != ReplayMagic) {
+        result.error = "Not a simulation recording";
+        return result;
+    }
+    if (version != ReplayVersion) {
+        result.error = "Unsupported recording version " + std::to_string(version);
+        return result;
+    }
+    uint32_t currentTriangles = terrain ? static_cast<uint32_t>(terrain->getIndices().size() / 3) : 0;
+    if (terrainTriangles != currentTriangles) {
+        result.error = "Recording was made on a different terrain";
+        return result;
+    }
+
+    // Egen verden, ingen GPU-ressurser
+    EntityManager entityManager;
+    PhysicsSystem physics(&entityManager);
+    physics.setTerrain(terrain);
+    CollisionSystem collision(&entityManager, terrain);
+    physics.setJobSystem(jobs);
+    collision.setJobSystem(jobs);
+    Frustum frustum{};
+
+    using clock = std::chrono::steady_clock;
+    clock::duration simulationTime{0};
+    uint64_t step = 0;
+    uint64_t eventStep = 0;
+
+    while (true) {
+        ReplayEventType type = static_cast<ReplayEventType>(reader.read<uint8_t>());
+        eventStep += reader.readVarUInt();
+        if (!reader.ok()) {
+            result.error = "Recording is truncated";
+            return result;
+        }
+
+        // Simuler frem til eventets step
+        while (step < eventStep) {
+            auto start = clock::now();
+            collision.update(fixedTimeStep);
+            physics.update(fixedTimeStep);
+            simulationTime += clock::now() - start;
+            ++step;
+        }
+
+        if (type == ReplayEventType::End) {
+            break;
+        }
+
+        switch (type) {
+        case ReplayEventType::EntityState: {
+            EntityID entity = reader.read<EntityID>();
+            if (!entityManager.isValidEntity(entity)) {
+                entityManager.createEntityWithID(entity);
+            }
+            applyState(reader, entityManager, entity);
+            break;
+        }
+        case ReplayEventType::EntityRemoved:
+            entityManager.destroyEntity(reader.read<EntityID>());
+            break;
+        case ReplayEventType::PhysicsParameters:
+            applyParameters(reader, physics, collision);
+            break;
+        case ReplayEventType::LODViewer:
+            applyViewer(reader, physics, frustum);
+            break;
+        case ReplayEventType::Checksum: {
+            uint64_t expected = reader.read<uint64_t>();
+            uint64_t actual = SimulationRecorder::computeChecksum(entityManager, collision.getTerrainEntity());
+            if (actual == expected) {
+                ++result.checksumsVerified;
+            } else if (result.firstMismatchStep < 0) {
+                result.firstMismatchStep = static_cast<int64_t>(step);
+            }
+            break;
+        }
+        default:
+            result.error = "Unknown event in recording";
+            return result;
+        }
+
+        if (!reader.ok()) {
+            result.error = "Recording is truncated";
+            return result;
+        }
+    }
+
+    result.success = true;
+    result.steps = step;
+    result.finalChecksum = SimulationRecorder::computeChecksum(entityManager, collision.getTerrainEntity());
+    result.simulationMs = std::chrono::duration<double, std::milli>(simulationTime).count();
+    result.averageStepUs = step > 0 ? result.simulationMs * 1000.0 / static_cast<double>(step) : 0.0;
+    return result;
+}
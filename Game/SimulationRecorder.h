@@ -0,0 +1,109 @@
+#ifndef SIMULATIONRECORDER_H
+#define SIMULATIONRECORDER_H
+
+#include "../ECS/Entity/EntityManager.h"
+#include "../ECS/Components/Physics.h"
+#include "../ECS/Components/CollisionSystem.h"
+#include "../Core/Camera.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace bbl
+{
+
+// Deterministisk opptak av simuleringen.
+//
+// Opptaket lagrer ikke hver frame. Det lagrer bare det som påvirker simuleringen
+// utenfra: spawns og sletting, editor-endringer på Transform/Physics/Collision,
+// fysikkparametre og LOD-viewer. Endringene finnes ved å sammenligne tilstanden
+// før hvert fixed step med tilstanden etter forrige step. Hvert 60. step lagres
+// en sjekksum slik at replay kan finne første step som avviker.
+//
+// Format (native endian, POD via memcpy):
+//   header:  magic 'BBLR', u16 version, u16 reserved, f32 fixedDt, u32 terrainTriangles
+//   events:  u8 type, varint steg siden forrige event, payload
+//   slutt:   End-event med totalt antall steg
+
+enum class ReplayEventType : uint8_t
+{
+    EntityState = 1,
+    EntityRemoved,
+    PhysicsParameters,
+    LODViewer,
+    Checksum,
+    End
+};
+
+class SimulationRecorder
+{
+public:
+    void begin(float fixedTimeStep, const Terrain* terrain);
+    void end(uint64_t totalSteps);
+    bool isRecording() const { return mRecording; }
+
+    // Kalles rett før step 'step' simuleres, og rett etter
+    void recordInputs(uint64_t step, EntityManager& entityManager,
+                      const PhysicsSystem& physics, const CollisionSystem& collision);
+    void commitStep(EntityManager& entityManager, const CollisionSystem& collision);
+
+    const std::vector<uint8_t>& getData() const { return mData; }
+    bool saveToFile(const std::string& filepath);
+    std::string getLastError() const { return mLastError; }
+
+    // Sjekksum over alle simulerte entiteter, brukt av både opptak og replay
+    static uint64_t computeChecksum(EntityManager& entityManager, EntityID terrainEntity);
+
+    // Serialisert Transform/Physics/Collision for én entitet, sammenlignes med memcmp
+    struct EntityState
+    {
+        static constexpr size_t MaxBytes = 96;
+        uint8_t size = 0;
+        uint8_t bytes[MaxBytes];
+
+        bool operator==(const EntityState& other) const;
+        bool operator!=(const EntityState& other) const { return !(*this == other); }
+    };
+    using EntityStateList = std::vector<std::pair<EntityID, EntityState>>;
+
+    // Alle entiteter med Physics eller Collision, pluss terrenget, sortert på ID
+    static void captureStates(EntityManager& entityManager, EntityID terrainEntity, EntityStateList& states);
+
+private:
+    bool mRecording = false;
+    uint64_t mLastEventStep = 0;
+    std::vector<uint8_t> mData;
+    std::unordered_map<EntityID, EntityState> mLastStates;
+    std::vector<uint8_t> mLastParameters;
+    std::vector<uint8_t> mLastViewer;
+    std::string mLastError;
+
+    void beginEvent(ReplayEventType type, uint64_t step);
+};
+
+struct ReplayResult
+{
+    bool success = false;
+    uint64_t steps = 0;
+    uint32_t checksumsVerified = 0;
+    int64_t firstMismatchStep = -1;  // -1 hvis replay var bit-for-bit lik opptaket
+    uint64_t finalChecksum = 0;
+    double simulationMs = 0.0;       // Kun tiden brukt i collision + physics
+    double averageStepUs = 0.0;
+    std::string error;
+};
+
+// Spiller av et opptak på en egen, headless EntityManager med egne systemer.
+// Brukes både til å reprodusere feil og som fast benchmark for fysikken.
+// Med jobs != nullptr steppes fysikken parallelt, resultatet er det samme.
+class SimulationReplayer
+{
+public:
+    static ReplayResult replay(const std::vector<uint8_t>& data, Terrain* terrain, JobSystem* jobs = nullptr);
+    static ReplayResult replayFile(const std::string& filepath, Terrain* terrain, JobSystem* jobs = nullptr);
+};
+
+} // namespace bbl
+
+#endif // SIMULATIONRECORDER_H
@@ -0,0 +1,162 @@
+#include "SimulationThread.h"
+#include <QDebug>
+#include <chrono>
+
+namespace bbl
+{
+
+SimulationThread::SimulationThread(GameWorld& world, EntityManager& entities)
+    : mWorld(world), mEntities(entities)
+{
+}
+
+SimulationThread::~SimulationThread()
+{
+    stop();
+}
+
+void SimulationThread::start()
+{
+    if (isRunning()) {
+        return;
+    }
+    mStopRequested = false;
+    mThread = std::thread([this] { run(); });
+    qDebug() << "Simulation thread started";
+}
+
+void SimulationThread::stop()
+{
+    if (!isRunning()) {
+        return;
+    }
+    mStopRequested = true;
+    mThread.join();
+
+    // Det som ble lagt i kø etter siste steg skal ikke forsvinne
+    std::lock_guard<std::recursive_mutex> lock(mWorldMutex);
+    applyCommands();
+    publishSnapshot();
+}
+
+void SimulationThread::submit(Command command)
+{
+    {
+        std::lock_guard<std::mutex> lock(mCommandMutex);
+        mCommands.push_back(std::move(command));
+    }
+    invalidate();
+}
+
+void SimulationThread::tick(float dt)
+{
+    std::lock_guard<std::recursive_mutex> lock(mWorldMutex);
+    step(dt);
+    publishSnapshot();
+}
+
+void SimulationThread::setViewer(const glm::vec3& position, const Frustum& frustum)
+{
+    Viewer& viewer = mViewers.back();
+    viewer.position = position;
+    viewer.frustum = frustum;
+    viewer.valid = true;
+    mViewers.publish();
+}
+
+const RenderSnapshot& SimulationThread::acquireSnapshot()
+{
+    mSnapshots.acquire();
+    return mSnapshots.front();
+}
+
+void SimulationThread::run()
+{
+    using clock = std::chrono::steady_clock;
+    auto last = clock::now();
+    auto next = last;
+
+    while (!mStopRequested.load(std::memory_order_acquire)) {
+        auto now = clock::now();
+        float dt = std::chrono::duration<float>(now - last).count();
+        last = now;
+
+        {
+            std::lock_guard<std::recursive_mutex> lock(mWorldMutex);
+            step(dt);
+            // Pauset og ingen endringer: forrige snapshot gjelder fortsatt
+            if (!mWorld.isPaused() || mSnapshotDirty.load(std::memory_order_acquire)) {
+                publishSnapshot();
+            }
+        }
+
+        // Ett steg per runde; GameWorld tar igjen selv hvis vi sover for lenge
+        next += std::chrono::duration_cast<clock::duration>(std::chrono::duration<float>(mWorld.getFixedTimeStep()));
+        if (next < now) {
+            next = now;
+        }
+        std::this_thread::sleep_until(next);
+    }
+}
+
+void SimulationThread::step(float dt)
+{
+    applyCommands();
+
+    mViewers.acquire();
+    const Viewer& viewer = mViewers.front();
+    if (viewer.valid) {
+        mWorld.setLODViewer(viewer.position, viewer.frustum);
+    }
+
+    mWorld.update(dt);
+}
+
+void SimulationThread::applyCommands()
+{
+    std::vector<Command> commands;
+    {
+        std::lock_guard<std::mutex> lock(mCommandMutex);
+        commands.swap(mCommands);
+    }
+    if (commands.empty()) {
+        return;
+    }
+    std::unique_lock<std::recursive_mutex> resources = lockResources();
+    for (Command& command : commands) {
+        command();
+    }
+}
+
+std::unique_lock<std::recursive_mutex> SimulationThread::lockResources()
+{
+    if (!mResourceMutex) {
+        return {};
+    }
+    return std::unique_lock<std::recursive_mutex>(*mResourceMutex);
+}
+
+void SimulationThread::publishSnapshot()
+{
+    // Flagget slettes før kopien tas, så en invalidate() underveis gir ett snapshot til
+    mSnapshotDirty.store(false, std::memory_order_release);
+
+    RenderSnapshot& snapshot = mSnapshots.back();
+    snapshot.step = mWorld.getStepIndex();
+    snapshot.traceVersion = mWorld.getTraceVersion();
+    snapshot.entities = mEntities.getEntitiesWith<Transform, Render>();
+    snapshot.renders.resize(snapshot.entities.size());
+    snapshot.models.resize(snapshot.entities.size());
+    for (size_t i = 0; i < snapshot.entities.size(); ++i) {
+        EntityID entity = snapshot.entities[i];
+        snapshot.renders[i] = *mEntities.getComponent<Render>(entity);
+        snapshot.models[i] = mEntities.getComponent<Transform>(entity)->getModelMatrix();
+    }
+    mSnapshots.publish();
+
+    if (mPublishListener) {
+        mPublishListener();
+    }
+}
+
+} // namespace bbl
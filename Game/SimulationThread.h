@@ -0,0 +1,127 @@
+#ifndef SIMULATIONTHREAD_H
+#define SIMULATIONTHREAD_H
+
+#include "GameWorld.h"
+#include "../Core/Camera.h"
+#include "../Core/Utility/TripleBuffer.h"
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace bbl
+{
+
+// Det rendereren trenger fra ECS-en til én frame, kopiert etter et simuleringssteg.
+// entities, renders og models har samme rekkefølge (som getEntitiesWith<Transform, Render>).
+struct RenderSnapshot
+{
+    uint64_t step = 0;            // GameWorld::getStepIndex() da kopien ble tatt
+    uint64_t traceVersion = 0;    // GameWorld::getTraceVersion(), nye trace-punkter å laste opp
+    std::vector<EntityID> entities;
+    std::vector<Render> renders;
+    std::vector<glm::mat4> models;
+};
+
+// Kjører GameWorld på egen tråd i faste steg, så editoren og simuleringen ikke stopper
+// hverandre. Mens tråden går eier den ECS-en:
+//  - submit() legger en endring i kø; den kjøres på simuleringstråden mellom to steg.
+//  - execute() kjører på kallende tråd mens simuleringen står mellom to steg, for kode som
+//    trenger svaret med en gang eller laster opp til GPU-en (spawn, lasting, paneler).
+//  - Rendereren leser bare RenderSnapshot, som byttes uten lås via en TripleBuffer.
+// Uten tråd (headless, benchmark) kjører tick() det samme på kallende tråd, deterministisk.
+class SimulationThread
+{
+public:
+    using Command = std::function<void()>;
+
+    SimulationThread(GameWorld& world, EntityManager& entities);
+    ~SimulationThread();
+
+    SimulationThread(const SimulationThread&) = delete;
+    SimulationThread& operator=(const SimulationThread&) = delete;
+
+    void start();
+    void stop();
+    bool isRunning() const { return mThread.joinable(); }
+
+    // Asynkron endring, kjøres i rekkefølge ved neste stegsgrense
+    void submit(Command command);
+
+    // Synkron tilgang til verden. Køen tømmes først så rekkefølgen holder, og et nytt
+    // snapshot publiseres etterpå. Kan nøstes (f.eks. spawnModel inne i en execute).
+    template <typename F>
+    auto execute(F&& fn)
+    {
+        std::lock_guard<std::recursive_mutex> lock(mWorldMutex);
+        std::unique_lock<std::recursive_mutex> resources = lockResources();
+        applyCommands();
+        if constexpr (std::is_void_v<std::invoke_result_t<F&>>) {
+            fn();
+            publishSnapshot();
+        } else {
+            auto result = fn();
+            publishSnapshot();
+            return result;
+        }
+    }
+
+    // Uten tråd: kommandoer, dt veggklokke inn i GameWorld::update og nytt snapshot
+    void tick(float dt);
+
+    // Endringer gjort utenom submit()/execute() (markSceneChanged): nytt snapshot ved neste steg
+    void invalidate() { mSnapshotDirty.store(true, std::memory_order_release); }
+
+    // Render-tråden (Renderer::updateScene): kameraet som simulerings-LOD regnes fra.
+    // Tar ingen lås; verdien går gjennom en TripleBuffer med én skriver (rendertråden) og
+    // én leser (step() i run(), under verdenslåsen), og brukes fra neste steg.
+    void setViewer(const glm::vec3& position, const Frustum& frustum);
+
+    // Render-siden: nyeste snapshot, gyldig frem til neste kall
+    const RenderSnapshot& acquireSnapshot();
+
+    // Låsen rendertråden holder mens den bruker GPU-ressurser og køene. Tas etter verdenslåsen
+    // i execute() og når kommandoer kjøres, siden de kan laste opp eller slippe ressurser.
+    // Selve simuleringssteget tar den ikke. Settes før start().
+    void setResourceMutex(std::recursive_mutex* mutex) { mResourceMutex = mutex; }
+
+    // Kalles etter hvert publiserte snapshot, på tråden som publiserte og under verdenslåsen.
+    // Må være kort; rendereren vekker bare rendertråden. Settes før start().
+    void setPublishListener(std::function<void()> listener) { mPublishListener = std::move(listener); }
+
+private:
+    struct Viewer
+    {
+        glm::vec3 position{0.0f};
+        Frustum frustum{};
+        bool valid = false;
+    };
+
+    void run();
+    void step(float dt);               // Under mWorldMutex
+    void applyCommands();              // Under mWorldMutex
+    void publishSnapshot();            // Under mWorldMutex
+    std::unique_lock<std::recursive_mutex> lockResources();
+
+    GameWorld& mWorld;
+    EntityManager& mEntities;
+
+    std::thread mThread;
+    std::atomic<bool> mStopRequested{false};
+    std::atomic<bool> mSnapshotDirty{true};
+    std::recursive_mutex mWorldMutex;
+    std::recursive_mutex* mResourceMutex = nullptr;
+    std::function<void()> mPublishListener;
+
+    std::mutex mCommandMutex;
+    std::vector<Command> mCommands;
+
+    TripleBuffer<RenderSnapshot> mSnapshots;
+    TripleBuffer<Viewer> mViewers;
+};
+
+} // namespace bbl
+
+#endif // SIMULATIONTHREAD_H
@@ -3,6 +3,7 @@
 #include "../Core/Utility/modelloader.h"
 #include <iostream>
 #include <cmath>
+#include <algorithm>
 #include <QDebug>
 
 Terrain::Terrain() : m_width (0), m_height(0), m_channels(0), m_heightScale(0.02f), m_gridSpacing(0.2f), m_heightPlacement(-5.0f)
@@ -55,6 +56,9 @@ bool Terrain::loadFromOBJ(const std::string& filepath)
     // Rekalkuler normal hvis det skulle være nødvendig
     calculateNormals();
 
+    // Romlig indeks brukt av getHeightAt og raycast
+    buildTriangleGrid();
+
     // Lagre min og maks høyde for kollisjon handling
     float minHeight = FLT_MAX;
     float maxHeight = -FLT_MAX;
@@ -138,17 +142,27 @@ float Terrain::barycentric(const glm::vec2& p, const glm::vec3& a, const glm::ve
 
 float Terrain::getHeightAt(float worldX, float worldZ, const glm::vec3& terrainPosition) const
 {
-    if (m_vertices.empty() || m_indices.empty())
+    if (m_vertices.empty() || m_indices.empty() || m_cellStart.empty())
         return m_heightPlacement;
 
     float localWorldX = worldX - terrainPosition.x;
     float localWorldZ = worldZ - terrainPosition.z;
 
-    // Finn trekanten som inneholder dette punktet
-    for (size_t i = 0; i < m_indices.size(); i += 3) {
-        const Vertex& v0 = m_vertices[m_indices[i]];
-        const Vertex& v1 = m_vertices[m_indices[i + 1]];
-        const Vertex& v2 = m_vertices[m_indices[i + 2]];
+    glm::vec2 gridMax = m_gridMin + glm::vec2(m_gridCellsX, m_gridCellsZ) * m_cellSize;
+    if (localWorldX < m_gridMin.x || localWorldX > gridMax.x || localWorldZ < m_gridMin.y || localWorldZ > gridMax.y)
+        return m_heightPlacement; // Utenfor terrenget
+
+    // Punkter på ytterkanten havner i siste celle, samme clamp som når gridet bygges
+    int cellX = std::clamp(static_cast<int>(std::floor((localWorldX - m_gridMin.x) / m_cellSize)), 0, m_gridCellsX - 1);
+    int cellZ = std::clamp(static_cast<int>(std::floor((localWorldZ - m_gridMin.y) / m_cellSize)), 0, m_gridCellsZ - 1);
+
+    // Finn trekanten som inneholder dette punktet, kun blant trekantene i cellen
+    uint32_t cell = static_cast<uint32_t>(cellZ * m_gridCellsX + cellX);
+    for (uint32_t i = m_cellStart[cell]; i < m_cellStart[cell + 1]; ++i) {
+        size_t base = static_cast<size_t>(m_cellTriangles[i]) * 3;
+        const Vertex& v0 = m_vertices[m_indices[base]];
+        const Vertex& v1 = m_vertices[m_indices[base + 1]];
+        const Vertex& v2 = m_vertices[m_indices[base + 2]];
 
         // Sjekk om punktet er inni triangelen med 2D projeksjon
         if (isPointInTriangleXZ(glm::vec2(localWorldX, localWorldZ),
@@ -240,3 +254,286 @@ glm::vec3 Terrain::calculateBounds(glm::vec3& minBounds, glm::vec3& maxBounds) c
 }
 
 
+
+//=============================================================================
+// Trekant-grid og raycast
+//=============================================================================
+
+void Terrain::buildTriangleGrid()
+{
+    m_cellStart.clear();
+    m_cellTriangles.clear();
+    m_gridCellsX = 0;
+    m_gridCellsZ = 0;
+
+    size_t triangleCount = m_indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    glm::vec3 minBounds, maxBounds;
+    calculateBounds(minBounds, maxBounds);
+    m_gridMin = glm::vec2(minBounds.x, minBounds.z);
+    m_minY = minBounds.y;
+    m_maxY = maxBounds.y;
+
+    float extentX = std::max(maxBounds.x - minBounds.x, 1e-4f);
+    float extentZ = std::max(maxBounds.z - minBounds.z, 1e-4f);
+
+    // Kvadratiske celler, sikter mot ca. to trekanter per celle
+    float targetCells = std::max(1.0f, static_cast<float>(triangleCount) * 0.5f);
+    m_cellSize = std::sqrt(extentX * extentZ / targetCells);
+    m_gridCellsX = std::clamp(static_cast<int>(std::ceil(extentX / m_cellSize)), 1, 1024);
+    m_gridCellsZ = std::clamp(static_cast<int>(std::ceil(extentZ / m_cellSize)), 1, 1024);
+    m_cellSize = std::max(extentX / m_gridCellsX, extentZ / m_gridCellsZ);
+    m_gridCellsX = std::max(1, static_cast<int>(std::ceil(extentX / m_cellSize)));
+    m_gridCellsZ = std::max(1, static_cast<int>(std::ceil(extentZ / m_cellSize)));
+
+    auto cellCoord = [this](float value, float gridMin, int cells) {
+        int c = static_cast<int>(std::floor((value - gridMin) / m_cellSize));
+        return std::clamp(c, 0, cells - 1);
+    };
+
+    // Trekantens XZ-bounding box i celler
+    auto triangleCellRange = [&](size_t triangle, int& x0, int& x1, int& z0, int& z1) {
+        const glm::vec3& a = m_vertices[m_indices[triangle * 3]].pos;
+        const glm::vec3& b = m_vertices[m_indices[triangle * 3 + 1]].pos;
+        const glm::vec3& c = m_vertices[m_indices[triangle * 3 + 2]].pos;
+        x0 = cellCoord(std::min({a.x, b.x, c.x}), m_gridMin.x, m_gridCellsX);
+        x1 = cellCoord(std::max({a.x, b.x, c.x}), m_gridMin.x, m_gridCellsX);
+        z0 = cellCoord(std::min({a.z, b.z, c.z}), m_gridMin.y, m_gridCellsZ);
+        z1 = cellCoord(std::max({a.z, b.z, c.z}), m_gridMin.y, m_gridCellsZ);
+    };
+
+    size_t cellCount = static_cast<size_t>(m_gridCellsX) * m_gridCellsZ;
+    m_cellStart.assign(cellCount + 1, 0);
+
+    // Første pass: tell trekanter per celle
+    for (size_t t = 0; t < triangleCount; ++t) {
+        int x0, x1, z0, z1;
+        triangleCellRange(t, x0, x1, z0, z1);
+        for (int z = z0; z <= z1; ++z)
+            for (int x = x0; x <= x1; ++x)
+                ++m_cellStart[z * m_gridCellsX + x + 1];
+    }
+
+    for (size_t c = 0; c < cellCount; ++c)
+        m_cellStart[c + 1] += m_cellStart[c];
+
+    // Andre pass: fyll inn trekantindeksene
+    m_cellTriangles.resize(m_cellStart[cellCount]);
+    std::vector<uint32_t> cursor(m_cellStart.begin(), m_cellStart.end() - 1);
+    for (size_t t = 0; t < triangleCount; ++t) {
+        int x0, x1, z0, z1;
+        triangleCellRange(t, x0, x1, z0, z1);
+        for (int z = z0; z <= z1; ++z)
+            for (int x = x0; x <= x1; ++x)
+                m_cellTriangles[cursor[z * m_gridCellsX + x]++] = static_cast<uint32_t>(t);
+    }
+
+    qDebug() << "Terrain grid:" << m_gridCellsX << "x" << m_gridCellsZ << "cells,"
+             << m_cellTriangles.size() << "triangle references";
+}
+
+bool Terrain::clipRayToGrid(const glm::vec3& origin, const glm::vec3& dir, float& tEnter, float& tExit) const
+{
+    glm::vec3 boxMin(m_gridMin.x, m_minY, m_gridMin.y);
+    glm::vec3 boxMax(m_gridMin.x + m_gridCellsX * m_cellSize, m_maxY, m_gridMin.y + m_gridCellsZ * m_cellSize);
+
+    tEnter = 0.0f;
+    tExit = FLT_MAX;
+    for (int axis = 0; axis < 3; ++axis) {
+        if (std::abs(dir[axis]) < 1e-8f) {
+            if (origin[axis] < boxMin[axis] || origin[axis] > boxMax[axis])
+                return false;
+            continue;
+        }
+        float invDir = 1.0f / dir[axis];
+        float t0 = (boxMin[axis] - origin[axis]) * invDir;
+        float t1 = (boxMax[axis] - origin[axis]) * invDir;
+        if (t0 > t1)
+            std::swap(t0, t1);
+        tEnter = std::max(tEnter, t0);
+        tExit = std::min(tExit, t1);
+        if (tEnter > tExit)
+            return false;
+    }
+    return true;
+}
+
+// 2D DDA (Amanatides & Woo) i XZ-planet
+template <typename CellVisitor>
+void Terrain::traverseGrid(const glm::vec3& origin, const glm::vec3& dir, float maxDistance, CellVisitor&& visitCell) const
+{
+    float tEnter, tExit;
+    if (!clipRayToGrid(origin, dir, tEnter, tExit))
+        return;
+    tExit = std::min(tExit, maxDistance);
+    if (tEnter > tExit)
+        return;
+
+    glm::vec3 start = origin + dir * tEnter;
+    int cellX = std::clamp(static_cast<int>(std::floor((start.x - m_gridMin.x) / m_cellSize)), 0, m_gridCellsX - 1);
+    int cellZ = std::clamp(static_cast<int>(std::floor((start.z - m_gridMin.y) / m_cellSize)), 0, m_gridCellsZ - 1);
+
+    int stepX = (dir.x > 0.0f) ? 1 : (dir.x < 0.0f ? -1 : 0);
+    int stepZ = (dir.z > 0.0f) ? 1 : (dir.z < 0.0f ? -1 : 0);
+
+    float tDeltaX = stepX != 0 ? m_cellSize / std::abs(dir.x) : FLT_MAX;
+    float tDeltaZ = stepZ != 0 ? m_cellSize / std::abs(dir.z) : FLT_MAX;
+
+    float tNextX = FLT_MAX;
+    if (stepX != 0) {
+        float boundary = m_gridMin.x + (cellX + (stepX > 0 ? 1 : 0)) * m_cellSize;
+        tNextX = tEnter + (boundary - start.x) / dir.x;
+    }
+    float tNextZ = FLT_MAX;
+    if (stepZ != 0) {
+        float boundary = m_gridMin.y + (cellZ + (stepZ > 0 ? 1 : 0)) * m_cellSize;
+        tNextZ = tEnter + (boundary - start.z) / dir.z;
+    }
+
+    float tCellEnter = tEnter;
+    while (true) {
+        float tCellExit = std::min(std::min(tNextX, tNextZ), tExit);
+        if (!visitCell(static_cast<uint32_t>(cellZ * m_gridCellsX + cellX), tCellEnter, tCellExit))
+            return;
+        if (tCellExit >= tExit)
+            return;
+
+        if (tNextX < tNextZ) {
+            cellX += stepX;
+            tCellEnter = tNextX;
+            tNextX += tDeltaX;
+            if (cellX < 0 || cellX >= m_gridCellsX)
+                return;
+        } else {
+            cellZ += stepZ;
+            tCellEnter = tNextZ;
+            tNextZ += tDeltaZ;
+            if (cellZ < 0 || cellZ >= m_gridCellsZ)
+                return;
+        }
+    }
+}
+
+// Möller-Trumbore, tosidig
+bool Terrain::intersectTriangle(const glm::vec3& origin, const glm::vec3& dir, uint32_t triangle, float& t) const
+{
+    size_t base = static_cast<size_t>(triangle) * 3;
+    const glm::vec3& v0 = m_vertices[m_indices[base]].pos;
+    const glm::vec3& v1 = m_vertices[m_indices[base + 1]].pos;
+    const glm::vec3& v2 = m_vertices[m_indices[base + 2]].pos;
+
+    glm::vec3 edge1 = v1 - v0;
+    glm::vec3 edge2 = v2 - v0;
+    glm::vec3 p = glm::cross(dir, edge2);
+    float det = glm::dot(edge1, p);
+    if (std::abs(det) < 1e-8f)
+        return false;
+
+    float invDet = 1.0f / det;
+    glm::vec3 s = origin - v0;
+    float u = glm::dot(s, p) * invDet;
+    if (u < 0.0f || u > 1.0f)
+        return false;
+
+    glm::vec3 q = glm::cross(s, edge1);
+    float v = glm::dot(dir, q) * invDet;
+    if (v < 0.0f || u + v > 1.0f)
+        return false;
+
+    t = glm::dot(edge2, q) * invDet;
+    return t > 1e-5f;
+}
+
+glm::vec3 Terrain::triangleNormal(uint32_t triangle, const glm::vec3& dir) const
+{
+    size_t base = static_cast<size_t>(triangle) * 3;
+    const glm::vec3& v0 = m_vertices[m_indices[base]].pos;
+    const glm::vec3& v1 = m_vertices[m_indices[base + 1]].pos;
+    const glm::vec3& v2 = m_vertices[m_indices[base + 2]].pos;
+
+    glm::vec3 normal = glm::cross(v1 - v0, v2 - v0);
+    float length = glm::length(normal);
+    if (length <= 0.0f)
+        return glm::vec3(0.0f, 1.0f, 0.0f);
+
+    // Normalen peker alltid mot strålens opphav
+    normal /= length;
+    return glm::dot(normal, dir) > 0.0f ? -normal : normal;
+}
+
+bool Terrain::raycast(const bbl::Ray& ray, bbl::RaycastHit& hit, const glm::vec3& terrainPosition) const
+{
+    float dirLength = glm::length(ray.direction);
+    if (m_cellStart.empty() || dirLength <= 0.0f)
+        return false;
+
+    glm::vec3 dir = ray.direction / dirLength;
+    glm::vec3 origin = ray.origin - terrainPosition;
+
+    float closest = ray.maxDistance;
+    int32_t closestTriangle = -1;
+
+    traverseGrid(origin, dir, ray.maxDistance, [&](uint32_t cell, float, float tCellExit) {
+        for (uint32_t i = m_cellStart[cell]; i < m_cellStart[cell + 1]; ++i) {
+            float t;
+            if (intersectTriangle(origin, dir, m_cellTriangles[i], t) && t < closest) {
+                closest = t;
+                closestTriangle = static_cast<int32_t>(m_cellTriangles[i]);
+            }
+        }
+        // Et treff innenfor denne cellen kan ikke slås av celler lenger ute
+        return !(closestTriangle >= 0 && closest <= tCellExit);
+    });
+
+    if (closestTriangle < 0)
+        return false;
+
+    hit = bbl::RaycastHit{};
+    hit.hasHit = true;
+    hit.triangleIndex = closestTriangle;
+    hit.distance = closest;
+    hit.point = ray.origin + dir * closest;
+    hit.normal = triangleNormal(static_cast<uint32_t>(closestTriangle), dir);
+    return true;
+}
+
+size_t Terrain::raycastAll(const bbl::Ray& ray, std::vector<bbl::RaycastHit>& hits, const glm::vec3& terrainPosition) const
+{
+    float dirLength = glm::length(ray.direction);
+    if (m_cellStart.empty() || dirLength <= 0.0f)
+        return 0;
+
+    glm::vec3 dir = ray.direction / dirLength;
+    glm::vec3 origin = ray.origin - terrainPosition;
+
+    std::vector<std::pair<uint32_t, float>> candidates;
+    traverseGrid(origin, dir, ray.maxDistance, [&](uint32_t cell, float, float) {
+        for (uint32_t i = m_cellStart[cell]; i < m_cellStart[cell + 1]; ++i) {
+            float t;
+            if (intersectTriangle(origin, dir, m_cellTriangles[i], t) && t <= ray.maxDistance)
+                candidates.emplace_back(m_cellTriangles[i], t);
+        }
+        return true;
+    });
+
+    // En trekant kan ligge i flere celler, fjern duplikater
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end(),
+                                 [](const auto& a, const auto& b) { return a.first == b.first; }),
+                     candidates.end());
+    std::sort(candidates.begin(), candidates.end(),
+              [](const auto& a, const auto& b) { return a.second < b.second; });
+
+    for (const auto& [triangle, t] : candidates) {
+        bbl::RaycastHit hit;
+        hit.hasHit = true;
+        hit.triangleIndex = static_cast<int32_t>(triangle);
+        hit.distance = t;
+        hit.point = ray.origin + dir * t;
+        hit.normal = triangleNormal(triangle, dir);
+        hits.push_back(hit);
+    }
+    return candidates.size();
+}
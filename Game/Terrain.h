@@ -2,6 +2,7 @@
 #define TERRAIN_H
 
 #include "../Core/Utility/Vertex.h"
+#include "../Core/Utility/Raycast.h"
 #include <vector>
 #include <string>
 #include <glm/glm.hpp>
@@ -9,6 +10,14 @@
 class Terrain
 {
 public:
+    // Skalar-parametre som ikke kommer fra meshen (brukes av WorldSnapshot)
+    struct Parameters
+    {
+        float heightScale;
+        float gridSpacing;
+        float heightPlacement;
+    };
+
     Terrain();
     ~Terrain();
 
@@ -16,6 +25,12 @@ public:
 
     float getHeightAt(float worldX, float worldZ, const glm::vec3& terrainPosition = glm::vec3(0.0f)) const;
 
+    // Raycast mot terrenget. Traverserer trekant-gridet i XZ (DDA), så kostnaden
+    // avhenger av hvor mange celler strålen krysser, ikke av antall trekanter.
+    bool raycast(const bbl::Ray& ray, bbl::RaycastHit& hit, const glm::vec3& terrainPosition = glm::vec3(0.0f)) const;
+    // Alle treff langs strålen, sortert etter avstand. Legges til i hits.
+    size_t raycastAll(const bbl::Ray& ray, std::vector<bbl::RaycastHit>& hits, const glm::vec3& terrainPosition = glm::vec3(0.0f)) const;
+
 
     // Get mesh data
     const std::vector<Vertex>& getVertices() const { return m_vertices; }
@@ -24,6 +39,13 @@ public:
     int getWidth() const { return m_width; }
     int getHeight() const { return m_height; }
     float getGridSpacing() const { return m_gridSpacing; }
+    Parameters getParameters() const { return {m_heightScale, m_gridSpacing, m_heightPlacement}; }
+    void setParameters(const Parameters& parameters)
+    {
+        m_heightScale = parameters.heightScale;
+        m_gridSpacing = parameters.gridSpacing;
+        m_heightPlacement = parameters.heightPlacement;
+    }
     glm::vec3 getCenter() const;
 
     void applyFrictionZoneColoring(const glm::vec3& zoneCenter, float radius, const glm::vec3& zoneColor);
@@ -43,11 +65,31 @@ private:
 
     bool isPointInTriangleXZ(const glm::vec2& p, const glm::vec2& a, const glm::vec2& b, const glm::vec2& c) const;
 
+    // Uniform XZ-grid over trekantene, bygget etter lasting
+    void buildTriangleGrid();
+    bool clipRayToGrid(const glm::vec3& origin, const glm::vec3& dir, float& tEnter, float& tExit) const;
+    // Besøker cellene langs strålen i rekkefølge. visitCell returnerer false for å stoppe.
+    template <typename CellVisitor>
+    void traverseGrid(const glm::vec3& origin, const glm::vec3& dir, float maxDistance, CellVisitor&& visitCell) const;
+    bool intersectTriangle(const glm::vec3& origin, const glm::vec3& dir, uint32_t triangle, float& t) const;
+    glm::vec3 triangleNormal(uint32_t triangle, const glm::vec3& dir) const;
+
     std::vector<Vertex> m_vertices;
     std::vector<uint32_t> m_indices;
 
 
     std::vector<float> m_heightData;
+
+    // Trekant-grid (CSR): trekantene i celle c ligger i
+    // m_cellTriangles[m_cellStart[c] .. m_cellStart[c + 1]]
+    glm::vec2 m_gridMin{0.0f};
+    float m_cellSize{1.0f};
+    int m_gridCellsX{0};
+    int m_gridCellsZ{0};
+    float m_minY{0.0f};
+    float m_maxY{0.0f};
+    std::vector<uint32_t> m_cellStart;
+    std::vector<uint32_t> m_cellTriangles;
 };
 
 #endif // TERRAIN_H
@@ -4,7 +4,9 @@ C:/VulkanSDK/1.4.321.1/Bin/glslangValidator.exe -V Shader.frag -o frag.spv
 C:/VulkanSDK/1.4.321.1/Bin/glslangValidator.exe -V Phong.vert -o phong.vert.spv
 C:/VulkanSDK/1.4.321.1/Bin/glslangValidator.exe -V Phong.frag -o phong.frag.spv
 
-C:/VulkanSDK/1.4.321.1/Bin/glslangValidator.exe -V Point.frag -o point.frag.spv
+C:/VulkanSDK/1.4.321.1/Bin/glslangValidator.exe -V Cull.comp -o cull.comp.spv
+
+cmake -DSHADER_DIR=. -P ShaderHashes.cmake
 
 pause
 
@@ -1,4 +1,8 @@
 #version 450
+// Spesialiseringskonstanter, se PipelineRegistry::MaterialFeature
+layout(constant_id = 0) const bool USE_TEXTURE = true;
+layout(constant_id = 1) const bool USE_BLINN = true;
+
 layout(location = 0) out vec4 outColor;
 layout(binding = 1) uniform sampler2D texSampler;
 layout(location = 0) in vec3 inPos;
@@ -12,8 +16,11 @@ layout(location = 7) in vec3 inColor;
 
 void main()
 {
-    bool blinn = true;
-    vec3 color = texture(texSampler, inTexCoord).rgb + inColor;
+    vec3 color = inColor;
+    if (USE_TEXTURE)
+    {
+        color += texture(texSampler, inTexCoord).rgb;
+    }
 
 
     vec3 lightDirection = normalize(lightDir);
@@ -29,7 +36,7 @@ void main()
     // specular
     vec3 viewDir = normalize(viewPos - inPos);
     float spec = 0.0;
-    if(blinn)
+    if(USE_BLINN)
     {
         vec3 halfwayDir = normalize(-lightDirection + viewDir);
         spec = pow(max(dot(normal, halfwayDir), 0.0), 32.0);
@@ -1,6 +1,5 @@
 #version 450
 layout( binding = 0) uniform UniformBufferObject {
-    mat4 model;
     mat4 view;
     mat4 proj;
     vec3 lightPos;
@@ -9,14 +8,13 @@ layout( binding = 0) uniform UniformBufferObject {
     float lightIntensity;
 } ubo;
 
-layout(push_constant) uniform PushConstants {
-    mat4 model;
-} pc;
-
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
 layout (location = 3) in vec3 aColor;
+// Per instans (binding 1), bruker lokasjon 4-7 og 8-10
+layout (location = 4) in mat4 aModel;
+layout (location = 8) in mat3 aNormalMatrix;
 
 layout(location = 0) out vec3 outPos;
 layout(location = 1) out vec3 outNormal;
@@ -30,12 +28,11 @@ layout(location = 7) out vec3 outColor;
 void main()
 {
     // Transform position to world space
-    vec4 worldPos = ubo.model * vec4(aPos, 1.0);
+    vec4 worldPos = aModel * vec4(aPos, 1.0);
     outPos = worldPos.xyz;
 
     // Transform normal to world space
-    mat3 normalMatrix = transpose(inverse(mat3(ubo.model)));
-    outNormal = normalMatrix * aNormal;
+    outNormal = aNormalMatrix * aNormal;
 
     outTexCoords = aTexCoords;
     outLightPos = ubo.lightPos;
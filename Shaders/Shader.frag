@@ -1,5 +1,8 @@
 #version 450
 
+// Spesialiseringskonstanter, se PipelineRegistry::MaterialFeature
+layout(constant_id = 0) const bool USE_TEXTURE = true;
+
 layout(binding = 1) uniform sampler2D texSampler;
 
 layout(location = 0) in vec3 fragColor;
@@ -9,5 +12,6 @@ layout(location = 0) out vec4 outColor;
 
 void main()
 {
-    outColor = texture(texSampler, fragTexCoord);
+    // Punkter og linjer bruker vertex-fargen
+    outColor = USE_TEXTURE ? texture(texSampler, fragTexCoord) : vec4(fragColor, 1.0);
 }
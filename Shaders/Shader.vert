@@ -1,7 +1,6 @@
 #version 450
 
 layout(binding = 0) uniform UniformBufferObject {
-    mat4 model;
     mat4 view;
     mat4 proj;
 } ubo;
@@ -9,12 +8,14 @@ layout(binding = 0) uniform UniformBufferObject {
 layout(location = 0) in vec3 inPosition;
 layout(location = 3) in vec3 inColor;
 layout(location = 2) in vec2 inTexCoord;
+// Per instans (binding 1), bruker lokasjon 4-7
+layout(location = 4) in mat4 inModel;
 
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
 
 void main() {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
+    gl_Position = ubo.proj * ubo.view * inModel * vec4(inPosition, 1.0);
     gl_PointSize = 5;
     fragColor = inColor;
     fragTexCoord = inTexCoord;
@@ -0,0 +1,23 @@
+# Hash av GLSL-kildene som de committede .spv-filene er bygget fra. CMake bruker
+# manifestet til å stoppe bygget hvis kildene er endret uten at .spv er bygget på nytt.
+# Linjeskift normaliseres så CRLF-checkout på Windows gir samme hash.
+set(BBL_SHADER_SOURCES Shader.vert Shader.frag Phong.vert Phong.frag Cull.comp)
+set(BBL_SHADER_OUTPUTS vert.spv frag.spv phong.vert.spv phong.frag.spv cull.comp.spv)
+set(BBL_SHADER_MANIFEST ShaderSources.sha256)
+
+function(bbl_shader_hash SOURCE_PATH OUT_VAR)
+    file(READ ${SOURCE_PATH} CONTENT)
+    string(REPLACE "\r\n" "\n" CONTENT "${CONTENT}")
+    string(SHA256 HASH "${CONTENT}")
+    set(${OUT_VAR} ${HASH} PARENT_SCOPE)
+endfunction()
+
+# cmake -DSHADER_DIR=<Shaders> -P ShaderHashes.cmake skriver manifestet på nytt
+if(CMAKE_SCRIPT_MODE_FILE AND SHADER_DIR)
+    set(MANIFEST "")
+    foreach(SHADER_SOURCE IN LISTS BBL_SHADER_SOURCES)
+        bbl_shader_hash(${SHADER_DIR}/${SHADER_SOURCE} HASH)
+        string(APPEND MANIFEST "${HASH}  ${SHADER_SOURCE}\n")
+    endforeach()
+    file(WRITE ${SHADER_DIR}/${BBL_SHADER_MANIFEST} "${MANIFEST}")
+endif()
@@ -0,0 +1,118 @@
+// TextureBaker: lager .bbltex (se Core/Utility/TextureContainer.h) med ferdig mip-kjede
+// fra JPG/PNG, så motoren slipper å dekode og generere mips ved lasting.
+//
+//   TextureBaker [--force] <bilde eller mappe>...
+//
+// Mapper bakes ikke-rekursivt. Filer der .bbltex allerede er nyere enn bildet hoppes
+// over uten --force. Bygges med målet BakeTextures, som baker Assets/Textures.
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../External/stb_image.h"
+#include "../Core/Utility/JobSystem.h"
+#include "../Core/Utility/TextureContainer.h"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+bool isSourceImage(const fs::path& path)
+{
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return extension == ".jpg" || extension == ".jpeg" || extension == ".png"
+           || extension == ".tga" || extension == ".bmp";
+}
+
+bool isUpToDate(const fs::path& source)
+{
+    std::error_code error;
+    const auto bakedTime = fs::last_write_time(bbl::bakedTexturePath(source.string()), error);
+    if (error) {
+        return false;
+    }
+    const auto sourceTime = fs::last_write_time(source, error);
+    return !error && bakedTime >= sourceTime;
+}
+
+bool bake(bbl::JobSystem& jobs, const fs::path& source)
+{
+    int width = 0, height = 0, channels = 0;
+    stbi_uc* pixels = stbi_load(source.string().c_str(), &width, &height, &channels, STBI_rgb_alpha);
+    std::unique_ptr<stbi_uc, void (*)(void*)> pixelGuard(pixels, stbi_image_free);
+    if (!pixels || width <= 0 || height <= 0) {
+        std::cerr << "  failed to decode " << source.string() << ": " << stbi_failure_reason() << "\n";
+        return false;
+    }
+
+    bbl::TextureContainer texture;
+    texture.width = static_cast<uint32_t>(width);
+    texture.height = static_cast<uint32_t>(height);
+    texture.mipLevels = bbl::mipLevelCount(texture.width, texture.height);
+    texture.data = bbl::buildMipChain(&jobs, pixels, texture.width, texture.height, texture.mipLevels);
+
+    const std::string bakedPath = bbl::bakedTexturePath(source.string());
+    if (!bbl::saveTextureContainer(bakedPath, texture)) {
+        return false;
+    }
+    std::cout << "  " << source.filename().string() << " -> " << fs::path(bakedPath).filename().string()
+              << " (" << width << "x" << height << ", " << texture.mipLevels << " levels, "
+              << texture.data.size() / 1024 << " KiB)\n";
+    return true;
+}
+}
+
+int main(int argc, char* argv[])
+{
+    bool force = false;
+    std::vector<fs::path> sources;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--force") {
+            force = true;
+            continue;
+        }
+
+        std::error_code error;
+        if (fs::is_directory(arg, error)) {
+            for (const fs::directory_entry& entry : fs::directory_iterator(arg, error)) {
+                if (entry.is_regular_file() && isSourceImage(entry.path())) {
+                    sources.push_back(entry.path());
+                }
+            }
+        } else if (fs::is_regular_file(arg, error)) {
+            sources.emplace_back(arg);
+        } else {
+            std::cerr << "TextureBaker: no such file or directory: " << arg << "\n";
+            return 1;
+        }
+    }
+
+    if (sources.empty()) {
+        std::cerr << "Usage: TextureBaker [--force] <image or directory>...\n";
+        return 1;
+    }
+    std::sort(sources.begin(), sources.end());
+
+    bbl::JobSystem jobs;
+    int baked = 0, skipped = 0, failed = 0;
+    for (const fs::path& source : sources) {
+        if (!force && isUpToDate(source)) {
+            ++skipped;
+            continue;
+        }
+        bake(jobs, source) ? ++baked : ++failed;
+    }
+
+    std::cout << "TextureBaker: " << baked << " baked, " << skipped << " up to date, " << failed << " failed\n";
+    return failed > 0 ? 1 : 0;
+}
@@ -2,12 +2,71 @@
 #include "Editor/MainWindow.h"
 #include "../../../Soundsystem/resourcemanager.h"
 #include "../../../Scripting/luamanager.h"
+#include "Core/Utility/JobSystem.h"
+#include "Core/Utility/BblHub.h"
+#include "Core/Benchmark.h"
 
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QDebug>
+#include <cstring>
+
+namespace
+{
+// QtVulkan --benchmark <scene> [--frames N] [--warmup N] [--size WxH] [--screenshot fil.png]
+//          [--frames-in-flight N]
+int runBenchmark(const QApplication& app)
+{
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption sceneOption("benchmark", "Render <scene> headless and print frame times.", "scene");
+    QCommandLineOption framesOption("frames", "Measured frames.", "N", "300");
+    QCommandLineOption warmupOption("warmup", "Frames rendered before measuring.", "N", "60");
+    QCommandLineOption sizeOption("size", "Render target size.", "WxH", "1280x720");
+    QCommandLineOption screenshotOption("screenshot", "Save the last frame as an image.", "file");
+    QCommandLineOption inFlightOption("frames-in-flight", "Frames the CPU may be ahead of the GPU.", "N", "0");
+    parser.addOptions({sceneOption, framesOption, warmupOption, sizeOption, screenshotOption, inFlightOption});
+    parser.process(app);
+
+    bbl::BenchmarkOptions options;
+    options.scenePath = parser.value(sceneOption);
+    options.frames = parser.value(framesOption).toUInt();
+    options.warmupFrames = parser.value(warmupOption).toUInt();
+    options.screenshotPath = parser.value(screenshotOption);
+    options.framesInFlight = parser.value(inFlightOption).toUInt();
+
+    const QStringList size = parser.value(sizeOption).split('x');
+    options.width = size.value(0).toUInt();
+    options.height = size.value(1).toUInt();
+    if (options.width == 0 || options.height == 0 || options.frames == 0) {
+        qCritical() << "Benchmark: invalid --size or --frames";
+        return 1;
+    }
+    return bbl::runBenchmark(options);
+}
+}
 
 int main(int argc, char *argv[])
 {
+    // Benchmark skal gå uten skjerm (CI, lavapipe), det må Qt vite før QApplication lages
+    bool benchmark = false;
+    for (int i = 1; i < argc; ++i) {
+        benchmark = benchmark || std::strncmp(argv[i], "--benchmark", 11) == 0;
+    }
+    if (benchmark && !qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
     QApplication a(argc, argv);
+
+    // Må leve lenger enn alt som kan legge jobber i den
+    bbl::JobSystem jobSystem;
+    BBLHub::Instance().setJobSystem(&jobSystem);
+
+    if (benchmark) {
+        return runBenchmark(a);
+    }
+
     ResourceManager resourceMgr;         //Create sound manager
     MainWindow w(&resourceMgr);          //Pass pointer to MainWindow
     w.move(200, 100);